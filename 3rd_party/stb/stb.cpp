@@ -20,6 +20,9 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+// stb_image records failure reasons in a global variable, which isn't safe
+// when decoding on multiple threads at once. We never query them anyway.
+#define STBI_NO_FAILURE_STRINGS
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
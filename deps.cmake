@@ -2,6 +2,7 @@ set(CMAKE_MODULE_PATH ${CMAKE_MODULE_PATH} "${CMAKE_CURRENT_LIST_DIR}/cmake/Modu
 
 find_package(SDL2 REQUIRED)
 find_package(Filesystem REQUIRED COMPONENTS Final)
+find_package(Threads REQUIRED)
 find_package(Boost)
 find_package(Git)
 
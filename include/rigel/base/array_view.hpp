@@ -18,6 +18,8 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <type_traits>
+#include <utility>
 
 
 namespace rigel::base
@@ -71,7 +73,11 @@ public:
   }
 
   // implicit on purpose
-  template <typename Container>
+  template <
+    typename Container,
+    typename = std::enable_if_t<std::is_convertible_v<
+      decltype(std::declval<const Container&>().data()),
+      const_pointer>>>
   constexpr ArrayView(const Container& c) noexcept // NOLINT
     : mpData(c.data())
     , mSize(static_cast<size_type>(c.size()))
@@ -0,0 +1,100 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <rigel/base/image.hpp>
+#include <rigel/base/thread_pool.hpp>
+
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+
+namespace rigel::base
+{
+
+/** Loads and decodes images in parallel on a pool of worker threads
+ *
+ * There are two ways of getting at the results:
+ *
+ *  1. loadImageAsync()/loadImagesAsync() return futures.
+ *  2. requestImages() takes a callback, which is invoked on the thread
+ *     calling processCompletions(). The idea is to call processCompletions()
+ *     once per frame from the function given to runApp(), so that results
+ *     can be handed straight to code that isn't thread-safe, like OpenGL
+ *     texture creation.
+ *
+ * Files are memory-mapped and decoded via loadImage(). Loading a file that
+ * doesn't exist or can't be decoded produces an empty optional, like
+ * loadImage() does.
+ *
+ * Destroying the loader waits for all outstanding work to finish. Callbacks
+ * of requests that weren't processed yet are not invoked.
+ */
+class AssetLoader
+{
+public:
+  using ImageLoadedFunc =
+    std::function<void(const std::filesystem::path&, std::optional<Image>)>;
+
+  explicit AssetLoader(std::size_t numThreads = defaultNumWorkerThreads());
+
+  std::future<std::optional<Image>>
+    loadImageAsync(const std::filesystem::path& path);
+
+  std::vector<std::future<std::optional<Image>>>
+    loadImagesAsync(const std::vector<std::filesystem::path>& paths);
+
+  void requestImages(
+    const std::vector<std::filesystem::path>& paths,
+    const ImageLoadedFunc& onLoaded);
+
+  /** Invoke callbacks for all requests completed since the last call
+   *
+   * Must be called from the thread that made the requests. If loading or
+   * one of the callbacks threw an exception, the first one is rethrown here
+   * after invoking all other callbacks. Completions are never lost this
+   * way. Returns the number of callbacks invoked.
+   */
+  std::size_t processCompletions();
+
+  /** Number of requests whose callbacks haven't been invoked yet */
+  std::size_t numPendingRequests() const { return mNumPendingRequests; }
+
+private:
+  struct Completion
+  {
+    std::filesystem::path mPath;
+    std::optional<Image> mImage;
+    std::exception_ptr mpError;
+    ImageLoadedFunc mOnLoaded;
+  };
+
+  std::mutex mCompletionsMutex;
+  std::vector<Completion> mCompletions;
+  std::size_t mNumPendingRequests = 0;
+
+  // Must come last, so that the worker threads are joined before any of the
+  // state they access is destroyed.
+  ThreadPool mThreadPool;
+};
+
+} // namespace rigel::base
@@ -16,10 +16,14 @@
 
 #pragma once
 
+#include <rigel/base/array_view.hpp>
+
+#include <array>
 #include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
@@ -44,12 +48,21 @@ std::string asText(const ByteBuffer& buffer);
 
 /** Offers checked reading of little-endian data from a byte buffer
  *
- * All readX() methods will throw if there is not enough data left.
+ * All readX() methods will throw if there is not enough data left. Each
+ * read is bounds-checked once as a whole, and a read that fails doesn't
+ * consume any data.
+ *
+ * The reader can operate on any contiguous range of bytes, e.g. a memory
+ * mapped file (see MappedFile). currentIter() is only available for readers
+ * constructed from a ByteBuffer or ByteBuffer iterators, it throws
+ * std::logic_error otherwise.
  */
 class LeStreamReader
 {
 public:
   explicit LeStreamReader(const ByteBuffer& data);
+  explicit LeStreamReader(ArrayView<std::uint8_t> data);
+  explicit LeStreamReader(std::string_view data);
   LeStreamReader(ByteBufferCIter begin, ByteBufferCIter end);
 
   std::uint8_t readU8();
@@ -74,6 +87,31 @@ public:
   std::int32_t peekS24();
   std::int32_t peekS32();
 
+  /** Read count consecutive values into the memory pointed to by pOut
+   *
+   * The whole array is bounds-checked up front. On little-endian hosts, this
+   * is a plain memory copy.
+   */
+  void readArrayU8(std::size_t count, std::uint8_t* pOut);
+  void readArrayU16(std::size_t count, std::uint16_t* pOut);
+  void readArrayU32(std::size_t count, std::uint32_t* pOut);
+
+  template <std::size_t N>
+  std::array<std::uint16_t, N> readU16Batch()
+  {
+    std::array<std::uint16_t, N> result;
+    readArrayU16(N, result.data());
+    return result;
+  }
+
+  template <std::size_t N>
+  std::array<std::uint32_t, N> readU32Batch()
+  {
+    std::array<std::uint32_t, N> result;
+    readArrayU32(N, result.data());
+    return result;
+  }
+
   void skipBytes(std::size_t count);
   bool hasData() const;
   size_t numBytesLeft() const;
@@ -83,8 +121,12 @@ private:
   template <typename Callable>
   auto withPreservingCurrentIter(Callable func);
 
-  ByteBufferCIter mCurrentByteIter;
-  const ByteBufferCIter mDataEnd;
+  const std::uint8_t* consume(std::size_t count, std::size_t elementSize = 1);
+
+  const std::uint8_t* mpCurrentByte;
+  const std::uint8_t* const mpDataBegin;
+  const std::uint8_t* const mpDataEnd;
+  const std::optional<ByteBufferCIter> mDataBeginIter;
 };
 
 
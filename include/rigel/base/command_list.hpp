@@ -0,0 +1,112 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace rigel::base
+{
+
+/** A list of deferred function calls, executed in the order they were added
+ *
+ * Meant for recording work on one thread and running it on another, e.g.
+ * GL calls made by a render thread. Any callable object can be added,
+ * including move-only ones. They are stored in memory blocks which are kept
+ * when the list is cleared, so a list that is reused every frame stops
+ * allocating once it has reached its working size.
+ */
+class CommandList
+{
+public:
+  CommandList() = default;
+  ~CommandList();
+
+  CommandList(const CommandList&) = delete;
+  CommandList& operator=(const CommandList&) = delete;
+
+  template <typename Func>
+  void add(Func&& func);
+
+  /** Run all commands in order, then clear the list
+   *
+   * If a command throws, the remaining ones are destroyed without running.
+   */
+  void execute();
+
+  /** Destroy all commands without running them */
+  void clear();
+
+  bool empty() const { return mCommands.empty(); }
+  std::size_t size() const { return mCommands.size(); }
+
+private:
+  struct Command
+  {
+    void* mpStorage;
+    void (*mpInvoke)(void*);
+    void (*mpDestroy)(void*);
+  };
+
+  struct Block
+  {
+    std::unique_ptr<std::byte[]> mpData;
+    std::size_t mSize;
+  };
+
+  void* allocate(std::size_t size, std::size_t alignment);
+
+  std::vector<Command> mCommands;
+  std::vector<Block> mBlocks;
+  std::size_t mCurrentBlock = 0;
+  std::size_t mOffsetInBlock = 0;
+};
+
+
+template <typename Func>
+void CommandList::add(Func&& func)
+{
+  using Stored = std::decay_t<Func>;
+
+  static_assert(
+    alignof(Stored) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+    "Over-aligned commands are not supported");
+
+  const auto pStorage = allocate(sizeof(Stored), alignof(Stored));
+  const auto pFunc = new (pStorage) Stored(std::forward<Func>(func));
+
+  try
+  {
+    mCommands.push_back(Command{
+      pStorage,
+      [](void* p) { (*static_cast<Stored*>(p))(); },
+      [](void* p) { static_cast<Stored*>(p)->~Stored(); }});
+  }
+  catch (...)
+  {
+    pFunc->~Stored();
+    throw;
+  }
+}
+
+} // namespace rigel::base
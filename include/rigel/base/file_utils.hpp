@@ -0,0 +1,34 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+
+
+namespace rigel::base
+{
+
+/** Returns a unique path in the same directory as the given one
+ *
+ * Meant for writing a file under a temporary name and then renaming it to
+ * its final name, so that readers never see a partially written file. The
+ * result is unique across threads and processes, so several of them can
+ * write the same file concurrently.
+ */
+std::filesystem::path temporaryPathFor(const std::filesystem::path& path);
+
+} // namespace rigel::base
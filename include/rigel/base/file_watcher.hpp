@@ -0,0 +1,80 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <set>
+#include <vector>
+
+#ifdef __linux__
+  #include <unordered_map>
+#else
+  #include <map>
+#endif
+
+
+namespace rigel::base
+{
+
+/** Reports modifications of a set of files
+ *
+ * On Linux, this uses inotify, so checking for changes is a single
+ * non-blocking read. The directories containing the files are watched,
+ * rather than the files themselves. Many editors save by writing a new file
+ * and renaming it over the original, which would end a watch on the file.
+ * On other platforms, the files' modification times are compared on every
+ * call to pollChanges().
+ *
+ * Paths are made absolute and normalized, both when passed to watch() and
+ * when returned from pollChanges().
+ */
+class FileWatcher
+{
+public:
+  FileWatcher();
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  /** Start watching the given file, if not watched already
+   *
+   * The file's directory must exist. Throws std::runtime_error if it can't
+   * be watched.
+   */
+  void watch(const std::filesystem::path& path);
+
+  /** Return the watched files modified since the last call
+   *
+   * Each file is reported once, even if it was modified several times.
+   * Files that were deleted aren't reported until they are created again.
+   */
+  std::vector<std::filesystem::path> pollChanges();
+
+private:
+  std::set<std::filesystem::path> mFiles;
+
+#ifdef __linux__
+  int mInotifyFd = -1;
+  std::unordered_map<int, std::filesystem::path> mDirectoriesByWatch;
+#else
+  std::map<std::filesystem::path, std::filesystem::file_time_type>
+    mModificationTimes;
+#endif
+};
+
+} // namespace rigel::base
@@ -0,0 +1,147 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/base/clock.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+
+namespace rigel::base
+{
+
+struct FrameSchedulerConfig
+{
+  /** Duration of a fixed update step in seconds, 0 disables fixed updates
+   *
+   * When set, FrameTiming::numUpdates tells how many simulation steps of
+   * this size to run in the current frame.
+   */
+  double fixedTimeStep = 0.0;
+
+  /** Upper limit for FrameTiming::numUpdates
+   *
+   * If a frame takes so long that more updates would be needed, the excess
+   * time is dropped. This avoids a "spiral of death" where catching up makes
+   * frames take even longer.
+   */
+  int maxUpdatesPerFrame = 8;
+
+  /** Frame rate cap, 0 for no limit */
+  double maxFps = 0.0;
+
+  /** Expected frame rate for late-frame detection, when not capping
+   *
+   * Typically the display's refresh rate when vsync is enabled. Not needed
+   * if maxFps is set.
+   */
+  double expectedFps = 0.0;
+
+  /** How long before a frame's deadline to stop sleeping, in seconds
+   *
+   * Sleeping is imprecise, the remaining time is spent busy-waiting.
+   */
+  double spinThreshold = 0.002;
+};
+
+
+struct FrameSchedulerStats
+{
+  std::uint64_t numFrames = 0;
+
+  /** Frames that missed their deadline */
+  std::uint64_t numLateFrames = 0;
+
+  /** Fixed updates skipped due to maxUpdatesPerFrame */
+  std::uint64_t numDroppedUpdates = 0;
+
+  /** Largest amount of time by which a deadline was missed, in seconds */
+  double worstLateness = 0.0;
+};
+
+
+struct FrameTiming
+{
+  std::uint64_t frameNumber = 0;
+
+  /** Time since the start of the previous frame in seconds */
+  double elapsed = 0.0;
+
+  /** Number of fixed update steps to run in this frame */
+  int numUpdates = 0;
+
+  /** How far the current time is into the next fixed update step, [0, 1)
+   *
+   * For interpolating between the last two simulation states when
+   * rendering.
+   */
+  double interpolationAlpha = 0.0;
+
+  /** True if the previous frame missed its deadline */
+  bool previousFrameWasLate = false;
+
+  FrameSchedulerStats stats;
+};
+
+
+/** Paces the main loop and provides fixed-timestep update counts
+ *
+ * Call beginFrame() at the start of each iteration of the main loop. If a
+ * frame rate cap is configured, it waits until the next frame is due, by
+ * sleeping first and then spinning for the last bit, for accurate timing
+ * without burning a full CPU core.
+ *
+ * Frames that start after their deadline count as late. The schedule is
+ * then restarted from the current time, instead of trying to catch up with
+ * several short frames in a row.
+ */
+class FrameScheduler
+{
+public:
+  explicit FrameScheduler(const FrameSchedulerConfig& config = {});
+
+  FrameTiming beginFrame();
+
+  /** Tell the scheduler that the application deliberately paused
+   *
+   * To be called after waiting for input while idle. The next frame then
+   * isn't counted as late, and the schedule restarts from that frame's start
+   * time. The pause still counts towards the next frame's elapsed time.
+   */
+  void onIdleWait() { mResumingFromIdleWait = true; }
+
+  const FrameSchedulerStats& stats() const { return mStats; }
+
+private:
+  void waitUntil(Clock::time_point deadline) const;
+  void recordLateFrame(double lateness);
+
+  FrameSchedulerConfig mConfig;
+  std::optional<Clock::duration> mFrameDuration;
+
+  std::optional<Clock::time_point> mLastFrameStart;
+  std::optional<Clock::time_point> mNextDeadline;
+  double mAccumulatedTime = 0.0;
+  bool mResumingFromIdleWait = false;
+
+  FrameSchedulerStats mStats;
+};
+
+} // namespace rigel::base
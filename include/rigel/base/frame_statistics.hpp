@@ -0,0 +1,64 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <ostream>
+#include <vector>
+
+
+namespace rigel::base
+{
+
+/** Summary of a series of frame times, all values in seconds */
+struct FrameTimeSummary
+{
+  std::size_t numFrames = 0;
+  double min = 0.0;
+  double max = 0.0;
+  double mean = 0.0;
+  double median = 0.0;
+  double p90 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+};
+
+
+/** Compute summary statistics for the given frame times (in seconds)
+ *
+ * Percentiles use the nearest-rank method, so they are always one of the
+ * measured values. All values are 0 if frameTimes is empty.
+ */
+FrameTimeSummary summarizeFrameTimes(const std::vector<double>& frameTimes);
+
+
+/** Write frame times and their summary as JSON
+ *
+ * The output is an object with a "summary" member holding the fields of
+ * FrameTimeSummary, and a "frameTimes" array listing all individual frame
+ * times. All times are written in milliseconds.
+ */
+void writeFrameTimesJson(
+  std::ostream& stream,
+  const std::vector<double>& frameTimes);
+bool saveFrameTimesJson(
+  const std::filesystem::path& path,
+  const std::vector<double>& frameTimes);
+
+} // namespace rigel::base
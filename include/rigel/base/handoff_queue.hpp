@@ -0,0 +1,201 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+
+namespace rigel::base
+{
+
+/** Fixed set of objects passed back and forth between two threads
+ *
+ * The queue owns a fixed number of T objects ("slots"), which are reused
+ * for its whole lifetime. A single producer thread fills slots between
+ * beginWrite() and endWrite(), and a single consumer thread processes them
+ * in the same order between beginRead() and endRead(). With two slots, this
+ * is double buffering: the producer fills one slot while the consumer works
+ * on the other. More slots let the producer get further ahead.
+ *
+ * Handing over a slot is lock-free. A thread only blocks, after spinning
+ * briefly, if it has to wait because all slots are full or empty,
+ * respectively.
+ *
+ * close() makes both sides stop waiting. Slots that were already filled can
+ * still be read after closing.
+ */
+template <typename T>
+class HandoffQueue
+{
+public:
+  explicit HandoffQueue(std::size_t numSlots);
+
+  HandoffQueue(const HandoffQueue&) = delete;
+  HandoffQueue& operator=(const HandoffQueue&) = delete;
+
+  /** Wait for a free slot. Returns nullptr if the queue has been closed. */
+  T* beginWrite();
+  void endWrite();
+
+  /** Wait for a filled slot
+   *
+   * Returns nullptr if the queue has been closed and there are no more
+   * filled slots.
+   */
+  T* beginRead();
+  void endRead();
+
+  void close();
+  bool isClosed() const { return mClosed.load(); }
+
+private:
+  template <typename Predicate>
+  void waitUntil(Predicate isReady);
+  void wakeWaitingThread();
+
+  std::unique_ptr<T[]> mpSlots;
+  std::size_t mNumSlots;
+
+  // Total number of slots written and read so far. The difference is the
+  // number of filled slots. Sequentially consistent operations are used
+  // throughout, which is required for the sleep/wake-up protocol.
+  std::atomic<std::uint64_t> mNumWritten{0};
+  std::atomic<std::uint64_t> mNumRead{0};
+  std::atomic<bool> mClosed{false};
+
+  // Only used for sleeping while waiting
+  std::mutex mWaitMutex;
+  std::condition_variable mWaitCondition;
+  std::atomic<int> mNumWaitingThreads{0};
+};
+
+
+template <typename T>
+HandoffQueue<T>::HandoffQueue(const std::size_t numSlots)
+  : mpSlots(std::make_unique<T[]>(numSlots))
+  , mNumSlots(numSlots)
+{
+  if (numSlots == 0)
+  {
+    throw std::invalid_argument("HandoffQueue needs at least one slot");
+  }
+}
+
+
+template <typename T>
+T* HandoffQueue<T>::beginWrite()
+{
+  const auto numWritten = mNumWritten.load();
+  waitUntil([&]() {
+    return mClosed.load() || numWritten - mNumRead.load() < mNumSlots;
+  });
+
+  if (mClosed.load())
+  {
+    return nullptr;
+  }
+
+  return &mpSlots[numWritten % mNumSlots];
+}
+
+
+template <typename T>
+void HandoffQueue<T>::endWrite()
+{
+  mNumWritten.fetch_add(1);
+  wakeWaitingThread();
+}
+
+
+template <typename T>
+T* HandoffQueue<T>::beginRead()
+{
+  const auto numRead = mNumRead.load();
+  waitUntil([&]() { return mClosed.load() || mNumWritten.load() != numRead; });
+
+  if (mNumWritten.load() == numRead)
+  {
+    return nullptr;
+  }
+
+  return &mpSlots[numRead % mNumSlots];
+}
+
+
+template <typename T>
+void HandoffQueue<T>::endRead()
+{
+  mNumRead.fetch_add(1);
+  wakeWaitingThread();
+}
+
+
+template <typename T>
+void HandoffQueue<T>::close()
+{
+  mClosed.store(true);
+
+  std::lock_guard lock{mWaitMutex};
+  mWaitCondition.notify_all();
+}
+
+
+template <typename T>
+template <typename Predicate>
+void HandoffQueue<T>::waitUntil(Predicate isReady)
+{
+  constexpr auto NUM_SPINS = 64;
+
+  for (auto i = 0; i < NUM_SPINS; ++i)
+  {
+    if (isReady())
+    {
+      return;
+    }
+
+    std::this_thread::yield();
+  }
+
+  // The other thread checks mNumWaitingThreads after updating the counters.
+  // Since we register before checking the counters under the lock, either
+  // we see its update, or it sees us waiting and notifies.
+  std::unique_lock lock{mWaitMutex};
+  mNumWaitingThreads.fetch_add(1);
+  mWaitCondition.wait(lock, isReady);
+  mNumWaitingThreads.fetch_sub(1);
+}
+
+
+template <typename T>
+void HandoffQueue<T>::wakeWaitingThread()
+{
+  if (mNumWaitingThreads.load() > 0)
+  {
+    std::lock_guard lock{mWaitMutex};
+    mWaitCondition.notify_all();
+  }
+}
+
+} // namespace rigel::base
@@ -0,0 +1,52 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+
+namespace rigel::base
+{
+
+constexpr auto HASH_SEED = std::uint64_t{0xCBF29CE484222325};
+
+
+/** Fast non-cryptographic 64-bit hash, a variant of FNV-1a
+ *
+ * Works on 8 bytes at a time, so that it's fast enough for hashing large
+ * buffers like per-frame vertex data. The result depends on the host's byte
+ * order, so it's only meant for data that stays on the same machine, like
+ * cache keys. Multiple values can be combined by passing the result of the
+ * previous call as hash.
+ */
+std::uint64_t hashBytes(
+  const void* pData,
+  std::size_t size,
+  std::uint64_t hash = HASH_SEED);
+
+
+/** Hash the object representation of value, including any padding bytes */
+template <typename T>
+std::uint64_t hashValue(const T& value, const std::uint64_t hash = HASH_SEED)
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+  return hashBytes(&value, sizeof(value), hash);
+}
+
+} // namespace rigel::base
@@ -18,6 +18,7 @@
 
 #include <rigel/base/color.hpp>
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -29,6 +30,86 @@ using Pixel = rigel::base::Color;
 using PixelBuffer = std::vector<Pixel>;
 
 
+namespace detail
+{
+
+/** Premultiply count pixels, source and destination may be the same
+ *
+ * Uses SIMD instructions where available.
+ */
+void premultiplyAlpha(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  std::size_t count);
+
+/** Alpha-blend count premultiplied pixels onto the destination (source-over)
+ *
+ * Uses SIMD instructions where available.
+ */
+void blendPremultiplied(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  std::size_t count);
+
+} // namespace detail
+
+
+/** Non-owning view of a rectangular region of pixels
+ *
+ * Consecutive rows are stride pixels apart, which allows referring to a part
+ * of a larger image without copying it. The stride can be negative, which
+ * makes for a vertically flipped view. The view must not outlive the pixel
+ * data it refers to.
+ */
+class ImageView
+{
+public:
+  ImageView(const Pixel* pPixels, std::size_t width, std::size_t height);
+  ImageView(
+    const Pixel* pPixels,
+    std::size_t width,
+    std::size_t height,
+    std::ptrdiff_t stride);
+
+  std::size_t width() const { return mWidth; }
+
+  std::size_t height() const { return mHeight; }
+
+  std::ptrdiff_t stride() const { return mStride; }
+
+  bool empty() const { return mWidth == 0 || mHeight == 0; }
+
+  const Pixel* row(const std::size_t y) const
+  {
+    return mpPixels + static_cast<std::ptrdiff_t>(y) * mStride;
+  }
+
+  const Pixel& pixel(const std::size_t x, const std::size_t y) const
+  {
+    return row(y)[x];
+  }
+
+  /** View of the given region, which must lie within this view */
+  ImageView subView(
+    std::size_t x,
+    std::size_t y,
+    std::size_t width,
+    std::size_t height) const;
+
+  /** View of the same pixels, with the order of rows reversed */
+  ImageView flippedVertically() const;
+
+  /** True if the rows are laid out back to back, top to bottom */
+  bool isContiguous() const { return mStride == std::ptrdiff_t(mWidth); }
+
+private:
+  const Pixel* mpPixels;
+  std::size_t mWidth;
+  std::size_t mHeight;
+  std::ptrdiff_t mStride;
+};
+
+
 /** 2D image (bitmap), RGBA */
 class Image
 {
@@ -37,21 +118,46 @@ public:
   Image(const PixelBuffer& pixels, std::size_t width, std::size_t height);
   Image(std::size_t width, std::size_t height);
 
+  /** Copies the pixels referenced by the given view */
+  explicit Image(const ImageView& view);
+
   const PixelBuffer& pixelData() const { return mPixels; }
 
+  ImageView view() const { return {mPixels.data(), mWidth, mHeight}; }
+
+  /** View of the given region, which must lie within the image */
+  ImageView subView(
+    std::size_t x,
+    std::size_t y,
+    std::size_t width,
+    std::size_t height) const
+  {
+    return view().subView(x, y, width, height);
+  }
+
   std::size_t width() const { return mWidth; }
 
   std::size_t height() const { return mHeight; }
 
-  /** Returns a vertically flipped copy of the image */
+  /** Returns a vertically flipped copy of the image
+   *
+   * To avoid the copy, use flipVertically() or view().flippedVertically().
+   */
   Image flipped() const;
 
+  /** Flips the image vertically in place */
+  void flipVertically();
+
   /** Returns a copy of the image, converted to premultiplied alpha */
   Image withPremultipliedAlpha() const;
 
+  /** Converts the image to premultiplied alpha in place */
+  void premultiplyAlpha();
+
   /** Copy given image's pixels into this image
    *
-   * The source image must fit into the target image.
+   * The source image must fit into the target image. The source may be a
+   * view into this image, also if it overlaps the destination region.
    */
   void insertImage(std::size_t x, std::size_t y, const Image& image);
 
@@ -61,6 +167,22 @@ public:
     const PixelBuffer& pixels,
     std::size_t sourceWidth);
 
+  void insertImage(std::size_t x, std::size_t y, const ImageView& source);
+
+  /** Copy given pixels into this image, discarding parts that don't fit
+   *
+   * The position may be negative or lie outside of the image.
+   */
+  void insertImageClipped(int x, int y, const ImageView& source);
+
+  /** Alpha-blend given pixels onto this image, discarding parts that don't fit
+   *
+   * Both source and target are expected to use premultiplied alpha, the
+   * source is composited on top (source-over). The source must not overlap
+   * this image's pixels.
+   */
+  void blendImage(int x, int y, const ImageView& source);
+
   /** Create Image containing only the pixels in the specified region */
   Image extractSubImage(
     std::size_t x,
@@ -0,0 +1,130 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <rigel/base/image.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+
+namespace rigel::base
+{
+
+struct ImageCacheConfig
+{
+  /** Maximum total size of decoded images kept in memory */
+  std::size_t memoryBudgetBytes = 256 * 1024 * 1024;
+
+  /** Directory for storing decoded images on disk, disabled if not set
+   *
+   * The directory is created if it doesn't exist yet.
+   */
+  std::optional<std::filesystem::path> diskCacheDirectory;
+
+  /** Convert images to premultiplied alpha before caching them */
+  bool premultiplyAlpha = false;
+};
+
+
+struct ImageCacheStats
+{
+  std::size_t memoryHits = 0;
+  std::size_t diskHits = 0;
+  std::size_t decodes = 0;
+};
+
+
+/** Caches decoded images, to avoid loading and decoding them repeatedly
+ *
+ * Images are identified by their path, size and modification time, so
+ * modifying a file causes it to be decoded again on the next load. The
+ * outdated version is dropped from memory and from the disk cache at that
+ * point, so editing images doesn't make the cache grow.
+ *
+ * Decoded images are kept in memory up to the configured budget, evicting
+ * the least recently used ones first. If a disk cache directory is set,
+ * decoded images are also written there in a raw format, which is mapped
+ * into memory on subsequent loads. This skips PNG decompression entirely,
+ * even across application restarts.
+ *
+ * All functions are thread-safe.
+ */
+class ImageCache
+{
+public:
+  explicit ImageCache(ImageCacheConfig config = {});
+
+  /** Load image, from cache if possible
+   *
+   * Returns nullptr if the file doesn't exist or can't be decoded. The
+   * returned image stays valid even if it's evicted from the cache.
+   */
+  std::shared_ptr<const Image> load(const std::filesystem::path& path);
+
+  /** Drop all images held in memory. Doesn't affect the disk cache. */
+  void clear();
+
+  std::size_t memoryUsage() const;
+
+  ImageCacheStats stats() const;
+
+private:
+  // The path key identifies the source file, the content key the version
+  // of its contents. There's at most one entry per path key.
+  struct Entry
+  {
+    std::uint64_t mPathKey;
+    std::uint64_t mContentKey;
+    std::shared_ptr<const Image> mpImage;
+    std::size_t mSizeInBytes;
+  };
+
+  std::shared_ptr<const Image>
+    findInMemory(std::uint64_t pathKey, std::uint64_t contentKey);
+  void insertIntoMemory(
+    std::uint64_t pathKey,
+    std::uint64_t contentKey,
+    std::shared_ptr<const Image> pImage);
+  void removeEntry(std::list<Entry>::iterator iEntry);
+
+  std::optional<Image>
+    loadFromDisk(std::uint64_t pathKey, std::uint64_t contentKey) const;
+  void saveToDisk(
+    std::uint64_t pathKey,
+    std::uint64_t contentKey,
+    const Image& image) const;
+  std::filesystem::path diskCachePath(std::uint64_t pathKey) const;
+
+  ImageCacheConfig mConfig;
+
+  mutable std::mutex mMutex;
+
+  // Most recently used first, indexed by path key
+  std::list<Entry> mEntries;
+  std::unordered_map<std::uint64_t, std::list<Entry>::iterator> mEntriesByKey;
+  std::size_t mMemoryUsage = 0;
+  ImageCacheStats mStats;
+};
+
+} // namespace rigel::base
@@ -17,21 +17,108 @@
 #pragma once
 
 #include <rigel/base/array_view.hpp>
+#include <rigel/base/byte_buffer.hpp>
 #include <rigel/base/image.hpp>
 
+#include <cstddef>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <optional>
 #include <string>
 
 namespace rigel::base
 {
 
-/** Load image from file (png, jpeg, other common formats - uses STB Image) */
+namespace detail
+{
+
+enum class PngDecodeResult
+{
+  Success,
+  Failure,
+
+  /** Not a PNG file, or an interlaced one */
+  Unsupported
+};
+
+PngDecodeResult decodePngRows(
+  ArrayView<std::uint8_t> data,
+  const std::function<void(std::size_t, const ImageView&)>& onRows,
+  std::size_t maxRowsPerCall);
+
+} // namespace detail
+
+
+/** Load image from file (png, jpeg, other common formats)
+ *
+ * Non-interlaced PNGs are decoded by a built-in decoder, in bands of rows
+ * which are appended to the image's storage. This avoids holding a second
+ * full-size copy of the image. Everything else goes through STB Image, as do
+ * PNGs the built-in decoder fails on.
+ */
 std::optional<Image> loadImage(const std::filesystem::path& path);
 std::optional<Image> loadImage(base::ArrayView<std::uint8_t> data);
 
 Image loadImageOrThrow(const std::filesystem::path& path);
 
+
+struct ImageInfo
+{
+  std::size_t width;
+  std::size_t height;
+};
+
+/** Determine image dimensions without decoding the image */
+std::optional<ImageInfo> readImageInfo(base::ArrayView<std::uint8_t> data);
+
+
+/** Receives a band of consecutive decoded rows, starting at firstRow */
+using ImageRowsFunc =
+  std::function<void(std::size_t firstRow, const ImageView& rows)>;
+
+/** Decode image incrementally, passing the result to onRows in bands
+ *
+ * Rows are delivered from top to bottom, in bands of at most
+ * maxRowsPerCall rows. The views are only valid during the call.
+ *
+ * For non-interlaced PNG files, the image is decompressed on the fly, so
+ * that the full decoded image never exists in memory at once. This makes it
+ * possible to process or upload very large images with a small, fixed
+ * amount of memory. Other formats are decoded completely with stb_image
+ * first, and then handed out in bands.
+ *
+ * Returns false if the image can't be decoded. onRows may have been invoked
+ * for some of the rows in that case.
+ */
+bool decodeImageRows(
+  base::ArrayView<std::uint8_t> data,
+  const ImageRowsFunc& onRows,
+  std::size_t maxRowsPerCall = 16);
+
+bool decodeImageRows(
+  const std::filesystem::path& path,
+  const ImageRowsFunc& onRows,
+  std::size_t maxRowsPerCall = 16);
+
+
+/** Encode image as PNG
+ *
+ * Large images are split into bands of rows, which are filtered and
+ * compressed in parallel on a pool of worker threads. The image must not be
+ * empty.
+ */
+ByteBuffer encodePng(const Image& image);
+ByteBuffer encodePng(const ImageView& image);
+
 bool savePng(const std::filesystem::path& path, const Image& image);
+bool savePng(const std::filesystem::path& path, const ImageView& image);
+
+/** Like savePng, but encodes and writes the file on a background thread
+ *
+ * Saves are processed one after another, in the order they were requested.
+ * Pending saves are completed before the application exits.
+ */
+std::future<bool> savePngAsync(std::filesystem::path path, Image image);
 
 } // namespace rigel::base
@@ -0,0 +1,79 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <rigel/base/array_view.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+
+namespace rigel::base
+{
+
+/** Read-only memory mapping of a file
+ *
+ * The file's contents are mapped into the address space without copying
+ * them. Pages are loaded on demand when they are first accessed, so only the
+ * parts of the file which are actually read cost any I/O. The mapping is
+ * released when the object is destroyed.
+ *
+ * The view returned by data() is only valid as long as the MappedFile it
+ * came from is alive.
+ */
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ArrayView<std::uint8_t> data() const { return {mpData, mSize}; }
+
+  std::uint32_t size() const { return mSize; }
+
+  bool empty() const { return mSize == 0; }
+
+private:
+  friend std::optional<MappedFile>
+    tryMapFile(const std::filesystem::path& path);
+
+  MappedFile(const std::uint8_t* pData, std::uint32_t size);
+
+  void unmap();
+
+  const std::uint8_t* mpData = nullptr;
+  std::uint32_t mSize = 0;
+};
+
+
+/** Map file into memory (read-only)
+ *
+ * Returns an empty optional if the file can't be opened or mapped, or if it
+ * is too large to be represented by an ArrayView (4 GiB or more).
+ */
+std::optional<MappedFile> tryMapFile(const std::filesystem::path& path);
+
+MappedFile mapFileOrThrow(const std::filesystem::path& path);
+
+} // namespace rigel::base
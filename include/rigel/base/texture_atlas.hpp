@@ -0,0 +1,115 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <rigel/base/image.hpp>
+#include <rigel/base/spatial_types.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+namespace rigel::base
+{
+
+class ThreadPool;
+
+
+struct TextureAtlasConfig
+{
+  /** Maximum width and height of a page, at most 65535 */
+  int maxPageSize = 2048;
+
+  /** Number of empty pixels between neighboring images */
+  int padding = 0;
+
+  /** Number of times to repeat each image's edge pixels around it
+   *
+   * Avoids bleeding of neighboring images when sampling with linear
+   * filtering close to an image's edges.
+   */
+  int extrusion = 0;
+};
+
+
+struct TextureAtlas
+{
+  struct Location
+  {
+    std::size_t page;
+
+    /** Area covered by the image on its page, in pixels */
+    Rect<int> rect;
+  };
+
+  std::vector<Image> pages;
+
+  /** Indexed by the ids returned from TextureAtlasBuilder::add() */
+  std::vector<Location> locations;
+};
+
+
+/** Packs many images into as few large images (pages) as possible
+ *
+ * Usage:
+ *
+ *   TextureAtlasBuilder builder;
+ *   const auto playerId = builder.add(loadImageOrThrow("player.png"));
+ *   const auto enemyId = builder.add(spriteSheet.subView(0, 0, 16, 16));
+ *   const auto atlas = builder.build();
+ *
+ *   const auto& [page, rect] = atlas.locations[playerId];
+ *
+ * Rectangles are packed with stb_rect_pack. Pages are filled one after
+ * another, and are trimmed to the area actually used. Each image must fit
+ * into a single page, including extrusion.
+ */
+class TextureAtlasBuilder
+{
+public:
+  explicit TextureAtlasBuilder(const TextureAtlasConfig& config = {});
+
+  /** Add an image, returns its id for lookup in TextureAtlas::locations */
+  std::size_t add(Image image);
+
+  /** Add pixels referenced by view, which must stay valid until build() */
+  std::size_t add(const ImageView& view);
+
+  std::size_t size() const { return mSources.size(); }
+
+  TextureAtlas build() const;
+
+  /** Like build(), but copies pixels into the pages on the given pool
+   *
+   * Filling a page in starts as soon as it has been packed, in parallel to
+   * packing the remaining pages.
+   */
+  TextureAtlas build(ThreadPool& threadPool) const;
+
+private:
+  TextureAtlas build(ThreadPool* pThreadPool) const;
+  void checkFitsIntoPage(const ImageView& view) const;
+
+  TextureAtlasConfig mConfig;
+  std::vector<ImageView> mSources;
+
+  // Moving an Image doesn't move its pixels, so views of these stay valid
+  // when the vector grows.
+  std::vector<Image> mOwnedImages;
+};
+
+} // namespace rigel::base
@@ -0,0 +1,88 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace rigel::base
+{
+
+/** Returns the number of worker threads to use by default
+ *
+ * This is the number of hardware threads minus one (for the main thread),
+ * but at least one.
+ */
+std::size_t defaultNumWorkerThreads();
+
+
+/** Fixed-size pool of worker threads
+ *
+ * Tasks are executed in FIFO order. Destroying the pool waits for all
+ * outstanding tasks to finish.
+ */
+class ThreadPool
+{
+public:
+  explicit ThreadPool(std::size_t numThreads = defaultNumWorkerThreads());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /** Run func on a worker thread
+   *
+   * The returned future receives the function's result, or the exception
+   * it has thrown.
+   */
+  template <typename Callable>
+  auto submit(Callable&& func)
+  {
+    using ResultT = std::invoke_result_t<std::decay_t<Callable>>;
+
+    // std::function requires copyable function objects, but packaged_task is
+    // move-only, hence the shared_ptr.
+    auto pTask = std::make_shared<std::packaged_task<ResultT()>>(
+      std::forward<Callable>(func));
+    auto result = pTask->get_future();
+    enqueue([pTask = std::move(pTask)]() { (*pTask)(); });
+    return result;
+  }
+
+  std::size_t numThreads() const { return mWorkers.size(); }
+
+private:
+  void enqueue(std::function<void()> task);
+  void runWorker();
+
+  std::vector<std::thread> mWorkers;
+  std::deque<std::function<void()>> mTasks;
+  std::mutex mMutex;
+  std::condition_variable mTaskAvailable;
+  bool mShuttingDown = false;
+};
+
+} // namespace rigel::base
@@ -0,0 +1,120 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/base/clock.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <ostream>
+
+
+/** Record the enclosing scope's duration in the trace
+ *
+ * The name must be a string literal (or otherwise outlive the tracing
+ * session). Only compiled in if RIGEL_ENABLE_TRACING is defined, which is
+ * controlled by the CMake option of the same name. Otherwise, the macro
+ * expands to nothing, and has no cost at all.
+ *
+ * Even if compiled in, nothing is recorded until startTracing() is called.
+ */
+#ifdef RIGEL_ENABLE_TRACING
+  #define RIGEL_TRACE_SCOPE(name)                                              \
+    const ::rigel::base::TraceScope RIGEL_TRACE_CONCAT(                        \
+      rigelTraceScope, __LINE__)(name)
+  #define RIGEL_TRACE_CONCAT(a, b) RIGEL_TRACE_CONCAT_IMPL(a, b)
+  #define RIGEL_TRACE_CONCAT_IMPL(a, b) a##b
+#else
+  #define RIGEL_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
+
+
+namespace rigel::base
+{
+
+namespace detail
+{
+
+inline std::atomic<bool> tracingEnabled{false};
+
+void recordTraceEvent(
+  const char* name,
+  Clock::time_point start,
+  Clock::time_point end);
+
+} // namespace detail
+
+
+/** Start recording trace events
+ *
+ * Events are kept in a fixed-size ring buffer per thread. Once a thread's
+ * buffer is full, its oldest events are overwritten. Starting discards all
+ * previously recorded events.
+ */
+void startTracing();
+void stopTracing();
+
+inline bool isTracingEnabled()
+{
+  return detail::tracingEnabled.load(std::memory_order_relaxed);
+}
+
+
+/** Write recorded events in Chrome's Trace Event JSON format
+ *
+ * The output can be loaded in chrome://tracing or https://ui.perfetto.dev.
+ * Best called after stopTracing(). If other threads are still recording,
+ * events they overwrite while writing is in progress are left out.
+ */
+void writeChromeTrace(std::ostream& stream);
+bool saveChromeTrace(const std::filesystem::path& path);
+
+
+/** Records the time between construction and destruction as trace event
+ *
+ * Normally used via RIGEL_TRACE_SCOPE.
+ */
+class TraceScope
+{
+public:
+  explicit TraceScope(const char* name)
+    : mpName(isTracingEnabled() ? name : nullptr)
+  {
+    if (mpName)
+    {
+      mStart = Clock::now();
+    }
+  }
+
+  ~TraceScope()
+  {
+    if (mpName)
+    {
+      detail::recordTraceEvent(mpName, mStart, Clock::now());
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+  const char* mpName;
+  Clock::time_point mStart;
+};
+
+} // namespace rigel::base
@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <rigel/base/command_list.hpp>
 #include <rigel/base/defer.hpp>
+#include <rigel/base/frame_scheduler.hpp>
 #include <rigel/base/warnings.hpp>
 
 RIGEL_DISABLE_WARNINGS
@@ -24,6 +26,8 @@ RIGEL_DISABLE_WARNINGS
 #include <lyra/cli.hpp>
 RIGEL_RESTORE_WARNINGS
 
+#include <cstddef>
+#include <filesystem>
 #include <functional>
 #include <optional>
 #include <string>
@@ -32,6 +36,33 @@ RIGEL_RESTORE_WARNINGS
 namespace rigel
 {
 
+/** Settings for running without a display, e.g. benchmarks on CI machines
+ *
+ * SDL's offscreen video driver is used, which renders into an EGL pbuffer
+ * instead of a window. Together with a software rasterizer like Mesa's
+ * llvmpipe, this works on machines without a GPU or display server. Audio
+ * goes to SDL's dummy driver. Either can be overridden by setting the
+ * SDL_VIDEODRIVER/SDL_AUDIODRIVER environment variables.
+ *
+ * Vsync and fullscreen are disabled, and errors are only logged instead of
+ * being shown in a message box.
+ */
+struct HeadlessConfig
+{
+  /** Number of frames to run, 0 runs until the frame function returns false
+   */
+  int numFrames = 0;
+
+  /** File to write per-frame timing statistics to, if not empty
+   *
+   * See base::writeFrameTimesJson() for the format. Each frame's time
+   * covers running the frame function and waiting for the GPU to finish its
+   * work (glFinish), so that GPU-bound regressions are captured as well.
+   */
+  std::filesystem::path frameTimesFile;
+};
+
+
 struct WindowConfig
 {
   std::string windowTitle = "Rigel SDL Window";
@@ -41,11 +72,43 @@ struct WindowConfig
   int windowY = SDL_WINDOWPOS_CENTERED;
   bool fullscreen = true;
   bool enableVsync = true;
+
+  /** Use adaptive vsync if available, i.e. don't wait for vertical blank
+   * when a frame is late, to avoid dropping to half the refresh rate. Falls
+   * back to regular vsync if not supported. Only used if enableVsync is set.
+   */
+  bool adaptiveVsync = false;
   std::optional<uint8_t> depthBufferBits;
+
+  /** Directory for data cached across runs, disabled if not set
+   *
+   * Currently used for Dear ImGui's font atlas. The directory is created if
+   * it doesn't exist yet.
+   */
+  std::optional<std::filesystem::path> cacheDirectory;
+
+  /** Run headless instead of showing a window, see HeadlessConfig */
+  std::optional<HeadlessConfig> headless;
+
+  /** Wait for events while the UI is idle, for at most this many seconds
+   *
+   * When set, runApp() checks imgui_integration::isIdle() before each
+   * frame, and if it's true, sleeps until the next event arrives or the
+   * timeout expires. This requires rendering Dear ImGui with
+   * imgui_integration::endFrameCached(). Only suitable for applications
+   * whose content doesn't change by itself, like tool windows. The timeout
+   * bounds the delay for UI changes not caused by input, e.g. tooltips
+   * appearing. Ignored by runAppWithRenderThread() and in headless mode.
+   */
+  std::optional<double> maxIdleWaitTime;
 };
 
 
 /** Initialize SDL (video, audio, and gamecontroller subsystems)
+ *
+ * If headless is set, SDL is configured to use the drivers described in
+ * HeadlessConfig. This must be done if runApp() is going to be used with a
+ * HeadlessConfig.
  *
  * Use this function if you need to perform work between SDL initialization
  * and window creation:
@@ -57,7 +120,7 @@ struct WindowConfig
  * If that's not needed, it's enough to call runApp, it will initialize SDL
  * by itself.
  */
-[[nodiscard]] base::ScopeGuard initSdl();
+[[nodiscard]] base::ScopeGuard initSdl(bool headless = false);
 
 
 /** Init SDL+Gl, create window and run provided function in a loop
@@ -71,6 +134,9 @@ struct WindowConfig
  *
  * Exceptions are caught and shown as message box before terminating the loop.
  *
+ * With WindowConfig::headless set, the loop also ends after the configured
+ * number of frames, and frame time statistics are written out at the end.
+ *
  * The return value is the application exit code, to be returned from main().
  */
 int runApp(
@@ -83,6 +149,77 @@ int runApp(
   std::function<void(SDL_Window*)> initFunc,
   std::function<bool(SDL_Window*)> runFrameFunc);
 
+/** Frame function receiving timing information from a FrameScheduler */
+using TimedFrameFunc =
+  std::function<bool(SDL_Window*, const base::FrameTiming& timing)>;
+
+/** Same as runApp(), but with frame pacing and fixed-timestep updates
+ *
+ * Each iteration of the main loop starts with FrameScheduler::beginFrame(),
+ * which waits as needed to respect the configured frame rate cap. Its result
+ * is passed to the frame function.
+ *
+ * If vsync is enabled and the scheduler's expectedFps is not set, it's set
+ * to the display's refresh rate for late-frame detection.
+ */
+int runApp(
+  const WindowConfig& config,
+  const base::FrameSchedulerConfig& schedulerConfig,
+  std::function<void(SDL_Window*)> initFunc,
+  TimedFrameFunc runFrameFunc);
+
+struct RenderThreadConfig
+{
+  /** Number of command lists passed between main and render thread
+   *
+   * With 2, the main thread records frame N+1 while the render thread
+   * submits frame N. With 3, the main thread can get one more frame ahead,
+   * which smooths out uneven frame times at the cost of an additional frame
+   * of latency.
+   */
+  std::size_t numCommandLists = 2;
+};
+
+
+/** Frame function for runAppWithRenderThread()
+ *
+ * Runs on the main thread, and must not make any GL calls. Instead, GL work
+ * is added to the given command list, to be executed on the render thread.
+ * Commands should capture everything they need by value, since they run
+ * while the main thread is already working on the next frame.
+ */
+using RecordFrameFunc = std::function<bool(
+  SDL_Window*,
+  const base::FrameTiming& timing,
+  base::CommandList& commands)>;
+
+/** Same as runApp(), but with GL submission on a dedicated render thread
+ *
+ * The main thread handles events and simulation, by running the frame
+ * function. The render thread owns the GL context, executes the recorded
+ * command lists, and then swaps buffers. Unlike with runApp(), the frame
+ * function must therefore not call SDL_GL_SwapWindow(). This way,
+ * simulation of the next frame overlaps with GL submission and waiting for
+ * vsync of the current one. Use imgui_integration::endFrameDeferred() for
+ * rendering Dear ImGui.
+ *
+ * The init function runs on the main thread while it still has the GL
+ * context, so it can create GL resources. Afterwards, the context is made
+ * current on the render thread. Once the loop ends, the render thread
+ * finishes the remaining command lists, and the context is made current on
+ * the main thread again.
+ *
+ * In headless mode, a frame's time is the interval between the starts of
+ * consecutive frames on the main thread. Since the main thread waits if the
+ * render thread falls behind, this measures overall throughput.
+ */
+int runAppWithRenderThread(
+  const WindowConfig& config,
+  const base::FrameSchedulerConfig& schedulerConfig,
+  const RenderThreadConfig& renderThreadConfig,
+  std::function<void(SDL_Window*)> initFunc,
+  RecordFrameFunc recordFrameFunc);
+
 /** Helper function for argument parsing */
 std::optional<int> parseArgs(
   int argc, char** argv,
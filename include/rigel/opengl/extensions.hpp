@@ -0,0 +1,64 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/base/warnings.hpp>
+#include <rigel/opengl/opengl.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <SDL_video.h>
+RIGEL_RESTORE_WARNINGS
+
+
+namespace rigel::opengl::detail
+{
+
+// Enums from extensions and later GL versions, which aren't part of the
+// GL 3.0/ES 2.0 headers generated by glad. The names leave out the GL_
+// prefix, so that they don't clash with the macros should the headers be
+// regenerated to include them. Values are the same for the ARB, OES and
+// KHR variants.
+constexpr auto PROGRAM_BINARY_LENGTH = GLenum{0x8741};
+constexpr auto NUM_PROGRAM_BINARY_FORMATS = GLenum{0x87FE};
+constexpr auto PROGRAM_BINARY_RETRIEVABLE_HINT = GLenum{0x8257};
+constexpr auto COMPLETION_STATUS = GLenum{0x91B1};
+
+// Sync objects, part of GL 3.2 and ARB_sync
+constexpr auto SYNC_GPU_COMMANDS_COMPLETE = GLenum{0x9117};
+constexpr auto ALREADY_SIGNALED = GLenum{0x911A};
+constexpr auto CONDITION_SATISFIED = GLenum{0x911C};
+constexpr auto SYNC_FLUSH_COMMANDS_BIT = GLbitfield{0x1};
+
+
+/** Load an extension function, returns nullptr if unavailable */
+template <typename Func>
+Func loadFunction(const char* name)
+{
+  return reinterpret_cast<Func>(SDL_GL_GetProcAddress(name));
+}
+
+
+/** Enable background shader compilation, if the driver supports it
+ *
+ * Uses GL_KHR_parallel_shader_compile or its ARB equivalent. Returns true if
+ * available, in which case the status of a build can be polled via
+ * COMPLETION_STATUS without blocking.
+ */
+bool enableParallelShaderCompile();
+
+} // namespace rigel::opengl::detail
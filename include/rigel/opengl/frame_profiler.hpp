@@ -0,0 +1,157 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/base/clock.hpp>
+#include <rigel/base/defer.hpp>
+#include <rigel/opengl/opengl.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <vector>
+
+
+namespace rigel::opengl
+{
+
+struct ProfileScopeTiming
+{
+  const char* name;
+
+  /** Nesting level, 0 for top-level scopes */
+  int depth;
+
+  /** Elapsed times in seconds */
+  double cpuTime;
+  std::optional<double> gpuTime;
+};
+
+
+struct FrameTimings
+{
+  /** Time between the start of the previous frame and this one */
+  double totalElapsed = 0.0;
+
+  /** Time between beginFrame() and endFrame() */
+  double cpuTime = 0.0;
+
+  /** Not set if GPU timing isn't available */
+  std::optional<double> gpuTime;
+
+  /** All scopes of the frame, in the order they were started */
+  std::vector<ProfileScopeTiming> scopes;
+};
+
+
+/** Measures CPU and GPU time spent per frame and in named scopes
+ *
+ * Usage:
+ *
+ *   FrameProfiler profiler;
+ *
+ *   // Each frame
+ *   profiler.beginFrame();
+ *   {
+ *     auto scope = profiler.scope("World");
+ *     renderWorld();
+ *   }
+ *   profiler.endFrame();
+ *
+ *   fpsDisplay.updateAndRender(profiler.latestTimings());
+ *
+ * GPU times are measured with GL_TIMESTAMP queries, which allows scopes to
+ * be nested. Query results become available a few frames later. To never
+ * wait for the GPU, up to MAX_PENDING_FRAMES frames are kept in flight, and
+ * latestTimings() reports the most recent frame whose results are complete.
+ * If more frames are pending, GPU timing is skipped for new frames until
+ * results have arrived.
+ *
+ * GPU timing needs timer query support (GL_ARB_timer_query, not available
+ * on OpenGL ES 2.0). Without it, or if disabled via the constructor, only
+ * CPU times are measured, and timings are available immediately. This
+ * also makes it possible to use the profiler without any OpenGL context.
+ *
+ * Scope names must stay valid while the profiler is in use, string literals
+ * are the expected use case. Scopes started outside of a frame are ignored.
+ * If endFrame() finds scopes that haven't been ended, it discards the frame
+ * and throws. The next frame can be started as usual afterwards.
+ * The profiler must be destroyed while its OpenGL context is still current.
+ */
+class FrameProfiler
+{
+public:
+  static constexpr auto MAX_PENDING_FRAMES = std::size_t{4};
+
+  explicit FrameProfiler(bool enableGpuTiming = true);
+  ~FrameProfiler();
+
+  FrameProfiler(const FrameProfiler&) = delete;
+  FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+  void beginFrame();
+  void endFrame();
+
+  void beginScope(const char* name);
+  void endScope();
+
+  /** Begin scope and end it once the returned guard goes out of scope */
+  [[nodiscard]] base::ScopeGuard scope(const char* name);
+
+  bool isGpuTimingAvailable() const { return mGpuTimingEnabled; }
+
+  const FrameTimings& latestTimings() const { return mLatestTimings; }
+
+private:
+  struct PendingScope
+  {
+    const char* mpName;
+    int mDepth;
+    base::Clock::time_point mCpuStart;
+    base::Clock::time_point mCpuEnd;
+    GLuint mStartQuery;
+    GLuint mEndQuery;
+  };
+
+  struct PendingFrame
+  {
+    // The first scope covers the whole frame
+    std::vector<PendingScope> mScopes;
+    double mTotalElapsed = 0.0;
+    bool mHasGpuQueries = false;
+  };
+
+  void discardCurrentFrame();
+  GLuint issueTimestampQuery();
+  void collectResults();
+  bool resultsAvailable(const PendingFrame& frame) const;
+  void publish(PendingFrame& frame);
+
+  bool mGpuTimingEnabled;
+
+  std::optional<PendingFrame> mCurrentFrame;
+  std::vector<std::size_t> mOpenScopes;
+  std::optional<base::Clock::time_point> mLastFrameStart;
+
+  std::deque<PendingFrame> mPendingFrames;
+  std::vector<GLuint> mFreeQueries;
+
+  FrameTimings mLatestTimings;
+};
+
+} // namespace rigel::opengl
@@ -0,0 +1,237 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/opengl/opengl.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+
+namespace rigel::opengl
+{
+
+namespace detail
+{
+
+/* Deletion policies for GlHandle
+ *
+ * destroy() deletes a number of objects at once, and also informs
+ * glStateCache() about it where the cache tracks bindings of that type of
+ * object. create() is only available for object types whose names are
+ * generated via glGen*().
+ */
+struct TexturePolicy
+{
+  static void create(GLsizei count, GLuint* pHandles);
+  static void destroy(GLsizei count, const GLuint* pHandles);
+};
+
+struct BufferPolicy
+{
+  static void create(GLsizei count, GLuint* pHandles);
+  static void destroy(GLsizei count, const GLuint* pHandles);
+};
+
+#ifndef RIGEL_USE_GL_ES
+struct VertexArrayPolicy
+{
+  static void create(GLsizei count, GLuint* pHandles);
+  static void destroy(GLsizei count, const GLuint* pHandles);
+};
+#endif
+
+struct FramebufferPolicy
+{
+  static void create(GLsizei count, GLuint* pHandles);
+  static void destroy(GLsizei count, const GLuint* pHandles);
+};
+
+struct RenderbufferPolicy
+{
+  static void create(GLsizei count, GLuint* pHandles);
+  static void destroy(GLsizei count, const GLuint* pHandles);
+};
+
+struct ShaderObjectPolicy
+{
+  static void destroy(GLsizei count, const GLuint* pHandles);
+};
+
+struct ProgramPolicy
+{
+  static void destroy(GLsizei count, const GLuint* pHandles);
+};
+
+} // namespace detail
+
+
+/** Owning handle for an OpenGL object
+ *
+ * The deleter is given by the Policy at compile time, so the handle is no
+ * bigger than the GLuint it wraps. A handle of 0 is empty and isn't deleted.
+ */
+template <typename Policy>
+class GlHandle
+{
+public:
+  GlHandle() = default;
+
+  explicit GlHandle(const GLuint handle) noexcept
+    : mHandle(handle)
+  {
+  }
+
+  /** Create a new object name via glGen*() */
+  static GlHandle generate()
+  {
+    auto handle = GLuint{0};
+    Policy::create(1, &handle);
+    return GlHandle{handle};
+  }
+
+  GlHandle(const GlHandle&) = delete;
+  GlHandle(GlHandle&& other) noexcept
+    : mHandle(std::exchange(other.mHandle, 0))
+  {
+  }
+
+  ~GlHandle() { reset(); }
+
+  GlHandle& operator=(const GlHandle&) = delete;
+  GlHandle& operator=(GlHandle&& other) noexcept
+  {
+    if (this != &other)
+    {
+      reset(other.release());
+    }
+
+    return *this;
+  }
+
+  /** Delete the current object, if any, and take ownership of handle */
+  void reset(const GLuint handle = 0) noexcept
+  {
+    if (mHandle != 0)
+    {
+      Policy::destroy(1, &mHandle);
+    }
+
+    mHandle = handle;
+  }
+
+  /** Give up ownership without deleting the object */
+  [[nodiscard]] GLuint release() noexcept { return std::exchange(mHandle, 0); }
+
+  GLuint mHandle = 0;
+};
+
+
+using TextureHandle = GlHandle<detail::TexturePolicy>;
+using BufferHandle = GlHandle<detail::BufferPolicy>;
+#ifndef RIGEL_USE_GL_ES
+using VertexArrayHandle = GlHandle<detail::VertexArrayPolicy>;
+#endif
+using FramebufferHandle = GlHandle<detail::FramebufferPolicy>;
+using RenderbufferHandle = GlHandle<detail::RenderbufferPolicy>;
+using ShaderObjectHandle = GlHandle<detail::ShaderObjectPolicy>;
+using ProgramHandle = GlHandle<detail::ProgramPolicy>;
+
+static_assert(sizeof(TextureHandle) == sizeof(GLuint));
+
+
+/** Allocates and deletes object names in batches
+ *
+ * acquire() hands out names from a batch generated with a single glGen*()
+ * call. Handles given back via release() are collected and deleted with a
+ * single glDelete*() call once batchSize of them have accumulated, or when
+ * flush() is called. This is meant for code creating and destroying many
+ * objects of the same type, e.g. textures for individual sprites.
+ *
+ * Handles obtained from the pool can also be destroyed normally, they are
+ * then deleted individually.
+ */
+template <typename Policy>
+class GlHandlePool
+{
+public:
+  explicit GlHandlePool(const std::size_t batchSize = 64)
+    : mBatchSize(batchSize > 0 ? batchSize : 1)
+  {
+  }
+
+  GlHandlePool(const GlHandlePool&) = delete;
+  GlHandlePool& operator=(const GlHandlePool&) = delete;
+
+  ~GlHandlePool()
+  {
+    flush();
+    deleteNames(mFreeNames);
+  }
+
+  GlHandle<Policy> acquire()
+  {
+    if (mFreeNames.empty())
+    {
+      mFreeNames.resize(mBatchSize);
+      Policy::create(GLsizei(mBatchSize), mFreeNames.data());
+    }
+
+    const auto handle = mFreeNames.back();
+    mFreeNames.pop_back();
+    return GlHandle<Policy>{handle};
+  }
+
+  /** Queue the handle's object for deletion */
+  void release(GlHandle<Policy>&& handle)
+  {
+    if (const auto name = handle.release())
+    {
+      mPendingDeletions.push_back(name);
+    }
+
+    if (mPendingDeletions.size() >= mBatchSize)
+    {
+      flush();
+    }
+  }
+
+  /** Delete all objects queued by release() */
+  void flush() { deleteNames(mPendingDeletions); }
+
+private:
+  static void deleteNames(std::vector<GLuint>& names)
+  {
+    if (!names.empty())
+    {
+      Policy::destroy(GLsizei(names.size()), names.data());
+      names.clear();
+    }
+  }
+
+  std::vector<GLuint> mFreeNames;
+  std::vector<GLuint> mPendingDeletions;
+  std::size_t mBatchSize;
+};
+
+
+using TexturePool = GlHandlePool<detail::TexturePolicy>;
+using BufferPool = GlHandlePool<detail::BufferPolicy>;
+
+} // namespace rigel::opengl
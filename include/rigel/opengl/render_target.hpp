@@ -0,0 +1,216 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/base/defer.hpp>
+#include <rigel/base/image.hpp>
+#include <rigel/base/warnings.hpp>
+#include <rigel/opengl/gl_handle.hpp>
+#include <rigel/opengl/opengl.hpp>
+#include <rigel/opengl/texture.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <SDL.h>
+RIGEL_RESTORE_WARNINGS
+
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+
+namespace rigel::opengl
+{
+
+enum class RenderTargetFormat
+{
+  /** RGBA color, 8 bits per channel */
+  Rgba8,
+
+  /** RGBA color plus a depth buffer */
+  Rgba8WithDepth
+};
+
+
+/** Texture which can be rendered into, via a framebuffer object */
+class RenderTarget
+{
+public:
+  RenderTarget(
+    std::size_t width,
+    std::size_t height,
+    RenderTargetFormat format = RenderTargetFormat::Rgba8,
+    TextureFilter filter = TextureFilter::Nearest);
+
+  /** Direct rendering into the target, until the returned guard goes away
+   *
+   * Binds the framebuffer and sets the viewport to cover the whole target,
+   * via glStateCache(). The guard binds the previously bound framebuffer
+   * again, but doesn't restore the viewport.
+   */
+  [[nodiscard]] base::ScopeGuard bind() const;
+
+  const Texture& texture() const { return mTexture; }
+  GLuint framebuffer() const { return mFramebuffer.mHandle; }
+  std::size_t width() const { return mTexture.width(); }
+  std::size_t height() const { return mTexture.height(); }
+  RenderTargetFormat format() const { return mFormat; }
+
+private:
+  Texture mTexture;
+  RenderbufferHandle mDepthBuffer;
+  FramebufferHandle mFramebuffer;
+  RenderTargetFormat mFormat;
+};
+
+
+struct RenderTargetPoolConfig
+{
+  /** Targets which haven't been used for this many frames are deleted */
+  std::size_t maxUnusedFrames = 3;
+};
+
+
+/** Recycles intermediate render targets across frames
+ *
+ * Meant for targets which are only needed during a single frame, like
+ * intermediate results of post-processing. Instead of creating them anew
+ * each frame, they are requested from the pool with acquire(), which hands
+ * out a target with matching size and format that isn't in use yet during
+ * the current frame. New targets are only created if there is none.
+ *
+ * endFrame() makes all targets available again. Targets which haven't been
+ * used for a while are deleted at that point. When the window size changes,
+ * targets created for the previous size are of no use anymore. Passing
+ * events to handleEvent() causes these to be deleted at the end of the
+ * following frame, without waiting for them to expire.
+ */
+class RenderTargetPool
+{
+public:
+  explicit RenderTargetPool(RenderTargetPoolConfig config = {});
+
+  /** Get an unused target of the given size and format
+   *
+   * The target remains valid until the end of the frame. Its contents are
+   * undefined.
+   */
+  RenderTarget& acquire(
+    std::size_t width,
+    std::size_t height,
+    RenderTargetFormat format = RenderTargetFormat::Rgba8);
+
+  void endFrame();
+
+  void handleEvent(const SDL_Event& event);
+
+  /** Number of targets currently owned by the pool */
+  std::size_t size() const { return mEntries.size(); }
+
+private:
+  struct Entry
+  {
+    std::unique_ptr<RenderTarget> mpTarget;
+    std::size_t mLastUsedFrame;
+    bool mIsInUse;
+  };
+
+  RenderTargetPoolConfig mConfig;
+  std::vector<Entry> mEntries;
+  std::size_t mCurrentFrame = 0;
+  bool mWindowSizeChanged = false;
+};
+
+
+/** Reads back framebuffer contents without waiting for the GPU
+ *
+ * readPixels() starts copying pixels into a pixel buffer object, and returns
+ * a future for the resulting image. update() is meant to be called once per
+ * frame, and completes readbacks once their data is available. This is
+ * detected via sync objects where available (GL 3.2 or ARB_sync), otherwise
+ * the data is assumed to be ready a fixed number of frames later. Either way,
+ * the result usually arrives a few frames after the request, but rendering
+ * is never stalled.
+ *
+ * The resulting images are top-down, i.e. they are flipped compared to the
+ * framebuffer's layout.
+ *
+ * OpenGL ES 2.0 lacks pixel buffer objects. There, pixels are read back
+ * synchronously, and the future is ready right away.
+ */
+class AsyncPixelReader
+{
+public:
+  AsyncPixelReader();
+  ~AsyncPixelReader();
+
+  AsyncPixelReader(const AsyncPixelReader&) = delete;
+  AsyncPixelReader& operator=(const AsyncPixelReader&) = delete;
+
+  /** Read back a region of the currently bound framebuffer */
+  std::future<base::Image> readPixels(int x, int y, int width, int height);
+
+  /** Read back the entire contents of the given target */
+  std::future<base::Image> readPixels(const RenderTarget& target);
+
+  /** Complete all readbacks whose data has arrived */
+  void update();
+
+  /** Complete all readbacks, waiting for the GPU if necessary */
+  void finishAll();
+
+  std::size_t pendingReadbacks() const;
+
+private:
+#ifndef RIGEL_USE_GL_ES
+  using FenceSyncFunc =
+    GLsync(KHRONOS_APIENTRY*)(GLenum condition, GLbitfield flags);
+  using ClientWaitSyncFunc =
+    GLenum(KHRONOS_APIENTRY*)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+  using DeleteSyncFunc = void(KHRONOS_APIENTRY*)(GLsync sync);
+
+  struct StagingBuffer
+  {
+    BufferHandle mHandle;
+    std::size_t mSize;
+  };
+
+  struct Readback
+  {
+    StagingBuffer mBuffer;
+    int mWidth;
+    int mHeight;
+    GLsync mFence;
+    std::size_t mFramesWaited;
+    std::promise<base::Image> mPromise;
+  };
+
+  bool isReady(const Readback& readback) const;
+  void complete(Readback& readback);
+
+  std::deque<Readback> mPendingReadbacks;
+  std::vector<StagingBuffer> mFreeBuffers;
+
+  FenceSyncFunc mpFenceSync = nullptr;
+  ClientWaitSyncFunc mpClientWaitSync = nullptr;
+  DeleteSyncFunc mpDeleteSync = nullptr;
+#endif
+};
+
+} // namespace rigel::opengl
@@ -19,6 +19,7 @@
 #include <rigel/base/array_view.hpp>
 #include <rigel/base/defer.hpp>
 #include <rigel/base/warnings.hpp>
+#include <rigel/opengl/gl_handle.hpp>
 #include <rigel/opengl/opengl.hpp>
 
 RIGEL_DISABLE_WARNINGS
@@ -26,15 +27,24 @@ RIGEL_DISABLE_WARNINGS
 #include <glm/mat4x4.hpp>
 RIGEL_RESTORE_WARNINGS
 
+#include <array>
 #include <functional>
 #include <initializer_list>
+#include <map>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
 
 
 namespace rigel::opengl
 {
 
+/** Owning handle with a deleter chosen at runtime
+ *
+ * Prefer GlHandle (see gl_handle.hpp) where the deleter is known at compile
+ * time, it's much smaller and doesn't need to allocate.
+ */
 class GlHandleWrapper
 {
 public:
@@ -50,17 +60,30 @@ public:
   }
 
   GlHandleWrapper(const GlHandleWrapper&) = delete;
-  GlHandleWrapper(GlHandleWrapper&& other)
-    : mHandle(other.mHandle)
-    , mDeleteFunc(other.mDeleteFunc)
+  GlHandleWrapper(GlHandleWrapper&& other) noexcept
+    : mHandle(std::exchange(other.mHandle, 0))
+    , mDeleteFunc(std::move(other.mDeleteFunc))
   {
-    other.mHandle = 0;
   }
 
-  ~GlHandleWrapper() { mDeleteFunc(mHandle); }
+  ~GlHandleWrapper()
+  {
+    if (mHandle != 0)
+    {
+      mDeleteFunc(mHandle);
+    }
+  }
 
   GlHandleWrapper& operator=(const GlHandleWrapper&) = delete;
 
+  /** The previously held handle is deleted along with other */
+  GlHandleWrapper& operator=(GlHandleWrapper&& other)
+  {
+    std::swap(mHandle, other.mHandle);
+    std::swap(mDeleteFunc, other.mDeleteFunc);
+    return *this;
+  }
+
   GLuint mHandle = 0;
 
 private:
@@ -84,80 +107,302 @@ struct ShaderSpec
 };
 
 
-class Shader
+namespace detail
+{
+
+template <typename T>
+struct UniformTypeInfo;
+
+template <>
+struct UniformTypeInfo<glm::mat4>
+{
+  static constexpr GLenum glType = GL_FLOAT_MAT4;
+  static constexpr GLint count = 1;
+};
+
+template <>
+struct UniformTypeInfo<glm::vec2>
+{
+  static constexpr GLenum glType = GL_FLOAT_VEC2;
+  static constexpr GLint count = 1;
+};
+
+template <>
+struct UniformTypeInfo<glm::vec3>
+{
+  static constexpr GLenum glType = GL_FLOAT_VEC3;
+  static constexpr GLint count = 1;
+};
+
+template <>
+struct UniformTypeInfo<glm::vec4>
+{
+  static constexpr GLenum glType = GL_FLOAT_VEC4;
+  static constexpr GLint count = 1;
+};
+
+template <>
+struct UniformTypeInfo<int>
+{
+  static constexpr GLenum glType = GL_INT;
+  static constexpr GLint count = 1;
+};
+
+template <>
+struct UniformTypeInfo<float>
+{
+  static constexpr GLenum glType = GL_FLOAT;
+  static constexpr GLint count = 1;
+};
+
+template <typename T, std::size_t N>
+struct UniformTypeInfo<std::array<T, N>>
+{
+  static constexpr GLenum glType = UniformTypeInfo<T>::glType;
+  static constexpr GLint count = GLint(N);
+};
+
+
+inline void setUniform(const GLint location, const glm::mat4& matrix)
+{
+  glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+inline void setUniform(const GLint location, const glm::vec2& vec2)
+{
+  glUniform2fv(location, 1, glm::value_ptr(vec2));
+}
+
+inline void setUniform(const GLint location, const glm::vec3& vec3)
+{
+  glUniform3fv(location, 1, glm::value_ptr(vec3));
+}
+
+inline void setUniform(const GLint location, const glm::vec4& vec4)
+{
+  glUniform4fv(location, 1, glm::value_ptr(vec4));
+}
+
+template <std::size_t N>
+void setUniform(const GLint location, const std::array<glm::vec2, N>& values)
+{
+  glUniform2fv(location, GLsizei(N), glm::value_ptr(values.front()));
+}
+
+template <std::size_t N>
+void setUniform(const GLint location, const std::array<glm::vec3, N>& values)
+{
+  glUniform3fv(location, GLsizei(N), glm::value_ptr(values.front()));
+}
+
+template <std::size_t N>
+void setUniform(const GLint location, const std::array<glm::vec4, N>& values)
+{
+  glUniform4fv(location, GLsizei(N), glm::value_ptr(values.front()));
+}
+
+inline void setUniform(const GLint location, const int value)
+{
+  glUniform1i(location, value);
+}
+
+inline void setUniform(const GLint location, const float value)
+{
+  glUniform1f(location, value);
+}
+
+
+/** True if a value of requestedType can be used to set a uniform declared
+ * as actualType in the shader. Integers can also be used for samplers and
+ * booleans.
+ */
+bool isCompatibleUniformType(GLenum requestedType, GLenum actualType);
+
+/** Preamble with version and compatibility macros, put in front of all
+ * shader sources
+ */
+const char* shaderPreamble();
+
+/** Start compiling a shader, without waiting for the result
+ *
+ * The driver may compile in the background. The result is only checked by
+ * checkCompileStatus().
+ */
+ShaderObjectHandle startCompilingShader(const char* source, GLenum type);
+
+/** Bind attribute locations as expected for the given layout
+ *
+ * Must be done before linking.
+ */
+void bindAttributeLocations(GLuint program, VertexLayout layout);
+
+/** Throw std::runtime_error with the info log if compilation failed
+ *
+ * Waits for compilation to finish.
+ */
+void checkCompileStatus(GLuint shader);
+
+/** Throw std::runtime_error with the info log if linking failed
+ *
+ * Waits for linking to finish.
+ */
+void checkLinkStatus(GLuint program);
+
+/** Program whose shaders are still being compiled and linked */
+struct PendingProgram
+{
+  ShaderObjectHandle mVertexShader;
+  ShaderObjectHandle mFragmentShader;
+  ProgramHandle mProgram;
+};
+
+/** Start compiling and linking a program, without waiting for the result
+ *
+ * If given, prepareLink is invoked with the program right before linking,
+ * e.g. to set program parameters.
+ */
+PendingProgram startBuildingProgram(
+  const ShaderSpec& spec,
+  const std::function<void(GLuint)>& prepareLink = {});
+
+/** True if the driver has finished building the program
+ *
+ * Without parallel shader compilation (see enableParallelShaderCompile()),
+ * there's no way to tell, and this always returns true.
+ */
+bool isBuildComplete(const PendingProgram& build, bool hasParallelCompile);
+
+/** Wait for the build to finish, and return the linked program
+ *
+ * Throws std::runtime_error if compiling or linking failed.
+ */
+ProgramHandle finishBuildingProgram(PendingProgram&& build);
+
+inline constexpr GLint INVALID_UNIFORM_LOCATION = -1;
+
+} // namespace detail
+
+
+/** Pre-resolved uniform location, for setting a uniform without lookup
+ *
+ * Obtained via Shader::uniform(). Like with Shader::setUniform(), the shader
+ * must be in use when calling set(). Handles for uniforms that don't exist
+ * in the shader (e.g. because they were optimized out by the compiler) are
+ * valid to use, setting them does nothing.
+ *
+ * The location is stored in the shader, so that handles stay valid when
+ * the shader's program is replaced (see Shader::replaceProgram()). A handle
+ * must not outlive the shader it came from.
+ */
+template <typename T>
+class UniformHandle
 {
 public:
-  Shader(const ShaderSpec& spec);
+  UniformHandle() = default;
 
-  void use() const;
+  void set(const T& value) const { detail::setUniform(*mpLocation, value); }
 
-  void setUniform(const std::string& name, const glm::mat4& matrix) const
-  {
-    glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(matrix));
-  }
+  GLint location() const { return *mpLocation; }
+  bool isActive() const { return *mpLocation != -1; }
 
-  void setUniform(const std::string& name, const glm::vec2& vec2) const
-  {
-    glUniform2fv(location(name), 1, glm::value_ptr(vec2));
-  }
+private:
+  friend class Shader;
 
-  void setUniform(const std::string& name, const glm::vec3& vec3) const
+  explicit UniformHandle(const GLint* pLocation)
+    : mpLocation(pLocation)
   {
-    glUniform3fv(location(name), 1, glm::value_ptr(vec3));
   }
 
-  void setUniform(const std::string& name, const glm::vec4& vec4) const
-  {
-    glUniform4fv(location(name), 1, glm::value_ptr(vec4));
-  }
+  const GLint* mpLocation = &detail::INVALID_UNIFORM_LOCATION;
+};
 
-  template <std::size_t N>
-  void setUniform(
-    const std::string& name,
-    const std::array<glm::vec2, N>& values) const
-  {
-    glUniform3fv(location(name), N, glm::value_ptr(values.front()));
-  }
 
-  template <std::size_t N>
-  void setUniform(
-    const std::string& name,
-    const std::array<glm::vec3, N>& values) const
-  {
-    glUniform3fv(location(name), N, glm::value_ptr(values.front()));
-  }
+class Shader
+{
+public:
+  Shader(const ShaderSpec& spec);
 
-  template <std::size_t N>
-  void setUniform(
-    const std::string& name,
-    const std::array<glm::vec4, N>& values) const
-  {
-    glUniform3fv(location(name), N, glm::value_ptr(values.front()));
-  }
+  /** Take ownership of an already successfully linked program
+   *
+   * The program's attribute locations must match the spec's vertex layout.
+   * The spec's sources are not used. See ShaderCache.
+   */
+  Shader(ProgramHandle program, const ShaderSpec& spec);
+
+  /** Switch to a new version of the program, e.g. after editing its source
+   *
+   * The new program must be successfully linked, and use the same vertex
+   * layout. Uniform handles obtained from this shader stay valid, and refer
+   * to the new program afterwards. Uniform values are not carried over,
+   * they need to be set again. If the old program is currently in use, the
+   * new one is used instead.
+   */
+  void replaceProgram(ProgramHandle program, const ShaderSpec& spec);
+
+  /** Make this the current program, via glStateCache() */
+  void use() const;
 
-  void setUniform(const std::string& name, const int value) const
+  /** Look up a uniform, and return a handle for setting it efficiently
+   *
+   * Meant to be called once after creating the shader, not on every use.
+   * Throws std::invalid_argument if T doesn't match the uniform's type as
+   * declared in the shader.
+   */
+  template <typename T>
+  UniformHandle<T> uniform(std::string_view name) const
   {
-    glUniform1i(location(name), value);
+    using TypeInfo = detail::UniformTypeInfo<T>;
+
+    const auto& info = uniformInfo(name);
+    if (
+      info.mType != 0 &&
+      (!detail::isCompatibleUniformType(TypeInfo::glType, info.mType) ||
+       TypeInfo::count > info.mSize))
+    {
+      throw std::invalid_argument(
+        "Type mismatch for uniform " + std::string{name});
+    }
+
+    return UniformHandle<T>{&info.mLocation};
   }
 
-  void setUniform(const std::string& name, const float value) const
+  template <typename T>
+  void setUniform(std::string_view name, const T& value) const
   {
-    glUniform1f(location(name), value);
+    detail::setUniform(uniformInfo(name).mLocation, value);
   }
 
   GLuint handle() const { return mProgram.mHandle; }
   VertexLayout vertexLayout() const { return mVertexLayout; }
 
 private:
-  GLint location(const std::string& name) const;
+  struct UniformInfo
+  {
+    GLint mLocation;
+
+    // 0 if the uniform wasn't found when introspecting the program
+    GLenum mType;
+    GLint mSize;
+  };
+
+  void resolveUniforms();
+  void bindTextureUnits(const ShaderSpec& spec);
+  const UniformInfo& uniformInfo(std::string_view name) const;
 
 private:
-  GlHandleWrapper mProgram;
+  ProgramHandle mProgram;
   VertexLayout mVertexLayout;
-  mutable std::unordered_map<std::string, GLint> mLocationCache;
+
+  // std::less<> allows lookup by string_view, without creating a std::string
+  mutable std::map<std::string, UniformInfo, std::less<>> mUniforms;
 };
 
 
+/** Use shader until the returned guard goes out of scope
+ *
+ * The previously used program is taken from glStateCache(), so this doesn't
+ * need to query OpenGL.
+ */
 base::ScopeGuard useTemporarily(const Shader& shader);
 
 } // namespace rigel::opengl
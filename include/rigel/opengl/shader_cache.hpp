@@ -0,0 +1,178 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <rigel/opengl/opengl.hpp>
+#include <rigel/opengl/shader.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace rigel::opengl
+{
+
+struct ShaderCacheConfig
+{
+  /** Directory for storing linked program binaries, disabled if not set
+   *
+   * The directory is created if it doesn't exist yet. Only used if the
+   * driver supports program binaries (GL_ARB_get_program_binary or
+   * GL_OES_get_program_binary).
+   */
+  std::optional<std::filesystem::path> binaryCacheDirectory;
+
+  /** Maximum total size of the program binaries in the cache directory
+   *
+   * When exceeded, the least recently used binaries are deleted. This
+   * removes binaries for outdated shader sources or drivers over time.
+   */
+  std::uintmax_t maxBinaryCacheBytes = 64 * 1024 * 1024;
+};
+
+
+struct ShaderCacheStats
+{
+  /** Programs restored from a cached program binary */
+  std::size_t binaryHits = 0;
+
+  /** Programs compiled and linked from source */
+  std::size_t compilations = 0;
+};
+
+
+/** Builds many shaders at once, and caches the results across runs
+ *
+ * Usage:
+ *
+ *   ShaderCache cache{{cacheDirectory}};
+ *
+ *   const auto spriteShaderId = cache.add(SPRITE_SHADER_SPEC);
+ *   const auto fontShaderId = cache.add(FONT_SHADER_SPEC);
+ *   // ... add all other shaders
+ *
+ *   const auto& spriteShader = cache.get(spriteShaderId);
+ *
+ * Constructing a Shader directly compiles and links it, and then checks the
+ * result, which waits for the driver to finish. add() only starts compiling
+ * and linking, the result isn't checked until get() is called. Adding all
+ * shaders up front gives the driver a chance to build them in parallel, or
+ * at least to overlap building with the application's other startup work.
+ * If the driver supports GL_KHR_parallel_shader_compile, isReady() can be
+ * used to check for completion without waiting.
+ *
+ * If a binary cache directory is configured, each successfully linked
+ * program is also saved as a program binary. The file is identified by a
+ * hash of the shader sources, and of the GL vendor, renderer and version
+ * strings, since binaries are specific to the driver. On subsequent runs,
+ * the binary is loaded instead of compiling the shader. If loading fails,
+ * e.g. because the driver rejects the binary after an update, the shader is
+ * compiled from source as usual. Binaries that haven't been used for the
+ * longest time are deleted once the cache exceeds its size limit.
+ *
+ * Must only be used on the thread which owns the GL context.
+ */
+class ShaderCache
+{
+public:
+  explicit ShaderCache(ShaderCacheConfig config = {});
+
+  ShaderCache(const ShaderCache&) = delete;
+  ShaderCache& operator=(const ShaderCache&) = delete;
+
+  /** Start building a shader, returns an id for retrieving it with get()
+   *
+   * The spec's strings are copied, they don't need to stay valid.
+   */
+  std::size_t add(const ShaderSpec& spec);
+
+  /** True if get() won't need to wait for the driver
+   *
+   * Without GL_KHR_parallel_shader_compile, there's no way to check for
+   * completion without waiting, so this always returns true in that case.
+   */
+  bool isReady(std::size_t id) const;
+
+  /** Return the shader, waiting for it to finish building if necessary
+   *
+   * Throws std::runtime_error if compiling or linking failed.
+   */
+  const Shader& get(std::size_t id);
+
+  /** Wait for all shaders added so far, see get() */
+  void finishAll();
+
+  std::size_t size() const { return mEntries.size(); }
+
+  const ShaderCacheStats& stats() const { return mStats; }
+
+private:
+  using GetProgramBinaryFunc = void(KHRONOS_APIENTRY*)(
+    GLuint program,
+    GLsizei bufSize,
+    GLsizei* pLength,
+    GLenum* pBinaryFormat,
+    void* pBinary);
+  using ProgramBinaryFunc = void(KHRONOS_APIENTRY*)(
+    GLuint program,
+    GLenum binaryFormat,
+    const void* pBinary,
+    GLsizei length);
+  using ProgramParameteriFunc =
+    void(KHRONOS_APIENTRY*)(GLuint program, GLenum name, GLint value);
+
+  struct Entry
+  {
+    VertexLayout mVertexLayout;
+    std::vector<std::string> mTextureUnitNames;
+    std::uint64_t mKey;
+
+    std::optional<ProgramHandle> mProgram;
+
+    // Only set while a program compiled from source is still being built
+    std::optional<detail::PendingProgram> mPendingBuild;
+
+    std::optional<Shader> mShader;
+  };
+
+  void checkId(std::size_t id) const;
+  bool binaryCacheEnabled() const;
+  std::filesystem::path binaryPath(std::uint64_t key) const;
+  bool tryLoadBinary(Entry& entry);
+  void saveBinary(const Entry& entry) const;
+  void pruneBinaryCache() const;
+  void startBuilding(Entry& entry, const ShaderSpec& spec);
+  void finish(Entry& entry);
+
+  ShaderCacheConfig mConfig;
+  std::uint64_t mDriverHash = 0;
+
+  GetProgramBinaryFunc mpGetProgramBinary = nullptr;
+  ProgramBinaryFunc mpProgramBinary = nullptr;
+  ProgramParameteriFunc mpProgramParameteri = nullptr;
+  bool mHasParallelCompile = false;
+
+  std::deque<Entry> mEntries;
+  ShaderCacheStats mStats;
+};
+
+} // namespace rigel::opengl
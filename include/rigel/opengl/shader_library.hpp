@@ -0,0 +1,119 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <rigel/base/file_watcher.hpp>
+#include <rigel/opengl/opengl.hpp>
+#include <rigel/opengl/shader.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace rigel::opengl
+{
+
+struct ShaderLibraryConfig
+{
+  /** Directory which shader file names are relative to */
+  std::filesystem::path shaderDirectory;
+
+  /** Watch the source files, and rebuild shaders when they change */
+  bool enableHotReload = false;
+};
+
+
+/** Like ShaderSpec, but with the sources stored in files */
+struct ShaderFileSpec
+{
+  VertexLayout mVertexLayout;
+  std::vector<std::string> mTextureUnitNames;
+  std::filesystem::path mVertexFile;
+  std::filesystem::path mFragmentFile;
+};
+
+
+/** Loads shaders from source files, optionally reloading them on changes
+ *
+ * With hot reloading enabled, shaders can be edited while the application
+ * is running. The source files are watched using base::FileWatcher, and
+ * update() rebuilds the shaders whose files have changed. The new program
+ * then replaces the old one in the existing Shader object, so references to
+ * shaders and their uniform handles stay valid.
+ *
+ * Must only be used on the thread which owns the GL context.
+ */
+class ShaderLibrary
+{
+public:
+  explicit ShaderLibrary(ShaderLibraryConfig config);
+
+  ShaderLibrary(const ShaderLibrary&) = delete;
+  ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+  /** Load and build a shader
+   *
+   * Throws std::runtime_error if the files can't be read, or if compiling
+   * or linking fails. The returned reference stays valid for the lifetime of
+   * the library, including across reloads.
+   */
+  const Shader& load(ShaderFileSpec spec);
+
+  /** Rebuild shaders whose source files have changed
+   *
+   * Meant to be called once per frame, at the start or end of a frame, so
+   * that all draw calls of a frame use the same version of a shader.
+   *
+   * Rebuilding doesn't block the frame if the driver supports
+   * GL_KHR_parallel_shader_compile: Changed shaders start building in one
+   * call, and are swapped in by the first call after the driver has
+   * finished. Without that extension, the next call waits for the build.
+   * All shaders finished at the same time are swapped in by the same call.
+   *
+   * If a rebuilt shader fails to compile or link, the error is logged, and
+   * the shader keeps using its previous program.
+   *
+   * Returns the number of shaders that were swapped. Does nothing if hot
+   * reloading is disabled.
+   */
+  std::size_t update();
+
+private:
+  struct Entry
+  {
+    ShaderFileSpec mSpec;
+    std::filesystem::path mVertexPath;
+    std::filesystem::path mFragmentPath;
+    Shader mShader;
+    std::optional<detail::PendingProgram> mPendingBuild;
+  };
+
+  void startRebuild(Entry& entry);
+  bool finishRebuild(Entry& entry);
+
+  ShaderLibraryConfig mConfig;
+  std::optional<base::FileWatcher> mWatcher;
+  bool mHasParallelCompile = false;
+
+  std::deque<Entry> mEntries;
+};
+
+} // namespace rigel::opengl
@@ -0,0 +1,187 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/base/color.hpp>
+#include <rigel/base/spatial_types.hpp>
+#include <rigel/opengl/gl_handle.hpp>
+#include <rigel/opengl/opengl.hpp>
+#include <rigel/opengl/shader.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+namespace rigel::opengl
+{
+
+struct SpriteBatchStats
+{
+  std::size_t drawCalls = 0;
+  std::size_t vertices = 0;
+};
+
+
+enum class SpriteSortMode
+{
+  /** Draw quads in the order they were queued, merging consecutive quads
+   * which use the same shader and texture
+   */
+  SubmissionOrder,
+
+  /** Group all queued quads by shader and texture before drawing
+   *
+   * Needs the fewest draw calls, but quads using different textures or
+   * shaders aren't drawn in submission order anymore. Only suitable if
+   * these don't overlap, or if overlap order doesn't matter.
+   */
+  TextureAndShader
+};
+
+
+namespace detail
+{
+
+// Indices are 16 bit for OpenGL ES 2.0 compatibility, which limits the number
+// of vertices that can be addressed in a single draw call.
+constexpr auto MAX_QUADS_PER_DRAW = std::size_t{65536 / 4};
+
+constexpr auto VERTICES_PER_QUAD = std::size_t{4};
+
+
+struct QueuedQuad
+{
+  const Shader* mpShader;
+  GLuint mTexture;
+  std::size_t mDataOffset;
+};
+
+
+/** Range of queued quads which is drawn with a single draw call */
+struct QuadRun
+{
+  std::size_t mFirst;
+  std::size_t mCount;
+};
+
+
+/** Group quads by shader and texture, keeping their relative order within
+ * each group
+ */
+void sortByShaderAndTexture(std::vector<QueuedQuad>& quads);
+
+/** Split quads into runs of consecutive quads sharing shader and texture
+ *
+ * Runs are limited to MAX_QUADS_PER_DRAW quads. Replaces the contents of
+ * runs.
+ */
+void splitIntoRuns(
+  const std::vector<QueuedQuad>& quads,
+  std::vector<QuadRun>& runs);
+
+/** Account for drawing the given run in stats */
+void addToStats(SpriteBatchStats& stats, const QuadRun& run);
+
+} // namespace detail
+
+
+/** Collects quads and draws them with as few draw calls as possible
+ *
+ * Usage:
+ *
+ *   SpriteBatch batch;
+ *
+ *   // Once per frame
+ *   batch.drawQuad(texturedShader, spriteTexture, {{10, 10}, {16, 16}});
+ *   batch.drawQuad(texturedShader, spriteTexture, {{30, 10}, {16, 16}});
+ *   batch.drawQuad(solidColorShader, {{0, 0}, {100, 2}}, Color{255, 0, 0});
+ *   batch.flush();
+ *
+ * Positions are passed to the vertex shader unmodified, any transformation
+ * must be set up as a uniform by the user.
+ *
+ * All vertices queued since the last flush are uploaded into a single
+ * streaming vertex buffer, which is orphaned on each flush to avoid waiting
+ * for the GPU to finish reading the previous contents.
+ *
+ * Flushing changes the current shader program, the texture bound to texture
+ * unit 0, and the buffer and vertex attribute bindings. Program, texture and
+ * array buffer changes go through glStateCache(). On OpenGL ES 2.0, vertex
+ * attributes 0 and 1 are left enabled.
+ */
+class SpriteBatch
+{
+public:
+  explicit SpriteBatch(
+    SpriteSortMode sortMode = SpriteSortMode::SubmissionOrder);
+
+  /** Queue a textured quad
+   *
+   * The shader must use VertexLayout::PositionAndTexCoords.
+   */
+  void drawQuad(
+    const Shader& shader,
+    GLuint texture,
+    const base::Rect<float>& destRect,
+    const base::Rect<float>& texCoords = {{0.0f, 0.0f}, {1.0f, 1.0f}});
+
+  /** Queue a solid color quad
+   *
+   * The shader must use VertexLayout::PositionAndColor.
+   */
+  void drawQuad(
+    const Shader& shader,
+    const base::Rect<float>& destRect,
+    const base::Color& color);
+
+  /** Draw all queued quads */
+  void flush();
+
+  std::size_t numQueuedQuads() const { return mQueuedQuads.size(); }
+
+  /** Draw calls and vertices submitted since the last call to resetStats()
+   *
+   * Meant to be read and reset once per frame.
+   */
+  const SpriteBatchStats& stats() const { return mStats; }
+  void resetStats() { mStats = {}; }
+
+private:
+  using QueuedQuad = detail::QueuedQuad;
+
+  void uploadVertices(const std::vector<float>& vertexData);
+  void drawQuads(
+    const std::vector<float>& vertexData,
+    const std::vector<QueuedQuad>& quads);
+
+  BufferHandle mVertexBuffer;
+  BufferHandle mIndexBuffer;
+#ifndef RIGEL_USE_GL_ES
+  VertexArrayHandle mVertexArray;
+#endif
+  std::size_t mVertexBufferCapacity = 0;
+
+  SpriteSortMode mSortMode;
+  std::vector<QueuedQuad> mQueuedQuads;
+  std::vector<float> mVertexData;
+  std::vector<float> mSortedVertexData;
+  std::vector<detail::QuadRun> mRuns;
+  SpriteBatchStats mStats;
+};
+
+} // namespace rigel::opengl
@@ -0,0 +1,149 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/opengl/opengl.hpp>
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+
+namespace rigel::opengl
+{
+
+struct GlStateCacheStats
+{
+  /** Number of state changes passed on to OpenGL */
+  std::size_t issuedCalls = 0;
+
+  /** Number of redundant state changes that were skipped */
+  std::size_t elidedCalls = 0;
+};
+
+
+/** Shadow copy of OpenGL state, to skip redundant state changes
+ *
+ * Tracks the current program, the 2D textures bound to each texture unit,
+ * the vertex array (not on OpenGL ES) and array buffer binding, blending,
+ * and the viewport. Setting a value that is already current doesn't call
+ * into OpenGL.
+ *
+ * For this to work, all changes to the tracked state need to go through
+ * the cache. When deleting a texture, buffer, or vertex array which might be
+ * bound, the corresponding on...Deleted() function must be called, since
+ * OpenGL resets bindings of deleted objects to 0. If third-party code
+ * changes tracked state without restoring it, call invalidate() afterwards.
+ *
+ * The initial state matches the state of a newly created OpenGL context,
+ * except for the viewport, which is unknown until set.
+ *
+ * There is one cache per thread, see glStateCache(). This matches how
+ * OpenGL contexts are current on one thread at a time.
+ */
+class GlStateCache
+{
+public:
+  static constexpr auto MAX_TEXTURE_UNITS = std::size_t{16};
+
+  GlStateCache();
+
+  void useProgram(GLuint program);
+
+  /** Returns the current program
+   *
+   * If the current program is unknown due to invalidate(), it's queried from
+   * OpenGL once.
+   */
+  GLuint currentProgram();
+
+  void bindTexture(std::size_t unit, GLuint texture);
+  void bindArrayBuffer(GLuint buffer);
+#ifndef RIGEL_USE_GL_ES
+  void bindVertexArray(GLuint vertexArray);
+
+  /** Returns the current vertex array, queried like currentProgram() */
+  GLuint currentVertexArray();
+#endif
+
+  void setBlendEnabled(bool enabled);
+  void setBlendFunc(GLenum sourceFactor, GLenum destFactor);
+  void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+  void onTextureDeleted(GLuint texture);
+  void onBufferDeleted(GLuint buffer);
+#ifndef RIGEL_USE_GL_ES
+  void onVertexArrayDeleted(GLuint vertexArray);
+#endif
+
+  /** Forget all tracked state, the next state changes are always issued */
+  void invalidate();
+
+  const GlStateCacheStats& stats() const { return mStats; }
+  void resetStats() { mStats = {}; }
+
+private:
+  template <typename T, typename SetFunc>
+  void update(std::optional<T>& current, const T& value, SetFunc&& set);
+
+  struct BlendFunc
+  {
+    GLenum mSourceFactor;
+    GLenum mDestFactor;
+
+    bool operator==(const BlendFunc& other) const
+    {
+      return mSourceFactor == other.mSourceFactor &&
+        mDestFactor == other.mDestFactor;
+    }
+  };
+
+  struct Viewport
+  {
+    GLint mX;
+    GLint mY;
+    GLsizei mWidth;
+    GLsizei mHeight;
+
+    bool operator==(const Viewport& other) const
+    {
+      return mX == other.mX && mY == other.mY && mWidth == other.mWidth &&
+        mHeight == other.mHeight;
+    }
+  };
+
+  std::optional<GLuint> mProgram = 0u;
+  std::optional<GLenum> mActiveTextureUnit = GLenum{GL_TEXTURE0};
+  std::array<std::optional<GLuint>, MAX_TEXTURE_UNITS> mTextures;
+  std::optional<GLuint> mArrayBuffer = 0u;
+#ifndef RIGEL_USE_GL_ES
+  std::optional<GLuint> mVertexArray = 0u;
+#endif
+  std::optional<bool> mBlendEnabled = false;
+  std::optional<BlendFunc> mBlendFunc = BlendFunc{GL_ONE, GL_ZERO};
+  std::optional<Viewport> mViewport;
+
+  GlStateCacheStats mStats;
+};
+
+
+/** State cache for the OpenGL context that's current on the calling thread
+ */
+GlStateCache& glStateCache();
+
+} // namespace rigel::opengl
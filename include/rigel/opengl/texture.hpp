@@ -0,0 +1,190 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <rigel/base/image.hpp>
+#include <rigel/opengl/gl_handle.hpp>
+#include <rigel/opengl/opengl.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+
+
+namespace rigel::opengl
+{
+
+enum class TextureFilter
+{
+  Nearest,
+  Linear
+};
+
+
+/** RGBA texture, with optional mipmaps
+ *
+ * Creating or updating a texture changes the texture bound to texture unit
+ * 0, via glStateCache(). On OpenGL ES 2.0, mipmaps are only supported for
+ * textures with power of two dimensions.
+ */
+class Texture
+{
+public:
+  /** Create texture with undefined contents */
+  Texture(
+    std::size_t width,
+    std::size_t height,
+    TextureFilter filter = TextureFilter::Nearest,
+    bool withMipmaps = false);
+
+  /** Create texture and upload the given pixels right away */
+  explicit Texture(
+    const base::ImageView& image,
+    TextureFilter filter = TextureFilter::Nearest,
+    bool withMipmaps = false);
+
+  /** Replace a region of the texture's contents right away
+   *
+   * The region must lie within the texture. Mipmaps are not updated, see
+   * generateMipmaps(). For uploads which shouldn't stall the frame, use
+   * TextureUploader.
+   */
+  void update(std::size_t x, std::size_t y, const base::ImageView& pixels);
+
+  /** Recompute mipmap levels from the base level */
+  void generateMipmaps();
+
+  GLuint handle() const { return mHandle.mHandle; }
+  std::size_t width() const { return mWidth; }
+  std::size_t height() const { return mHeight; }
+  bool hasMipmaps() const { return mHasMipmaps; }
+
+  /** True while a TextureUploader still has uploads queued for the texture */
+  bool hasPendingUploads() const { return mNumPendingUploads > 0; }
+
+private:
+  friend class TextureUploader;
+
+  TextureHandle mHandle;
+  std::size_t mWidth;
+  std::size_t mHeight;
+  bool mHasMipmaps;
+  std::size_t mNumPendingUploads = 0;
+};
+
+
+struct TextureUploaderConfig
+{
+  /** Maximum number of pixel bytes uploaded by each call to processUploads()
+   *
+   * At least one row of pixels is uploaded per call, even if that exceeds
+   * the budget.
+   */
+  std::size_t maxBytesPerFrame = 4 * 1024 * 1024;
+};
+
+
+struct TextureUploaderStats
+{
+  std::size_t uploadedBytes = 0;
+  std::size_t completedUploads = 0;
+};
+
+
+/** Streams pixel data into textures, spread out over multiple frames
+ *
+ * Uploads are queued with enqueue(), and performed by processUploads(),
+ * which is meant to be called once per frame on the thread owning the GL
+ * context. Each call uploads at most maxBytesPerFrame, splitting large
+ * images into bands of rows, so that loading a burst of new assets doesn't
+ * cause a hitch. Uploads are processed in the order they were queued.
+ *
+ * On desktop GL, the pixels are copied into a pixel buffer object, which is
+ * orphaned on each call. The transfer into the texture can then happen
+ * asynchronously, without waiting for the GPU. On OpenGL ES 2.0, which
+ * lacks pixel buffer objects, pixels are uploaded directly from memory.
+ *
+ * If the texture was created with mipmaps, they are regenerated once an
+ * upload has been completed. Uploads to a texture which has been destroyed
+ * in the meantime are dropped.
+ *
+ * Processing uploads changes the texture bound to texture unit 0, via
+ * glStateCache().
+ */
+class TextureUploader
+{
+public:
+  explicit TextureUploader(TextureUploaderConfig config = {});
+  ~TextureUploader();
+
+  TextureUploader(const TextureUploader&) = delete;
+  TextureUploader& operator=(const TextureUploader&) = delete;
+
+  /** Queue upload of image into the given texture, at position x/y
+   *
+   * The image must fit into the texture at that position. The image is kept
+   * alive until the upload is done.
+   */
+  void enqueue(
+    const std::shared_ptr<Texture>& pTexture,
+    std::size_t x,
+    std::size_t y,
+    std::shared_ptr<const base::Image> pImage);
+
+  /** Like above, but copies the pixels referenced by the view */
+  void enqueue(
+    const std::shared_ptr<Texture>& pTexture,
+    std::size_t x,
+    std::size_t y,
+    const base::ImageView& pixels);
+
+  /** Create a new texture and queue upload of the image into it */
+  std::shared_ptr<Texture> createTexture(
+    std::shared_ptr<const base::Image> pImage,
+    TextureFilter filter = TextureFilter::Nearest,
+    bool withMipmaps = false);
+
+  /** Perform queued uploads, up to the configured budget */
+  void processUploads();
+
+  /** Perform all queued uploads, regardless of the budget */
+  void finishAll();
+
+  std::size_t pendingUploads() const { return mQueue.size(); }
+  TextureUploaderStats stats() const { return mStats; }
+
+private:
+  struct Upload
+  {
+    std::weak_ptr<Texture> mpTexture;
+    std::shared_ptr<const base::Image> mpImage;
+    std::size_t mX;
+    std::size_t mY;
+    std::size_t mNextRow = 0;
+  };
+
+  TextureUploaderConfig mConfig;
+  TextureUploaderStats mStats;
+  std::deque<Upload> mQueue;
+#ifndef RIGEL_USE_GL_ES
+  BufferHandle mPixelBuffer;
+  std::size_t mPixelBufferSize = 0;
+#endif
+};
+
+} // namespace rigel::opengl
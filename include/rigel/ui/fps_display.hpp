@@ -16,6 +16,11 @@
 
 #pragma once
 
+#include <rigel/opengl/frame_profiler.hpp>
+
+#include <optional>
+#include <vector>
+
 #ifdef RIGEL_HAVE_BOOST
   #include <boost/circular_buffer.hpp>
 #endif
@@ -30,8 +35,17 @@ public:
   void
     updateAndRender(double totalElapsed, double elapsedCpu, double elapsedGpu);
 
+  /** Show timings measured by an opengl::FrameProfiler, including scopes */
+  void updateAndRender(const opengl::FrameTimings& timings);
+
 
 private:
+  void render(
+    double totalElapsed,
+    double elapsedCpu,
+    std::optional<double> elapsedGpu,
+    const std::vector<opengl::ProfileScopeTiming>& scopes);
+
 #ifdef RIGEL_HAVE_BOOST
   boost::circular_buffer<float> mFrameTimesHistory{120};
 #endif
@@ -23,20 +23,69 @@ RIGEL_DISABLE_WARNINGS
 RIGEL_RESTORE_WARNINGS
 
 #include <filesystem>
+#include <functional>
 #include <optional>
 
 
 namespace rigel::ui::imgui_integration
 {
 
+/** Set up Dear ImGui for the given window
+ *
+ * If preferencesPath is given, ImGui's settings are stored there. If
+ * cacheDirectory is given, the rasterized font atlas is cached there, which
+ * speeds up subsequent runs.
+ */
 void init(
   SDL_Window* pWindow,
   void* pGlContext,
-  const std::optional<std::filesystem::path>& preferencesPath);
+  const std::optional<std::filesystem::path>& preferencesPath,
+  const std::optional<std::filesystem::path>& cacheDirectory = std::nullopt);
 void shutdown();
 
+/** Pass an event to Dear ImGui
+ *
+ * Returns true if the event was consumed by the UI. When the window size
+ * changes, the UI is rescaled at the start of the first frame after the size
+ * has been stable for a short while, rather than on every resize event.
+ */
 bool handleEvent(const SDL_Event& event);
 void beginFrame(SDL_Window* pWindow);
 void endFrame();
 
+/** Finish the frame like endFrame(), but render it later
+ *
+ * Returns a function which renders a copy of the frame's draw data. It can
+ * be invoked on a different thread, as long as the GL context is current
+ * there. Meant for use with runAppWithRenderThread(), where it can be added
+ * to the frame's command list. beginFrame() doesn't need the GL context, so
+ * ImGui frames can be built on a thread that doesn't own it.
+ */
+std::function<void()> endFrameDeferred();
+
+/** Finish the frame like endFrame(), but only re-render the UI if it changed
+ *
+ * The UI is rendered into an off-screen texture, which is then drawn on top
+ * of the current framebuffer. On subsequent frames, the texture is reused
+ * as long as the draw data is identical, which saves the GPU work for
+ * rendering the UI. Draw data containing user callbacks or images other than
+ * the font atlas is always re-rendered, since the contents of those textures
+ * aren't part of the draw data and may change at any time.
+ *
+ * Drawing the texture changes the current shader program, the texture bound
+ * to unit 0, blending and the viewport, via glStateCache().
+ *
+ * Returns true if the UI was re-rendered.
+ */
+bool endFrameCached();
+
+/** True if nothing is happening in the UI right now
+ *
+ * This is the case if the last frame finished with endFrameCached() was
+ * unchanged, and no events have been passed to handleEvent() in the last
+ * couple of frames. Always false when using endFrame() or
+ * endFrameDeferred().
+ */
+bool isIdle();
+
 } // namespace rigel::ui::imgui_integration
@@ -0,0 +1,132 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/asset_loader.hpp"
+
+#include "base/image_loading.hpp"
+
+
+namespace rigel::base
+{
+
+AssetLoader::AssetLoader(const std::size_t numThreads)
+  : mThreadPool(numThreads)
+{
+}
+
+
+std::future<std::optional<Image>>
+  AssetLoader::loadImageAsync(const std::filesystem::path& path)
+{
+  return mThreadPool.submit([path]() { return loadImage(path); });
+}
+
+
+std::vector<std::future<std::optional<Image>>>
+  AssetLoader::loadImagesAsync(const std::vector<std::filesystem::path>& paths)
+{
+  std::vector<std::future<std::optional<Image>>> results;
+  results.reserve(paths.size());
+
+  for (const auto& path : paths)
+  {
+    results.push_back(loadImageAsync(path));
+  }
+
+  return results;
+}
+
+
+void AssetLoader::requestImages(
+  const std::vector<std::filesystem::path>& paths,
+  const ImageLoadedFunc& onLoaded)
+{
+  for (const auto& path : paths)
+  {
+    mThreadPool.submit([this, path, onLoaded]() {
+      Completion completion{path, std::nullopt, nullptr, onLoaded};
+
+      try
+      {
+        completion.mImage = loadImage(path);
+      }
+      catch (...)
+      {
+        completion.mpError = std::current_exception();
+      }
+
+      std::lock_guard lock{mCompletionsMutex};
+      mCompletions.push_back(std::move(completion));
+    });
+  }
+
+  mNumPendingRequests += paths.size();
+}
+
+
+std::size_t AssetLoader::processCompletions()
+{
+  std::vector<Completion> completions;
+
+  {
+    std::lock_guard lock{mCompletionsMutex};
+    std::swap(completions, mCompletions);
+  }
+
+  // Callbacks are invoked without holding the lock, so that they are free to
+  // make new requests.
+  mNumPendingRequests -= completions.size();
+
+  std::exception_ptr pFirstError;
+  auto numInvoked = std::size_t{0};
+
+  for (auto& completion : completions)
+  {
+    if (completion.mpError)
+    {
+      if (!pFirstError)
+      {
+        pFirstError = completion.mpError;
+      }
+
+      continue;
+    }
+
+    // A throwing callback must not cause the remaining completions to be
+    // lost, so its exception is deferred like a loading error.
+    try
+    {
+      ++numInvoked;
+      completion.mOnLoaded(completion.mPath, std::move(completion.mImage));
+    }
+    catch (...)
+    {
+      if (!pFirstError)
+      {
+        pFirstError = std::current_exception();
+      }
+    }
+  }
+
+  if (pFirstError)
+  {
+    std::rethrow_exception(pFirstError);
+  }
+
+  return numInvoked;
+}
+
+} // namespace rigel::base
@@ -17,6 +17,7 @@
 #include "base/byte_buffer.hpp"
 
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
 
@@ -32,9 +33,79 @@ namespace
 
 const char* OUT_OF_DATA_ERROR_MSG = "No more data in stream";
 
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr auto IS_BIG_ENDIAN_HOST = true;
+#else
+constexpr auto IS_BIG_ENDIAN_HOST = false;
+#endif
+
+
+// Compilers recognize these patterns and turn them into a single bswap
+// instruction. Only used on big-endian hosts.
+[[maybe_unused]] std::uint8_t byteSwapped(const std::uint8_t value)
+{
+  return value;
+}
+
+
+[[maybe_unused]] std::uint16_t byteSwapped(const std::uint16_t value)
+{
+  return static_cast<std::uint16_t>((value >> 8) | (value << 8));
+}
+
+
+[[maybe_unused]] std::uint32_t byteSwapped(const std::uint32_t value)
+{
+  return ((value & 0x000000FFu) << 24) | ((value & 0x0000FF00u) << 8) |
+    ((value & 0x00FF0000u) >> 8) | ((value & 0xFF000000u) >> 24);
+}
+
+
+template <typename T>
+T loadLittleEndian(const std::uint8_t* pData)
+{
+  // memcpy is the portable way to do an unaligned load, it compiles down to
+  // a single mov on all relevant platforms.
+  T value;
+  std::memcpy(&value, pData, sizeof(T));
+
+  if constexpr (IS_BIG_ENDIAN_HOST)
+  {
+    return byteSwapped(value);
+  }
+  else
+  {
+    return value;
+  }
 }
 
 
+template <typename T>
+void loadLittleEndianArray(
+  const std::uint8_t* pData,
+  const std::size_t count,
+  T* pOut)
+{
+  if constexpr (IS_BIG_ENDIAN_HOST)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      pOut[i] = loadLittleEndian<T>(pData + i * sizeof(T));
+    }
+  }
+  else
+  {
+    if (count > 0)
+    {
+      std::memcpy(pOut, pData, count * sizeof(T));
+    }
+  }
+}
+
+} // namespace
+
+
 std::optional<ByteBuffer> tryLoadFile(const std::filesystem::path& path)
 {
   ifstream file(path, ios::binary | ios::ate);
@@ -54,9 +125,9 @@ std::optional<ByteBuffer> tryLoadFile(const std::filesystem::path& path)
 
 ByteBuffer loadFileOrThrow(const std::filesystem::path& path)
 {
-  if (const auto buffer = tryLoadFile(path))
+  if (auto buffer = tryLoadFile(path))
   {
-    return *buffer;
+    return std::move(*buffer);
   }
 
   throw std::runtime_error(string("File can't be opened: ") + path.u8string());
@@ -91,46 +162,69 @@ LeStreamReader::LeStreamReader(const ByteBuffer& data)
 }
 
 
+LeStreamReader::LeStreamReader(ArrayView<std::uint8_t> data)
+  : mpCurrentByte(data.begin())
+  , mpDataBegin(data.begin())
+  , mpDataEnd(data.end())
+{
+}
+
+
+LeStreamReader::LeStreamReader(std::string_view data)
+  : LeStreamReader(ArrayView<std::uint8_t>{
+      reinterpret_cast<const std::uint8_t*>(data.data()),
+      static_cast<ArrayView<std::uint8_t>::size_type>(data.size())})
+{
+}
+
+
 LeStreamReader::LeStreamReader(ByteBufferCIter begin, ByteBufferCIter end)
-  : mCurrentByteIter(begin)
-  , mDataEnd(end)
+  // Dereferencing the begin iterator is not allowed for an empty range
+  : mpCurrentByte(begin == end ? nullptr : &*begin)
+  , mpDataBegin(mpCurrentByte)
+  , mpDataEnd(mpCurrentByte + std::distance(begin, end))
+  , mDataBeginIter(begin)
 {
 }
 
 
-uint8_t LeStreamReader::readU8()
+const uint8_t*
+  LeStreamReader::consume(const size_t count, const size_t elementSize)
 {
-  if (mCurrentByteIter == mDataEnd)
+  // Dividing instead of multiplying avoids overflow for huge counts
+  if (count > numBytesLeft() / elementSize)
   {
     throw runtime_error(OUT_OF_DATA_ERROR_MSG);
   }
-  return *mCurrentByteIter++;
+
+  const auto pStart = mpCurrentByte;
+  mpCurrentByte += count * elementSize;
+  return pStart;
+}
+
+
+uint8_t LeStreamReader::readU8()
+{
+  return *consume(1);
 }
 
 
 uint16_t LeStreamReader::readU16()
 {
-  const auto lsb = readU8();
-  const auto msb = readU8();
-  return lsb | uint16_t(msb << 8);
+  return loadLittleEndian<uint16_t>(consume(sizeof(uint16_t)));
 }
 
 
 uint32_t LeStreamReader::readU24()
 {
-  const auto lsb = readU8();
-  const auto middle = readU8();
-  const auto msb = readU8();
-
-  return lsb | (middle << 8) | (msb << 16);
+  const auto pBytes = consume(3);
+  return pBytes[0] | (pBytes[1] << 8) | (pBytes[2] << 16);
 }
 
 
 uint32_t LeStreamReader::readU32()
 {
-  const auto lowWord = readU16();
-  const auto highWord = readU16();
-  return lowWord | (highWord << 16);
+  return loadLittleEndian<uint32_t>(consume(sizeof(uint32_t)));
 }
 
 
@@ -164,9 +258,9 @@ int32_t LeStreamReader::readS32()
 template <typename Callable>
 auto LeStreamReader::withPreservingCurrentIter(Callable func)
 {
-  const auto currentIter = mCurrentByteIter;
+  const auto pCurrentByte = mpCurrentByte;
   const auto result = func();
-  mCurrentByteIter = currentIter;
+  mpCurrentByte = pCurrentByte;
   return result;
 }
 
@@ -219,51 +313,68 @@ int32_t LeStreamReader::peekS32()
 }
 
 
-void LeStreamReader::skipBytes(const size_t count)
+void LeStreamReader::readArrayU8(const size_t count, uint8_t* pOut)
 {
-  assert(distance(mCurrentByteIter, mDataEnd) >= 0);
-  const auto availableBytes =
-    static_cast<size_t>(distance(mCurrentByteIter, mDataEnd));
-  if (availableBytes < count)
-  {
-    throw runtime_error(OUT_OF_DATA_ERROR_MSG);
-  }
+  loadLittleEndianArray(consume(count), count, pOut);
+}
 
-  advance(mCurrentByteIter, count);
+
+void LeStreamReader::readArrayU16(const size_t count, uint16_t* pOut)
+{
+  loadLittleEndianArray(consume(count, sizeof(uint16_t)), count, pOut);
+}
+
+
+void LeStreamReader::readArrayU32(const size_t count, uint32_t* pOut)
+{
+  loadLittleEndianArray(consume(count, sizeof(uint32_t)), count, pOut);
+}
+
+
+void LeStreamReader::skipBytes(const size_t count)
+{
+  consume(count);
 }
 
 
 bool LeStreamReader::hasData() const
 {
-  return mCurrentByteIter != mDataEnd;
+  return mpCurrentByte != mpDataEnd;
 }
 
 
 size_t LeStreamReader::numBytesLeft() const
 {
-  return size_t(std::distance(mCurrentByteIter, mDataEnd));
+  assert(mpDataEnd >= mpCurrentByte);
+  return size_t(mpDataEnd - mpCurrentByte);
 }
 
 
 ByteBufferCIter LeStreamReader::currentIter() const
 {
-  return mCurrentByteIter;
+  if (!mDataBeginIter)
+  {
+    throw std::logic_error(
+      "currentIter() requires a reader constructed from a ByteBuffer");
+  }
+
+  return *mDataBeginIter + (mpCurrentByte - mpDataBegin);
 }
 
 
 string readFixedSizeString(LeStreamReader& reader, const size_t len)
 {
-  vector<char> characters;
-  for (size_t i = 0; i < len; ++i)
+  string characters(len, '\0');
+  reader.readArrayU8(len, reinterpret_cast<uint8_t*>(characters.data()));
+
+  // The string ends at the first zero-terminator, if there is one
+  const auto terminatorPos = characters.find('\0');
+  if (terminatorPos != string::npos)
   {
-    characters.push_back(static_cast<char>(reader.readU8()));
+    characters.resize(terminatorPos);
   }
 
-  // Ensure string is zero-terminated
-  characters.push_back(0);
-
-  // Let std::string's ctor handle the zero-terminator detection
-  return string(characters.data());
+  return characters;
 }
 
 } // namespace rigel::base
@@ -0,0 +1,98 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "base/command_list.hpp"
+
+#include "base/defer.hpp"
+
+#include <algorithm>
+
+
+namespace rigel::base
+{
+
+namespace
+{
+
+constexpr auto BLOCK_SIZE = std::size_t{64 * 1024};
+
+
+std::size_t alignUp(const std::size_t offset, const std::size_t alignment)
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+
+CommandList::~CommandList()
+{
+  clear();
+}
+
+
+void CommandList::execute()
+{
+  auto clearGuard = defer([this]() { clear(); });
+
+  for (const auto& command : mCommands)
+  {
+    command.mpInvoke(command.mpStorage);
+  }
+}
+
+
+void CommandList::clear()
+{
+  for (const auto& command : mCommands)
+  {
+    command.mpDestroy(command.mpStorage);
+  }
+
+  mCommands.clear();
+  mCurrentBlock = 0;
+  mOffsetInBlock = 0;
+}
+
+
+void* CommandList::allocate(const std::size_t size, const std::size_t alignment)
+{
+  while (mCurrentBlock < mBlocks.size())
+  {
+    auto& block = mBlocks[mCurrentBlock];
+
+    const auto offset = alignUp(mOffsetInBlock, alignment);
+    if (offset + size <= block.mSize)
+    {
+      mOffsetInBlock = offset + size;
+      return block.mpData.get() + offset;
+    }
+
+    ++mCurrentBlock;
+    mOffsetInBlock = 0;
+  }
+
+  // Blocks are aligned for any type that's not over-aligned, so a fresh
+  // block can always hold the object at its start
+  const auto blockSize = std::max(BLOCK_SIZE, size);
+  mBlocks.push_back(Block{std::make_unique<std::byte[]>(blockSize), blockSize});
+  mCurrentBlock = mBlocks.size() - 1;
+  mOffsetInBlock = size;
+  return mBlocks.back().mpData.get();
+}
+
+} // namespace rigel::base
@@ -0,0 +1,49 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/file_utils.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+
+
+namespace rigel::base
+{
+
+std::filesystem::path temporaryPathFor(const std::filesystem::path& path)
+{
+  // Thread ids or counters are only unique within a process, so a random
+  // suffix is used instead.
+  thread_local auto generator = []() {
+    std::random_device device;
+    return std::mt19937_64{
+      (std::uint64_t{device()} << 32) | std::uint64_t{device()}};
+  }();
+
+  char suffix[32];
+  std::snprintf(
+    suffix,
+    sizeof(suffix),
+    ".%016llx.tmp",
+    static_cast<unsigned long long>(generator()));
+
+  auto result = path;
+  result += suffix;
+  return result;
+}
+
+} // namespace rigel::base
@@ -0,0 +1,177 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/file_watcher.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+  #include <sys/inotify.h>
+  #include <unistd.h>
+#endif
+
+
+namespace rigel::base
+{
+
+namespace
+{
+
+std::filesystem::path normalize(const std::filesystem::path& path)
+{
+  return std::filesystem::absolute(path).lexically_normal();
+}
+
+} // namespace
+
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher()
+  : mInotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+  if (mInotifyFd == -1)
+  {
+    throw std::runtime_error(
+      std::string{"Failed to initialize inotify: "} + std::strerror(errno));
+  }
+}
+
+
+FileWatcher::~FileWatcher()
+{
+  close(mInotifyFd);
+}
+
+
+void FileWatcher::watch(const std::filesystem::path& path)
+{
+  const auto normalizedPath = normalize(path);
+  if (mFiles.count(normalizedPath))
+  {
+    return;
+  }
+
+  const auto directory = normalizedPath.parent_path();
+
+  // Adding a watch for a directory that's already watched returns the
+  // existing watch descriptor, so this works for both cases.
+  const auto watchDescriptor = inotify_add_watch(
+    mInotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (watchDescriptor == -1)
+  {
+    throw std::runtime_error(
+      "Failed to watch " + directory.u8string() + ": " +
+      std::strerror(errno));
+  }
+
+  mDirectoriesByWatch[watchDescriptor] = directory;
+  mFiles.insert(normalizedPath);
+}
+
+
+std::vector<std::filesystem::path> FileWatcher::pollChanges()
+{
+  std::vector<std::filesystem::path> changedFiles;
+
+  alignas(inotify_event) std::array<char, 4096> buffer;
+
+  for (;;)
+  {
+    const auto bytesRead = read(mInotifyFd, buffer.data(), buffer.size());
+    if (bytesRead <= 0)
+    {
+      // EAGAIN, no more events pending
+      break;
+    }
+
+    for (auto offset = ssize_t{0}; offset < bytesRead;)
+    {
+      const auto pEvent =
+        reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+      offset += ssize_t(sizeof(inotify_event) + pEvent->len);
+
+      const auto iDirectory = mDirectoriesByWatch.find(pEvent->wd);
+      if (pEvent->len == 0 || iDirectory == mDirectoriesByWatch.end())
+      {
+        continue;
+      }
+
+      auto path = iDirectory->second / pEvent->name;
+      if (
+        mFiles.count(path) &&
+        std::find(changedFiles.begin(), changedFiles.end(), path) ==
+          changedFiles.end())
+      {
+        changedFiles.push_back(std::move(path));
+      }
+    }
+  }
+
+  return changedFiles;
+}
+
+#else
+
+FileWatcher::FileWatcher() = default;
+FileWatcher::~FileWatcher() = default;
+
+
+void FileWatcher::watch(const std::filesystem::path& path)
+{
+  const auto normalizedPath = normalize(path);
+  if (!mFiles.insert(normalizedPath).second)
+  {
+    return;
+  }
+
+  std::error_code ec;
+  mModificationTimes[normalizedPath] =
+    std::filesystem::last_write_time(normalizedPath, ec);
+}
+
+
+std::vector<std::filesystem::path> FileWatcher::pollChanges()
+{
+  std::vector<std::filesystem::path> changedFiles;
+
+  for (auto& [path, lastModificationTime] : mModificationTimes)
+  {
+    std::error_code ec;
+    const auto modificationTime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+    {
+      continue;
+    }
+
+    if (modificationTime != lastModificationTime)
+    {
+      lastModificationTime = modificationTime;
+      changedFiles.push_back(path);
+    }
+  }
+
+  return changedFiles;
+}
+
+#endif
+
+} // namespace rigel::base
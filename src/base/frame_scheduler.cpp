@@ -0,0 +1,173 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "base/frame_scheduler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+
+namespace rigel::base
+{
+
+namespace
+{
+
+// Without a frame rate cap, a frame counts as late once it took long enough
+// to miss at least one refresh.
+constexpr auto LATE_FRAME_FACTOR = 1.5;
+
+
+double toSeconds(const Clock::duration duration)
+{
+  return std::chrono::duration<double>(duration).count();
+}
+
+
+Clock::duration fromSeconds(const double seconds)
+{
+  return std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(seconds));
+}
+
+} // namespace
+
+
+FrameScheduler::FrameScheduler(const FrameSchedulerConfig& config)
+  : mConfig(config)
+{
+  if (
+    config.fixedTimeStep < 0.0 || config.maxUpdatesPerFrame < 1 ||
+    config.maxFps < 0.0 || config.expectedFps < 0.0 ||
+    config.spinThreshold < 0.0)
+  {
+    throw std::invalid_argument("Invalid frame scheduler configuration");
+  }
+
+  if (config.maxFps > 0.0)
+  {
+    mFrameDuration = fromSeconds(1.0 / config.maxFps);
+  }
+}
+
+
+FrameTiming FrameScheduler::beginFrame()
+{
+  const auto resumingFromIdleWait = std::exchange(mResumingFromIdleWait, false);
+  auto previousFrameWasLate = false;
+  auto missedDeadline = false;
+
+  if (mNextDeadline)
+  {
+    const auto now = Clock::now();
+    if (now > *mNextDeadline)
+    {
+      missedDeadline = true;
+
+      if (!resumingFromIdleWait)
+      {
+        previousFrameWasLate = true;
+        recordLateFrame(toSeconds(now - *mNextDeadline));
+      }
+    }
+    else
+    {
+      waitUntil(*mNextDeadline);
+    }
+  }
+
+  const auto frameStart = Clock::now();
+  const auto elapsed =
+    mLastFrameStart ? toSeconds(frameStart - *mLastFrameStart) : 0.0;
+  mLastFrameStart = frameStart;
+
+  if (mFrameDuration)
+  {
+    mNextDeadline = missedDeadline || !mNextDeadline
+      ? frameStart + *mFrameDuration
+      : *mNextDeadline + *mFrameDuration;
+  }
+  else if (mConfig.expectedFps > 0.0 && !resumingFromIdleWait)
+  {
+    const auto expectedFrameTime = 1.0 / mConfig.expectedFps;
+    if (elapsed > expectedFrameTime * LATE_FRAME_FACTOR)
+    {
+      previousFrameWasLate = true;
+      recordLateFrame(elapsed - expectedFrameTime);
+    }
+  }
+
+  FrameTiming timing;
+  timing.frameNumber = mStats.numFrames++;
+  timing.elapsed = elapsed;
+  timing.previousFrameWasLate = previousFrameWasLate;
+
+  if (mConfig.fixedTimeStep > 0.0)
+  {
+    const auto step = mConfig.fixedTimeStep;
+
+    mAccumulatedTime += elapsed;
+    auto numUpdates = static_cast<std::uint64_t>(mAccumulatedTime / step);
+    mAccumulatedTime -= double(numUpdates) * step;
+
+    const auto maxUpdates = std::uint64_t(mConfig.maxUpdatesPerFrame);
+    if (numUpdates > maxUpdates)
+    {
+      mStats.numDroppedUpdates += numUpdates - maxUpdates;
+      numUpdates = maxUpdates;
+    }
+
+    timing.numUpdates = int(numUpdates);
+    timing.interpolationAlpha = std::clamp(mAccumulatedTime / step, 0.0, 1.0);
+  }
+
+  timing.stats = mStats;
+  return timing;
+}
+
+
+void FrameScheduler::waitUntil(const Clock::time_point deadline) const
+{
+  const auto spinThreshold = fromSeconds(mConfig.spinThreshold);
+
+  for (;;)
+  {
+    const auto remaining = deadline - Clock::now();
+    if (remaining <= spinThreshold)
+    {
+      break;
+    }
+
+    std::this_thread::sleep_for(remaining - spinThreshold);
+  }
+
+  while (Clock::now() < deadline)
+  {
+    std::this_thread::yield();
+  }
+}
+
+
+void FrameScheduler::recordLateFrame(const double lateness)
+{
+  ++mStats.numLateFrames;
+  mStats.worstLateness = std::max(mStats.worstLateness, lateness);
+}
+
+} // namespace rigel::base
@@ -0,0 +1,121 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "base/frame_statistics.hpp"
+
+#include "base/warnings.hpp"
+
+RIGEL_DISABLE_WARNINGS
+#include <nlohmann/json.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+
+namespace rigel::base
+{
+
+namespace
+{
+
+double percentile(const std::vector<double>& sortedValues, const double p)
+{
+  const auto rank =
+    static_cast<std::size_t>(std::ceil(p / 100.0 * sortedValues.size()));
+  const auto index = std::clamp<std::size_t>(rank, 1, sortedValues.size()) - 1;
+  return sortedValues[index];
+}
+
+
+double toMilliseconds(const double seconds)
+{
+  return seconds * 1000.0;
+}
+
+} // namespace
+
+
+FrameTimeSummary summarizeFrameTimes(const std::vector<double>& frameTimes)
+{
+  if (frameTimes.empty())
+  {
+    return {};
+  }
+
+  auto sorted = frameTimes;
+  std::sort(sorted.begin(), sorted.end());
+
+  FrameTimeSummary summary;
+  summary.numFrames = sorted.size();
+  summary.min = sorted.front();
+  summary.max = sorted.back();
+  summary.mean =
+    std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+  summary.median = percentile(sorted, 50.0);
+  summary.p90 = percentile(sorted, 90.0);
+  summary.p95 = percentile(sorted, 95.0);
+  summary.p99 = percentile(sorted, 99.0);
+  return summary;
+}
+
+
+void writeFrameTimesJson(
+  std::ostream& stream,
+  const std::vector<double>& frameTimes)
+{
+  const auto summary = summarizeFrameTimes(frameTimes);
+
+  auto frameTimesMs = nlohmann::json::array();
+  for (const auto time : frameTimes)
+  {
+    frameTimesMs.push_back(toMilliseconds(time));
+  }
+
+  const auto json = nlohmann::json{
+    {"summary",
+     {{"numFrames", summary.numFrames},
+      {"min", toMilliseconds(summary.min)},
+      {"max", toMilliseconds(summary.max)},
+      {"mean", toMilliseconds(summary.mean)},
+      {"median", toMilliseconds(summary.median)},
+      {"p90", toMilliseconds(summary.p90)},
+      {"p95", toMilliseconds(summary.p95)},
+      {"p99", toMilliseconds(summary.p99)}}},
+    {"frameTimes", std::move(frameTimesMs)}};
+
+  stream << json.dump(2) << '\n';
+}
+
+
+bool saveFrameTimesJson(
+  const std::filesystem::path& path,
+  const std::vector<double>& frameTimes)
+{
+  std::ofstream file(path);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  writeFrameTimesJson(file, frameTimes);
+  return file.good();
+}
+
+} // namespace rigel::base
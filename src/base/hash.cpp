@@ -0,0 +1,52 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/hash.hpp"
+
+#include <cstring>
+
+
+namespace rigel::base
+{
+
+std::uint64_t
+  hashBytes(const void* pData, const std::size_t size, std::uint64_t hash)
+{
+  constexpr auto PRIME = std::uint64_t{0x100000001B3};
+
+  const auto pBytes = static_cast<const std::uint8_t*>(pData);
+  auto i = std::size_t{0};
+
+  for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+  {
+    std::uint64_t word;
+    std::memcpy(&word, pBytes + i, sizeof(word));
+    hash = (hash ^ word) * PRIME;
+
+    // Multiplication only propagates bits upwards, this mixes the high
+    // bits back down before the next word is xored in
+    hash ^= hash >> 32;
+  }
+
+  for (; i < size; ++i)
+  {
+    hash = (hash ^ pBytes[i]) * PRIME;
+  }
+
+  return hash;
+}
+
+} // namespace rigel::base
@@ -16,12 +16,110 @@
 
 #include "base/image.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <optional>
 #include <stdexcept>
 
 
 namespace rigel::base
 {
 
+namespace
+{
+
+struct ClippedBlit
+{
+  std::size_t mX;
+  std::size_t mY;
+  ImageView mSource;
+};
+
+
+/** Determine the part of source that's visible when placed at x, y */
+std::optional<ClippedBlit> clip(
+  const int x,
+  const int y,
+  const ImageView& source,
+  const std::size_t targetWidth,
+  const std::size_t targetHeight)
+{
+  using Coord = std::int64_t;
+
+  const auto left = std::max(Coord{x}, Coord{0});
+  const auto top = std::max(Coord{y}, Coord{0});
+  const auto right =
+    std::min(Coord{x} + Coord(source.width()), Coord(targetWidth));
+  const auto bottom =
+    std::min(Coord{y} + Coord(source.height()), Coord(targetHeight));
+
+  if (left >= right || top >= bottom)
+  {
+    return std::nullopt;
+  }
+
+  return ClippedBlit{
+    std::size_t(left),
+    std::size_t(top),
+    source.subView(
+      std::size_t(left - x),
+      std::size_t(top - y),
+      std::size_t(right - left),
+      std::size_t(bottom - top))};
+}
+
+} // namespace
+
+
+ImageView::ImageView(
+  const Pixel* pPixels,
+  const std::size_t width,
+  const std::size_t height)
+  : ImageView(pPixels, width, height, width)
+{
+}
+
+
+ImageView::ImageView(
+  const Pixel* pPixels,
+  const std::size_t width,
+  const std::size_t height,
+  const std::ptrdiff_t stride)
+  : mpPixels(pPixels)
+  , mWidth(width)
+  , mHeight(height)
+  , mStride(stride)
+{
+}
+
+
+ImageView ImageView::subView(
+  const std::size_t x,
+  const std::size_t y,
+  const std::size_t width,
+  const std::size_t height) const
+{
+  if (x + width > mWidth || y + height > mHeight)
+  {
+    throw std::invalid_argument("Area out of bounds");
+  }
+
+  return ImageView{row(y) + x, width, height, mStride};
+}
+
+
+ImageView ImageView::flippedVertically() const
+{
+  if (mHeight == 0)
+  {
+    return *this;
+  }
+
+  return ImageView{row(mHeight - 1), mWidth, mHeight, -mStride};
+}
+
+
 Image::Image(
   const PixelBuffer& pixels,
   const std::size_t width,
@@ -50,43 +148,63 @@ Image::Image(const std::size_t width, const std::size_t height)
 }
 
 
-Image Image::flipped() const
+Image::Image(const ImageView& view)
+  : mWidth(view.width())
+  , mHeight(view.height())
 {
-  PixelBuffer flippedPixelData;
-  flippedPixelData.resize(width() * height());
+  mPixels.reserve(mWidth * mHeight);
 
-  for (std::size_t y = 0; y < height(); ++y)
+  for (std::size_t row = 0; row < mHeight; ++row)
   {
-    const auto sourceRow = height() - (y + 1);
-    const auto yOffsetSource = sourceRow * width();
-    const auto yOffset = y * width();
-    for (std::size_t x = 0; x < width(); ++x)
-    {
-      flippedPixelData[x + yOffset] = pixelData()[x + yOffsetSource];
-    }
+    mPixels.insert(mPixels.end(), view.row(row), view.row(row) + mWidth);
   }
+}
+
+
+Image Image::flipped() const
+{
+  return Image{view().flippedVertically()};
+}
+
+
+void Image::flipVertically()
+{
+  const auto rowSize = mWidth * sizeof(Pixel);
+  PixelBuffer tempRow(mWidth);
+
+  for (std::size_t y = 0; y < mHeight / 2; ++y)
+  {
+    const auto pTop = mPixels.data() + y * mWidth;
+    const auto pBottom = mPixels.data() + (mHeight - 1 - y) * mWidth;
 
-  return Image{std::move(flippedPixelData), width(), height()};
+    std::memcpy(tempRow.data(), pTop, rowSize);
+    std::memcpy(pTop, pBottom, rowSize);
+    std::memcpy(pBottom, tempRow.data(), rowSize);
+  }
 }
 
 
 Image Image::withPremultipliedAlpha() const
 {
   PixelBuffer premultipliedPixelData;
-  premultipliedPixelData.resize(width() * height());
+  premultipliedPixelData.resize(mPixels.size());
 
-  for (auto i = 0u; i < premultipliedPixelData.size(); ++i)
-  {
-    premultipliedPixelData[i] = pixelData()[i].asPremultiplied();
-  }
+  detail::premultiplyAlpha(
+    mPixels.data(), premultipliedPixelData.data(), mPixels.size());
 
   return Image{std::move(premultipliedPixelData), width(), height()};
 }
 
 
+void Image::premultiplyAlpha()
+{
+  detail::premultiplyAlpha(mPixels.data(), mPixels.data(), mPixels.size());
+}
+
+
 void Image::insertImage(const size_t x, const size_t y, const Image& image)
 {
-  insertImage(x, y, image.pixelData(), image.width());
+  insertImage(x, y, image.view());
 }
 
 
@@ -96,47 +214,111 @@ void Image::insertImage(
   const PixelBuffer& pixels,
   const size_t sourceWidth)
 {
-  const auto inferredHeight = pixels.size() / sourceWidth;
-  if (x + sourceWidth > mWidth || y + inferredHeight > mHeight)
+  const auto inferredHeight = sourceWidth ? pixels.size() / sourceWidth : 0;
+  insertImage(x, y, ImageView{pixels.data(), sourceWidth, inferredHeight});
+}
+
+
+void Image::insertImage(
+  const size_t x,
+  const size_t y,
+  const ImageView& source)
+{
+  if (x + source.width() > mWidth || y + source.height() > mHeight)
   {
     throw std::invalid_argument("Source image doesn't fit");
   }
 
-  auto sourceIter = pixels.begin();
-  for (size_t row = 0; row < inferredHeight; ++row)
+  if (source.empty())
+  {
+    return;
+  }
+
+  const auto pDestination = &mPixels[x + y * mWidth];
+  const auto pFirstSourceRow = source.row(0);
+  const auto pLastSourceRow = source.row(source.height() - 1);
+
+  const auto pixelsLess = std::less<const Pixel*>{};
+  const auto pSourceBegin =
+    std::min(pFirstSourceRow, pLastSourceRow, pixelsLess);
+  const auto pSourceEnd =
+    std::max(pFirstSourceRow, pLastSourceRow, pixelsLess) + source.width();
+  const auto overlapsThisImage =
+    pixelsLess(pSourceBegin, mPixels.data() + mPixels.size()) &&
+    pixelsLess(mPixels.data(), pSourceEnd);
+
+  // A flipped view of this image's own pixels can't be copied in place in
+  // either order, so it goes through a temporary copy
+  if (overlapsThisImage && source.stride() < 0)
+  {
+    insertImage(x, y, Image{source}.view());
+    return;
+  }
+
+  const auto copyRow = [&](const size_t row) {
+    // memmove, since the source might be a view into this image
+    std::memmove(
+      &mPixels[x + (y + row) * mWidth],
+      source.row(row),
+      source.width() * sizeof(Pixel));
+  };
+
+  // When the source is a view into this image and the destination comes
+  // after it, copying top-down would overwrite source rows before they are
+  // read. Copying bottom-up avoids that.
+  if (pixelsLess(pFirstSourceRow, pDestination))
   {
-    for (size_t col = 0; col < sourceWidth; ++col)
+    for (auto row = source.height(); row > 0; --row)
     {
-      const auto targetOffset = (x + col) + (y + row) * mWidth;
-      mPixels[targetOffset] = *sourceIter++;
+      copyRow(row - 1);
+    }
+  }
+  else
+  {
+    for (size_t row = 0; row < source.height(); ++row)
+    {
+      copyRow(row);
     }
   }
 }
 
 
-Image Image::extractSubImage(
-  std::size_t x,
-  std::size_t y,
-  std::size_t width,
-  std::size_t height) const
+void Image::insertImageClipped(
+  const int x,
+  const int y,
+  const ImageView& source)
 {
-  if (x + width > mWidth || y + height > mHeight)
+  if (const auto clipped = clip(x, y, source, mWidth, mHeight))
   {
-    throw std::invalid_argument("Area out of bounds");
+    insertImage(clipped->mX, clipped->mY, clipped->mSource);
   }
+}
 
-  PixelBuffer data;
-  data.reserve(width * height);
 
-  for (size_t row = y; row < (y + height); ++row)
+void Image::blendImage(const int x, const int y, const ImageView& source)
+{
+  if (const auto clipped = clip(x, y, source, mWidth, mHeight))
   {
-    for (size_t col = x; col < (x + width); ++col)
+    const auto& clippedSource = clipped->mSource;
+
+    for (size_t row = 0; row < clippedSource.height(); ++row)
     {
-      data.push_back(mPixels[col + row * mWidth]);
+      detail::blendPremultiplied(
+        clippedSource.row(row),
+        &mPixels[clipped->mX + (clipped->mY + row) * mWidth],
+        clippedSource.width());
     }
   }
+}
+
 
-  return Image{std::move(data), width, height};
+Image Image::extractSubImage(
+  std::size_t x,
+  std::size_t y,
+  std::size_t width,
+  std::size_t height) const
+{
+  return Image{subView(x, y, width, height)};
 }
 
 } // namespace rigel::base
@@ -0,0 +1,373 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/image_cache.hpp"
+
+#include "base/byte_buffer.hpp"
+#include "base/file_utils.hpp"
+#include "base/hash.hpp"
+#include "base/image_loading.hpp"
+#include "base/mapped_file.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+
+namespace rigel::base
+{
+
+namespace
+{
+
+/* Disk cache file format (all values are little-endian):
+ *
+ *   u32 magic ("RIMG")
+ *   u32 format version
+ *   u32 content key (low half)
+ *   u32 content key (high half)
+ *   u32 width
+ *   u32 height
+ *   u32 flags
+ *   u8[width * height * 4] pixels, RGBA
+ *
+ * The cache is local to the machine, so there's no need for a portable
+ * format beyond fixing the byte order. Pixels are stored uncompressed, so
+ * that loading is a single copy out of the mapped file.
+ *
+ * Files are named after the path key, so there is at most one file per
+ * source image. A modified source image replaces its previous version
+ * instead of adding to the cache's size.
+ */
+constexpr auto FORMAT_MAGIC = std::uint32_t{0x474D4952};
+constexpr auto FORMAT_VERSION = std::uint32_t{1};
+constexpr auto HEADER_SIZE = std::size_t{7 * 4};
+
+constexpr auto FLAG_PREMULTIPLIED = std::uint32_t{1};
+
+
+struct Keys
+{
+  /** Identifies the source file, and the cache slot used for it */
+  std::uint64_t mPath;
+
+  /** Identifies the current version of the file's contents */
+  std::uint64_t mContent;
+};
+
+
+std::optional<Keys> makeKeys(
+  const std::filesystem::path& path,
+  const bool premultiplyAlpha)
+{
+  std::error_code ec;
+  const auto absolutePath = std::filesystem::absolute(path, ec);
+  const auto fileSize = std::filesystem::file_size(path, ec);
+  if (ec)
+  {
+    return std::nullopt;
+  }
+
+  const auto modificationTime =
+    std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+  if (ec)
+  {
+    return std::nullopt;
+  }
+
+  const auto pathString = absolutePath.lexically_normal().u8string();
+
+  auto pathKey = hashBytes(pathString.data(), pathString.size());
+  pathKey = hashValue(premultiplyAlpha, pathKey);
+
+  auto contentKey = hashValue(fileSize, pathKey);
+  contentKey = hashValue(modificationTime, contentKey);
+
+  return Keys{pathKey, contentKey};
+}
+
+
+void appendU32(ByteBuffer& buffer, const std::uint32_t value)
+{
+  buffer.push_back(static_cast<std::uint8_t>(value & 0xFF));
+  buffer.push_back(static_cast<std::uint8_t>((value >> 8) & 0xFF));
+  buffer.push_back(static_cast<std::uint8_t>((value >> 16) & 0xFF));
+  buffer.push_back(static_cast<std::uint8_t>((value >> 24) & 0xFF));
+}
+
+} // namespace
+
+
+ImageCache::ImageCache(ImageCacheConfig config)
+  : mConfig(std::move(config))
+{
+}
+
+
+std::shared_ptr<const Image>
+  ImageCache::load(const std::filesystem::path& path)
+{
+  const auto keys = makeKeys(path, mConfig.premultiplyAlpha);
+  if (!keys)
+  {
+    return nullptr;
+  }
+
+  if (auto pImage = findInMemory(keys->mPath, keys->mContent))
+  {
+    return pImage;
+  }
+
+  if (mConfig.diskCacheDirectory)
+  {
+    if (auto image = loadFromDisk(keys->mPath, keys->mContent))
+    {
+      auto pImage = std::make_shared<const Image>(std::move(*image));
+      insertIntoMemory(keys->mPath, keys->mContent, pImage);
+
+      std::lock_guard lock{mMutex};
+      ++mStats.diskHits;
+      return pImage;
+    }
+  }
+
+  auto image = loadImage(path);
+  if (!image)
+  {
+    return nullptr;
+  }
+
+  if (mConfig.premultiplyAlpha)
+  {
+    image->premultiplyAlpha();
+  }
+
+  if (mConfig.diskCacheDirectory)
+  {
+    saveToDisk(keys->mPath, keys->mContent, *image);
+  }
+
+  auto pImage = std::make_shared<const Image>(std::move(*image));
+  insertIntoMemory(keys->mPath, keys->mContent, pImage);
+
+  std::lock_guard lock{mMutex};
+  ++mStats.decodes;
+  return pImage;
+}
+
+
+void ImageCache::clear()
+{
+  std::lock_guard lock{mMutex};
+  mEntries.clear();
+  mEntriesByKey.clear();
+  mMemoryUsage = 0;
+}
+
+
+std::size_t ImageCache::memoryUsage() const
+{
+  std::lock_guard lock{mMutex};
+  return mMemoryUsage;
+}
+
+
+ImageCacheStats ImageCache::stats() const
+{
+  std::lock_guard lock{mMutex};
+  return mStats;
+}
+
+
+std::shared_ptr<const Image> ImageCache::findInMemory(
+  const std::uint64_t pathKey,
+  const std::uint64_t contentKey)
+{
+  std::lock_guard lock{mMutex};
+
+  const auto iEntry = mEntriesByKey.find(pathKey);
+  if (iEntry == mEntriesByKey.end())
+  {
+    return nullptr;
+  }
+
+  // The file has been modified since it was cached
+  if (iEntry->second->mContentKey != contentKey)
+  {
+    removeEntry(iEntry->second);
+    return nullptr;
+  }
+
+  mEntries.splice(mEntries.begin(), mEntries, iEntry->second);
+  ++mStats.memoryHits;
+  return iEntry->second->mpImage;
+}
+
+
+void ImageCache::insertIntoMemory(
+  const std::uint64_t pathKey,
+  const std::uint64_t contentKey,
+  std::shared_ptr<const Image> pImage)
+{
+  const auto sizeInBytes = pImage->pixelData().size() * sizeof(Pixel);
+  if (sizeInBytes > mConfig.memoryBudgetBytes)
+  {
+    return;
+  }
+
+  std::lock_guard lock{mMutex};
+
+  // Another thread might have loaded the same image in the meantime, or a
+  // different version of it
+  const auto iEntry = mEntriesByKey.find(pathKey);
+  if (iEntry != mEntriesByKey.end())
+  {
+    if (iEntry->second->mContentKey == contentKey)
+    {
+      return;
+    }
+
+    removeEntry(iEntry->second);
+  }
+
+  while (mMemoryUsage + sizeInBytes > mConfig.memoryBudgetBytes)
+  {
+    removeEntry(std::prev(mEntries.end()));
+  }
+
+  mEntries.push_front(
+    Entry{pathKey, contentKey, std::move(pImage), sizeInBytes});
+  mEntriesByKey.emplace(pathKey, mEntries.begin());
+  mMemoryUsage += sizeInBytes;
+}
+
+
+void ImageCache::removeEntry(const std::list<Entry>::iterator iEntry)
+{
+  mMemoryUsage -= iEntry->mSizeInBytes;
+  mEntriesByKey.erase(iEntry->mPathKey);
+  mEntries.erase(iEntry);
+}
+
+
+std::optional<Image> ImageCache::loadFromDisk(
+  const std::uint64_t pathKey,
+  const std::uint64_t contentKey) const
+{
+  const auto mappedFile = tryMapFile(diskCachePath(pathKey));
+  if (!mappedFile || mappedFile->size() < HEADER_SIZE)
+  {
+    return std::nullopt;
+  }
+
+  LeStreamReader reader{mappedFile->data()};
+
+  const auto magic = reader.readU32();
+  const auto version = reader.readU32();
+  const auto keyLow = reader.readU32();
+  const auto keyHigh = reader.readU32();
+  const auto width = reader.readU32();
+  const auto height = reader.readU32();
+  const auto flags = reader.readU32();
+
+  const auto storedKey = (std::uint64_t{keyHigh} << 32) | keyLow;
+  const auto isPremultiplied = (flags & FLAG_PREMULTIPLIED) != 0;
+  const auto numPixels = std::size_t{width} * height;
+
+  if (
+    magic != FORMAT_MAGIC || version != FORMAT_VERSION ||
+    storedKey != contentKey ||
+    isPremultiplied != mConfig.premultiplyAlpha ||
+    numPixels * sizeof(Pixel) != mappedFile->size() - HEADER_SIZE)
+  {
+    return std::nullopt;
+  }
+
+  PixelBuffer pixels(numPixels);
+  reader.readArrayU8(
+    numPixels * sizeof(Pixel), reinterpret_cast<std::uint8_t*>(pixels.data()));
+
+  return Image{std::move(pixels), width, height};
+}
+
+
+void ImageCache::saveToDisk(
+  const std::uint64_t pathKey,
+  const std::uint64_t contentKey,
+  const Image& image) const
+{
+  // The disk cache is an optimization only, failing to write to it is not
+  // an error.
+  std::error_code ec;
+  std::filesystem::create_directories(*mConfig.diskCacheDirectory, ec);
+
+  ByteBuffer header;
+  header.reserve(HEADER_SIZE);
+  appendU32(header, FORMAT_MAGIC);
+  appendU32(header, FORMAT_VERSION);
+  appendU32(header, static_cast<std::uint32_t>(contentKey & 0xFFFFFFFF));
+  appendU32(header, static_cast<std::uint32_t>(contentKey >> 32));
+  appendU32(header, static_cast<std::uint32_t>(image.width()));
+  appendU32(header, static_cast<std::uint32_t>(image.height()));
+  appendU32(header, mConfig.premultiplyAlpha ? FLAG_PREMULTIPLIED : 0);
+
+  // Written under a temporary name and then renamed, so that other threads
+  // or processes never see a partially written file. Renaming also replaces
+  // the file for an outdated version of the same image.
+  const auto finalPath = diskCachePath(pathKey);
+  const auto tempPath = temporaryPathFor(finalPath);
+
+  {
+    std::ofstream file(tempPath, std::ios::binary);
+    if (!file.is_open())
+    {
+      return;
+    }
+
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(
+      reinterpret_cast<const char*>(image.pixelData().data()),
+      image.pixelData().size() * sizeof(Pixel));
+
+    if (!file.good())
+    {
+      file.close();
+      std::filesystem::remove(tempPath, ec);
+      return;
+    }
+  }
+
+  std::filesystem::rename(tempPath, finalPath, ec);
+  if (ec)
+  {
+    std::filesystem::remove(tempPath, ec);
+  }
+}
+
+
+std::filesystem::path
+  ImageCache::diskCachePath(const std::uint64_t pathKey) const
+{
+  char name[32];
+  std::snprintf(
+    name,
+    sizeof(name),
+    "%016llx.rimg",
+    static_cast<unsigned long long>(pathKey));
+  return *mConfig.diskCacheDirectory / name;
+}
+
+} // namespace rigel::base
@@ -0,0 +1,466 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/image.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) ||            \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define RIGEL_HAVE_SSE2 1
+  #include <immintrin.h>
+
+  #if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+    #define RIGEL_TARGET_AVX2
+  #else
+    #define RIGEL_TARGET_AVX2 __attribute__((target("avx2")))
+  #endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+  #define RIGEL_HAVE_NEON 1
+  #include <arm_neon.h>
+#endif
+
+
+/* Pixel processing kernels, with SIMD implementations for x86 (SSE2, AVX2)
+ * and ARM (NEON). The best variant supported by the CPU is picked at runtime.
+ *
+ * All variants produce exactly the same output as the scalar versions.
+ * Division by 255 is done via multiply and shift, which gives identical
+ * results for all products of two 8-bit values.
+ */
+
+namespace rigel::base::detail
+{
+
+namespace
+{
+
+static_assert(sizeof(Pixel) == 4, "Kernels assume tightly packed RGBA8");
+
+using PixelKernelFunc = void (*)(const Pixel*, Pixel*, std::size_t);
+
+struct Kernels
+{
+  PixelKernelFunc mpPremultiply;
+  PixelKernelFunc mpBlend;
+};
+
+
+void premultiplyScalar(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    pDestination[i] = pSource[i].asPremultiplied();
+  }
+}
+
+
+std::uint8_t blendChannel(
+  const std::uint8_t source,
+  const std::uint8_t destination,
+  const std::uint8_t inverseAlpha)
+{
+  // Saturates in case the source isn't properly premultiplied, to match the
+  // SIMD versions
+  const auto result = source + destination * inverseAlpha / 255;
+  return std::uint8_t(std::min(result, 255));
+}
+
+
+void blendScalar(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const auto& source = pSource[i];
+    auto& destination = pDestination[i];
+    const auto inverseAlpha = std::uint8_t(255 - source.a);
+
+    destination = Pixel{
+      blendChannel(source.r, destination.r, inverseAlpha),
+      blendChannel(source.g, destination.g, inverseAlpha),
+      blendChannel(source.b, destination.b, inverseAlpha),
+      blendChannel(source.a, destination.a, inverseAlpha)};
+  }
+}
+
+
+#ifdef RIGEL_HAVE_SSE2
+
+// In the "wide" representation used below, each channel is widened to
+// 16 bits, so that a 128-bit register holds two pixels.
+
+// Alpha is multiplied by 255 instead of by itself when premultiplying, so
+// that it comes out unchanged after dividing by 255.
+constexpr auto ALPHA_LANE_MASK = static_cast<long long>(0xFFFF000000000000);
+constexpr auto ALPHA_LANE_FACTOR = static_cast<long long>(0x00FF000000000000);
+
+// floor(x / 255) == (x * 0x8081) >> 23 for all 16-bit x
+constexpr auto DIV_255_MAGIC = static_cast<short>(0x8081);
+constexpr auto DIV_255_SHIFT = 7;
+
+
+__m128i broadcastAlphaSse2(const __m128i widePixels)
+{
+  const auto alpha = _mm_shufflelo_epi16(widePixels, _MM_SHUFFLE(3, 3, 3, 3));
+  return _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+
+__m128i divideBy255Sse2(const __m128i x)
+{
+  return _mm_srli_epi16(
+    _mm_mulhi_epu16(x, _mm_set1_epi16(DIV_255_MAGIC)), DIV_255_SHIFT);
+}
+
+
+__m128i premultiplyWidePixelsSse2(const __m128i pixels)
+{
+  const auto alphaMask = _mm_set1_epi64x(ALPHA_LANE_MASK);
+  const auto alphaFactor = _mm_set1_epi64x(ALPHA_LANE_FACTOR);
+
+  const auto alpha = _mm_or_si128(
+    _mm_andnot_si128(alphaMask, broadcastAlphaSse2(pixels)), alphaFactor);
+  return divideBy255Sse2(_mm_mullo_epi16(pixels, alpha));
+}
+
+
+/** Returns destination * (255 - source alpha) / 255 */
+__m128i scaleByInverseAlphaSse2(
+  const __m128i wideSource,
+  const __m128i wideDestination)
+{
+  const auto inverseAlpha =
+    _mm_xor_si128(broadcastAlphaSse2(wideSource), _mm_set1_epi16(0xFF));
+  return divideBy255Sse2(_mm_mullo_epi16(wideDestination, inverseAlpha));
+}
+
+
+void premultiplySse2(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  constexpr auto PIXELS_PER_ITERATION = 4;
+
+  const auto zero = _mm_setzero_si128();
+
+  std::size_t i = 0;
+  for (; i + PIXELS_PER_ITERATION <= count; i += PIXELS_PER_ITERATION)
+  {
+    const auto pixels =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + i));
+
+    const auto low = premultiplyWidePixelsSse2(_mm_unpacklo_epi8(pixels, zero));
+    const auto high =
+      premultiplyWidePixelsSse2(_mm_unpackhi_epi8(pixels, zero));
+
+    _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(pDestination + i),
+      _mm_packus_epi16(low, high));
+  }
+
+  premultiplyScalar(pSource + i, pDestination + i, count - i);
+}
+
+
+void blendSse2(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  constexpr auto PIXELS_PER_ITERATION = 4;
+
+  const auto zero = _mm_setzero_si128();
+
+  std::size_t i = 0;
+  for (; i + PIXELS_PER_ITERATION <= count; i += PIXELS_PER_ITERATION)
+  {
+    const auto source =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + i));
+    const auto destination =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDestination + i));
+
+    const auto low = scaleByInverseAlphaSse2(
+      _mm_unpacklo_epi8(source, zero), _mm_unpacklo_epi8(destination, zero));
+    const auto high = scaleByInverseAlphaSse2(
+      _mm_unpackhi_epi8(source, zero), _mm_unpackhi_epi8(destination, zero));
+
+    _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(pDestination + i),
+      _mm_adds_epu8(source, _mm_packus_epi16(low, high)));
+  }
+
+  blendScalar(pSource + i, pDestination + i, count - i);
+}
+
+
+// The AVX2 versions are the same as the SSE2 ones, operating on twice as
+// many pixels at once. Unpacking and packing both work on each 128-bit half
+// separately, so the two cancel out and pixels end up in their original
+// order.
+
+RIGEL_TARGET_AVX2 __m256i broadcastAlphaAvx2(const __m256i widePixels)
+{
+  const auto alpha =
+    _mm256_shufflelo_epi16(widePixels, _MM_SHUFFLE(3, 3, 3, 3));
+  return _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+
+RIGEL_TARGET_AVX2 __m256i divideBy255Avx2(const __m256i x)
+{
+  return _mm256_srli_epi16(
+    _mm256_mulhi_epu16(x, _mm256_set1_epi16(DIV_255_MAGIC)), DIV_255_SHIFT);
+}
+
+
+RIGEL_TARGET_AVX2 __m256i premultiplyWidePixelsAvx2(const __m256i pixels)
+{
+  const auto alphaMask = _mm256_set1_epi64x(ALPHA_LANE_MASK);
+  const auto alphaFactor = _mm256_set1_epi64x(ALPHA_LANE_FACTOR);
+
+  const auto alpha = _mm256_or_si256(
+    _mm256_andnot_si256(alphaMask, broadcastAlphaAvx2(pixels)), alphaFactor);
+  return divideBy255Avx2(_mm256_mullo_epi16(pixels, alpha));
+}
+
+
+RIGEL_TARGET_AVX2 __m256i scaleByInverseAlphaAvx2(
+  const __m256i wideSource,
+  const __m256i wideDestination)
+{
+  const auto inverseAlpha =
+    _mm256_xor_si256(broadcastAlphaAvx2(wideSource), _mm256_set1_epi16(0xFF));
+  return divideBy255Avx2(_mm256_mullo_epi16(wideDestination, inverseAlpha));
+}
+
+
+RIGEL_TARGET_AVX2 void premultiplyAvx2(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  constexpr auto PIXELS_PER_ITERATION = 8;
+
+  const auto zero = _mm256_setzero_si256();
+
+  std::size_t i = 0;
+  for (; i + PIXELS_PER_ITERATION <= count; i += PIXELS_PER_ITERATION)
+  {
+    const auto pixels =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSource + i));
+
+    const auto low =
+      premultiplyWidePixelsAvx2(_mm256_unpacklo_epi8(pixels, zero));
+    const auto high =
+      premultiplyWidePixelsAvx2(_mm256_unpackhi_epi8(pixels, zero));
+
+    _mm256_storeu_si256(
+      reinterpret_cast<__m256i*>(pDestination + i),
+      _mm256_packus_epi16(low, high));
+  }
+
+  premultiplySse2(pSource + i, pDestination + i, count - i);
+}
+
+
+RIGEL_TARGET_AVX2 void blendAvx2(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  constexpr auto PIXELS_PER_ITERATION = 8;
+
+  const auto zero = _mm256_setzero_si256();
+
+  std::size_t i = 0;
+  for (; i + PIXELS_PER_ITERATION <= count; i += PIXELS_PER_ITERATION)
+  {
+    const auto source =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSource + i));
+    const auto destination =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDestination + i));
+
+    const auto low = scaleByInverseAlphaAvx2(
+      _mm256_unpacklo_epi8(source, zero),
+      _mm256_unpacklo_epi8(destination, zero));
+    const auto high = scaleByInverseAlphaAvx2(
+      _mm256_unpackhi_epi8(source, zero),
+      _mm256_unpackhi_epi8(destination, zero));
+
+    _mm256_storeu_si256(
+      reinterpret_cast<__m256i*>(pDestination + i),
+      _mm256_adds_epu8(source, _mm256_packus_epi16(low, high)));
+  }
+
+  blendSse2(pSource + i, pDestination + i, count - i);
+}
+
+
+bool cpuSupportsAvx2()
+{
+  #if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+  {
+    return false;
+  }
+
+  // The OS must save/restore YMM registers (OSXSAVE + AVX, XCR0 bits 1 & 2)
+  __cpuid(info, 1);
+  const auto osxsaveAndAvx = (1 << 27) | (1 << 28);
+  if ((info[2] & osxsaveAndAvx) != osxsaveAndAvx || (_xgetbv(0) & 6) != 6)
+  {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+  #else
+  return __builtin_cpu_supports("avx2");
+  #endif
+}
+
+#endif
+
+
+#ifdef RIGEL_HAVE_NEON
+
+/** Returns a * b / 255 for each channel value */
+uint8x16_t multiplyChannelsNeon(const uint8x16_t a, const uint8x16_t b)
+{
+  // floor(x / 255) == (x + 1 + (x >> 8)) >> 8 for all products of 8-bit values
+  const auto divideBy255 = [](const uint16x8_t x) {
+    const auto sum = vaddq_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), vdupq_n_u16(1));
+    return vshrn_n_u16(sum, 8);
+  };
+
+  const auto low = vmull_u8(vget_low_u8(a), vget_low_u8(b));
+  const auto high = vmull_u8(vget_high_u8(a), vget_high_u8(b));
+  return vcombine_u8(divideBy255(low), divideBy255(high));
+}
+
+
+void premultiplyNeon(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  constexpr auto PIXELS_PER_ITERATION = 16;
+
+  std::size_t i = 0;
+  for (; i + PIXELS_PER_ITERATION <= count; i += PIXELS_PER_ITERATION)
+  {
+    // De-interleaves into one register per channel
+    auto pixels = vld4q_u8(reinterpret_cast<const std::uint8_t*>(pSource + i));
+
+    pixels.val[0] = multiplyChannelsNeon(pixels.val[0], pixels.val[3]);
+    pixels.val[1] = multiplyChannelsNeon(pixels.val[1], pixels.val[3]);
+    pixels.val[2] = multiplyChannelsNeon(pixels.val[2], pixels.val[3]);
+
+    vst4q_u8(reinterpret_cast<std::uint8_t*>(pDestination + i), pixels);
+  }
+
+  premultiplyScalar(pSource + i, pDestination + i, count - i);
+}
+
+
+void blendNeon(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  constexpr auto PIXELS_PER_ITERATION = 16;
+
+  std::size_t i = 0;
+  for (; i + PIXELS_PER_ITERATION <= count; i += PIXELS_PER_ITERATION)
+  {
+    const auto source =
+      vld4q_u8(reinterpret_cast<const std::uint8_t*>(pSource + i));
+    auto destination =
+      vld4q_u8(reinterpret_cast<const std::uint8_t*>(pDestination + i));
+
+    const auto inverseAlpha = vmvnq_u8(source.val[3]);
+
+    for (auto channel = 0; channel < 4; ++channel)
+    {
+      destination.val[channel] = vqaddq_u8(
+        source.val[channel],
+        multiplyChannelsNeon(destination.val[channel], inverseAlpha));
+    }
+
+    vst4q_u8(reinterpret_cast<std::uint8_t*>(pDestination + i), destination);
+  }
+
+  blendScalar(pSource + i, pDestination + i, count - i);
+}
+
+#endif
+
+
+Kernels selectKernels()
+{
+#if defined(RIGEL_HAVE_SSE2)
+  if (cpuSupportsAvx2())
+  {
+    return {premultiplyAvx2, blendAvx2};
+  }
+
+  return {premultiplySse2, blendSse2};
+#elif defined(RIGEL_HAVE_NEON)
+  return {premultiplyNeon, blendNeon};
+#else
+  return {premultiplyScalar, blendScalar};
+#endif
+}
+
+
+const Kernels& kernels()
+{
+  static const auto instance = selectKernels();
+  return instance;
+}
+
+} // namespace
+
+
+void premultiplyAlpha(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  kernels().mpPremultiply(pSource, pDestination, count);
+}
+
+
+void blendPremultiplied(
+  const Pixel* pSource,
+  Pixel* pDestination,
+  const std::size_t count)
+{
+  kernels().mpBlend(pSource, pDestination, count);
+}
+
+} // namespace rigel::base::detail
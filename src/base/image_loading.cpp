@@ -16,15 +16,15 @@
 
 #include "base/image_loading.hpp"
 
-#include "base/byte_buffer.hpp"
+#include "base/mapped_file.hpp"
+#include "base/trace.hpp"
 #include "base/warnings.hpp"
 
 RIGEL_DISABLE_WARNINGS
 #include <stb_image.h>
-#include <stb_image_write.h>
 RIGEL_RESTORE_WARNINGS
 
-#include <fstream>
+#include <algorithm>
 #include <memory>
 
 
@@ -34,6 +34,14 @@ namespace rigel::base
 namespace
 {
 
+constexpr auto DEFAULT_ROWS_PER_BAND = std::size_t{16};
+
+// Deflate can't compress by more than about 1032:1, and PNG pixels take up
+// at least one bit each. A file can't contain more pixels than that,
+// whatever its header claims.
+constexpr auto MAX_PIXELS_PER_INPUT_BYTE = std::size_t{1032 * 8};
+
+
 std::optional<Image>
   convertToImage(unsigned char* pImageData, const int width, const int height)
 {
@@ -50,10 +58,19 @@ std::optional<Image>
 }
 
 
-void writeToFile(void* pContext, void* pData, int size)
+std::optional<Image> loadImageWithStb(base::ArrayView<std::uint8_t> data)
 {
-  auto& file = *static_cast<std::ofstream*>(pContext);
-  file.write(reinterpret_cast<const char*>(pData), size);
+  int width = 0;
+  int height = 0;
+  const auto imageDeleter = [](unsigned char* p) {
+    stbi_image_free(p);
+  };
+  std::unique_ptr<unsigned char, decltype(imageDeleter)> pImageData{
+    stbi_load_from_memory(
+      data.data(), data.size(), &width, &height, nullptr, 4),
+    imageDeleter};
+
+  return convertToImage(pImageData.get(), width, height);
 }
 
 } // namespace
@@ -61,9 +78,9 @@ void writeToFile(void* pContext, void* pData, int size)
 
 std::optional<Image> loadImage(const std::filesystem::path& path)
 {
-  if (const auto data = base::tryLoadFile(path))
+  if (const auto file = base::tryMapFile(path))
   {
-    return loadImage(*data);
+    return loadImage(file->data());
   }
 
   return {};
@@ -72,17 +89,43 @@ std::optional<Image> loadImage(const std::filesystem::path& path)
 
 std::optional<Image> loadImage(base::ArrayView<std::uint8_t> data)
 {
-  int width = 0;
-  int height = 0;
-  const auto imageDeleter = [](unsigned char* p) {
-    stbi_image_free(p);
-  };
-  std::unique_ptr<unsigned char, decltype(imageDeleter)> pImageData{
-    stbi_load_from_memory(
-      data.data(), data.size(), &width, &height, nullptr, 4),
-    imageDeleter};
+  RIGEL_TRACE_SCOPE("loadImage");
 
-  return convertToImage(pImageData.get(), width, height);
+  // PNGs are decoded in bands, which are appended to the image's storage
+  // one row at a time. Unlike with STB Image, there is no second full-size
+  // buffer.
+  if (const auto info = readImageInfo(data))
+  {
+    PixelBuffer pixels;
+
+    const auto result = detail::decodePngRows(
+      data,
+      [&](std::size_t, const ImageView& rows) {
+        // The header is only validated by the decoder, so reserving is
+        // deferred until it has produced the first rows.
+        if (pixels.empty())
+        {
+          pixels.reserve(std::min(
+            info->width * info->height,
+            data.size() * MAX_PIXELS_PER_INPUT_BYTE));
+        }
+
+        for (std::size_t y = 0; y < rows.height(); ++y)
+        {
+          pixels.insert(pixels.end(), rows.row(y), rows.row(y) + rows.width());
+        }
+      },
+      DEFAULT_ROWS_PER_BAND);
+
+    if (result == detail::PngDecodeResult::Success)
+    {
+      return Image{std::move(pixels), info->width, info->height};
+    }
+  }
+
+  // Files the built-in decoder rejects might still be readable by STB Image,
+  // which is more lenient in some cases.
+  return loadImageWithStb(data);
 }
 
 
@@ -96,20 +139,61 @@ Image loadImageOrThrow(const std::filesystem::path& path)
   throw std::runtime_error("Failed to load: " + path.u8string());
 }
 
+std::optional<ImageInfo> readImageInfo(base::ArrayView<std::uint8_t> data)
+{
+  int width = 0;
+  int height = 0;
+  if (!stbi_info_from_memory(
+        data.data(), int(data.size()), &width, &height, nullptr))
+  {
+    return {};
+  }
+
+  return ImageInfo{std::size_t(width), std::size_t(height)};
+}
 
-bool savePng(const std::filesystem::path& path, const Image& image)
+
+bool decodeImageRows(
+  base::ArrayView<std::uint8_t> data,
+  const ImageRowsFunc& onRows,
+  const std::size_t maxRowsPerCall)
 {
-  std::ofstream file(path, std::ios::binary);
-  if (!file.is_open())
+  RIGEL_TRACE_SCOPE("decodeImageRows");
+
+  const auto result = detail::decodePngRows(data, onRows, maxRowsPerCall);
+  if (result != detail::PngDecodeResult::Unsupported)
+  {
+    return result == detail::PngDecodeResult::Success;
+  }
+
+  const auto image = loadImageWithStb(data);
+  if (!image)
   {
     return false;
   }
 
-  const auto width = static_cast<int>(image.width());
-  const auto height = static_cast<int>(image.height());
-  const auto result = stbi_write_png_to_func(
-    writeToFile, &file, width, height, 4, image.pixelData().data(), width * 4);
-  return result != 0;
+  const auto rowsPerBand = std::max(maxRowsPerCall, std::size_t{1});
+  for (std::size_t y = 0; y < image->height(); y += rowsPerBand)
+  {
+    const auto numRows = std::min(rowsPerBand, image->height() - y);
+    onRows(y, image->subView(0, y, image->width(), numRows));
+  }
+
+  return true;
+}
+
+
+bool decodeImageRows(
+  const std::filesystem::path& path,
+  const ImageRowsFunc& onRows,
+  const std::size_t maxRowsPerCall)
+{
+  if (const auto file = base::tryMapFile(path))
+  {
+    return decodeImageRows(file->data(), onRows, maxRowsPerCall);
+  }
+
+  return false;
 }
 
 } // namespace rigel::base
@@ -0,0 +1,240 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/mapped_file.hpp"
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #define NOMINMAX
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+
+namespace rigel::base
+{
+
+namespace
+{
+
+constexpr auto MAX_MAPPABLE_SIZE =
+  std::uint64_t{std::numeric_limits<std::uint32_t>::max()};
+
+
+#ifdef _WIN32
+
+const std::uint8_t* mapWholeFile(
+  const std::filesystem::path& path,
+  std::uint32_t& size,
+  bool& success)
+{
+  success = false;
+
+  const auto hFile = CreateFileW(
+    path.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    nullptr);
+  if (hFile == INVALID_HANDLE_VALUE)
+  {
+    return nullptr;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (
+    !GetFileSizeEx(hFile, &fileSize) ||
+    std::uint64_t(fileSize.QuadPart) > MAX_MAPPABLE_SIZE)
+  {
+    CloseHandle(hFile);
+    return nullptr;
+  }
+
+  size = static_cast<std::uint32_t>(fileSize.QuadPart);
+
+  // Mapping an empty file is an error on Windows, but it's a perfectly valid
+  // thing to ask for from the user's perspective.
+  if (size == 0)
+  {
+    CloseHandle(hFile);
+    success = true;
+    return nullptr;
+  }
+
+  const auto hMapping =
+    CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(hFile);
+
+  if (!hMapping)
+  {
+    return nullptr;
+  }
+
+  // The view keeps the mapping object alive, so we don't need to hold on to
+  // any handles beyond this point.
+  const auto pData = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(hMapping);
+
+  success = pData != nullptr;
+  return static_cast<const std::uint8_t*>(pData);
+}
+
+
+void unmapFile(const std::uint8_t* pData, std::uint32_t)
+{
+  UnmapViewOfFile(pData);
+}
+
+#else
+
+const std::uint8_t* mapWholeFile(
+  const std::filesystem::path& path,
+  std::uint32_t& size,
+  bool& success)
+{
+  success = false;
+
+  const auto fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+  {
+    return nullptr;
+  }
+
+  struct stat fileInfo;
+  if (
+    fstat(fd, &fileInfo) != 0 || !S_ISREG(fileInfo.st_mode) ||
+    std::uint64_t(fileInfo.st_size) > MAX_MAPPABLE_SIZE)
+  {
+    close(fd);
+    return nullptr;
+  }
+
+  size = static_cast<std::uint32_t>(fileInfo.st_size);
+
+  // mmap() doesn't accept a length of 0
+  if (size == 0)
+  {
+    close(fd);
+    success = true;
+    return nullptr;
+  }
+
+  // The mapping stays valid after closing the file descriptor.
+  const auto pData = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (pData == MAP_FAILED)
+  {
+    return nullptr;
+  }
+
+  success = true;
+  return static_cast<const std::uint8_t*>(pData);
+}
+
+
+void unmapFile(const std::uint8_t* pData, const std::uint32_t size)
+{
+  munmap(const_cast<std::uint8_t*>(pData), size);
+}
+
+#endif
+
+} // namespace
+
+
+MappedFile::MappedFile(const std::uint8_t* pData, const std::uint32_t size)
+  : mpData(pData)
+  , mSize(size)
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+  unmap();
+}
+
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+  : mpData(std::exchange(other.mpData, nullptr))
+  , mSize(std::exchange(other.mSize, 0))
+{
+}
+
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other)
+  {
+    unmap();
+    mpData = std::exchange(other.mpData, nullptr);
+    mSize = std::exchange(other.mSize, 0);
+  }
+
+  return *this;
+}
+
+
+void MappedFile::unmap()
+{
+  if (mpData)
+  {
+    unmapFile(mpData, mSize);
+    mpData = nullptr;
+    mSize = 0;
+  }
+}
+
+
+std::optional<MappedFile> tryMapFile(const std::filesystem::path& path)
+{
+  std::uint32_t size = 0;
+  auto success = false;
+  const auto pData = mapWholeFile(path, size, success);
+
+  if (!success)
+  {
+    return {};
+  }
+
+  return MappedFile{pData, size};
+}
+
+
+MappedFile mapFileOrThrow(const std::filesystem::path& path)
+{
+  if (auto file = tryMapFile(path))
+  {
+    return std::move(*file);
+  }
+
+  throw std::runtime_error(
+    std::string("File can't be mapped: ") + path.u8string());
+}
+
+} // namespace rigel::base
@@ -0,0 +1,1081 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/image_loading.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+
+/* Streaming PNG decoder
+ *
+ * Unlike stb_image, this never holds the entire decompressed image data in
+ * memory. The zlib stream is inflated on demand in small chunks, which are
+ * unfiltered one scanline at a time. Memory use is fixed apart from a few
+ * scanlines' worth of state. Decoded rows are converted to RGBA and handed
+ * out in small bands.
+ *
+ * Supports all color types and bit depths of the PNG spec, including
+ * transparency via tRNS chunks. Output matches stb_image, i.e. 16-bit
+ * samples are reduced to their most significant byte. Interlaced images
+ * are not supported, and reported as such so that the caller can fall back
+ * to stb_image.
+ */
+
+namespace rigel::base::detail
+{
+
+namespace
+{
+
+constexpr std::uint8_t PNG_SIGNATURE[] = {
+  0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+// Same limit as stb_image
+constexpr auto MAX_DIMENSION = std::uint32_t{1} << 24;
+
+constexpr auto WINDOW_SIZE = std::size_t{32768};
+
+// Deflate length and distance code tables, see RFC 1951, section 3.2.5
+constexpr std::uint16_t LENGTH_BASE[] = {
+  3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr std::uint8_t LENGTH_EXTRA_BITS[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr std::uint16_t DISTANCE_BASE[] = {
+  1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+  33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+  1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr std::uint8_t DISTANCE_EXTRA_BITS[] = {
+  0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+constexpr std::uint8_t CODE_LENGTH_ORDER[] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+constexpr auto MAX_CODE_LENGTH = 15;
+constexpr auto NUM_LITERAL_LENGTH_SYMBOLS = 288;
+constexpr auto NUM_DISTANCE_SYMBOLS = 32;
+constexpr auto END_OF_BLOCK = 256;
+
+
+std::uint32_t readU32BigEndian(const std::uint8_t* pData)
+{
+  return (std::uint32_t{pData[0]} << 24) | (std::uint32_t{pData[1]} << 16) |
+    (std::uint32_t{pData[2]} << 8) | pData[3];
+}
+
+
+std::uint16_t readU16BigEndian(const std::uint8_t* pData)
+{
+  return static_cast<std::uint16_t>((pData[0] << 8) | pData[1]);
+}
+
+
+/** Reads bits LSB-first from the payloads of a sequence of IDAT chunks */
+class BitReader
+{
+public:
+  explicit BitReader(std::vector<ArrayView<std::uint8_t>> spans)
+    : mSpans(std::move(spans))
+  {
+  }
+
+  std::uint32_t peekBits(const int count)
+  {
+    if (mNumBits < count)
+    {
+      refill();
+    }
+
+    return static_cast<std::uint32_t>(mBuffer & ((1ull << count) - 1));
+  }
+
+  void consumeBits(const int count)
+  {
+    mBuffer >>= count;
+    mNumBits -= count;
+  }
+
+  std::uint32_t readBits(const int count)
+  {
+    const auto bits = peekBits(count);
+    consumeBits(count);
+    return bits;
+  }
+
+  void alignToByte() { consumeBits(mNumBits % 8); }
+
+  /** True if more bits were consumed than the input contains */
+  bool hasOverrun() const
+  {
+    return mNumPaddingBytes * 8 > std::size_t(mNumBits);
+  }
+
+private:
+  void refill()
+  {
+    while (mNumBits <= 56)
+    {
+      mBuffer |= std::uint64_t{nextByte()} << mNumBits;
+      mNumBits += 8;
+    }
+  }
+
+  std::uint8_t nextByte()
+  {
+    while (mCurrentSpan < mSpans.size())
+    {
+      const auto& span = mSpans[mCurrentSpan];
+      if (mPositionInSpan < span.size())
+      {
+        return span[mPositionInSpan++];
+      }
+
+      ++mCurrentSpan;
+      mPositionInSpan = 0;
+    }
+
+    // Reading past the end yields zeros. Whether any of these were actually
+    // used is checked via hasOverrun().
+    ++mNumPaddingBytes;
+    return 0;
+  }
+
+  std::vector<ArrayView<std::uint8_t>> mSpans;
+  std::size_t mCurrentSpan = 0;
+  std::size_t mPositionInSpan = 0;
+  std::size_t mNumPaddingBytes = 0;
+  std::uint64_t mBuffer = 0;
+  int mNumBits = 0;
+};
+
+
+class HuffmanTable
+{
+public:
+  bool build(const std::uint8_t* pCodeLengths, const int numSymbols)
+  {
+    mCounts.fill(0);
+    mFastLookup.fill(0);
+
+    for (auto symbol = 0; symbol < numSymbols; ++symbol)
+    {
+      ++mCounts[pCodeLengths[symbol]];
+    }
+    mCounts[0] = 0;
+
+    // Incomplete codes are allowed (e.g. a single distance code), but
+    // over-subscribed ones are invalid.
+    auto numCodesLeft = 1;
+    for (auto length = 1; length <= MAX_CODE_LENGTH; ++length)
+    {
+      numCodesLeft = numCodesLeft * 2 - mCounts[length];
+      if (numCodesLeft < 0)
+      {
+        return false;
+      }
+    }
+
+    std::array<std::uint16_t, MAX_CODE_LENGTH + 2> offsets{};
+    for (auto length = 1; length <= MAX_CODE_LENGTH; ++length)
+    {
+      offsets[length + 1] = offsets[length] + mCounts[length];
+    }
+
+    for (auto symbol = 0; symbol < numSymbols; ++symbol)
+    {
+      if (const auto length = pCodeLengths[symbol])
+      {
+        mSymbols[offsets[length]++] = static_cast<std::uint16_t>(symbol);
+      }
+    }
+
+    // Canonical codes are assigned in order of length, then symbol - which
+    // is the order of mSymbols. Short codes go into the lookup table.
+    auto code = 0;
+    auto index = 0;
+    for (auto length = 1; length <= FAST_BITS; ++length)
+    {
+      for (auto i = 0; i < mCounts[length]; ++i, ++code, ++index)
+      {
+        const auto reversed = reverseBits(code, length);
+        const auto entry =
+          static_cast<std::uint16_t>((length << 12) | mSymbols[index]);
+
+        for (auto fill = reversed; fill < (1 << FAST_BITS);
+             fill += 1 << length)
+        {
+          mFastLookup[fill] = entry;
+        }
+      }
+
+      code <<= 1;
+    }
+
+    return true;
+  }
+
+  /** Returns the next symbol, or -1 if the input doesn't form a valid code */
+  int decode(BitReader& reader) const
+  {
+    const auto bits = reader.peekBits(MAX_CODE_LENGTH);
+
+    if (const auto entry = mFastLookup[bits & ((1 << FAST_BITS) - 1)])
+    {
+      reader.consumeBits(entry >> 12);
+      return entry & 0xFFF;
+    }
+
+    // Codes longer than FAST_BITS are decoded one bit at a time
+    auto code = 0;
+    auto first = 0;
+    auto index = 0;
+    for (auto length = 1; length <= MAX_CODE_LENGTH; ++length)
+    {
+      code |= (bits >> (length - 1)) & 1;
+      const auto count = mCounts[length];
+      if (code - first < count)
+      {
+        reader.consumeBits(length);
+        return mSymbols[index + code - first];
+      }
+
+      index += count;
+      first = (first + count) << 1;
+      code <<= 1;
+    }
+
+    return -1;
+  }
+
+private:
+  static constexpr auto FAST_BITS = 9;
+
+  static int reverseBits(const int code, const int length)
+  {
+    auto result = 0;
+    for (auto i = 0; i < length; ++i)
+    {
+      result |= ((code >> i) & 1) << (length - 1 - i);
+    }
+
+    return result;
+  }
+
+  // (code length << 12) | symbol, 0 for codes longer than FAST_BITS
+  std::array<std::uint16_t, 1 << FAST_BITS> mFastLookup;
+  std::array<std::uint16_t, MAX_CODE_LENGTH + 1> mCounts;
+  std::array<std::uint16_t, NUM_LITERAL_LENGTH_SYMBOLS> mSymbols;
+};
+
+
+/** Incremental deflate decompressor (RFC 1951)
+ *
+ * Produces output on demand, in arbitrarily sized pieces. Data is inflated
+ * into a buffer holding the most recent 32k of output (the deflate window)
+ * plus room for a chunk of new output. Once that has been consumed, the
+ * window is moved back to the start of the buffer.
+ */
+class Inflater
+{
+public:
+  explicit Inflater(std::vector<ArrayView<std::uint8_t>> spans)
+    : mReader(std::move(spans))
+    , mBuffer(WINDOW_SIZE + CHUNK_SIZE)
+  {
+  }
+
+  /** Consume the zlib stream header. Returns false if it's not supported
+   *
+   * Like everything else, the header can be split across IDAT chunks.
+   */
+  bool readZlibHeader()
+  {
+    const auto method = mReader.readBits(8);
+    const auto flags = mReader.readBits(8);
+
+    // Deflate compression, no preset dictionary
+    return !mReader.hasOverrun() && (method & 0x0F) == 8 &&
+      (flags & 0x20) == 0 && ((method << 8) | flags) % 31 == 0;
+  }
+
+  /** Produce exactly count bytes. Returns false if the input is invalid */
+  bool read(std::uint8_t* pOutput, std::size_t count)
+  {
+    while (count > 0)
+    {
+      if (mReadPosition == mWritePosition && !inflateChunk())
+      {
+        return false;
+      }
+
+      const auto copyCount =
+        std::min(count, mWritePosition - mReadPosition);
+      std::memcpy(pOutput, &mBuffer[mReadPosition], copyCount);
+      mReadPosition += copyCount;
+      pOutput += copyCount;
+      count -= copyCount;
+    }
+
+    return true;
+  }
+
+private:
+  static constexpr auto CHUNK_SIZE = std::size_t{65536};
+  static constexpr auto MAX_MATCH_LENGTH = std::size_t{258};
+
+  enum class State
+  {
+    BlockHeader,
+    Stored,
+    Compressed,
+    Finished
+  };
+
+  /** Inflate more data into the buffer. False on error or end of stream */
+  bool inflateChunk()
+  {
+    if (mWritePosition > WINDOW_SIZE)
+    {
+      std::memmove(
+        mBuffer.data(), &mBuffer[mWritePosition - WINDOW_SIZE], WINDOW_SIZE);
+      mWritePosition = mReadPosition = WINDOW_SIZE;
+    }
+
+    const auto startPosition = mWritePosition;
+
+    // Leaves room for one more match of maximum length
+    const auto limit = mBuffer.size() - MAX_MATCH_LENGTH;
+
+    while (mWritePosition < limit)
+    {
+      if (mState == State::BlockHeader)
+      {
+        if (!startBlock())
+        {
+          return false;
+        }
+      }
+      else if (mState == State::Stored)
+      {
+        if (mStoredRemaining == 0)
+        {
+          mState = mIsFinalBlock ? State::Finished : State::BlockHeader;
+          continue;
+        }
+
+        const auto copyCount =
+          std::min(mStoredRemaining, mBuffer.size() - mWritePosition);
+        for (std::size_t i = 0; i < copyCount; ++i)
+        {
+          mBuffer[mWritePosition++] =
+            static_cast<std::uint8_t>(mReader.readBits(8));
+        }
+
+        mStoredRemaining -= copyCount;
+      }
+      else if (mState == State::Compressed)
+      {
+        if (!decodeSymbols(limit))
+        {
+          return false;
+        }
+      }
+      else
+      {
+        break;
+      }
+    }
+
+    return !mReader.hasOverrun() && mWritePosition > startPosition;
+  }
+
+  /** Decode until the end of the block or until reaching limit */
+  bool decodeSymbols(const std::size_t limit)
+  {
+    auto pBuffer = mBuffer.data();
+
+    while (mWritePosition < limit)
+    {
+      const auto symbol = mLiteralLengthTable.decode(mReader);
+
+      if (symbol < END_OF_BLOCK)
+      {
+        if (symbol < 0)
+        {
+          return false;
+        }
+
+        pBuffer[mWritePosition++] = static_cast<std::uint8_t>(symbol);
+        continue;
+      }
+
+      if (symbol == END_OF_BLOCK)
+      {
+        mState = mIsFinalBlock ? State::Finished : State::BlockHeader;
+        return true;
+      }
+
+      const auto lengthCode = symbol - 257;
+      if (lengthCode >= int(std::size(LENGTH_BASE)))
+      {
+        return false;
+      }
+
+      const auto length = LENGTH_BASE[lengthCode] +
+        mReader.readBits(LENGTH_EXTRA_BITS[lengthCode]);
+
+      const auto distanceCode = mDistanceTable.decode(mReader);
+      if (distanceCode < 0 || distanceCode >= int(std::size(DISTANCE_BASE)))
+      {
+        return false;
+      }
+
+      const auto distance = DISTANCE_BASE[distanceCode] +
+        mReader.readBits(DISTANCE_EXTRA_BITS[distanceCode]);
+      if (distance > mWritePosition)
+      {
+        return false;
+      }
+
+      const auto pSource = pBuffer + mWritePosition - distance;
+      const auto pDestination = pBuffer + mWritePosition;
+
+      if (distance >= length)
+      {
+        std::memcpy(pDestination, pSource, length);
+      }
+      else
+      {
+        // Overlapping copy, repeats the most recent distance bytes
+        for (std::size_t i = 0; i < length; ++i)
+        {
+          pDestination[i] = pSource[i];
+        }
+      }
+
+      mWritePosition += length;
+    }
+
+    return true;
+  }
+
+  bool startBlock()
+  {
+    mIsFinalBlock = mReader.readBits(1) != 0;
+    const auto blockType = mReader.readBits(2);
+
+    if (blockType == 0)
+    {
+      mReader.alignToByte();
+      const auto length = mReader.readBits(16);
+      const auto lengthComplement = mReader.readBits(16);
+      if ((length ^ 0xFFFF) != lengthComplement)
+      {
+        return false;
+      }
+
+      mStoredRemaining = length;
+      mState = State::Stored;
+      return true;
+    }
+
+    if (blockType == 1)
+    {
+      buildFixedTables();
+    }
+    else if (blockType == 2)
+    {
+      if (!readDynamicTables())
+      {
+        return false;
+      }
+    }
+    else
+    {
+      return false;
+    }
+
+    mState = State::Compressed;
+    return true;
+  }
+
+  void buildFixedTables()
+  {
+    std::array<std::uint8_t, NUM_LITERAL_LENGTH_SYMBOLS> lengths;
+    std::fill(lengths.begin(), lengths.begin() + 144, std::uint8_t{8});
+    std::fill(lengths.begin() + 144, lengths.begin() + 256, std::uint8_t{9});
+    std::fill(lengths.begin() + 256, lengths.begin() + 280, std::uint8_t{7});
+    std::fill(lengths.begin() + 280, lengths.end(), std::uint8_t{8});
+    mLiteralLengthTable.build(lengths.data(), NUM_LITERAL_LENGTH_SYMBOLS);
+
+    lengths.fill(5);
+    mDistanceTable.build(lengths.data(), NUM_DISTANCE_SYMBOLS);
+  }
+
+  bool readDynamicTables()
+  {
+    const auto numLiteralLengthCodes = int(mReader.readBits(5)) + 257;
+    const auto numDistanceCodes = int(mReader.readBits(5)) + 1;
+    const auto numCodeLengthCodes = int(mReader.readBits(4)) + 4;
+
+    std::array<std::uint8_t, std::size(CODE_LENGTH_ORDER)> codeLengthLengths{};
+    for (auto i = 0; i < numCodeLengthCodes; ++i)
+    {
+      codeLengthLengths[CODE_LENGTH_ORDER[i]] =
+        static_cast<std::uint8_t>(mReader.readBits(3));
+    }
+
+    HuffmanTable codeLengthTable;
+    if (!codeLengthTable.build(
+          codeLengthLengths.data(), int(codeLengthLengths.size())))
+    {
+      return false;
+    }
+
+    // Literal/length and distance code lengths form one continuous sequence,
+    // repeat codes may cross from one to the other.
+    std::array<std::uint8_t, NUM_LITERAL_LENGTH_SYMBOLS + NUM_DISTANCE_SYMBOLS>
+      lengths{};
+    const auto totalCodes = numLiteralLengthCodes + numDistanceCodes;
+
+    auto index = 0;
+    while (index < totalCodes)
+    {
+      const auto symbol = codeLengthTable.decode(mReader);
+      if (symbol < 0)
+      {
+        return false;
+      }
+
+      if (symbol < 16)
+      {
+        lengths[index++] = static_cast<std::uint8_t>(symbol);
+        continue;
+      }
+
+      auto repeatValue = std::uint8_t{0};
+      auto repeatCount = 0;
+
+      if (symbol == 16)
+      {
+        if (index == 0)
+        {
+          return false;
+        }
+
+        repeatValue = lengths[index - 1];
+        repeatCount = 3 + int(mReader.readBits(2));
+      }
+      else if (symbol == 17)
+      {
+        repeatCount = 3 + int(mReader.readBits(3));
+      }
+      else
+      {
+        repeatCount = 11 + int(mReader.readBits(7));
+      }
+
+      if (index + repeatCount > totalCodes)
+      {
+        return false;
+      }
+
+      std::fill_n(lengths.begin() + index, repeatCount, repeatValue);
+      index += repeatCount;
+    }
+
+    if (lengths[END_OF_BLOCK] == 0)
+    {
+      return false;
+    }
+
+    return mLiteralLengthTable.build(lengths.data(), numLiteralLengthCodes) &&
+      mDistanceTable.build(
+        lengths.data() + numLiteralLengthCodes, numDistanceCodes);
+  }
+
+  BitReader mReader;
+  std::vector<std::uint8_t> mBuffer;
+  std::size_t mReadPosition = 0;
+  std::size_t mWritePosition = 0;
+
+  State mState = State::BlockHeader;
+  bool mIsFinalBlock = false;
+  std::size_t mStoredRemaining = 0;
+
+  HuffmanTable mLiteralLengthTable;
+  HuffmanTable mDistanceTable;
+};
+
+
+enum ColorType : std::uint8_t
+{
+  Grayscale = 0,
+  Rgb = 2,
+  Indexed = 3,
+  GrayscaleAlpha = 4,
+  Rgba = 6
+};
+
+
+struct PngInfo
+{
+  std::uint32_t mWidth = 0;
+  std::uint32_t mHeight = 0;
+  std::uint8_t mBitDepth = 0;
+  std::uint8_t mColorType = 0;
+  bool mIsInterlaced = false;
+
+  std::array<Pixel, 256> mPalette;
+
+  // Sample value(s) marked as transparent, for grayscale and RGB images
+  std::optional<std::array<std::uint16_t, 3>> mTransparentColor;
+
+  std::vector<ArrayView<std::uint8_t>> mImageData;
+};
+
+
+int numChannels(const std::uint8_t colorType)
+{
+  switch (colorType)
+  {
+    case Grayscale:
+    case Indexed:
+      return 1;
+
+    case GrayscaleAlpha:
+      return 2;
+
+    case Rgb:
+      return 3;
+
+    case Rgba:
+      return 4;
+
+    default:
+      return 0;
+  }
+}
+
+
+bool isValidBitDepth(const std::uint8_t colorType, const std::uint8_t depth)
+{
+  switch (colorType)
+  {
+    case Grayscale:
+      return depth == 1 || depth == 2 || depth == 4 || depth == 8 ||
+        depth == 16;
+
+    case Indexed:
+      return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+
+    default:
+      return depth == 8 || depth == 16;
+  }
+}
+
+
+bool parseHeader(ArrayView<std::uint8_t> data, PngInfo& info)
+{
+  if (data.size() != 13)
+  {
+    return false;
+  }
+
+  info.mWidth = readU32BigEndian(&data[0]);
+  info.mHeight = readU32BigEndian(&data[4]);
+  info.mBitDepth = data[8];
+  info.mColorType = data[9];
+  info.mIsInterlaced = data[12] != 0;
+
+  return info.mWidth > 0 && info.mHeight > 0 &&
+    info.mWidth <= MAX_DIMENSION && info.mHeight <= MAX_DIMENSION &&
+    numChannels(info.mColorType) > 0 &&
+    isValidBitDepth(info.mColorType, info.mBitDepth) && data[10] == 0 &&
+    data[11] == 0 && data[12] <= 1;
+}
+
+
+void parseTransparency(ArrayView<std::uint8_t> data, PngInfo& info)
+{
+  if (info.mColorType == Indexed)
+  {
+    for (std::size_t i = 0; i < std::min<std::size_t>(data.size(), 256); ++i)
+    {
+      info.mPalette[i].a = data[i];
+    }
+  }
+  else if (info.mColorType == Grayscale && data.size() >= 2)
+  {
+    const auto value = readU16BigEndian(&data[0]);
+    info.mTransparentColor = {value, value, value};
+  }
+  else if (info.mColorType == Rgb && data.size() >= 6)
+  {
+    info.mTransparentColor = {
+      readU16BigEndian(&data[0]),
+      readU16BigEndian(&data[2]),
+      readU16BigEndian(&data[4])};
+  }
+}
+
+
+/** Parse all chunks, collecting (but not decompressing) the image data */
+std::optional<PngInfo> parsePng(ArrayView<std::uint8_t> data)
+{
+  constexpr auto SIGNATURE_SIZE = sizeof(PNG_SIGNATURE);
+  constexpr auto CHUNK_OVERHEAD = std::size_t{12};
+
+  PngInfo info;
+  info.mPalette.fill(Pixel{0, 0, 0, 255});
+
+  auto position = SIGNATURE_SIZE;
+  auto hasHeader = false;
+
+  while (position + CHUNK_OVERHEAD <= data.size())
+  {
+    const auto length = std::size_t{readU32BigEndian(&data[position])};
+    const auto pType = &data[position + 4];
+    const auto dataStart = position + 8;
+
+    if (length > data.size() - position - CHUNK_OVERHEAD)
+    {
+      return std::nullopt;
+    }
+
+    const auto chunkData = ArrayView<std::uint8_t>{
+      data.data() + dataStart, static_cast<std::uint32_t>(length)};
+    const auto isChunk = [pType](const char* type) {
+      return std::memcmp(pType, type, 4) == 0;
+    };
+
+    if (!hasHeader)
+    {
+      if (!isChunk("IHDR") || !parseHeader(chunkData, info))
+      {
+        return std::nullopt;
+      }
+
+      hasHeader = true;
+    }
+    else if (isChunk("PLTE"))
+    {
+      if (length % 3 != 0 || length / 3 > 256)
+      {
+        return std::nullopt;
+      }
+
+      for (std::size_t i = 0; i < length / 3; ++i)
+      {
+        info.mPalette[i].r = chunkData[i * 3];
+        info.mPalette[i].g = chunkData[i * 3 + 1];
+        info.mPalette[i].b = chunkData[i * 3 + 2];
+      }
+    }
+    else if (isChunk("tRNS"))
+    {
+      parseTransparency(chunkData, info);
+    }
+    else if (isChunk("IDAT"))
+    {
+      info.mImageData.push_back(chunkData);
+    }
+    else if (isChunk("IEND"))
+    {
+      break;
+    }
+
+    position = dataStart + length + 4;
+  }
+
+  if (!hasHeader || info.mImageData.empty())
+  {
+    return std::nullopt;
+  }
+
+  return info;
+}
+
+
+std::uint8_t paethPredictor(const int a, const int b, const int c)
+{
+  const auto p = a + b - c;
+  const auto pa = std::abs(p - a);
+  const auto pb = std::abs(p - b);
+  const auto pc = std::abs(p - c);
+
+  if (pa <= pb && pa <= pc)
+  {
+    return static_cast<std::uint8_t>(a);
+  }
+
+  return static_cast<std::uint8_t>(pb <= pc ? b : c);
+}
+
+
+bool unfilterRow(
+  const std::uint8_t filterType,
+  std::uint8_t* pRow,
+  const std::uint8_t* pPreviousRow,
+  const std::size_t rowSize,
+  const std::size_t bytesPerPixel)
+{
+  switch (filterType)
+  {
+    case 0:
+      break;
+
+    case 1:
+      for (auto i = bytesPerPixel; i < rowSize; ++i)
+      {
+        pRow[i] += pRow[i - bytesPerPixel];
+      }
+      break;
+
+    case 2:
+      for (std::size_t i = 0; i < rowSize; ++i)
+      {
+        pRow[i] += pPreviousRow[i];
+      }
+      break;
+
+    case 3:
+      for (std::size_t i = 0; i < rowSize; ++i)
+      {
+        const auto left = i >= bytesPerPixel ? pRow[i - bytesPerPixel] : 0;
+        pRow[i] += static_cast<std::uint8_t>((left + pPreviousRow[i]) / 2);
+      }
+      break;
+
+    case 4:
+      for (std::size_t i = 0; i < rowSize; ++i)
+      {
+        const auto hasLeft = i >= bytesPerPixel;
+        const auto left = hasLeft ? pRow[i - bytesPerPixel] : 0;
+        const auto upperLeft = hasLeft ? pPreviousRow[i - bytesPerPixel] : 0;
+        pRow[i] += paethPredictor(left, pPreviousRow[i], upperLeft);
+      }
+      break;
+
+    default:
+      return false;
+  }
+
+  return true;
+}
+
+
+/** Converts a row of unfiltered PNG samples to RGBA */
+class RowConverter
+{
+public:
+  explicit RowConverter(const PngInfo& info)
+    : mInfo(info)
+    , mBitDepth(info.mBitDepth)
+  {
+  }
+
+  void convert(const std::uint8_t* pRow, Pixel* pOutput) const
+  {
+    const auto width = mInfo.mWidth;
+
+    if (mInfo.mColorType == Rgba && mBitDepth == 8)
+    {
+      std::memcpy(pOutput, pRow, width * sizeof(Pixel));
+      return;
+    }
+
+    for (std::uint32_t x = 0; x < width; ++x)
+    {
+      pOutput[x] = convertPixel(pRow, x);
+    }
+  }
+
+private:
+  /** Raw sample value at given index, at full bit depth */
+  std::uint16_t sample(const std::uint8_t* pRow, const std::size_t index) const
+  {
+    switch (mBitDepth)
+    {
+      case 16:
+        return readU16BigEndian(pRow + index * 2);
+
+      case 8:
+        return pRow[index];
+
+      default:
+        {
+          const auto bitOffset = index * mBitDepth;
+          const auto shift = 8 - mBitDepth - int(bitOffset % 8);
+          return (pRow[bitOffset / 8] >> shift) & ((1 << mBitDepth) - 1);
+        }
+    }
+  }
+
+  /** Scales a raw sample to 8 bits, the same way as stb_image */
+  std::uint8_t to8Bit(const std::uint16_t value) const
+  {
+    switch (mBitDepth)
+    {
+      case 1:
+        return static_cast<std::uint8_t>(value * 0xFF);
+
+      case 2:
+        return static_cast<std::uint8_t>(value * 0x55);
+
+      case 4:
+        return static_cast<std::uint8_t>(value * 0x11);
+
+      case 16:
+        return static_cast<std::uint8_t>(value >> 8);
+
+      default:
+        return static_cast<std::uint8_t>(value);
+    }
+  }
+
+  Pixel convertPixel(const std::uint8_t* pRow, const std::uint32_t x) const
+  {
+    switch (mInfo.mColorType)
+    {
+      case Grayscale:
+        {
+          const auto value = sample(pRow, x);
+          const auto gray = to8Bit(value);
+          const auto isTransparent = mInfo.mTransparentColor &&
+            (*mInfo.mTransparentColor)[0] == value;
+          return Pixel{gray, gray, gray, std::uint8_t(isTransparent ? 0 : 255)};
+        }
+
+      case Rgb:
+        {
+          const auto r = sample(pRow, x * 3);
+          const auto g = sample(pRow, x * 3 + 1);
+          const auto b = sample(pRow, x * 3 + 2);
+          const auto isTransparent = mInfo.mTransparentColor &&
+            *mInfo.mTransparentColor == std::array<std::uint16_t, 3>{r, g, b};
+          return Pixel{
+            to8Bit(r),
+            to8Bit(g),
+            to8Bit(b),
+            std::uint8_t(isTransparent ? 0 : 255)};
+        }
+
+      case Indexed:
+        return mInfo.mPalette[sample(pRow, x)];
+
+      case GrayscaleAlpha:
+        {
+          const auto gray = to8Bit(sample(pRow, x * 2));
+          return Pixel{gray, gray, gray, to8Bit(sample(pRow, x * 2 + 1))};
+        }
+
+      default:
+        return Pixel{
+          to8Bit(sample(pRow, x * 4)),
+          to8Bit(sample(pRow, x * 4 + 1)),
+          to8Bit(sample(pRow, x * 4 + 2)),
+          to8Bit(sample(pRow, x * 4 + 3))};
+    }
+  }
+
+  const PngInfo& mInfo;
+  int mBitDepth;
+};
+
+} // namespace
+
+
+PngDecodeResult decodePngRows(
+  ArrayView<std::uint8_t> data,
+  const ImageRowsFunc& onRows,
+  const std::size_t maxRowsPerCall)
+{
+  if (
+    data.size() < sizeof(PNG_SIGNATURE) ||
+    std::memcmp(data.data(), PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0)
+  {
+    return PngDecodeResult::Unsupported;
+  }
+
+  const auto info = parsePng(data);
+  if (!info)
+  {
+    return PngDecodeResult::Failure;
+  }
+
+  if (info->mIsInterlaced)
+  {
+    return PngDecodeResult::Unsupported;
+  }
+
+  Inflater inflater{info->mImageData};
+  if (!inflater.readZlibHeader())
+  {
+    return PngDecodeResult::Failure;
+  }
+
+  const auto width = std::size_t{info->mWidth};
+  const auto height = std::size_t{info->mHeight};
+  const auto bitsPerPixel =
+    std::size_t(numChannels(info->mColorType) * info->mBitDepth);
+  const auto rowSize = (width * bitsPerPixel + 7) / 8;
+  const auto bytesPerPixel = std::max(std::size_t{1}, bitsPerPixel / 8);
+  const auto rowsPerBand = std::clamp(maxRowsPerCall, std::size_t{1}, height);
+
+  std::vector<std::uint8_t> currentRow(rowSize);
+  std::vector<std::uint8_t> previousRow(rowSize);
+  PixelBuffer band(width * rowsPerBand);
+  const auto converter = RowConverter{*info};
+
+  auto bandStart = std::size_t{0};
+
+  for (std::size_t y = 0; y < height; ++y)
+  {
+    auto filterType = std::uint8_t{0};
+    if (
+      !inflater.read(&filterType, 1) ||
+      !inflater.read(currentRow.data(), rowSize) ||
+      !unfilterRow(
+        filterType,
+        currentRow.data(),
+        previousRow.data(),
+        rowSize,
+        bytesPerPixel))
+    {
+      return PngDecodeResult::Failure;
+    }
+
+    converter.convert(currentRow.data(), &band[(y - bandStart) * width]);
+    std::swap(currentRow, previousRow);
+
+    const auto numRowsInBand = y + 1 - bandStart;
+    if (numRowsInBand == rowsPerBand || y + 1 == height)
+    {
+      onRows(bandStart, ImageView{band.data(), width, numRowsInBand});
+      bandStart = y + 1;
+    }
+  }
+
+  return PngDecodeResult::Success;
+}
+
+} // namespace rigel::base::detail
@@ -0,0 +1,773 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/image_loading.hpp"
+
+#include "base/thread_pool.hpp"
+#include "base/trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+
+/* PNG encoder which splits the work across multiple threads.
+ *
+ * The image is divided into horizontal bands of rows. Each band is filtered
+ * and compressed independently, into a sequence of deflate blocks that ends
+ * on a byte boundary (the same thing zlib does for Z_SYNC_FLUSH). This makes
+ * it possible to concatenate the compressed bands into a single zlib stream.
+ * Each band becomes its own IDAT chunk, so that CRCs can also be computed
+ * in parallel. The zlib stream's Adler-32 checksum is combined from the
+ * per-band checksums at the end.
+ *
+ * Compression uses the fixed Huffman code and a hash-chain match finder with
+ * lazy matching, which is roughly on par with stb_image_write.
+ */
+
+namespace rigel::base
+{
+
+namespace
+{
+
+constexpr auto BYTES_PER_PIXEL = std::size_t{4};
+constexpr auto MIN_ROWS_PER_BAND = std::size_t{32};
+
+constexpr auto WINDOW_SIZE = 32768;
+constexpr auto WINDOW_MASK = WINDOW_SIZE - 1;
+constexpr auto HASH_BITS = 15;
+constexpr auto HASH_SIZE = 1 << HASH_BITS;
+constexpr auto MIN_MATCH_LENGTH = 3;
+constexpr auto MAX_MATCH_LENGTH = 258;
+constexpr auto MAX_CHAIN_LENGTH = 16;
+
+constexpr std::uint8_t PNG_SIGNATURE[] = {
+  0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+// Deflate length and distance code tables, see RFC 1951, section 3.2.5
+constexpr std::uint16_t LENGTH_BASE[] = {
+  3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr std::uint8_t LENGTH_EXTRA_BITS[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr std::uint16_t DISTANCE_BASE[] = {
+  1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+  33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+  1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr std::uint8_t DISTANCE_EXTRA_BITS[] = {
+  0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+
+class BitWriter
+{
+public:
+  explicit BitWriter(ByteBuffer& output)
+    : mOutput(output)
+  {
+  }
+
+  void writeBits(const std::uint32_t bits, const int count)
+  {
+    mBitBuffer |= bits << mBitCount;
+    mBitCount += count;
+
+    while (mBitCount >= 8)
+    {
+      mOutput.push_back(static_cast<std::uint8_t>(mBitBuffer));
+      mBitBuffer >>= 8;
+      mBitCount -= 8;
+    }
+  }
+
+  /** Huffman codes are stored starting with the most significant bit */
+  void writeHuffmanCode(const std::uint32_t code, const int length)
+  {
+    auto reversed = std::uint32_t{0};
+    for (auto i = 0; i < length; ++i)
+    {
+      reversed |= ((code >> i) & 1u) << (length - 1 - i);
+    }
+
+    writeBits(reversed, length);
+  }
+
+  void alignToByte()
+  {
+    if (mBitCount > 0)
+    {
+      writeBits(0, 8 - mBitCount);
+    }
+  }
+
+private:
+  ByteBuffer& mOutput;
+  std::uint32_t mBitBuffer = 0;
+  int mBitCount = 0;
+};
+
+
+void writeLiteral(BitWriter& writer, const int symbol)
+{
+  // Fixed Huffman code, see RFC 1951, section 3.2.6
+  if (symbol < 144)
+  {
+    writer.writeHuffmanCode(0x30 + symbol, 8);
+  }
+  else if (symbol < 256)
+  {
+    writer.writeHuffmanCode(0x190 + (symbol - 144), 9);
+  }
+  else if (symbol < 280)
+  {
+    writer.writeHuffmanCode(symbol - 256, 7);
+  }
+  else
+  {
+    writer.writeHuffmanCode(0xC0 + (symbol - 280), 8);
+  }
+}
+
+
+void writeMatch(BitWriter& writer, const int length, const int distance)
+{
+  auto lengthCode = 0;
+  while (lengthCode < 28 && LENGTH_BASE[lengthCode + 1] <= length)
+  {
+    ++lengthCode;
+  }
+
+  writeLiteral(writer, 257 + lengthCode);
+  writer.writeBits(
+    length - LENGTH_BASE[lengthCode], LENGTH_EXTRA_BITS[lengthCode]);
+
+  auto distanceCode = 0;
+  while (distanceCode < 29 && DISTANCE_BASE[distanceCode + 1] <= distance)
+  {
+    ++distanceCode;
+  }
+
+  writer.writeHuffmanCode(distanceCode, 5);
+  writer.writeBits(
+    distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA_BITS[distanceCode]);
+}
+
+
+class MatchFinder
+{
+public:
+  MatchFinder(const std::uint8_t* pData, const int size)
+    : mpData(pData)
+    , mSize(size)
+    , mHashHeads(HASH_SIZE, -1)
+    , mPreviousInChain(WINDOW_SIZE, -1)
+  {
+  }
+
+  void insert(const int pos)
+  {
+    if (pos + MIN_MATCH_LENGTH > mSize)
+    {
+      return;
+    }
+
+    const auto hash = hashAt(pos);
+    mPreviousInChain[pos & WINDOW_MASK] = mHashHeads[hash];
+    mHashHeads[hash] = pos;
+  }
+
+  /** Find longest match for pos, must be called before insert(pos) */
+  std::pair<int, int> findMatch(const int pos) const
+  {
+    auto bestLength = 0;
+    auto bestDistance = 0;
+
+    if (pos + MIN_MATCH_LENGTH > mSize)
+    {
+      return {bestLength, bestDistance};
+    }
+
+    const auto maxLength = std::min(MAX_MATCH_LENGTH, mSize - pos);
+    auto candidate = mHashHeads[hashAt(pos)];
+
+    for (auto i = 0; i < MAX_CHAIN_LENGTH && candidate >= 0; ++i)
+    {
+      const auto distance = pos - candidate;
+      if (distance > WINDOW_SIZE)
+      {
+        break;
+      }
+
+      auto length = 0;
+      while (length < maxLength &&
+             mpData[candidate + length] == mpData[pos + length])
+      {
+        ++length;
+      }
+
+      if (length > bestLength)
+      {
+        bestLength = length;
+        bestDistance = distance;
+
+        if (length == maxLength)
+        {
+          break;
+        }
+      }
+
+      // Entries in the window-sized chain buffer get overwritten by newer
+      // positions eventually. Chains always go backwards, so anything else
+      // means we've hit a stale entry.
+      const auto next = mPreviousInChain[candidate & WINDOW_MASK];
+      if (next >= candidate)
+      {
+        break;
+      }
+
+      candidate = next;
+    }
+
+    if (bestLength < MIN_MATCH_LENGTH)
+    {
+      return {0, 0};
+    }
+
+    return {bestLength, bestDistance};
+  }
+
+private:
+  int hashAt(const int pos) const
+  {
+    const auto value = std::uint32_t{mpData[pos]} << 16 |
+      std::uint32_t{mpData[pos + 1]} << 8 | mpData[pos + 2];
+    return static_cast<int>((value * 2654435761u) >> (32 - HASH_BITS));
+  }
+
+  const std::uint8_t* mpData;
+  int mSize;
+  std::vector<int> mHashHeads;
+  std::vector<int> mPreviousInChain;
+};
+
+
+/** Compress data into deflate blocks
+ *
+ * Unless isFinal is set, the output ends with an empty stored block. This
+ * aligns the output to a byte boundary, so that it can be followed by further
+ * deflate blocks compressed independently.
+ */
+void deflate(
+  const ByteBuffer& data,
+  const bool isFinal,
+  ByteBuffer& output)
+{
+  BitWriter writer{output};
+
+  // Block header: BFINAL, then BTYPE 01 (fixed Huffman codes)
+  writer.writeBits(isFinal ? 1 : 0, 1);
+  writer.writeBits(1, 2);
+
+  const auto size = static_cast<int>(data.size());
+  MatchFinder matchFinder{data.data(), size};
+
+  auto pos = 0;
+  while (pos < size)
+  {
+    auto [length, distance] = matchFinder.findMatch(pos);
+    matchFinder.insert(pos);
+
+    if (length == 0)
+    {
+      writeLiteral(writer, data[pos]);
+      ++pos;
+      continue;
+    }
+
+    // Lazy matching: If the next position has a longer match, emit the
+    // current byte as a literal and take that match instead.
+    if (length < MAX_MATCH_LENGTH)
+    {
+      const auto [nextLength, nextDistance] = matchFinder.findMatch(pos + 1);
+
+      if (nextLength > length)
+      {
+        writeLiteral(writer, data[pos]);
+        ++pos;
+        matchFinder.insert(pos);
+
+        length = nextLength;
+        distance = nextDistance;
+      }
+    }
+
+    writeMatch(writer, length, distance);
+
+    for (auto i = 1; i < length; ++i)
+    {
+      matchFinder.insert(pos + i);
+    }
+
+    pos += length;
+  }
+
+  // End of block
+  writeLiteral(writer, 256);
+
+  if (!isFinal)
+  {
+    // Empty stored block: header bits, padding, then LEN = 0 and NLEN = ~0
+    writer.writeBits(0, 3);
+    writer.alignToByte();
+    output.insert(output.end(), {0x00, 0x00, 0xFF, 0xFF});
+  }
+  else
+  {
+    writer.alignToByte();
+  }
+}
+
+
+constexpr std::uint32_t ADLER_MODULUS = 65521;
+
+std::uint32_t adler32(const std::uint8_t* pData, std::size_t size)
+{
+  std::uint32_t a = 1;
+  std::uint32_t b = 0;
+
+  while (size > 0)
+  {
+    // This is the largest number of bytes that can be summed up before b
+    // might overflow 32 bits
+    const auto blockSize = std::min(size, std::size_t{5552});
+    for (std::size_t i = 0; i < blockSize; ++i)
+    {
+      a += pData[i];
+      b += a;
+    }
+
+    a %= ADLER_MODULUS;
+    b %= ADLER_MODULUS;
+    pData += blockSize;
+    size -= blockSize;
+  }
+
+  return (b << 16) | a;
+}
+
+
+/** Compute Adler-32 of A + B, given Adler-32 of A and B and the size of B */
+std::uint32_t combineAdler32(
+  const std::uint32_t adlerA,
+  const std::uint32_t adlerB,
+  const std::size_t sizeB)
+{
+  const auto remainder = static_cast<std::uint32_t>(sizeB % ADLER_MODULUS);
+
+  auto a = adlerA & 0xFFFF;
+  auto b = static_cast<std::uint32_t>(
+    (std::uint64_t{remainder} * a) % ADLER_MODULUS);
+  a += (adlerB & 0xFFFF) + ADLER_MODULUS - 1;
+  b += (adlerA >> 16) + (adlerB >> 16) + ADLER_MODULUS - remainder;
+
+  a %= ADLER_MODULUS;
+  b %= ADLER_MODULUS;
+
+  return (b << 16) | a;
+}
+
+
+std::uint32_t crc32(
+  std::uint32_t crc,
+  const std::uint8_t* pData,
+  const std::size_t size)
+{
+  static const auto table = []() {
+    std::array<std::uint32_t, 256> result{};
+    for (std::uint32_t i = 0; i < 256; ++i)
+    {
+      auto value = i;
+      for (auto bit = 0; bit < 8; ++bit)
+      {
+        value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+      }
+      result[i] = value;
+    }
+    return result;
+  }();
+
+  crc = ~crc;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+
+void appendU32BigEndian(ByteBuffer& buffer, const std::uint32_t value)
+{
+  buffer.push_back(static_cast<std::uint8_t>(value >> 24));
+  buffer.push_back(static_cast<std::uint8_t>(value >> 16));
+  buffer.push_back(static_cast<std::uint8_t>(value >> 8));
+  buffer.push_back(static_cast<std::uint8_t>(value));
+}
+
+
+/** Append a PNG chunk, with type and data already in place at chunkStart */
+void finishChunk(ByteBuffer& buffer, const std::size_t chunkStart)
+{
+  const auto pChunkType = buffer.data() + chunkStart + 4;
+  const auto dataSize = buffer.size() - chunkStart - 8;
+
+  const auto length = static_cast<std::uint32_t>(dataSize);
+  buffer[chunkStart] = static_cast<std::uint8_t>(length >> 24);
+  buffer[chunkStart + 1] = static_cast<std::uint8_t>(length >> 16);
+  buffer[chunkStart + 2] = static_cast<std::uint8_t>(length >> 8);
+  buffer[chunkStart + 3] = static_cast<std::uint8_t>(length);
+
+  appendU32BigEndian(buffer, crc32(0, pChunkType, dataSize + 4));
+}
+
+
+std::size_t beginChunk(ByteBuffer& buffer, const char* type)
+{
+  const auto chunkStart = buffer.size();
+
+  // Placeholder for the length, filled in by finishChunk()
+  appendU32BigEndian(buffer, 0);
+  buffer.insert(buffer.end(), type, type + 4);
+
+  return chunkStart;
+}
+
+
+std::uint8_t paethPredictor(const int a, const int b, const int c)
+{
+  const auto p = a + b - c;
+  const auto pa = std::abs(p - a);
+  const auto pb = std::abs(p - b);
+  const auto pc = std::abs(p - c);
+
+  if (pa <= pb && pa <= pc)
+  {
+    return static_cast<std::uint8_t>(a);
+  }
+
+  return static_cast<std::uint8_t>(pb <= pc ? b : c);
+}
+
+
+/** Apply PNG filtering to a row, picking the best filter type
+ *
+ * Like most encoders, we use the minimum sum of absolute differences
+ * heuristic from the PNG spec.
+ */
+void filterRow(
+  const std::uint8_t* pRow,
+  const std::uint8_t* pPreviousRow,
+  const std::size_t rowSize,
+  std::uint8_t* pOutput,
+  std::vector<std::uint8_t>& scratch)
+{
+  constexpr auto NUM_FILTER_TYPES = 5;
+
+  scratch.resize(rowSize * NUM_FILTER_TYPES);
+
+  auto bestFilter = 0;
+  auto bestScore = ~std::uint64_t{0};
+
+  for (auto filter = 0; filter < NUM_FILTER_TYPES; ++filter)
+  {
+    const auto pFiltered = scratch.data() + filter * rowSize;
+    auto score = std::uint64_t{0};
+
+    for (std::size_t i = 0; i < rowSize; ++i)
+    {
+      const int left = i >= BYTES_PER_PIXEL ? pRow[i - BYTES_PER_PIXEL] : 0;
+      const int up = pPreviousRow ? pPreviousRow[i] : 0;
+      const int upLeft = pPreviousRow && i >= BYTES_PER_PIXEL
+        ? pPreviousRow[i - BYTES_PER_PIXEL]
+        : 0;
+
+      auto predicted = 0;
+      switch (filter)
+      {
+        case 1:
+          predicted = left;
+          break;
+
+        case 2:
+          predicted = up;
+          break;
+
+        case 3:
+          predicted = (left + up) / 2;
+          break;
+
+        case 4:
+          predicted = paethPredictor(left, up, upLeft);
+          break;
+      }
+
+      const auto value = static_cast<std::uint8_t>(pRow[i] - predicted);
+      pFiltered[i] = value;
+      score += std::abs(static_cast<std::int8_t>(value));
+    }
+
+    if (score < bestScore)
+    {
+      bestScore = score;
+      bestFilter = filter;
+    }
+  }
+
+  pOutput[0] = static_cast<std::uint8_t>(bestFilter);
+  std::memcpy(pOutput + 1, scratch.data() + bestFilter * rowSize, rowSize);
+}
+
+
+struct EncodedBand
+{
+  /** Any number of complete IDAT chunks, copied to the output as they are */
+  ByteBuffer mChunks;
+  std::uint32_t mAdler32;
+  std::size_t mUncompressedSize;
+};
+
+
+EncodedBand encodeBand(
+  const ImageView& image,
+  const std::size_t firstRow,
+  const std::size_t lastRow,
+  const bool isFirstBand,
+  const bool isLastBand)
+{
+  const auto rowSize = image.width() * BYTES_PER_PIXEL;
+  const auto rowBytes = [&image](const std::size_t row) {
+    return reinterpret_cast<const std::uint8_t*>(image.row(row));
+  };
+
+  ByteBuffer filtered((rowSize + 1) * (lastRow - firstRow));
+  std::vector<std::uint8_t> scratch;
+
+  for (auto row = firstRow; row < lastRow; ++row)
+  {
+    const auto pRow = rowBytes(row);
+    const auto pPreviousRow = row > 0 ? rowBytes(row - 1) : nullptr;
+    filterRow(
+      pRow,
+      pPreviousRow,
+      rowSize,
+      filtered.data() + (row - firstRow) * (rowSize + 1),
+      scratch);
+  }
+
+  EncodedBand result;
+  result.mAdler32 = adler32(filtered.data(), filtered.size());
+  result.mUncompressedSize = filtered.size();
+
+  // Roughly the size of a typical result, to avoid most reallocations
+  result.mChunks.reserve(filtered.size() / 2 + 64);
+
+  const auto chunkStart = beginChunk(result.mChunks, "IDAT");
+
+  if (isFirstBand)
+  {
+    // zlib header: deflate with 32k window, no preset dictionary. The second
+    // byte makes the header a multiple of 31, as required.
+    result.mChunks.push_back(0x78);
+    result.mChunks.push_back(0x01);
+  }
+
+  deflate(filtered, isLastBand, result.mChunks);
+  finishChunk(result.mChunks, chunkStart);
+
+  return result;
+}
+
+
+struct EncoderThreads
+{
+  ThreadPool mBandWorkers;
+
+  // Declared last, so that it's shut down first: Saves still in the queue
+  // at exit need the band workers.
+  ThreadPool mSaveQueue{1};
+};
+
+
+EncoderThreads& encoderThreads()
+{
+  static EncoderThreads threads;
+  return threads;
+}
+
+} // namespace
+
+
+ByteBuffer encodePng(const Image& image)
+{
+  return encodePng(image.view());
+}
+
+
+ByteBuffer encodePng(const ImageView& image)
+{
+  RIGEL_TRACE_SCOPE("encodePng");
+
+  if (image.empty())
+  {
+    throw std::invalid_argument("Can't encode empty image as PNG");
+  }
+
+  auto& pool = encoderThreads().mBandWorkers;
+
+  const auto numBands = std::clamp(
+    image.height() / MIN_ROWS_PER_BAND, std::size_t{1}, pool.numThreads() * 2);
+  const auto rowsPerBand = (image.height() + numBands - 1) / numBands;
+
+  std::vector<std::future<EncodedBand>> pendingBands;
+  pendingBands.reserve(numBands);
+
+  for (std::size_t band = 0; band < numBands; ++band)
+  {
+    const auto firstRow = band * rowsPerBand;
+    const auto lastRow = std::min(firstRow + rowsPerBand, image.height());
+    if (firstRow >= lastRow)
+    {
+      break;
+    }
+
+    const auto isFirst = band == 0;
+    const auto isLast = lastRow == image.height();
+
+    if (numBands == 1)
+    {
+      // Not worth the overhead of going through the thread pool
+      std::promise<EncodedBand> result;
+      result.set_value(encodeBand(image, firstRow, lastRow, isFirst, isLast));
+      pendingBands.push_back(result.get_future());
+    }
+    else
+    {
+      pendingBands.push_back(
+        pool.submit([&image, firstRow, lastRow, isFirst, isLast]() {
+          return encodeBand(image, firstRow, lastRow, isFirst, isLast);
+        }));
+    }
+  }
+
+  std::vector<EncodedBand> bands;
+  bands.reserve(pendingBands.size());
+  for (auto& pendingBand : pendingBands)
+  {
+    bands.push_back(pendingBand.get());
+  }
+
+  auto adler = bands.front().mAdler32;
+  for (auto i = 1u; i < bands.size(); ++i)
+  {
+    adler = combineAdler32(
+      adler, bands[i].mAdler32, bands[i].mUncompressedSize);
+  }
+
+  constexpr auto IHDR_CHUNK_SIZE = 12 + 13;
+  constexpr auto ADLER_CHUNK_SIZE = 12 + 4;
+  constexpr auto IEND_CHUNK_SIZE = 12;
+
+  auto totalSize = sizeof(PNG_SIGNATURE) + IHDR_CHUNK_SIZE +
+    ADLER_CHUNK_SIZE + IEND_CHUNK_SIZE;
+  for (const auto& band : bands)
+  {
+    totalSize += band.mChunks.size();
+  }
+
+  ByteBuffer output;
+  output.reserve(totalSize);
+  output.insert(
+    output.end(), std::begin(PNG_SIGNATURE), std::end(PNG_SIGNATURE));
+
+  {
+    const auto chunkStart = beginChunk(output, "IHDR");
+    appendU32BigEndian(output, static_cast<std::uint32_t>(image.width()));
+    appendU32BigEndian(output, static_cast<std::uint32_t>(image.height()));
+
+    // 8 bits per channel, RGBA, default compression/filtering, no interlacing
+    output.insert(output.end(), {8, 6, 0, 0, 0});
+    finishChunk(output, chunkStart);
+  }
+
+  for (const auto& band : bands)
+  {
+    output.insert(output.end(), band.mChunks.begin(), band.mChunks.end());
+  }
+
+  {
+    // The zlib stream's checksum is only known once all bands are done, so
+    // it goes into an IDAT chunk of its own.
+    const auto chunkStart = beginChunk(output, "IDAT");
+    appendU32BigEndian(output, adler);
+    finishChunk(output, chunkStart);
+  }
+
+  finishChunk(output, beginChunk(output, "IEND"));
+
+  return output;
+}
+
+
+bool savePng(const std::filesystem::path& path, const Image& image)
+{
+  return savePng(path, image.view());
+}
+
+
+bool savePng(const std::filesystem::path& path, const ImageView& image)
+{
+  if (image.empty())
+  {
+    return false;
+  }
+
+  const auto encoded = encodePng(image);
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+  return file.good();
+}
+
+
+std::future<bool> savePngAsync(std::filesystem::path path, Image image)
+{
+  return encoderThreads().mSaveQueue.submit(
+    [path = std::move(path), image = std::move(image)]() {
+      return savePng(path, image);
+    });
+}
+
+} // namespace rigel::base
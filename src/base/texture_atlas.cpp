@@ -0,0 +1,267 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/texture_atlas.hpp"
+
+#include "base/thread_pool.hpp"
+#include "base/warnings.hpp"
+
+RIGEL_DISABLE_WARNINGS
+#include <stb_rect_pack.h>
+RIGEL_RESTORE_WARNINGS
+
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+
+
+namespace rigel::base
+{
+
+namespace
+{
+
+// stb_rect_pack stores coordinates as unsigned short
+constexpr auto MAX_PACKING_AREA_SIZE = 65535;
+
+
+struct Placement
+{
+  ImageView mSource;
+
+  // Position of the image itself, not including extrusion
+  std::size_t mX;
+  std::size_t mY;
+};
+
+
+void extrude(Image& page, const Placement& placement, const int extrusion)
+{
+  const auto& source = placement.mSource;
+  if (extrusion == 0 || source.empty())
+  {
+    return;
+  }
+
+  const auto x = placement.mX;
+  const auto y = placement.mY;
+  const auto width = source.width();
+  const auto height = source.height();
+  const auto amount = std::size_t(extrusion);
+
+  const auto leftColumn = source.subView(0, 0, 1, height);
+  const auto rightColumn = source.subView(width - 1, 0, 1, height);
+
+  for (std::size_t i = 1; i <= amount; ++i)
+  {
+    page.insertImage(x - i, y, leftColumn);
+    page.insertImage(x + width - 1 + i, y, rightColumn);
+  }
+
+  // Rows are extended after the columns, so that this fills in the corners
+  // as well.
+  const auto extrudedWidth = width + 2 * amount;
+  const auto topRow = page.subView(x - amount, y, extrudedWidth, 1);
+  const auto bottomRow =
+    page.subView(x - amount, y + height - 1, extrudedWidth, 1);
+
+  for (std::size_t i = 1; i <= amount; ++i)
+  {
+    page.insertImage(x - amount, y - i, topRow);
+    page.insertImage(x - amount, y + height - 1 + i, bottomRow);
+  }
+}
+
+
+Image fillPage(
+  const std::size_t width,
+  const std::size_t height,
+  const std::vector<Placement>& placements,
+  const int extrusion)
+{
+  Image page{width, height};
+
+  for (const auto& placement : placements)
+  {
+    page.insertImage(placement.mX, placement.mY, placement.mSource);
+    extrude(page, placement, extrusion);
+  }
+
+  return page;
+}
+
+} // namespace
+
+
+TextureAtlasBuilder::TextureAtlasBuilder(const TextureAtlasConfig& config)
+  : mConfig(config)
+{
+  if (
+    mConfig.maxPageSize <= 0 || mConfig.padding < 0 || mConfig.extrusion < 0 ||
+    mConfig.maxPageSize + mConfig.padding > MAX_PACKING_AREA_SIZE)
+  {
+    throw std::invalid_argument("Invalid texture atlas configuration");
+  }
+}
+
+
+std::size_t TextureAtlasBuilder::add(Image image)
+{
+  // Checked upfront, so that a rejected image isn't kept alive
+  checkFitsIntoPage(image.view());
+
+  mOwnedImages.push_back(std::move(image));
+  return add(mOwnedImages.back().view());
+}
+
+
+std::size_t TextureAtlasBuilder::add(const ImageView& view)
+{
+  checkFitsIntoPage(view);
+
+  mSources.push_back(view);
+  return mSources.size() - 1;
+}
+
+
+void TextureAtlasBuilder::checkFitsIntoPage(const ImageView& view) const
+{
+  const auto maxSize =
+    std::size_t(mConfig.maxPageSize) - 2 * std::size_t(mConfig.extrusion);
+  if (
+    2 * mConfig.extrusion >= mConfig.maxPageSize || view.width() > maxSize ||
+    view.height() > maxSize)
+  {
+    throw std::invalid_argument("Image doesn't fit into a texture atlas page");
+  }
+}
+
+
+TextureAtlas TextureAtlasBuilder::build() const
+{
+  return build(nullptr);
+}
+
+
+TextureAtlas TextureAtlasBuilder::build(ThreadPool& threadPool) const
+{
+  return build(&threadPool);
+}
+
+
+TextureAtlas TextureAtlasBuilder::build(ThreadPool* pThreadPool) const
+{
+  const auto padding = mConfig.padding;
+  const auto extrusion = mConfig.extrusion;
+
+  // Padding is only needed in between images. Making the packing area
+  // bigger by the amount of padding allows images at the right/bottom edge
+  // to have their padding hang off the page.
+  const auto packingAreaSize = mConfig.maxPageSize + padding;
+
+  std::vector<stbrp_rect> remaining;
+  remaining.reserve(mSources.size());
+
+  for (std::size_t i = 0; i < mSources.size(); ++i)
+  {
+    stbrp_rect rect{};
+    rect.id = static_cast<int>(i);
+    rect.w = static_cast<stbrp_coord>(
+      mSources[i].width() + 2 * extrusion + padding);
+    rect.h = static_cast<stbrp_coord>(
+      mSources[i].height() + 2 * extrusion + padding);
+    remaining.push_back(rect);
+  }
+
+  TextureAtlas atlas;
+  atlas.locations.resize(mSources.size());
+
+  std::vector<std::future<Image>> pendingPages;
+  std::vector<stbrp_node> nodes(packingAreaSize);
+  auto numPages = std::size_t{0};
+
+  while (!remaining.empty())
+  {
+    stbrp_context context;
+    stbrp_init_target(
+      &context,
+      packingAreaSize,
+      packingAreaSize,
+      nodes.data(),
+      static_cast<int>(nodes.size()));
+    stbrp_pack_rects(&context, remaining.data(), int(remaining.size()));
+
+    const auto pageIndex = numPages++;
+
+    std::vector<Placement> placements;
+    std::vector<stbrp_rect> leftOver;
+    auto pageWidth = 0;
+    auto pageHeight = 0;
+
+    for (const auto& rect : remaining)
+    {
+      if (!rect.was_packed)
+      {
+        leftOver.push_back(rect);
+        continue;
+      }
+
+      const auto& source = mSources[rect.id];
+      const auto x = rect.x + extrusion;
+      const auto y = rect.y + extrusion;
+
+      placements.push_back(Placement{source, std::size_t(x), std::size_t(y)});
+      atlas.locations[rect.id] = TextureAtlas::Location{
+        pageIndex,
+        Rect<int>{{x, y}, {int(source.width()), int(source.height())}}};
+
+      pageWidth = std::max(pageWidth, rect.x + rect.w - padding);
+      pageHeight = std::max(pageHeight, rect.y + rect.h - padding);
+    }
+
+    if (placements.empty())
+    {
+      throw std::runtime_error("Failed to pack texture atlas");
+    }
+
+    auto fillThisPage = [placements = std::move(placements),
+                         width = std::size_t(pageWidth),
+                         height = std::size_t(pageHeight),
+                         extrusion]() {
+      return fillPage(width, height, placements, extrusion);
+    };
+
+    if (pThreadPool)
+    {
+      pendingPages.push_back(pThreadPool->submit(std::move(fillThisPage)));
+    }
+    else
+    {
+      atlas.pages.push_back(fillThisPage());
+    }
+
+    remaining = std::move(leftOver);
+  }
+
+  for (auto& pendingPage : pendingPages)
+  {
+    atlas.pages.push_back(pendingPage.get());
+  }
+
+  return atlas;
+}
+
+} // namespace rigel::base
@@ -0,0 +1,100 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/thread_pool.hpp"
+
+#include <algorithm>
+
+
+namespace rigel::base
+{
+
+std::size_t defaultNumWorkerThreads()
+{
+  // hardware_concurrency() is allowed to return 0 if the number of threads
+  // can't be determined.
+  const auto numHardwareThreads =
+    std::size_t{std::thread::hardware_concurrency()};
+  return numHardwareThreads > 1 ? numHardwareThreads - 1 : 1;
+}
+
+
+ThreadPool::ThreadPool(const std::size_t numThreads)
+{
+  const auto actualNumThreads = std::max(std::size_t{1}, numThreads);
+
+  mWorkers.reserve(actualNumThreads);
+  for (std::size_t i = 0; i < actualNumThreads; ++i)
+  {
+    mWorkers.emplace_back([this]() { runWorker(); });
+  }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock{mMutex};
+    mShuttingDown = true;
+  }
+
+  mTaskAvailable.notify_all();
+
+  for (auto& worker : mWorkers)
+  {
+    worker.join();
+  }
+}
+
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+  {
+    std::lock_guard lock{mMutex};
+    mTasks.push_back(std::move(task));
+  }
+
+  mTaskAvailable.notify_one();
+}
+
+
+void ThreadPool::runWorker()
+{
+  for (;;)
+  {
+    std::function<void()> task;
+
+    {
+      std::unique_lock lock{mMutex};
+      mTaskAvailable.wait(
+        lock, [this]() { return mShuttingDown || !mTasks.empty(); });
+
+      // Remaining tasks are still executed during shutdown, so that nobody
+      // is left waiting on a future that never becomes ready.
+      if (mTasks.empty())
+      {
+        return;
+      }
+
+      task = std::move(mTasks.front());
+      mTasks.pop_front();
+    }
+
+    task();
+  }
+}
+
+} // namespace rigel::base
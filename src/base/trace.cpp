@@ -0,0 +1,291 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "base/trace.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace rigel::base
+{
+
+namespace
+{
+
+constexpr auto EVENTS_PER_THREAD = std::size_t{1} << 16;
+
+
+// Fields are atomic so that writing a trace while other threads are still
+// recording is well-defined. Relaxed atomic stores compile down to plain
+// stores on common platforms, so this doesn't add overhead.
+struct TraceEvent
+{
+  std::atomic<const char*> mpName;
+  std::atomic<Clock::rep> mStart;
+  std::atomic<Clock::rep> mEnd;
+};
+
+
+struct EventCopy
+{
+  const char* mpName;
+  Clock::rep mStart;
+  Clock::rep mEnd;
+};
+
+
+/** Ring buffer of events recorded by a single thread */
+struct ThreadBuffer
+{
+  explicit ThreadBuffer(const std::size_t threadId)
+    : mThreadId(threadId)
+    , mpEvents(new TraceEvent[EVENTS_PER_THREAD])
+  {
+  }
+
+  const std::size_t mThreadId;
+
+  // Tracing session the events belong to, and total number of events
+  // written during that session. Both are only modified by the owning
+  // thread.
+  std::atomic<std::uint64_t> mSession{0};
+  std::atomic<std::uint64_t> mWriteCount{0};
+  std::unique_ptr<TraceEvent[]> mpEvents;
+};
+
+
+struct Registry
+{
+  std::mutex mMutex;
+
+  // Buffers are kept after their thread ends, so that its events can still
+  // be written out.
+  std::vector<std::shared_ptr<ThreadBuffer>> mBuffers;
+  Clock::time_point mStartTime;
+};
+
+
+// Incremented by startTracing(). Each thread discards the events in its own
+// buffer when it notices that a new session has started, since resetting
+// the buffers from another thread would race with recording.
+std::atomic<std::uint64_t> gCurrentSession{0};
+
+
+Registry& registry()
+{
+  static Registry instance;
+  return instance;
+}
+
+
+ThreadBuffer& threadBuffer()
+{
+  thread_local const auto pBuffer = []() {
+    auto& reg = registry();
+    std::lock_guard lock{reg.mMutex};
+
+    reg.mBuffers.push_back(
+      std::make_shared<ThreadBuffer>(reg.mBuffers.size() + 1));
+    return reg.mBuffers.back();
+  }();
+
+  return *pBuffer;
+}
+
+
+std::vector<EventCopy>
+  copyEvents(const ThreadBuffer& buffer, const std::uint64_t session)
+{
+  // The owning thread resets the write count before publishing the new
+  // session, so once the current session is visible here, the write count
+  // belongs to it. Buffers of threads that haven't recorded anything during
+  // the current session only hold stale events.
+  if (buffer.mSession.load(std::memory_order_acquire) != session)
+  {
+    return {};
+  }
+
+  const auto oldestIndex = [](const std::uint64_t writeCount) {
+    return writeCount > EVENTS_PER_THREAD ? writeCount - EVENTS_PER_THREAD
+                                          : std::uint64_t{0};
+  };
+
+  const auto writeCount = buffer.mWriteCount.load(std::memory_order_acquire);
+
+  std::vector<EventCopy> events;
+  events.reserve(std::size_t(writeCount - oldestIndex(writeCount)));
+
+  for (auto i = oldestIndex(writeCount); i < writeCount; ++i)
+  {
+    const auto& event = buffer.mpEvents[i % EVENTS_PER_THREAD];
+    events.push_back(EventCopy{
+      event.mpName.load(std::memory_order_relaxed),
+      event.mStart.load(std::memory_order_relaxed),
+      event.mEnd.load(std::memory_order_relaxed)});
+  }
+
+  // Events overwritten while copying are unreliable, and need to be dropped.
+  // That includes the one which might currently be in the process of being
+  // written, which occupies the slot of the oldest remaining event.
+  const auto newWriteCount =
+    buffer.mWriteCount.load(std::memory_order_acquire);
+  const auto firstValid = std::max(
+    oldestIndex(writeCount), oldestIndex(newWriteCount + 1));
+  const auto numInvalid =
+    std::size_t(std::min(firstValid, writeCount) - oldestIndex(writeCount));
+
+  events.erase(events.begin(), events.begin() + numInvalid);
+  return events;
+}
+
+
+void writeJsonString(std::ostream& stream, const char* str)
+{
+  stream << '"';
+
+  for (auto pChar = str; *pChar; ++pChar)
+  {
+    const auto c = *pChar;
+    if (c == '"' || c == '\\')
+    {
+      stream << '\\' << c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      stream << escaped;
+    }
+    else
+    {
+      stream << c;
+    }
+  }
+
+  stream << '"';
+}
+
+} // namespace
+
+
+void detail::recordTraceEvent(
+  const char* name,
+  const Clock::time_point start,
+  const Clock::time_point end)
+{
+  auto& buffer = threadBuffer();
+
+  const auto session = gCurrentSession.load(std::memory_order_relaxed);
+  if (buffer.mSession.load(std::memory_order_relaxed) != session)
+  {
+    buffer.mWriteCount.store(0, std::memory_order_relaxed);
+    buffer.mSession.store(session, std::memory_order_release);
+  }
+
+  const auto index = buffer.mWriteCount.load(std::memory_order_relaxed);
+  auto& event = buffer.mpEvents[index % EVENTS_PER_THREAD];
+  event.mpName.store(name, std::memory_order_relaxed);
+  event.mStart.store(
+    start.time_since_epoch().count(), std::memory_order_relaxed);
+  event.mEnd.store(end.time_since_epoch().count(), std::memory_order_relaxed);
+
+  buffer.mWriteCount.store(index + 1, std::memory_order_release);
+}
+
+
+void startTracing()
+{
+  auto& reg = registry();
+
+  {
+    std::lock_guard lock{reg.mMutex};
+    gCurrentSession.fetch_add(1, std::memory_order_relaxed);
+    reg.mStartTime = Clock::now();
+  }
+
+  detail::tracingEnabled.store(true, std::memory_order_relaxed);
+}
+
+
+void stopTracing()
+{
+  detail::tracingEnabled.store(false, std::memory_order_relaxed);
+}
+
+
+void writeChromeTrace(std::ostream& stream)
+{
+  auto& reg = registry();
+  std::lock_guard lock{reg.mMutex};
+
+  const auto toMicroseconds = [](const Clock::rep ticks) {
+    return std::chrono::duration<double, std::micro>(Clock::duration{ticks})
+      .count();
+  };
+  const auto startTime = reg.mStartTime.time_since_epoch().count();
+  const auto session = gCurrentSession.load(std::memory_order_relaxed);
+
+  stream << "{\"traceEvents\":[";
+
+  auto isFirst = true;
+  for (const auto& pBuffer : reg.mBuffers)
+  {
+    for (const auto& event : copyEvents(*pBuffer, session))
+    {
+      stream << (isFirst ? "\n" : ",\n");
+      isFirst = false;
+
+      // Stream formatting would switch to scientific notation for large
+      // values, which loses precision.
+      char times[64];
+      std::snprintf(
+        times,
+        sizeof(times),
+        "\"ts\":%.3f,\"dur\":%.3f",
+        toMicroseconds(event.mStart - startTime),
+        toMicroseconds(event.mEnd - event.mStart));
+
+      stream << "{\"name\":";
+      writeJsonString(stream, event.mpName);
+      stream << ",\"ph\":\"X\"," << times
+             << ",\"pid\":1,\"tid\":" << pBuffer->mThreadId << '}';
+    }
+  }
+
+  stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+
+bool saveChromeTrace(const std::filesystem::path& path)
+{
+  std::ofstream file(path);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  writeChromeTrace(file);
+  return file.good();
+}
+
+} // namespace rigel::base
@@ -16,8 +16,13 @@
 
 #include "bootstrap.hpp"
 
+#include "base/command_list.hpp"
+#include "base/frame_statistics.hpp"
+#include "base/handoff_queue.hpp"
+#include "base/trace.hpp"
 #include "base/warnings.hpp"
 #include "opengl/opengl.hpp"
+#include "opengl/state_cache.hpp"
 #include "sdl_utils/error.hpp"
 #include "sdl_utils/ptr.hpp"
 #include "ui/imgui_integration.hpp"
@@ -27,6 +32,13 @@ RIGEL_DISABLE_WARNINGS
 #include <lyra/help.hpp>
 RIGEL_RESTORE_WARNINGS
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 
 #ifdef _WIN32
 
@@ -105,6 +117,12 @@ constexpr auto FULLSCREEN_FLAG = SDL_WINDOW_FULLSCREEN_DESKTOP;
 #endif
 
 
+bool isVsyncEnabled(const WindowConfig& config)
+{
+  return config.enableVsync && !config.headless;
+}
+
+
 void setGLAttributes(const WindowConfig& config)
 {
 #ifdef RIGEL_USE_GL_ES
@@ -129,6 +147,7 @@ void setGLAttributes(const WindowConfig& config)
 sdl_utils::Ptr<SDL_Window> createWindow(const WindowConfig& config)
 {
   LOG_SCOPE_FUNCTION(INFO);
+  RIGEL_TRACE_SCOPE("createWindow");
 
   LOG_F(INFO, "Querying current screen resolution");
 
@@ -137,16 +156,19 @@ sdl_utils::Ptr<SDL_Window> createWindow(const WindowConfig& config)
 
   LOG_F(INFO, "Screen resolution is %dx%d", displayMode.w, displayMode.h);
 
+  const auto fullscreen = config.fullscreen && !config.headless;
+
   // clang-format off
   const auto windowFlags =
     SDL_WINDOW_RESIZABLE |
     SDL_WINDOW_ALLOW_HIGHDPI |
     SDL_WINDOW_OPENGL |
-    (config.fullscreen ? FULLSCREEN_FLAG : 0);
+    (fullscreen ? FULLSCREEN_FLAG : 0) |
+    (config.headless ? SDL_WINDOW_HIDDEN : 0);
   // clang-format on
 
   const auto width = [&]() {
-    if (config.fullscreen)
+    if (fullscreen)
     {
       return displayMode.w;
     }
@@ -159,7 +181,7 @@ sdl_utils::Ptr<SDL_Window> createWindow(const WindowConfig& config)
     return config.windowWidth;
   }();
   const auto height = [&]() {
-    if (config.fullscreen)
+    if (fullscreen)
     {
       return displayMode.h;
     }
@@ -175,7 +197,9 @@ sdl_utils::Ptr<SDL_Window> createWindow(const WindowConfig& config)
   LOG_F(
     INFO,
     "Creating window in %s mode, size: %dx%d",
-    config.fullscreen ? "fullscreen" : "windowed",
+    config.headless ? "headless"
+    : fullscreen    ? "fullscreen"
+                    : "windowed",
     width,
     height);
   auto pWindow = sdl_utils::wrap(sdl_utils::check(SDL_CreateWindow(
@@ -219,19 +243,287 @@ void loadGameControllerDbForOldSdl()
 }
 
 
-void showErrorBox(const char* message)
+void showErrorBox(const WindowConfig& config, const char* message)
+{
+  if (!config.headless)
+  {
+    SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", message, nullptr);
+  }
+}
+
+
+void setSwapInterval(const WindowConfig& config)
 {
-  SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", message, nullptr);
+  if (!isVsyncEnabled(config))
+  {
+    SDL_GL_SetSwapInterval(0);
+    return;
+  }
+
+  // -1 requests adaptive vsync, which fails if it's not supported
+  if (config.adaptiveVsync && SDL_GL_SetSwapInterval(-1) == 0)
+  {
+    LOG_F(INFO, "Using adaptive vsync");
+    return;
+  }
+
+  SDL_GL_SetSwapInterval(1);
+}
+
+
+base::FrameSchedulerConfig withExpectedFps(
+  base::FrameSchedulerConfig schedulerConfig,
+  const WindowConfig& config,
+  SDL_Window* pWindow)
+{
+  if (
+    isVsyncEnabled(config) && schedulerConfig.maxFps == 0.0 &&
+    schedulerConfig.expectedFps == 0.0)
+  {
+    SDL_DisplayMode displayMode;
+    if (
+      SDL_GetWindowDisplayMode(pWindow, &displayMode) == 0 &&
+      displayMode.refresh_rate > 0)
+    {
+      schedulerConfig.expectedFps = displayMode.refresh_rate;
+    }
+  }
+
+  return schedulerConfig;
+}
+
+
+void reportFrameTimes(
+  const HeadlessConfig& headlessConfig,
+  const std::vector<double>& frameTimes)
+{
+  const auto summary = base::summarizeFrameTimes(frameTimes);
+  LOG_F(
+    INFO,
+    "Frame times: min %.2f ms, median %.2f ms, p99 %.2f ms, max %.2f ms",
+    summary.min * 1000.0,
+    summary.median * 1000.0,
+    summary.p99 * 1000.0,
+    summary.max * 1000.0);
+
+  const auto& path = headlessConfig.frameTimesFile;
+  if (!path.empty() && !base::saveFrameTimesJson(path, frameTimes))
+  {
+    throw std::runtime_error(
+      "Failed to write frame times to " + path.u8string());
+  }
+}
+
+
+std::size_t numFramesToRun(const WindowConfig& config)
+{
+  return config.headless ? std::size_t(std::max(config.headless->numFrames, 0))
+                         : std::size_t{0};
+}
+
+
+double secondsSince(const base::Clock::time_point start)
+{
+  return std::chrono::duration<double>(base::Clock::now() - start).count();
+}
+
+
+/** Runs the main loop, returns frame times when running headless */
+using MainLoopFunc = std::function<std::vector<double>(
+  SDL_Window*,
+  SDL_GLContext,
+  base::FrameScheduler&)>;
+
+
+std::vector<double> runSingleThreadedLoop(
+  const WindowConfig& config,
+  SDL_Window* pWindow,
+  base::FrameScheduler& scheduler,
+  const TimedFrameFunc& runFrameFunc)
+{
+  const auto numFrames = numFramesToRun(config);
+
+  std::vector<double> frameTimes;
+  frameTimes.reserve(numFrames);
+
+  for (;;)
+  {
+    if (numFrames != 0 && frameTimes.size() == numFrames)
+    {
+      break;
+    }
+
+    if (
+      config.maxIdleWaitTime && !config.headless &&
+      ui::imgui_integration::isIdle())
+    {
+      RIGEL_TRACE_SCOPE("Idle wait");
+
+      // The event stays in the queue, to be handled by the frame function
+      SDL_WaitEventTimeout(
+        nullptr, static_cast<int>(*config.maxIdleWaitTime * 1000.0));
+      scheduler.onIdleWait();
+    }
+
+    const auto timing = scheduler.beginFrame();
+
+    RIGEL_TRACE_SCOPE("Frame");
+
+    const auto frameStart = base::Clock::now();
+
+    if (!runFrameFunc(pWindow, timing))
+    {
+      break;
+    }
+
+    if (config.headless)
+    {
+      glFinish();
+      frameTimes.push_back(secondsSince(frameStart));
+    }
+  }
+
+  return frameTimes;
+}
+
+
+std::vector<double> runRenderThreadLoop(
+  const WindowConfig& config,
+  const RenderThreadConfig& renderThreadConfig,
+  SDL_Window* pWindow,
+  SDL_GLContext pGlContext,
+  base::FrameScheduler& scheduler,
+  const RecordFrameFunc& recordFrameFunc)
+{
+  const auto numFrames = numFramesToRun(config);
+
+  std::vector<double> frameTimes;
+  frameTimes.reserve(numFrames);
+
+  base::HandoffQueue<base::CommandList> queue{
+    renderThreadConfig.numCommandLists};
+  std::exception_ptr pRenderThreadError;
+
+  // A GL context can only be current on one thread at a time
+  sdl_utils::check(SDL_GL_MakeCurrent(pWindow, nullptr));
+
+  std::thread renderThread{[&]() {
+    try
+    {
+      sdl_utils::check(SDL_GL_MakeCurrent(pWindow, pGlContext));
+
+      // The state cache is per thread, and this thread's copy doesn't know
+      // about the state changes made by initFunc on the main thread
+      opengl::glStateCache().invalidate();
+
+      while (const auto pCommands = queue.beginRead())
+      {
+        {
+          RIGEL_TRACE_SCOPE("Render");
+          pCommands->execute();
+        }
+
+        // Hand back the command list before swapping, so that the main
+        // thread can start recording into it while we wait for vsync
+        queue.endRead();
+
+        RIGEL_TRACE_SCOPE("Swap");
+        SDL_GL_SwapWindow(pWindow);
+      }
+
+      if (config.headless)
+      {
+        glFinish();
+      }
+    }
+    catch (...)
+    {
+      pRenderThreadError = std::current_exception();
+    }
+
+    queue.close();
+    SDL_GL_MakeCurrent(pWindow, nullptr);
+  }};
+
+  {
+    // Lets the render thread finish the remaining frames, also when leaving
+    // via exception
+    auto renderThreadGuard = base::defer([&]() {
+      queue.close();
+      if (renderThread.joinable())
+      {
+        renderThread.join();
+      }
+
+      SDL_GL_MakeCurrent(pWindow, pGlContext);
+      opengl::glStateCache().invalidate();
+    });
+
+    std::optional<base::Clock::time_point> lastFrameStart;
+    auto numFramesRecorded = std::size_t{0};
+
+    for (;;)
+    {
+      if (numFrames != 0 && numFramesRecorded == numFrames)
+      {
+        break;
+      }
+
+      const auto timing = scheduler.beginFrame();
+
+      RIGEL_TRACE_SCOPE("Frame");
+
+      if (config.headless && lastFrameStart)
+      {
+        frameTimes.push_back(secondsSince(*lastFrameStart));
+      }
+      lastFrameStart = base::Clock::now();
+
+      const auto pCommands = queue.beginWrite();
+      if (!pCommands)
+      {
+        // Render thread has stopped due to an error
+        break;
+      }
+
+      const auto keepRunning = recordFrameFunc(pWindow, timing, *pCommands);
+      queue.endWrite();
+      ++numFramesRecorded;
+
+      if (!keepRunning)
+      {
+        break;
+      }
+    }
+
+    // The last frame is complete once the render thread is done with it
+    if (config.headless && lastFrameStart)
+    {
+      queue.close();
+      renderThread.join();
+      frameTimes.push_back(secondsSince(*lastFrameStart));
+    }
+  }
+
+  if (pRenderThreadError)
+  {
+    std::rethrow_exception(pRenderThreadError);
+  }
+
+  return frameTimes;
 }
 
 
 void runAppUnguarded(
   const WindowConfig& config,
+  const base::FrameSchedulerConfig& schedulerConfig,
   std::function<void(SDL_Window*)> initFunc,
-  std::function<bool(SDL_Window*)> runFrameFunc)
+  const MainLoopFunc& runMainLoop)
 {
   using base::defer;
 
+  RIGEL_TRACE_SCOPE("runApp");
+
   sdl_utils::check(SDL_GL_LoadLibrary(nullptr));
 
   setGLAttributes(config);
@@ -245,35 +537,93 @@ void runAppUnguarded(
   LOG_F(INFO, "Loading OpenGL function pointers");
   opengl::loadGlFunctions();
 
-  // On some platforms, an initial swap is necessary in order for the next
-  // frame to show up on screen.
-  SDL_GL_SetSwapInterval(config.enableVsync ? 1 : 0);
-  SDL_GL_SwapWindow(pWindow.get());
+  setSwapInterval(config);
 
-  SDL_DisableScreenSaver();
-  SDL_ShowCursor(SDL_DISABLE);
+  if (!config.headless)
+  {
+    // On some platforms, an initial swap is necessary in order for the next
+    // frame to show up on screen.
+    SDL_GL_SwapWindow(pWindow.get());
+
+    SDL_DisableScreenSaver();
+    SDL_ShowCursor(SDL_DISABLE);
+  }
 
   LOG_F(INFO, "Initializing Dear ImGui");
-  ui::imgui_integration::init(pWindow.get(), pGlContext, {});
+  ui::imgui_integration::init(
+    pWindow.get(), pGlContext, {}, config.cacheDirectory);
   auto imGuiGuard = defer([]() { ui::imgui_integration::shutdown(); });
 
-  initFunc(pWindow.get());
+  {
+    RIGEL_TRACE_SCOPE("initFunc");
+    initFunc(pWindow.get());
+  }
 
-  while (runFrameFunc(pWindow.get()))
+  base::FrameScheduler scheduler{
+    withExpectedFps(schedulerConfig, config, pWindow.get())};
+
+  const auto frameTimes = runMainLoop(pWindow.get(), pGlContext, scheduler);
+
+  const auto& stats = scheduler.stats();
+  LOG_F(
+    INFO,
+    "%llu frames, %llu late, worst lateness %.2f ms",
+    static_cast<unsigned long long>(stats.numFrames),
+    static_cast<unsigned long long>(stats.numLateFrames),
+    stats.worstLateness * 1000.0);
+
+  if (config.headless)
   {
-    //
+    reportFrameTimes(*config.headless, frameTimes);
   }
 
   LOG_F(INFO, "Exiting");
 }
 
+
+template <typename Func>
+int runGuarded(const WindowConfig& config, Func&& func)
+{
+  try
+  {
+    std::optional<base::ScopeGuard> sdlGuard;
+
+    if (!SDL_WasInit(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER))
+    {
+      sdlGuard.emplace(initSdl(config.headless.has_value()));
+    }
+
+    func();
+    return 0;
+  }
+  catch (const std::exception& ex)
+  {
+    LOG_F(ERROR, "%s", ex.what());
+    showErrorBox(config, ex.what());
+    return -2;
+  }
+  catch (...)
+  {
+    LOG_F(ERROR, "Unknown error");
+    showErrorBox(config, "Unknown error");
+    return -3;
+  }
+}
+
 } // namespace
 
 
-[[nodiscard]] base::ScopeGuard initSdl()
+[[nodiscard]] base::ScopeGuard initSdl(const bool headless)
 {
   using base::defer;
 
+  if (headless)
+  {
+    // Don't overwrite existing values, to allow choosing a different driver
+    SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+  }
+
   enableDpiAwareness();
   loadGameControllerDbForOldSdl();
 
@@ -306,30 +656,60 @@ int runApp(
   std::function<void(SDL_Window*)> initFunc,
   std::function<bool(SDL_Window*)> runFrameFunc)
 {
-  try
-  {
-    std::optional<base::ScopeGuard> sdlGuard;
+  return runApp(
+    config,
+    {},
+    std::move(initFunc),
+    [runFrameFunc = std::move(runFrameFunc)](
+      SDL_Window* pWindow, const base::FrameTiming&) {
+      return runFrameFunc(pWindow);
+    });
+}
 
-    if (!SDL_WasInit(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER))
-    {
-      sdlGuard.emplace(initSdl());
-    }
 
-    runAppUnguarded(config, std::move(initFunc), std::move(runFrameFunc));
-    return 0;
-  }
-  catch (const std::exception& ex)
-  {
-    LOG_F(ERROR, "%s", ex.what());
-    showErrorBox(ex.what());
-    return -2;
-  }
-  catch (...)
-  {
-    LOG_F(ERROR, "Unknown error");
-    showErrorBox("Unknown error");
-    return -3;
-  }
+int runApp(
+  const WindowConfig& config,
+  const base::FrameSchedulerConfig& schedulerConfig,
+  std::function<void(SDL_Window*)> initFunc,
+  TimedFrameFunc runFrameFunc)
+{
+  return runGuarded(config, [&]() {
+    runAppUnguarded(
+      config,
+      schedulerConfig,
+      std::move(initFunc),
+      [&](SDL_Window* pWindow, SDL_GLContext, base::FrameScheduler& scheduler) {
+        return runSingleThreadedLoop(config, pWindow, scheduler, runFrameFunc);
+      });
+  });
+}
+
+
+int runAppWithRenderThread(
+  const WindowConfig& config,
+  const base::FrameSchedulerConfig& schedulerConfig,
+  const RenderThreadConfig& renderThreadConfig,
+  std::function<void(SDL_Window*)> initFunc,
+  RecordFrameFunc recordFrameFunc)
+{
+  return runGuarded(config, [&]() {
+    runAppUnguarded(
+      config,
+      schedulerConfig,
+      std::move(initFunc),
+      [&](
+        SDL_Window* pWindow,
+        SDL_GLContext pGlContext,
+        base::FrameScheduler& scheduler) {
+        return runRenderThreadLoop(
+          config,
+          renderThreadConfig,
+          pWindow,
+          pGlContext,
+          scheduler,
+          recordFrameFunc);
+      });
+  });
 }
 
 
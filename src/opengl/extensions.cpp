@@ -0,0 +1,63 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "opengl/extensions.hpp"
+
+
+namespace rigel::opengl::detail
+{
+
+namespace
+{
+
+using MaxShaderCompilerThreadsFunc = void(KHRONOS_APIENTRY*)(GLuint count);
+
+
+void setMaxShaderCompilerThreads(const char* functionName)
+{
+  // 0xFFFFFFFF means no limit, i.e. let the driver decide
+  if (
+    const auto pMaxThreads =
+      loadFunction<MaxShaderCompilerThreadsFunc>(functionName))
+  {
+    pMaxThreads(0xFFFFFFFF);
+  }
+}
+
+} // namespace
+
+
+bool enableParallelShaderCompile()
+{
+  if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile"))
+  {
+    setMaxShaderCompilerThreads("glMaxShaderCompilerThreadsKHR");
+    return true;
+  }
+
+#ifndef RIGEL_USE_GL_ES
+  if (SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile"))
+  {
+    setMaxShaderCompilerThreads("glMaxShaderCompilerThreadsARB");
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+} // namespace rigel::opengl::detail
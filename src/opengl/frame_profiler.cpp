@@ -0,0 +1,290 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "opengl/frame_profiler.hpp"
+
+#include <initializer_list>
+#include <stdexcept>
+
+
+namespace rigel::opengl
+{
+
+namespace
+{
+
+const auto FRAME_SCOPE_NAME = "Frame";
+
+
+double toSeconds(const base::Clock::duration duration)
+{
+  return std::chrono::duration<double>(duration).count();
+}
+
+
+bool timerQueriesSupported()
+{
+#ifdef RIGEL_USE_GL_ES
+  return false;
+#else
+  return GLAD_GL_ARB_timer_query != 0;
+#endif
+}
+
+} // namespace
+
+
+FrameProfiler::FrameProfiler(const bool enableGpuTiming)
+  : mGpuTimingEnabled(enableGpuTiming && timerQueriesSupported())
+{
+}
+
+
+FrameProfiler::~FrameProfiler()
+{
+#ifndef RIGEL_USE_GL_ES
+  if (!mGpuTimingEnabled)
+  {
+    return;
+  }
+
+  const auto deleteQueries = [](const PendingFrame& frame) {
+    for (const auto& scope : frame.mScopes)
+    {
+      glDeleteQueries(1, &scope.mStartQuery);
+      glDeleteQueries(1, &scope.mEndQuery);
+    }
+  };
+
+  for (const auto& frame : mPendingFrames)
+  {
+    deleteQueries(frame);
+  }
+
+  if (mCurrentFrame)
+  {
+    deleteQueries(*mCurrentFrame);
+  }
+
+  glDeleteQueries(GLsizei(mFreeQueries.size()), mFreeQueries.data());
+#endif
+}
+
+
+void FrameProfiler::beginFrame()
+{
+  if (mCurrentFrame)
+  {
+    throw std::runtime_error("FrameProfiler: Previous frame not ended");
+  }
+
+  const auto now = base::Clock::now();
+
+  mCurrentFrame.emplace();
+  mCurrentFrame->mHasGpuQueries =
+    mGpuTimingEnabled && mPendingFrames.size() < MAX_PENDING_FRAMES;
+
+  if (mLastFrameStart)
+  {
+    mCurrentFrame->mTotalElapsed = toSeconds(now - *mLastFrameStart);
+  }
+
+  mLastFrameStart = now;
+
+  beginScope(FRAME_SCOPE_NAME);
+}
+
+
+void FrameProfiler::endFrame()
+{
+  if (!mCurrentFrame)
+  {
+    throw std::runtime_error("FrameProfiler: Frame not started");
+  }
+
+  if (mOpenScopes.size() != 1)
+  {
+    // Discard the frame, so that the next one can start normally
+    discardCurrentFrame();
+    throw std::runtime_error("FrameProfiler: Unbalanced scopes");
+  }
+
+  endScope();
+
+  mPendingFrames.push_back(std::move(*mCurrentFrame));
+  mCurrentFrame.reset();
+
+  collectResults();
+}
+
+
+void FrameProfiler::beginScope(const char* name)
+{
+  if (!mCurrentFrame)
+  {
+    return;
+  }
+
+  auto& scopes = mCurrentFrame->mScopes;
+  mOpenScopes.push_back(scopes.size());
+
+  // The frame scope itself doesn't count towards nesting depth
+  const auto depth = int(mOpenScopes.size()) - 2;
+  const auto startQuery =
+    mCurrentFrame->mHasGpuQueries ? issueTimestampQuery() : 0;
+
+  scopes.push_back(
+    PendingScope{name, depth, base::Clock::now(), {}, startQuery, 0});
+}
+
+
+void FrameProfiler::endScope()
+{
+  if (!mCurrentFrame || mOpenScopes.empty())
+  {
+    return;
+  }
+
+  auto& scope = mCurrentFrame->mScopes[mOpenScopes.back()];
+  mOpenScopes.pop_back();
+
+  scope.mCpuEnd = base::Clock::now();
+  if (mCurrentFrame->mHasGpuQueries)
+  {
+    scope.mEndQuery = issueTimestampQuery();
+  }
+}
+
+
+base::ScopeGuard FrameProfiler::scope(const char* name)
+{
+  beginScope(name);
+  return base::defer([this]() { endScope(); });
+}
+
+
+void FrameProfiler::discardCurrentFrame()
+{
+  for (const auto& scope : mCurrentFrame->mScopes)
+  {
+    for (const auto query : {scope.mStartQuery, scope.mEndQuery})
+    {
+      if (query != 0)
+      {
+        mFreeQueries.push_back(query);
+      }
+    }
+  }
+
+  mCurrentFrame.reset();
+  mOpenScopes.clear();
+}
+
+
+GLuint FrameProfiler::issueTimestampQuery()
+{
+  GLuint query = 0;
+
+#ifndef RIGEL_USE_GL_ES
+  if (mFreeQueries.empty())
+  {
+    glGenQueries(1, &query);
+  }
+  else
+  {
+    query = mFreeQueries.back();
+    mFreeQueries.pop_back();
+  }
+
+  glQueryCounter(query, GL_TIMESTAMP);
+#endif
+
+  return query;
+}
+
+
+void FrameProfiler::collectResults()
+{
+  // Frames are completed by the GPU in order, so there's no need to look
+  // further once a frame's results aren't available yet.
+  while (!mPendingFrames.empty() && resultsAvailable(mPendingFrames.front()))
+  {
+    publish(mPendingFrames.front());
+    mPendingFrames.pop_front();
+  }
+}
+
+
+bool FrameProfiler::resultsAvailable(const PendingFrame& frame) const
+{
+  if (!frame.mHasGpuQueries)
+  {
+    return true;
+  }
+
+#ifdef RIGEL_USE_GL_ES
+  return true;
+#else
+  // The frame scope's end query is the last one issued for the frame
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(
+    frame.mScopes.front().mEndQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+  return available != GL_FALSE;
+#endif
+}
+
+
+void FrameProfiler::publish(PendingFrame& frame)
+{
+  const auto readGpuTime = [&]([[maybe_unused]] const PendingScope& scope) {
+#ifdef RIGEL_USE_GL_ES
+    return std::optional<double>{};
+#else
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(scope.mStartQuery, GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(scope.mEndQuery, GL_QUERY_RESULT, &end);
+
+    mFreeQueries.push_back(scope.mStartQuery);
+    mFreeQueries.push_back(scope.mEndQuery);
+
+    return std::optional<double>{double(end - start) / 1.0e9};
+#endif
+  };
+
+  const auto timeScope = [&](const PendingScope& scope) {
+    return ProfileScopeTiming{
+      scope.mpName,
+      scope.mDepth,
+      toSeconds(scope.mCpuEnd - scope.mCpuStart),
+      frame.mHasGpuQueries ? readGpuTime(scope) : std::nullopt};
+  };
+
+  const auto frameTiming = timeScope(frame.mScopes.front());
+
+  mLatestTimings.totalElapsed = frame.mTotalElapsed;
+  mLatestTimings.cpuTime = frameTiming.cpuTime;
+  mLatestTimings.gpuTime = frameTiming.gpuTime;
+
+  mLatestTimings.scopes.clear();
+  for (auto i = std::size_t{1}; i < frame.mScopes.size(); ++i)
+  {
+    mLatestTimings.scopes.push_back(timeScope(frame.mScopes[i]));
+  }
+}
+
+} // namespace rigel::opengl
@@ -0,0 +1,120 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "opengl/gl_handle.hpp"
+
+#include "opengl/state_cache.hpp"
+
+
+namespace rigel::opengl::detail
+{
+
+void TexturePolicy::create(const GLsizei count, GLuint* pHandles)
+{
+  glGenTextures(count, pHandles);
+}
+
+
+void TexturePolicy::destroy(const GLsizei count, const GLuint* pHandles)
+{
+  for (GLsizei i = 0; i < count; ++i)
+  {
+    glStateCache().onTextureDeleted(pHandles[i]);
+  }
+
+  glDeleteTextures(count, pHandles);
+}
+
+
+void BufferPolicy::create(const GLsizei count, GLuint* pHandles)
+{
+  glGenBuffers(count, pHandles);
+}
+
+
+void BufferPolicy::destroy(const GLsizei count, const GLuint* pHandles)
+{
+  for (GLsizei i = 0; i < count; ++i)
+  {
+    glStateCache().onBufferDeleted(pHandles[i]);
+  }
+
+  glDeleteBuffers(count, pHandles);
+}
+
+
+#ifndef RIGEL_USE_GL_ES
+void VertexArrayPolicy::create(const GLsizei count, GLuint* pHandles)
+{
+  glGenVertexArrays(count, pHandles);
+}
+
+
+void VertexArrayPolicy::destroy(const GLsizei count, const GLuint* pHandles)
+{
+  for (GLsizei i = 0; i < count; ++i)
+  {
+    glStateCache().onVertexArrayDeleted(pHandles[i]);
+  }
+
+  glDeleteVertexArrays(count, pHandles);
+}
+#endif
+
+
+void FramebufferPolicy::create(const GLsizei count, GLuint* pHandles)
+{
+  glGenFramebuffers(count, pHandles);
+}
+
+
+void FramebufferPolicy::destroy(const GLsizei count, const GLuint* pHandles)
+{
+  glDeleteFramebuffers(count, pHandles);
+}
+
+
+void RenderbufferPolicy::create(const GLsizei count, GLuint* pHandles)
+{
+  glGenRenderbuffers(count, pHandles);
+}
+
+
+void RenderbufferPolicy::destroy(const GLsizei count, const GLuint* pHandles)
+{
+  glDeleteRenderbuffers(count, pHandles);
+}
+
+
+void ShaderObjectPolicy::destroy(const GLsizei count, const GLuint* pHandles)
+{
+  for (GLsizei i = 0; i < count; ++i)
+  {
+    glDeleteShader(pHandles[i]);
+  }
+}
+
+
+void ProgramPolicy::destroy(const GLsizei count, const GLuint* pHandles)
+{
+  for (GLsizei i = 0; i < count; ++i)
+  {
+    glDeleteProgram(pHandles[i]);
+  }
+}
+
+} // namespace rigel::opengl::detail
@@ -0,0 +1,421 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "opengl/render_target.hpp"
+
+#include "opengl/extensions.hpp"
+#include "opengl/state_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+
+namespace rigel::opengl
+{
+
+namespace
+{
+
+#ifdef RIGEL_USE_GL_ES
+constexpr auto DEPTH_BUFFER_FORMAT = GLenum{GL_DEPTH_COMPONENT16};
+#else
+constexpr auto DEPTH_BUFFER_FORMAT = GLenum{GL_DEPTH_COMPONENT24};
+
+// Without sync objects, readbacks are assumed to be complete after this many
+// frames
+constexpr auto FRAMES_UNTIL_READBACK_COMPLETE = std::size_t{3};
+
+constexpr auto MAX_FREE_STAGING_BUFFERS = std::size_t{4};
+#endif
+
+
+RenderbufferHandle createDepthBuffer(
+  const std::size_t width,
+  const std::size_t height,
+  const RenderTargetFormat format)
+{
+  if (format != RenderTargetFormat::Rgba8WithDepth)
+  {
+    return {};
+  }
+
+  auto depthBuffer = RenderbufferHandle::generate();
+
+  glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer.mHandle);
+  glRenderbufferStorage(
+    GL_RENDERBUFFER, DEPTH_BUFFER_FORMAT, GLsizei(width), GLsizei(height));
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  return depthBuffer;
+}
+
+
+FramebufferHandle
+  createFramebuffer(const GLuint texture, const GLuint depthBuffer)
+{
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+  auto framebuffer = FramebufferHandle::generate();
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.mHandle);
+  glFramebufferTexture2D(
+    GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+  if (depthBuffer)
+  {
+    glFramebufferRenderbuffer(
+      GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+  }
+
+  const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previousFramebuffer));
+
+  if (status != GL_FRAMEBUFFER_COMPLETE)
+  {
+    throw std::runtime_error("Failed to create render target");
+  }
+
+  return framebuffer;
+}
+
+} // namespace
+
+
+RenderTarget::RenderTarget(
+  const std::size_t width,
+  const std::size_t height,
+  const RenderTargetFormat format,
+  const TextureFilter filter)
+  : mTexture(width, height, filter)
+  , mDepthBuffer(createDepthBuffer(width, height, format))
+  , mFramebuffer(createFramebuffer(mTexture.handle(), mDepthBuffer.mHandle))
+  , mFormat(format)
+{
+}
+
+
+base::ScopeGuard RenderTarget::bind() const
+{
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer.mHandle);
+  glStateCache().setViewport(0, 0, GLsizei(width()), GLsizei(height()));
+
+  return base::defer([previousFramebuffer]() {
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previousFramebuffer));
+  });
+}
+
+
+RenderTargetPool::RenderTargetPool(RenderTargetPoolConfig config)
+  : mConfig(config)
+{
+}
+
+
+RenderTarget& RenderTargetPool::acquire(
+  const std::size_t width,
+  const std::size_t height,
+  const RenderTargetFormat format)
+{
+  const auto iEntry =
+    std::find_if(mEntries.begin(), mEntries.end(), [&](const Entry& entry) {
+      return !entry.mIsInUse && entry.mpTarget->width() == width &&
+        entry.mpTarget->height() == height &&
+        entry.mpTarget->format() == format;
+    });
+
+  if (iEntry != mEntries.end())
+  {
+    iEntry->mIsInUse = true;
+    iEntry->mLastUsedFrame = mCurrentFrame;
+    return *iEntry->mpTarget;
+  }
+
+  mEntries.push_back(Entry{
+    std::make_unique<RenderTarget>(width, height, format),
+    mCurrentFrame,
+    true});
+  return *mEntries.back().mpTarget;
+}
+
+
+void RenderTargetPool::endFrame()
+{
+  const auto isExpired = [this](const Entry& entry) {
+    if (mWindowSizeChanged && entry.mLastUsedFrame != mCurrentFrame)
+    {
+      return true;
+    }
+
+    return mCurrentFrame - entry.mLastUsedFrame > mConfig.maxUnusedFrames;
+  };
+
+  mEntries.erase(
+    std::remove_if(mEntries.begin(), mEntries.end(), isExpired),
+    mEntries.end());
+
+  for (auto& entry : mEntries)
+  {
+    entry.mIsInUse = false;
+  }
+
+  mWindowSizeChanged = false;
+  ++mCurrentFrame;
+}
+
+
+void RenderTargetPool::handleEvent(const SDL_Event& event)
+{
+  if (
+    event.type == SDL_WINDOWEVENT &&
+    event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+  {
+    mWindowSizeChanged = true;
+  }
+}
+
+
+AsyncPixelReader::AsyncPixelReader()
+{
+#ifndef RIGEL_USE_GL_ES
+  const auto hasSyncObjects =
+    GLVersion.major > 3 || (GLVersion.major == 3 && GLVersion.minor >= 2) ||
+    SDL_GL_ExtensionSupported("GL_ARB_sync");
+
+  if (hasSyncObjects)
+  {
+    mpFenceSync = detail::loadFunction<FenceSyncFunc>("glFenceSync");
+    mpClientWaitSync =
+      detail::loadFunction<ClientWaitSyncFunc>("glClientWaitSync");
+    mpDeleteSync = detail::loadFunction<DeleteSyncFunc>("glDeleteSync");
+
+    if (!mpFenceSync || !mpClientWaitSync || !mpDeleteSync)
+    {
+      mpFenceSync = nullptr;
+    }
+  }
+#endif
+}
+
+
+AsyncPixelReader::~AsyncPixelReader()
+{
+#ifndef RIGEL_USE_GL_ES
+  for (const auto& readback : mPendingReadbacks)
+  {
+    if (readback.mFence)
+    {
+      mpDeleteSync(readback.mFence);
+    }
+  }
+#endif
+}
+
+
+std::future<base::Image> AsyncPixelReader::readPixels(
+  const int x,
+  const int y,
+  const int width,
+  const int height)
+{
+  if (width <= 0 || height <= 0)
+  {
+    throw std::invalid_argument("Readback region must not be empty");
+  }
+
+#ifdef RIGEL_USE_GL_ES
+  base::PixelBuffer pixels(std::size_t(width) * std::size_t(height));
+  glReadPixels(
+    x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+  auto image =
+    base::Image{std::move(pixels), std::size_t(width), std::size_t(height)};
+  image.flipVertically();
+
+  std::promise<base::Image> promise;
+  promise.set_value(std::move(image));
+  return promise.get_future();
+#else
+  const auto size =
+    std::size_t(width) * std::size_t(height) * sizeof(base::Pixel);
+
+  const auto iBuffer = std::find_if(
+    mFreeBuffers.begin(),
+    mFreeBuffers.end(),
+    [&](const StagingBuffer& buffer) { return buffer.mSize >= size; });
+
+  auto buffer = StagingBuffer{};
+  if (iBuffer != mFreeBuffers.end())
+  {
+    buffer = std::move(*iBuffer);
+    mFreeBuffers.erase(iBuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.mHandle.mHandle);
+  }
+  else
+  {
+    buffer = StagingBuffer{BufferHandle::generate(), size};
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.mHandle.mHandle);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+  }
+
+  // With a pack buffer bound, this only schedules the copy, it doesn't wait
+  // for rendering to finish
+  glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  const auto fence =
+    mpFenceSync ? mpFenceSync(detail::SYNC_GPU_COMMANDS_COMPLETE, 0) : nullptr;
+
+  auto& readback = mPendingReadbacks.emplace_back(
+    Readback{std::move(buffer), width, height, fence, 0, {}});
+  return readback.mPromise.get_future();
+#endif
+}
+
+
+std::future<base::Image>
+  AsyncPixelReader::readPixels(const RenderTarget& target)
+{
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer());
+
+  auto result = readPixels(0, 0, int(target.width()), int(target.height()));
+
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previousFramebuffer));
+  return result;
+}
+
+
+void AsyncPixelReader::update()
+{
+#ifndef RIGEL_USE_GL_ES
+  for (auto& readback : mPendingReadbacks)
+  {
+    ++readback.mFramesWaited;
+  }
+
+  // The GPU finishes work in order, so there's no need to look beyond the
+  // first readback which isn't ready yet
+  while (!mPendingReadbacks.empty() && isReady(mPendingReadbacks.front()))
+  {
+    complete(mPendingReadbacks.front());
+    mPendingReadbacks.pop_front();
+  }
+#endif
+}
+
+
+void AsyncPixelReader::finishAll()
+{
+#ifndef RIGEL_USE_GL_ES
+  while (!mPendingReadbacks.empty())
+  {
+    complete(mPendingReadbacks.front());
+    mPendingReadbacks.pop_front();
+  }
+#endif
+}
+
+
+std::size_t AsyncPixelReader::pendingReadbacks() const
+{
+#ifdef RIGEL_USE_GL_ES
+  return 0;
+#else
+  return mPendingReadbacks.size();
+#endif
+}
+
+
+#ifndef RIGEL_USE_GL_ES
+bool AsyncPixelReader::isReady(const Readback& readback) const
+{
+  if (readback.mFence)
+  {
+    const auto status =
+      mpClientWaitSync(readback.mFence, detail::SYNC_FLUSH_COMMANDS_BIT, 0);
+    return status == detail::ALREADY_SIGNALED ||
+    status == detail::CONDITION_SATISFIED;
+  }
+
+  return readback.mFramesWaited >= FRAMES_UNTIL_READBACK_COMPLETE;
+}
+
+
+void AsyncPixelReader::complete(Readback& readback)
+{
+  const auto width = std::size_t(readback.mWidth);
+  const auto height = std::size_t(readback.mHeight);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.mBuffer.mHandle.mHandle);
+  const auto pMapped = static_cast<const base::Pixel*>(glMapBufferRange(
+    GL_PIXEL_PACK_BUFFER,
+    0,
+    width * height * sizeof(base::Pixel),
+    GL_MAP_READ_BIT));
+
+  if (pMapped)
+  {
+    // Flip while copying, GL's rows are ordered bottom to top
+    base::PixelBuffer pixels(width * height);
+    for (std::size_t row = 0; row < height; ++row)
+    {
+      std::memcpy(
+        pixels.data() + row * width,
+        pMapped + (height - 1 - row) * width,
+        width * sizeof(base::Pixel));
+    }
+
+    if (glUnmapBuffer(GL_PIXEL_PACK_BUFFER))
+    {
+      readback.mPromise.set_value(
+        base::Image{std::move(pixels), width, height});
+    }
+    else
+    {
+      readback.mPromise.set_exception(std::make_exception_ptr(
+        std::runtime_error("Read back pixel data was lost")));
+    }
+  }
+  else
+  {
+    readback.mPromise.set_exception(std::make_exception_ptr(
+      std::runtime_error("Failed to map pixel buffer for reading")));
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if (readback.mFence)
+  {
+    mpDeleteSync(readback.mFence);
+    readback.mFence = nullptr;
+  }
+
+  if (mFreeBuffers.size() < MAX_FREE_STAGING_BUFFERS)
+  {
+    mFreeBuffers.push_back(std::move(readback.mBuffer));
+  }
+}
+#endif
+
+} // namespace rigel::opengl
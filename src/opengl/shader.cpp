@@ -16,14 +16,59 @@
 
 #include "opengl/shader.hpp"
 
+#include "base/trace.hpp"
+#include "opengl/extensions.hpp"
+#include "opengl/state_cache.hpp"
+
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <vector>
 
 
 namespace rigel::opengl
 {
 
+namespace detail
+{
+
+bool isCompatibleUniformType(
+  const GLenum requestedType,
+  const GLenum actualType)
+{
+  if (requestedType == actualType)
+  {
+    return true;
+  }
+
+  if (requestedType != GL_INT)
+  {
+    return false;
+  }
+
+  switch (actualType)
+  {
+    case GL_BOOL:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_CUBE:
+#ifndef RIGEL_USE_GL_ES
+    case GL_SAMPLER_1D:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_2D_SHADOW:
+#endif
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+} // namespace detail
+
+
 namespace
 {
 
@@ -83,104 +128,239 @@ const auto SHADER_PREAMBLE = R"shd(
 #endif
 
 
-GlHandleWrapper compileShader(const std::string& source, GLenum type)
+template <typename GetParamFunc, typename GetInfoLogFunc>
+std::string getInfoLog(
+  const GLuint handle,
+  GetParamFunc&& getParam,
+  GetInfoLogFunc&& getLog)
 {
-  auto shader = GlHandleWrapper{glCreateShader(type), glDeleteShader};
-  const auto sourcePtr = source.c_str();
-  glShaderSource(shader.mHandle, 1, &sourcePtr, nullptr);
-  glCompileShader(shader.mHandle);
-
-  GLint compileStatus = 0;
-  glGetShaderiv(shader.mHandle, GL_COMPILE_STATUS, &compileStatus);
+  GLint infoLogSize = 0;
+  getParam(handle, GL_INFO_LOG_LENGTH, &infoLogSize);
 
-  if (!compileStatus)
+  if (infoLogSize <= 0)
   {
-    GLint infoLogSize = 0;
-    glGetShaderiv(shader.mHandle, GL_INFO_LOG_LENGTH, &infoLogSize);
+    return {};
+  }
 
-    if (infoLogSize > 0)
-    {
-      std::unique_ptr<char[]> infoLogBuffer(new char[infoLogSize]);
-      glGetShaderInfoLog(
-        shader.mHandle, infoLogSize, nullptr, infoLogBuffer.get());
+  std::unique_ptr<char[]> infoLogBuffer(new char[infoLogSize]);
+  getLog(handle, infoLogSize, nullptr, infoLogBuffer.get());
+  return infoLogBuffer.get();
+}
 
-      throw std::runtime_error(
-        std::string{"Shader compilation failed:\n\n"} + infoLogBuffer.get());
-    }
-    else
-    {
-      throw std::runtime_error(
-        "Shader compilation failed, but could not get info log");
-    }
-  }
 
-  return shader;
+ProgramHandle buildProgram(const ShaderSpec& spec)
+{
+  return detail::finishBuildingProgram(detail::startBuildingProgram(spec));
 }
 
 
 auto useTemporarily(const GLuint shaderHandle)
 {
-  GLint currentProgram;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-  glUseProgram(shaderHandle);
+  auto& stateCache = glStateCache();
+  const auto previousProgram = stateCache.currentProgram();
+  stateCache.useProgram(shaderHandle);
 
-  return base::defer([currentProgram]() { glUseProgram(currentProgram); });
+  return base::defer(
+    [previousProgram]() { glStateCache().useProgram(previousProgram); });
 }
 
 } // namespace
 
 
-Shader::Shader(const ShaderSpec& spec)
-  : mProgram(glCreateProgram(), glDeleteProgram)
-  , mVertexLayout(spec.mVertexLayout)
+namespace detail
 {
-  auto vertexShader = compileShader(
-    std::string{SHADER_PREAMBLE} + spec.mVertexSource, GL_VERTEX_SHADER);
-  auto fragmentShader = compileShader(
-    std::string{SHADER_PREAMBLE} + spec.mFragmentSource, GL_FRAGMENT_SHADER);
 
-  glAttachShader(mProgram.mHandle, vertexShader.mHandle);
-  glAttachShader(mProgram.mHandle, fragmentShader.mHandle);
+const char* shaderPreamble()
+{
+  return SHADER_PREAMBLE;
+}
+
+
+ShaderObjectHandle startCompilingShader(const char* source, const GLenum type)
+{
+  auto shader = ShaderObjectHandle{glCreateShader(type)};
+
+  // Passing the preamble as a separate string avoids building a combined
+  // copy of the source
+  const char* sources[] = {SHADER_PREAMBLE, source};
+  glShaderSource(shader.mHandle, 2, sources, nullptr);
+  glCompileShader(shader.mHandle);
+
+  return shader;
+}
 
-  switch (spec.mVertexLayout)
+
+void bindAttributeLocations(const GLuint program, const VertexLayout layout)
+{
+  switch (layout)
   {
     case VertexLayout::PositionAndTexCoords:
-      glBindAttribLocation(mProgram.mHandle, 0, "position");
-      glBindAttribLocation(mProgram.mHandle, 1, "texCoord");
+      glBindAttribLocation(program, 0, "position");
+      glBindAttribLocation(program, 1, "texCoord");
       break;
 
     case VertexLayout::PositionAndColor:
-      glBindAttribLocation(mProgram.mHandle, 0, "position");
-      glBindAttribLocation(mProgram.mHandle, 1, "color");
+      glBindAttribLocation(program, 0, "position");
+      glBindAttribLocation(program, 1, "color");
       break;
   }
+}
+
+
+void checkCompileStatus(const GLuint shader)
+{
+  GLint compileStatus = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
+
+  if (compileStatus)
+  {
+    return;
+  }
+
+  const auto infoLog = getInfoLog(shader, glGetShaderiv, glGetShaderInfoLog);
+  if (infoLog.empty())
+  {
+    throw std::runtime_error(
+      "Shader compilation failed, but could not get info log");
+  }
+
+  throw std::runtime_error("Shader compilation failed:\n\n" + infoLog);
+}
 
-  glLinkProgram(mProgram.mHandle);
 
+void checkLinkStatus(const GLuint program)
+{
   GLint linkStatus = 0;
-  glGetProgramiv(mProgram.mHandle, GL_LINK_STATUS, &linkStatus);
-  if (!linkStatus)
+  glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+
+  if (linkStatus)
   {
-    GLint infoLogSize = 0;
-    glGetProgramiv(mProgram.mHandle, GL_INFO_LOG_LENGTH, &infoLogSize);
+    return;
+  }
 
-    if (infoLogSize > 0)
-    {
-      std::unique_ptr<char[]> infoLogBuffer(new char[infoLogSize]);
-      glGetProgramInfoLog(
-        mProgram.mHandle, infoLogSize, nullptr, infoLogBuffer.get());
+  const auto infoLog =
+    getInfoLog(program, glGetProgramiv, glGetProgramInfoLog);
+  if (infoLog.empty())
+  {
+    throw std::runtime_error(
+      "Shader program linking failed, but could not get info log");
+  }
 
-      throw std::runtime_error(
-        std::string{"Shader program linking failed:\n\n"} +
-        infoLogBuffer.get());
-    }
-    else
-    {
-      throw std::runtime_error(
-        "Shader program linking failed, but could not get info log");
-    }
+  throw std::runtime_error("Shader program linking failed:\n\n" + infoLog);
+}
+
+
+PendingProgram startBuildingProgram(
+  const ShaderSpec& spec,
+  const std::function<void(GLuint)>& prepareLink)
+{
+  auto vertexShader =
+    startCompilingShader(spec.mVertexSource, GL_VERTEX_SHADER);
+  auto fragmentShader =
+    startCompilingShader(spec.mFragmentSource, GL_FRAGMENT_SHADER);
+
+  auto program = ProgramHandle{glCreateProgram()};
+  glAttachShader(program.mHandle, vertexShader.mHandle);
+  glAttachShader(program.mHandle, fragmentShader.mHandle);
+  bindAttributeLocations(program.mHandle, spec.mVertexLayout);
+
+  if (prepareLink)
+  {
+    prepareLink(program.mHandle);
+  }
+
+  // Not checking the result here, so the driver can keep working in the
+  // background until finishBuildingProgram()
+  glLinkProgram(program.mHandle);
+
+  return PendingProgram{
+    std::move(vertexShader), std::move(fragmentShader), std::move(program)};
+}
+
+
+bool isBuildComplete(const PendingProgram& build, const bool hasParallelCompile)
+{
+  if (!hasParallelCompile)
+  {
+    return true;
+  }
+
+  GLint isComplete = GL_FALSE;
+  glGetProgramiv(build.mProgram.mHandle, COMPLETION_STATUS, &isComplete);
+  return isComplete == GL_TRUE;
+}
+
+
+ProgramHandle finishBuildingProgram(PendingProgram&& build)
+{
+  // Compilation errors are more helpful than the resulting link error
+  checkCompileStatus(build.mVertexShader.mHandle);
+  checkCompileStatus(build.mFragmentShader.mHandle);
+  checkLinkStatus(build.mProgram.mHandle);
+
+  // The shader objects aren't needed anymore once the program is linked
+  glDetachShader(build.mProgram.mHandle, build.mVertexShader.mHandle);
+  glDetachShader(build.mProgram.mHandle, build.mFragmentShader.mHandle);
+
+  return std::move(build.mProgram);
+}
+
+} // namespace detail
+
+
+Shader::Shader(const ShaderSpec& spec)
+  : Shader(
+      [&]() {
+        RIGEL_TRACE_SCOPE("Shader compilation");
+        return buildProgram(spec);
+      }(),
+      spec)
+{
+}
+
+
+Shader::Shader(ProgramHandle program, const ShaderSpec& spec)
+  : mProgram(std::move(program))
+  , mVertexLayout(spec.mVertexLayout)
+{
+  resolveUniforms();
+  bindTextureUnits(spec);
+}
+
+
+void Shader::replaceProgram(ProgramHandle program, const ShaderSpec& spec)
+{
+  if (spec.mVertexLayout != mVertexLayout)
+  {
+    throw std::invalid_argument("Vertex layout of a shader can't change");
+  }
+
+  const auto wasInUse = glStateCache().currentProgram() == mProgram.mHandle;
+
+  // The old program ends up in the parameter, and is deleted on return
+  std::swap(mProgram, program);
+
+  // Existing entries must be updated in place, since uniform handles point
+  // to them. Uniforms which are not active anymore get their location from
+  // a plain lookup, like in uniformInfo().
+  for (auto& [name, info] : mUniforms)
+  {
+    info = UniformInfo{
+      glGetUniformLocation(mProgram.mHandle, name.c_str()), 0, 0};
+  }
+
+  resolveUniforms();
+  bindTextureUnits(spec);
+
+  if (wasInUse)
+  {
+    use();
   }
+}
+
 
+void Shader::bindTextureUnits(const ShaderSpec& spec)
+{
   // Bind texture sampler names to texture units
   auto guard = useTemporarily(mProgram.mHandle);
 
@@ -193,17 +373,68 @@ Shader::Shader(const ShaderSpec& spec)
 
 void Shader::use() const
 {
-  glUseProgram(mProgram.mHandle);
+  glStateCache().useProgram(mProgram.mHandle);
+}
+
+
+void Shader::resolveUniforms()
+{
+  GLint numUniforms = 0;
+  GLint maxNameLength = 0;
+  glGetProgramiv(mProgram.mHandle, GL_ACTIVE_UNIFORMS, &numUniforms);
+  glGetProgramiv(
+    mProgram.mHandle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+  std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+
+  for (auto i = 0; i < numUniforms; ++i)
+  {
+    GLsizei nameLength = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(
+      mProgram.mHandle,
+      GLuint(i),
+      GLsizei(nameBuffer.size()),
+      &nameLength,
+      &size,
+      &type,
+      nameBuffer.data());
+
+    auto name = std::string{nameBuffer.data(), std::size_t(nameLength)};
+    const auto info = UniformInfo{
+      glGetUniformLocation(mProgram.mHandle, name.c_str()), type, size};
+
+    // Arrays are reported as "name[0]", but should also be accessible by
+    // their plain name.
+    constexpr auto ARRAY_SUFFIX = std::string_view{"[0]"};
+    if (
+      name.size() > ARRAY_SUFFIX.size() &&
+      std::string_view{name}.substr(name.size() - ARRAY_SUFFIX.size()) ==
+        ARRAY_SUFFIX)
+    {
+      mUniforms.insert_or_assign(name, info);
+      name.resize(name.size() - ARRAY_SUFFIX.size());
+    }
+
+    mUniforms.insert_or_assign(std::move(name), info);
+  }
 }
 
 
-GLint Shader::location(const std::string& name) const
+auto Shader::uniformInfo(const std::string_view name) const
+  -> const UniformInfo&
 {
-  auto it = mLocationCache.find(name);
-  if (it == mLocationCache.end())
+  auto it = mUniforms.find(name);
+  if (it == mUniforms.end())
   {
-    const auto location = glGetUniformLocation(mProgram.mHandle, name.c_str());
-    std::tie(it, std::ignore) = mLocationCache.emplace(name, location);
+    // Not an active uniform as reported by the driver, e.g. an individual
+    // array element like "values[2]", or a uniform that was optimized out.
+    const auto nameString = std::string{name};
+    const auto location =
+      glGetUniformLocation(mProgram.mHandle, nameString.c_str());
+    std::tie(it, std::ignore) =
+      mUniforms.emplace(nameString, UniformInfo{location, 0, 0});
   }
 
   return it->second;
@@ -0,0 +1,432 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "opengl/shader_cache.hpp"
+
+#include "base/binary_io.hpp"
+#include "base/file_utils.hpp"
+#include "base/hash.hpp"
+#include "base/trace.hpp"
+#include "opengl/extensions.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+
+
+namespace rigel::opengl
+{
+
+namespace
+{
+
+/* Program binary file format (native byte order, the file is only usable
+ * with the driver that wrote it anyway):
+ *
+ *   u32 magic ("RSPB")
+ *   u32 format version
+ *   u64 key
+ *   u32 binary format, as reported by the driver
+ *   u32 binary size
+ *   u8[binary size] program binary
+ */
+constexpr auto BINARY_MAGIC = std::uint32_t{0x42505352};
+constexpr auto BINARY_VERSION = std::uint32_t{1};
+constexpr auto MAX_BINARY_SIZE = std::uint32_t{64 * 1024 * 1024};
+
+
+std::uint64_t hashString(const char* pString, const std::uint64_t hash)
+{
+  // Including the terminator separates consecutive strings, so that e.g.
+  // "ab" + "c" and "a" + "bc" don't produce the same hash
+  return pString ? base::hashBytes(pString, std::strlen(pString) + 1, hash)
+                 : hash;
+}
+
+
+std::uint64_t hashGlString(const GLenum name, const std::uint64_t hash)
+{
+  return hashString(reinterpret_cast<const char*>(glGetString(name)), hash);
+}
+
+} // namespace
+
+
+ShaderCache::ShaderCache(ShaderCacheConfig config)
+  : mConfig(std::move(config))
+{
+  mDriverHash = hashGlString(GL_VENDOR, base::HASH_SEED);
+  mDriverHash = hashGlString(GL_RENDERER, mDriverHash);
+  mDriverHash = hashGlString(GL_VERSION, mDriverHash);
+
+  mHasParallelCompile = detail::enableParallelShaderCompile();
+
+  if (!mConfig.binaryCacheDirectory)
+  {
+    return;
+  }
+
+#ifdef RIGEL_USE_GL_ES
+  if (SDL_GL_ExtensionSupported("GL_OES_get_program_binary"))
+  {
+    mpGetProgramBinary =
+      detail::loadFunction<GetProgramBinaryFunc>("glGetProgramBinaryOES");
+    mpProgramBinary =
+      detail::loadFunction<ProgramBinaryFunc>("glProgramBinaryOES");
+  }
+#else
+  if (SDL_GL_ExtensionSupported("GL_ARB_get_program_binary"))
+  {
+    mpGetProgramBinary =
+      detail::loadFunction<GetProgramBinaryFunc>("glGetProgramBinary");
+    mpProgramBinary =
+      detail::loadFunction<ProgramBinaryFunc>("glProgramBinary");
+    mpProgramParameteri =
+      detail::loadFunction<ProgramParameteriFunc>("glProgramParameteri");
+  }
+#endif
+
+  // Some drivers report the extension without supporting any binary formats
+  GLint numBinaryFormats = 0;
+  if (mpGetProgramBinary && mpProgramBinary)
+  {
+    glGetIntegerv(detail::NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+  }
+
+  if (numBinaryFormats <= 0)
+  {
+    mpGetProgramBinary = nullptr;
+    mpProgramBinary = nullptr;
+    mpProgramParameteri = nullptr;
+  }
+}
+
+
+std::size_t ShaderCache::add(const ShaderSpec& spec)
+{
+  auto key = hashString(spec.mVertexSource, mDriverHash);
+  key = hashString(spec.mFragmentSource, key);
+  key = hashString(detail::shaderPreamble(), key);
+  key = base::hashValue(spec.mVertexLayout, key);
+
+  auto& entry = mEntries.emplace_back();
+  entry.mVertexLayout = spec.mVertexLayout;
+  entry.mTextureUnitNames.assign(
+    spec.mTextureUnitNames.begin(), spec.mTextureUnitNames.end());
+  entry.mKey = key;
+
+  if (binaryCacheEnabled() && tryLoadBinary(entry))
+  {
+    ++mStats.binaryHits;
+  }
+  else
+  {
+    startBuilding(entry, spec);
+    ++mStats.compilations;
+  }
+
+  return mEntries.size() - 1;
+}
+
+
+bool ShaderCache::isReady(const std::size_t id) const
+{
+  checkId(id);
+
+  const auto& entry = mEntries[id];
+  if (entry.mShader || !entry.mPendingBuild)
+  {
+    return true;
+  }
+
+  return detail::isBuildComplete(*entry.mPendingBuild, mHasParallelCompile);
+}
+
+
+const Shader& ShaderCache::get(const std::size_t id)
+{
+  checkId(id);
+
+  auto& entry = mEntries[id];
+  if (!entry.mShader)
+  {
+    finish(entry);
+  }
+
+  return *entry.mShader;
+}
+
+
+void ShaderCache::finishAll()
+{
+  for (auto& entry : mEntries)
+  {
+    if (!entry.mShader)
+    {
+      finish(entry);
+    }
+  }
+}
+
+
+void ShaderCache::checkId(const std::size_t id) const
+{
+  if (id >= mEntries.size())
+  {
+    throw std::invalid_argument("Invalid shader id");
+  }
+}
+
+
+bool ShaderCache::binaryCacheEnabled() const
+{
+  return mConfig.binaryCacheDirectory && mpGetProgramBinary &&
+    mpProgramBinary;
+}
+
+
+std::filesystem::path ShaderCache::binaryPath(const std::uint64_t key) const
+{
+  char name[32];
+  std::snprintf(
+    name, sizeof(name), "%016llx.glbin", static_cast<unsigned long long>(key));
+  return *mConfig.binaryCacheDirectory / name;
+}
+
+
+bool ShaderCache::tryLoadBinary(Entry& entry)
+{
+  using base::read;
+  using base::readArray;
+
+  std::ifstream file(binaryPath(entry.mKey), std::ios::binary);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  const auto magic = read<std::uint32_t>(file);
+  const auto version = read<std::uint32_t>(file);
+  const auto key = read<std::uint64_t>(file);
+  const auto format = read<std::uint32_t>(file);
+  const auto size = read<std::uint32_t>(file);
+
+  if (
+    !file.good() || magic != BINARY_MAGIC || version != BINARY_VERSION ||
+    key != entry.mKey || size == 0 || size > MAX_BINARY_SIZE)
+  {
+    return false;
+  }
+
+  std::vector<char> binary(size);
+  readArray(file, binary.data(), binary.size());
+  if (!file.good())
+  {
+    return false;
+  }
+
+  auto program = ProgramHandle{glCreateProgram()};
+  mpProgramBinary(
+    program.mHandle, GLenum(format), binary.data(), GLsizei(binary.size()));
+
+  // The driver rejects binaries it can't use anymore, e.g. after an update
+  GLint linkStatus = GL_FALSE;
+  glGetProgramiv(program.mHandle, GL_LINK_STATUS, &linkStatus);
+  if (linkStatus != GL_TRUE)
+  {
+    return false;
+  }
+
+  // The modification time serves as the last use time for pruning
+  std::error_code ec;
+  std::filesystem::last_write_time(
+    binaryPath(entry.mKey), std::filesystem::file_time_type::clock::now(), ec);
+
+  entry.mProgram.emplace(std::move(program));
+  return true;
+}
+
+
+void ShaderCache::saveBinary(const Entry& entry) const
+{
+  using base::write;
+  using base::writeArray;
+
+  const auto program = entry.mProgram->mHandle;
+
+  GLint length = 0;
+  glGetProgramiv(program, detail::PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0 || std::uint32_t(length) > MAX_BINARY_SIZE)
+  {
+    return;
+  }
+
+  std::vector<char> binary(std::size_t(length), 0);
+  GLsizei actualLength = 0;
+  GLenum format = 0;
+  mpGetProgramBinary(program, length, &actualLength, &format, binary.data());
+  if (actualLength <= 0)
+  {
+    return;
+  }
+
+  // Written under a temporary name and then renamed, so that other
+  // processes never see a partially written file
+  std::error_code ec;
+  std::filesystem::create_directories(*mConfig.binaryCacheDirectory, ec);
+
+  const auto finalPath = binaryPath(entry.mKey);
+  const auto tempPath = base::temporaryPathFor(finalPath);
+
+  {
+    std::ofstream file(tempPath, std::ios::binary);
+    if (!file.is_open())
+    {
+      return;
+    }
+
+    write(file, BINARY_MAGIC);
+    write(file, BINARY_VERSION);
+    write(file, entry.mKey);
+    write(file, std::uint32_t{format});
+    write(file, std::uint32_t(actualLength));
+    writeArray(file, binary.data(), std::size_t(actualLength));
+
+    if (!file.good())
+    {
+      file.close();
+      std::filesystem::remove(tempPath, ec);
+      return;
+    }
+  }
+
+  std::filesystem::rename(tempPath, finalPath, ec);
+  if (ec)
+  {
+    std::filesystem::remove(tempPath, ec);
+    return;
+  }
+
+  pruneBinaryCache();
+}
+
+
+void ShaderCache::pruneBinaryCache() const
+{
+  struct CachedBinary
+  {
+    std::filesystem::path mPath;
+    std::filesystem::file_time_type mLastUsed;
+    std::uintmax_t mSize;
+  };
+
+  std::vector<CachedBinary> binaries;
+  auto totalSize = std::uintmax_t{0};
+
+  std::error_code ec;
+  for (auto iFile = std::filesystem::directory_iterator{
+         *mConfig.binaryCacheDirectory, ec};
+       !ec && iFile != std::filesystem::directory_iterator{};
+       iFile.increment(ec))
+  {
+    if (iFile->path().extension() != ".glbin")
+    {
+      continue;
+    }
+
+    std::error_code fileEc;
+    const auto size = iFile->file_size(fileEc);
+    const auto lastUsed = iFile->last_write_time(fileEc);
+    if (!fileEc)
+    {
+      binaries.push_back(CachedBinary{iFile->path(), lastUsed, size});
+      totalSize += size;
+    }
+  }
+
+  if (totalSize <= mConfig.maxBinaryCacheBytes)
+  {
+    return;
+  }
+
+  std::sort(
+    binaries.begin(),
+    binaries.end(),
+    [](const CachedBinary& lhs, const CachedBinary& rhs) {
+      return lhs.mLastUsed < rhs.mLastUsed;
+    });
+
+  for (const auto& binary : binaries)
+  {
+    if (totalSize <= mConfig.maxBinaryCacheBytes)
+    {
+      break;
+    }
+
+    if (std::filesystem::remove(binary.mPath, ec))
+    {
+      totalSize -= binary.mSize;
+    }
+  }
+}
+
+
+void ShaderCache::startBuilding(Entry& entry, const ShaderSpec& spec)
+{
+  entry.mPendingBuild.emplace(
+    detail::startBuildingProgram(spec, [this](const GLuint program) {
+      if (binaryCacheEnabled() && mpProgramParameteri)
+      {
+        mpProgramParameteri(
+          program, detail::PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      }
+    }));
+}
+
+
+void ShaderCache::finish(Entry& entry)
+{
+  RIGEL_TRACE_SCOPE("Shader compilation");
+
+  if (entry.mPendingBuild)
+  {
+    entry.mProgram.emplace(
+      detail::finishBuildingProgram(std::move(*entry.mPendingBuild)));
+    entry.mPendingBuild.reset();
+
+    if (binaryCacheEnabled())
+    {
+      saveBinary(entry);
+    }
+  }
+
+  std::vector<const char*> textureUnitNames;
+  for (const auto& name : entry.mTextureUnitNames)
+  {
+    textureUnitNames.push_back(name.c_str());
+  }
+
+  entry.mShader.emplace(
+    std::move(*entry.mProgram),
+    ShaderSpec{
+      entry.mVertexLayout, textureUnitNames, nullptr, nullptr});
+  entry.mProgram.reset();
+}
+
+} // namespace rigel::opengl
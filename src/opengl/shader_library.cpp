@@ -0,0 +1,243 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "opengl/shader_library.hpp"
+
+#include "base/byte_buffer.hpp"
+#include "base/warnings.hpp"
+#include "opengl/extensions.hpp"
+
+RIGEL_DISABLE_WARNINGS
+#include <loguru.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+
+namespace rigel::opengl
+{
+
+namespace
+{
+
+std::string loadSource(const std::filesystem::path& path)
+{
+  return base::asText(base::loadFileOrThrow(path));
+}
+
+
+std::string describe(const ShaderFileSpec& spec)
+{
+  return spec.mVertexFile.u8string() + " + " + spec.mFragmentFile.u8string();
+}
+
+
+std::vector<const char*> toCStrings(const std::vector<std::string>& strings)
+{
+  std::vector<const char*> result;
+  for (const auto& string : strings)
+  {
+    result.push_back(string.c_str());
+  }
+
+  return result;
+}
+
+
+/** ShaderSpec for a ShaderFileSpec, keeping the pointers it needs alive */
+struct SpecData
+{
+  SpecData(
+    const ShaderFileSpec& fileSpec,
+    const char* vertexSource,
+    const char* fragmentSource)
+    : mTextureUnitNames(toCStrings(fileSpec.mTextureUnitNames))
+    , mSpec{
+        fileSpec.mVertexLayout,
+        mTextureUnitNames,
+        vertexSource,
+        fragmentSource}
+  {
+  }
+
+  SpecData(const SpecData&) = delete;
+  SpecData& operator=(const SpecData&) = delete;
+
+  std::vector<const char*> mTextureUnitNames;
+  ShaderSpec mSpec;
+};
+
+} // namespace
+
+
+ShaderLibrary::ShaderLibrary(ShaderLibraryConfig config)
+  : mConfig(std::move(config))
+{
+  if (mConfig.enableHotReload)
+  {
+    mWatcher.emplace();
+    mHasParallelCompile = detail::enableParallelShaderCompile();
+  }
+}
+
+
+const Shader& ShaderLibrary::load(ShaderFileSpec spec)
+{
+  auto vertexPath = mConfig.shaderDirectory / spec.mVertexFile;
+  auto fragmentPath = mConfig.shaderDirectory / spec.mFragmentFile;
+
+  const auto vertexSource = loadSource(vertexPath);
+  const auto fragmentSource = loadSource(fragmentPath);
+
+  auto shader = [&]() {
+    const SpecData specData{
+      spec, vertexSource.c_str(), fragmentSource.c_str()};
+
+    try
+    {
+      return Shader{specData.mSpec};
+    }
+    catch (const std::runtime_error& error)
+    {
+      throw std::runtime_error(
+        "Failed to build shader " + describe(spec) + ": " + error.what());
+    }
+  }();
+
+  if (mWatcher)
+  {
+    mWatcher->watch(vertexPath);
+    mWatcher->watch(fragmentPath);
+
+    // Matching the form of the paths reported by the watcher
+    vertexPath = std::filesystem::absolute(vertexPath).lexically_normal();
+    fragmentPath = std::filesystem::absolute(fragmentPath).lexically_normal();
+  }
+
+  auto& entry = mEntries.emplace_back(Entry{
+    std::move(spec),
+    std::move(vertexPath),
+    std::move(fragmentPath),
+    std::move(shader),
+    std::nullopt});
+  return entry.mShader;
+}
+
+
+std::size_t ShaderLibrary::update()
+{
+  if (!mWatcher)
+  {
+    return 0;
+  }
+
+  const auto changedFiles = mWatcher->pollChanges();
+  const auto hasChanged = [&](const std::filesystem::path& path) {
+    return std::find(changedFiles.begin(), changedFiles.end(), path) !=
+      changedFiles.end();
+  };
+
+  if (!changedFiles.empty())
+  {
+    for (auto& entry : mEntries)
+    {
+      if (hasChanged(entry.mVertexPath) || hasChanged(entry.mFragmentPath))
+      {
+        startRebuild(entry);
+      }
+    }
+  }
+
+  auto numSwapped = std::size_t{0};
+
+  for (auto& entry : mEntries)
+  {
+    if (
+      entry.mPendingBuild &&
+      detail::isBuildComplete(*entry.mPendingBuild, mHasParallelCompile))
+    {
+      if (finishRebuild(entry))
+      {
+        ++numSwapped;
+      }
+    }
+  }
+
+  return numSwapped;
+}
+
+
+void ShaderLibrary::startRebuild(Entry& entry)
+{
+  // A build that's still in progress is outdated now
+  entry.mPendingBuild.reset();
+
+  std::string vertexSource;
+  std::string fragmentSource;
+
+  try
+  {
+    vertexSource = loadSource(entry.mVertexPath);
+    fragmentSource = loadSource(entry.mFragmentPath);
+  }
+  catch (const std::exception& error)
+  {
+    LOG_F(
+      ERROR,
+      "Failed to reload shader %s: %s",
+      describe(entry.mSpec).c_str(),
+      error.what());
+    return;
+  }
+
+  const SpecData specData{
+    entry.mSpec, vertexSource.c_str(), fragmentSource.c_str()};
+  entry.mPendingBuild.emplace(detail::startBuildingProgram(specData.mSpec));
+}
+
+
+bool ShaderLibrary::finishRebuild(Entry& entry)
+{
+  auto build = std::move(*entry.mPendingBuild);
+  entry.mPendingBuild.reset();
+
+  auto program = ProgramHandle{};
+
+  try
+  {
+    program = detail::finishBuildingProgram(std::move(build));
+  }
+  catch (const std::exception& error)
+  {
+    LOG_F(
+      ERROR,
+      "Failed to rebuild shader %s, keeping previous version: %s",
+      describe(entry.mSpec).c_str(),
+      error.what());
+    return false;
+  }
+
+  // Only the texture unit names are needed for replacing the program
+  const SpecData specData{entry.mSpec, nullptr, nullptr};
+  entry.mShader.replaceProgram(std::move(program), specData.mSpec);
+
+  LOG_F(INFO, "Reloaded shader %s", describe(entry.mSpec).c_str());
+  return true;
+}
+
+} // namespace rigel::opengl
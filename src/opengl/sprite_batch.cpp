@@ -0,0 +1,347 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "opengl/sprite_batch.hpp"
+
+#include "opengl/state_cache.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+
+namespace rigel::opengl
+{
+
+namespace
+{
+
+using detail::MAX_QUADS_PER_DRAW;
+using detail::VERTICES_PER_QUAD;
+
+constexpr auto INDICES_PER_QUAD = 6;
+
+
+std::size_t floatsPerVertex(const VertexLayout layout)
+{
+  switch (layout)
+  {
+    case VertexLayout::PositionAndTexCoords:
+      return 2 + 2;
+
+    case VertexLayout::PositionAndColor:
+      return 2 + 4;
+  }
+
+  return 0;
+}
+
+
+void setVertexAttributes(const VertexLayout layout, const std::size_t offset)
+{
+  const auto stride = GLsizei(floatsPerVertex(layout) * sizeof(float));
+  const auto pPosition = reinterpret_cast<const void*>(offset);
+  const auto pSecond =
+    reinterpret_cast<const void*>(offset + 2 * sizeof(float));
+
+  switch (layout)
+  {
+    case VertexLayout::PositionAndTexCoords:
+      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, pPosition);
+      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, pSecond);
+      break;
+
+    case VertexLayout::PositionAndColor:
+      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, pPosition);
+      glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, pSecond);
+      break;
+  }
+}
+
+
+void fillIndexBuffer(const GLuint buffer)
+{
+  // Quad vertices are ordered top left, bottom left, top right, bottom right
+  std::vector<GLushort> indices;
+  indices.reserve(MAX_QUADS_PER_DRAW * INDICES_PER_QUAD);
+
+  for (std::size_t i = 0; i < MAX_QUADS_PER_DRAW; ++i)
+  {
+    const auto first = GLushort(i * VERTICES_PER_QUAD);
+    indices.push_back(first);
+    indices.push_back(GLushort(first + 1));
+    indices.push_back(GLushort(first + 2));
+    indices.push_back(GLushort(first + 2));
+    indices.push_back(GLushort(first + 1));
+    indices.push_back(GLushort(first + 3));
+  }
+
+  // The element array binding is part of the vertex array state on desktop
+  // GL. To not disturb whatever vertex array the user has bound, the buffer
+  // is filled via the array buffer target. It's only used as an index
+  // buffer while our own vertex array is bound, see drawQuads().
+  glStateCache().bindArrayBuffer(buffer);
+  glBufferData(
+    GL_ARRAY_BUFFER,
+    indices.size() * sizeof(GLushort),
+    indices.data(),
+    GL_STATIC_DRAW);
+}
+
+
+void checkVertexLayout(const Shader& shader, const VertexLayout expected)
+{
+  if (shader.vertexLayout() != expected)
+  {
+    throw std::invalid_argument("Shader has wrong vertex layout for quad type");
+  }
+}
+
+} // namespace
+
+
+namespace detail
+{
+
+void sortByShaderAndTexture(std::vector<QueuedQuad>& quads)
+{
+  std::stable_sort(
+    quads.begin(),
+    quads.end(),
+    [](const QueuedQuad& lhs, const QueuedQuad& rhs) {
+      // std::less gives a total order for unrelated pointers, unlike <
+      if (lhs.mpShader != rhs.mpShader)
+      {
+        return std::less<const Shader*>{}(lhs.mpShader, rhs.mpShader);
+      }
+
+      return lhs.mTexture < rhs.mTexture;
+    });
+}
+
+
+void splitIntoRuns(
+  const std::vector<QueuedQuad>& quads,
+  std::vector<QuadRun>& runs)
+{
+  runs.clear();
+
+  for (auto iFirst = quads.begin(); iFirst != quads.end();)
+  {
+    const auto maxCount = std::min(
+      MAX_QUADS_PER_DRAW, std::size_t(std::distance(iFirst, quads.end())));
+    const auto iLast = std::find_if(
+      iFirst + 1, iFirst + maxCount, [&](const QueuedQuad& quad) {
+        return quad.mpShader != iFirst->mpShader ||
+          quad.mTexture != iFirst->mTexture;
+      });
+
+    runs.push_back(QuadRun{
+      std::size_t(std::distance(quads.begin(), iFirst)),
+      std::size_t(std::distance(iFirst, iLast))});
+
+    iFirst = iLast;
+  }
+}
+
+
+void addToStats(SpriteBatchStats& stats, const QuadRun& run)
+{
+  ++stats.drawCalls;
+  stats.vertices += run.mCount * VERTICES_PER_QUAD;
+}
+
+} // namespace detail
+
+
+SpriteBatch::SpriteBatch(const SpriteSortMode sortMode)
+  : mVertexBuffer(BufferHandle::generate())
+  , mIndexBuffer(BufferHandle::generate())
+#ifndef RIGEL_USE_GL_ES
+  , mVertexArray(VertexArrayHandle::generate())
+#endif
+  , mSortMode(sortMode)
+{
+  fillIndexBuffer(mIndexBuffer.mHandle);
+}
+
+
+void SpriteBatch::drawQuad(
+  const Shader& shader,
+  const GLuint texture,
+  const base::Rect<float>& destRect,
+  const base::Rect<float>& texCoords)
+{
+  checkVertexLayout(shader, VertexLayout::PositionAndTexCoords);
+
+  mQueuedQuads.push_back(QueuedQuad{&shader, texture, mVertexData.size()});
+
+  const auto left = destRect.topLeft.x;
+  const auto top = destRect.topLeft.y;
+  const auto right = left + destRect.size.width;
+  const auto bottom = top + destRect.size.height;
+
+  const auto texLeft = texCoords.topLeft.x;
+  const auto texTop = texCoords.topLeft.y;
+  const auto texRight = texLeft + texCoords.size.width;
+  const auto texBottom = texTop + texCoords.size.height;
+
+  // clang-format off
+  const float vertices[] = {
+    left,  top,    texLeft,  texTop,
+    left,  bottom, texLeft,  texBottom,
+    right, top,    texRight, texTop,
+    right, bottom, texRight, texBottom,
+  };
+  // clang-format on
+
+  mVertexData.insert(
+    mVertexData.end(), std::begin(vertices), std::end(vertices));
+}
+
+
+void SpriteBatch::drawQuad(
+  const Shader& shader,
+  const base::Rect<float>& destRect,
+  const base::Color& color)
+{
+  checkVertexLayout(shader, VertexLayout::PositionAndColor);
+
+  mQueuedQuads.push_back(QueuedQuad{&shader, 0, mVertexData.size()});
+
+  const auto left = destRect.topLeft.x;
+  const auto top = destRect.topLeft.y;
+  const auto right = left + destRect.size.width;
+  const auto bottom = top + destRect.size.height;
+
+  const auto r = color.r / 255.0f;
+  const auto g = color.g / 255.0f;
+  const auto b = color.b / 255.0f;
+  const auto a = color.a / 255.0f;
+
+  // clang-format off
+  const float vertices[] = {
+    left,  top,    r, g, b, a,
+    left,  bottom, r, g, b, a,
+    right, top,    r, g, b, a,
+    right, bottom, r, g, b, a,
+  };
+  // clang-format on
+
+  mVertexData.insert(
+    mVertexData.end(), std::begin(vertices), std::end(vertices));
+}
+
+
+void SpriteBatch::flush()
+{
+  if (mQueuedQuads.empty())
+  {
+    return;
+  }
+
+  if (mSortMode == SpriteSortMode::TextureAndShader)
+  {
+    detail::sortByShaderAndTexture(mQueuedQuads);
+
+    // Quads drawn together need to be adjacent in the vertex buffer
+    mSortedVertexData.clear();
+    for (auto& quad : mQueuedQuads)
+    {
+      const auto pFirst = mVertexData.begin() + quad.mDataOffset;
+      const auto size = VERTICES_PER_QUAD *
+        floatsPerVertex(quad.mpShader->vertexLayout());
+
+      quad.mDataOffset = mSortedVertexData.size();
+      mSortedVertexData.insert(mSortedVertexData.end(), pFirst, pFirst + size);
+    }
+
+    drawQuads(mSortedVertexData, mQueuedQuads);
+  }
+  else
+  {
+    drawQuads(mVertexData, mQueuedQuads);
+  }
+
+  mQueuedQuads.clear();
+  mVertexData.clear();
+}
+
+
+void SpriteBatch::uploadVertices(const std::vector<float>& vertexData)
+{
+  const auto size = vertexData.size() * sizeof(float);
+
+  glStateCache().bindArrayBuffer(mVertexBuffer.mHandle);
+
+  // Re-specifying the buffer's storage orphans the previous one, which the
+  // driver can keep alive until pending draw calls are done with it. This
+  // way, the upload doesn't need to wait for the GPU.
+  mVertexBufferCapacity = std::max(mVertexBufferCapacity, size);
+  glBufferData(
+    GL_ARRAY_BUFFER, mVertexBufferCapacity, nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertexData.data());
+}
+
+
+void SpriteBatch::drawQuads(
+  const std::vector<float>& vertexData,
+  const std::vector<QueuedQuad>& quads)
+{
+  auto& stateCache = glStateCache();
+
+#ifndef RIGEL_USE_GL_ES
+  const auto previousVertexArray = stateCache.currentVertexArray();
+  stateCache.bindVertexArray(mVertexArray.mHandle);
+#endif
+
+  uploadVertices(vertexData);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer.mHandle);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+
+  detail::splitIntoRuns(quads, mRuns);
+
+  for (const auto& run : mRuns)
+  {
+    const auto& first = quads[run.mFirst];
+    const auto layout = first.mpShader->vertexLayout();
+
+    first.mpShader->use();
+
+    if (layout == VertexLayout::PositionAndTexCoords)
+    {
+      stateCache.bindTexture(0, first.mTexture);
+    }
+
+    setVertexAttributes(layout, first.mDataOffset * sizeof(float));
+    glDrawElements(
+      GL_TRIANGLES,
+      GLsizei(run.mCount * INDICES_PER_QUAD),
+      GL_UNSIGNED_SHORT,
+      nullptr);
+
+    detail::addToStats(mStats, run);
+  }
+
+#ifndef RIGEL_USE_GL_ES
+  stateCache.bindVertexArray(previousVertexArray);
+#endif
+}
+
+} // namespace rigel::opengl
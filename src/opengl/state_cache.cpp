@@ -0,0 +1,214 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "opengl/state_cache.hpp"
+
+#include <stdexcept>
+
+
+namespace rigel::opengl
+{
+
+GlStateCache::GlStateCache()
+{
+  mTextures.fill(0u);
+}
+
+
+template <typename T, typename SetFunc>
+void GlStateCache::update(
+  std::optional<T>& current,
+  const T& value,
+  SetFunc&& set)
+{
+  if (current == value)
+  {
+    ++mStats.elidedCalls;
+    return;
+  }
+
+  set();
+  current = value;
+  ++mStats.issuedCalls;
+}
+
+
+void GlStateCache::useProgram(const GLuint program)
+{
+  update(mProgram, program, [&]() { glUseProgram(program); });
+}
+
+
+GLuint GlStateCache::currentProgram()
+{
+  if (!mProgram)
+  {
+    GLint program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    mProgram = GLuint(program);
+  }
+
+  return *mProgram;
+}
+
+
+void GlStateCache::bindTexture(const std::size_t unit, const GLuint texture)
+{
+  if (unit >= MAX_TEXTURE_UNITS)
+  {
+    throw std::invalid_argument("Texture unit out of range");
+  }
+
+  if (mTextures[unit] == texture)
+  {
+    ++mStats.elidedCalls;
+    return;
+  }
+
+  const auto textureUnit = GLenum(GL_TEXTURE0 + unit);
+  update(
+    mActiveTextureUnit, textureUnit, [&]() { glActiveTexture(textureUnit); });
+  update(mTextures[unit], texture, [&]() {
+    glBindTexture(GL_TEXTURE_2D, texture);
+  });
+}
+
+
+void GlStateCache::bindArrayBuffer(const GLuint buffer)
+{
+  update(
+    mArrayBuffer, buffer, [&]() { glBindBuffer(GL_ARRAY_BUFFER, buffer); });
+}
+
+
+#ifndef RIGEL_USE_GL_ES
+void GlStateCache::bindVertexArray(const GLuint vertexArray)
+{
+  update(
+    mVertexArray, vertexArray, [&]() { glBindVertexArray(vertexArray); });
+}
+
+
+GLuint GlStateCache::currentVertexArray()
+{
+  if (!mVertexArray)
+  {
+    GLint vertexArray = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+    mVertexArray = GLuint(vertexArray);
+  }
+
+  return *mVertexArray;
+}
+#endif
+
+
+void GlStateCache::setBlendEnabled(const bool enabled)
+{
+  update(mBlendEnabled, enabled, [&]() {
+    if (enabled)
+    {
+      glEnable(GL_BLEND);
+    }
+    else
+    {
+      glDisable(GL_BLEND);
+    }
+  });
+}
+
+
+void GlStateCache::setBlendFunc(
+  const GLenum sourceFactor,
+  const GLenum destFactor)
+{
+  update(mBlendFunc, BlendFunc{sourceFactor, destFactor}, [&]() {
+    glBlendFunc(sourceFactor, destFactor);
+  });
+}
+
+
+void GlStateCache::setViewport(
+  const GLint x,
+  const GLint y,
+  const GLsizei width,
+  const GLsizei height)
+{
+  update(mViewport, Viewport{x, y, width, height}, [&]() {
+    glViewport(x, y, width, height);
+  });
+}
+
+
+void GlStateCache::onTextureDeleted(const GLuint texture)
+{
+  // OpenGL resets the binding to 0 on all units the texture was bound to
+  for (auto& boundTexture : mTextures)
+  {
+    if (boundTexture == texture)
+    {
+      boundTexture = 0u;
+    }
+  }
+}
+
+
+void GlStateCache::onBufferDeleted(const GLuint buffer)
+{
+  if (mArrayBuffer == buffer)
+  {
+    mArrayBuffer = 0u;
+  }
+}
+
+
+#ifndef RIGEL_USE_GL_ES
+void GlStateCache::onVertexArrayDeleted(const GLuint vertexArray)
+{
+  if (mVertexArray == vertexArray)
+  {
+    mVertexArray = 0u;
+  }
+}
+#endif
+
+
+void GlStateCache::invalidate()
+{
+  mProgram.reset();
+  mActiveTextureUnit.reset();
+  for (auto& texture : mTextures)
+  {
+    texture.reset();
+  }
+  mArrayBuffer.reset();
+#ifndef RIGEL_USE_GL_ES
+  mVertexArray.reset();
+#endif
+  mBlendEnabled.reset();
+  mBlendFunc.reset();
+  mViewport.reset();
+}
+
+
+GlStateCache& glStateCache()
+{
+  thread_local GlStateCache cache;
+  return cache;
+}
+
+} // namespace rigel::opengl
@@ -0,0 +1,447 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "opengl/texture.hpp"
+
+#include "opengl/state_cache.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+namespace rigel::opengl
+{
+
+namespace
+{
+
+GLint minFilter(const TextureFilter filter, const bool withMipmaps)
+{
+  if (withMipmaps)
+  {
+    return filter == TextureFilter::Linear ? GL_LINEAR_MIPMAP_LINEAR
+                                           : GL_NEAREST_MIPMAP_NEAREST;
+  }
+
+  return filter == TextureFilter::Linear ? GL_LINEAR : GL_NEAREST;
+}
+
+
+TextureHandle createTexture(
+  const std::size_t width,
+  const std::size_t height,
+  const TextureFilter filter,
+  const bool withMipmaps)
+{
+  auto texture = TextureHandle::generate();
+
+  glStateCache().bindTexture(0, texture.mHandle);
+  glTexImage2D(
+    GL_TEXTURE_2D,
+    0,
+    GL_RGBA,
+    GLsizei(width),
+    GLsizei(height),
+    0,
+    GL_RGBA,
+    GL_UNSIGNED_BYTE,
+    nullptr);
+  glTexParameteri(
+    GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter(filter, withMipmaps));
+  glTexParameteri(
+    GL_TEXTURE_2D,
+    GL_TEXTURE_MAG_FILTER,
+    filter == TextureFilter::Linear ? GL_LINEAR : GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  return texture;
+}
+
+
+void texSubImage(
+  const std::size_t x,
+  const std::size_t y,
+  const std::size_t width,
+  const std::size_t height,
+  const void* pPixels)
+{
+  glTexSubImage2D(
+    GL_TEXTURE_2D,
+    0,
+    GLint(x),
+    GLint(y),
+    GLsizei(width),
+    GLsizei(height),
+    GL_RGBA,
+    GL_UNSIGNED_BYTE,
+    pPixels);
+}
+
+
+void uploadPixels(
+  const GLuint texture,
+  const std::size_t x,
+  const std::size_t y,
+  const base::ImageView& pixels)
+{
+  glStateCache().bindTexture(0, texture);
+
+  if (pixels.isContiguous())
+  {
+    texSubImage(x, y, pixels.width(), pixels.height(), pixels.row(0));
+    return;
+  }
+
+#ifndef RIGEL_USE_GL_ES
+  if (pixels.stride() > 0)
+  {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(pixels.stride()));
+    texSubImage(x, y, pixels.width(), pixels.height(), pixels.row(0));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    return;
+  }
+#endif
+
+  // GL ES 2.0 has no way to specify a row stride, and negative strides
+  // (flipped views) aren't supported at all, so go row by row.
+  for (std::size_t row = 0; row < pixels.height(); ++row)
+  {
+    texSubImage(x, y + row, pixels.width(), 1, pixels.row(row));
+  }
+}
+
+
+bool fitsInto(
+  const Texture& texture,
+  const std::size_t x,
+  const std::size_t y,
+  const std::size_t width,
+  const std::size_t height)
+{
+  return x + width <= texture.width() && y + height <= texture.height();
+}
+
+} // namespace
+
+
+Texture::Texture(
+  const std::size_t width,
+  const std::size_t height,
+  const TextureFilter filter,
+  const bool withMipmaps)
+  : mHandle(createTexture(width, height, filter, withMipmaps))
+  , mWidth(width)
+  , mHeight(height)
+  , mHasMipmaps(withMipmaps)
+{
+  if (mHasMipmaps)
+  {
+    // Allocates the remaining levels, making the texture complete
+    generateMipmaps();
+  }
+}
+
+
+Texture::Texture(
+  const base::ImageView& image,
+  const TextureFilter filter,
+  const bool withMipmaps)
+  : mHandle(createTexture(image.width(), image.height(), filter, withMipmaps))
+  , mWidth(image.width())
+  , mHeight(image.height())
+  , mHasMipmaps(withMipmaps)
+{
+  update(0, 0, image);
+
+  if (mHasMipmaps)
+  {
+    generateMipmaps();
+  }
+}
+
+
+void Texture::update(
+  const std::size_t x,
+  const std::size_t y,
+  const base::ImageView& pixels)
+{
+  if (!fitsInto(*this, x, y, pixels.width(), pixels.height()))
+  {
+    throw std::invalid_argument("Texture update region out of bounds");
+  }
+
+  if (!pixels.empty())
+  {
+    uploadPixels(mHandle.mHandle, x, y, pixels);
+  }
+}
+
+
+void Texture::generateMipmaps()
+{
+  glStateCache().bindTexture(0, mHandle.mHandle);
+  glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+
+TextureUploader::TextureUploader(TextureUploaderConfig config)
+  : mConfig(config)
+{
+}
+
+
+TextureUploader::~TextureUploader()
+{
+  for (const auto& upload : mQueue)
+  {
+    if (const auto pTexture = upload.mpTexture.lock())
+    {
+      --pTexture->mNumPendingUploads;
+    }
+  }
+}
+
+
+void TextureUploader::enqueue(
+  const std::shared_ptr<Texture>& pTexture,
+  const std::size_t x,
+  const std::size_t y,
+  std::shared_ptr<const base::Image> pImage)
+{
+  if (!fitsInto(*pTexture, x, y, pImage->width(), pImage->height()))
+  {
+    throw std::invalid_argument("Texture upload region out of bounds");
+  }
+
+  if (pImage->width() == 0 || pImage->height() == 0)
+  {
+    return;
+  }
+
+  ++pTexture->mNumPendingUploads;
+  mQueue.push_back(Upload{pTexture, std::move(pImage), x, y});
+}
+
+
+void TextureUploader::enqueue(
+  const std::shared_ptr<Texture>& pTexture,
+  const std::size_t x,
+  const std::size_t y,
+  const base::ImageView& pixels)
+{
+  enqueue(pTexture, x, y, std::make_shared<const base::Image>(pixels));
+}
+
+
+std::shared_ptr<Texture> TextureUploader::createTexture(
+  std::shared_ptr<const base::Image> pImage,
+  const TextureFilter filter,
+  const bool withMipmaps)
+{
+  auto pTexture = std::make_shared<Texture>(
+    pImage->width(), pImage->height(), filter, withMipmaps);
+  enqueue(pTexture, 0, 0, std::move(pImage));
+  return pTexture;
+}
+
+
+void TextureUploader::processUploads()
+{
+  struct Band
+  {
+    std::shared_ptr<Texture> mpTexture;
+    std::size_t mX;
+    std::size_t mY;
+    base::ImageView mPixels;
+    std::size_t mOffset;
+  };
+
+  // Carve the next bands of rows out of the queue, until the budget is used
+  // up. Uploads which are completed by this are kept around until the
+  // pixels have been submitted.
+  std::vector<Band> bands;
+  std::vector<Upload> completedUploads;
+  auto totalBytes = std::size_t{0};
+
+  while (!mQueue.empty())
+  {
+    auto& upload = mQueue.front();
+    auto pTexture = upload.mpTexture.lock();
+    if (!pTexture)
+    {
+      mQueue.pop_front();
+      continue;
+    }
+
+    const auto& image = *upload.mpImage;
+    const auto bytesPerRow = image.width() * sizeof(base::Pixel);
+    const auto remainingBudget =
+      mConfig.maxBytesPerFrame - std::min(totalBytes, mConfig.maxBytesPerFrame);
+    auto numRows =
+      std::min(image.height() - upload.mNextRow, remainingBudget / bytesPerRow);
+
+    if (numRows == 0)
+    {
+      if (!bands.empty())
+      {
+        break;
+      }
+
+      numRows = 1;
+    }
+
+    bands.push_back(Band{
+      std::move(pTexture),
+      upload.mX,
+      upload.mY + upload.mNextRow,
+      image.subView(0, upload.mNextRow, image.width(), numRows),
+      totalBytes});
+    totalBytes += numRows * bytesPerRow;
+    upload.mNextRow += numRows;
+
+    if (upload.mNextRow < image.height())
+    {
+      break;
+    }
+
+    completedUploads.push_back(std::move(upload));
+    mQueue.pop_front();
+  }
+
+  if (bands.empty())
+  {
+    return;
+  }
+
+#ifdef RIGEL_USE_GL_ES
+  for (const auto& band : bands)
+  {
+    uploadPixels(band.mpTexture->handle(), band.mX, band.mY, band.mPixels);
+  }
+#else
+  if (!mPixelBuffer.mHandle)
+  {
+    mPixelBuffer = BufferHandle::generate();
+  }
+
+  mPixelBufferSize =
+    std::max({mPixelBufferSize, totalBytes, mConfig.maxBytesPerFrame});
+
+  // Orphaning the buffer gives us fresh storage, so that there's no need to
+  // wait until the GPU has finished reading the previous frame's pixels.
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPixelBuffer.mHandle);
+  glBufferData(
+    GL_PIXEL_UNPACK_BUFFER, mPixelBufferSize, nullptr, GL_STREAM_DRAW);
+
+  auto pMapped = static_cast<std::uint8_t*>(glMapBufferRange(
+    GL_PIXEL_UNPACK_BUFFER,
+    0,
+    totalBytes,
+    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+  if (pMapped)
+  {
+    for (const auto& band : bands)
+    {
+      // Bands always consist of complete rows of an Image, so they are
+      // contiguous
+      std::memcpy(
+        pMapped + band.mOffset,
+        band.mPixels.row(0),
+        band.mPixels.width() * band.mPixels.height() * sizeof(base::Pixel));
+    }
+
+    // Unmapping can fail if the buffer's contents were lost, e.g. due to
+    // a display mode change. The pixels are uploaded directly in that case.
+    if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+    {
+      pMapped = nullptr;
+    }
+  }
+
+  if (pMapped)
+  {
+    for (const auto& band : bands)
+    {
+      glStateCache().bindTexture(0, band.mpTexture->handle());
+      texSubImage(
+        band.mX,
+        band.mY,
+        band.mPixels.width(),
+        band.mPixels.height(),
+        reinterpret_cast<const void*>(band.mOffset));
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  else
+  {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    for (const auto& band : bands)
+    {
+      uploadPixels(band.mpTexture->handle(), band.mX, band.mY, band.mPixels);
+    }
+  }
+#endif
+
+  mStats.uploadedBytes += totalBytes;
+
+  // Several uploads might have gone into the same texture, e.g. an atlas.
+  // Its mipmaps only need to be regenerated once.
+  std::vector<Texture*> texturesNeedingMipmaps;
+
+  for (const auto& upload : completedUploads)
+  {
+    if (const auto pTexture = upload.mpTexture.lock())
+    {
+      --pTexture->mNumPendingUploads;
+
+      if (
+        pTexture->hasMipmaps() &&
+        std::find(
+          texturesNeedingMipmaps.begin(),
+          texturesNeedingMipmaps.end(),
+          pTexture.get()) == texturesNeedingMipmaps.end())
+      {
+        texturesNeedingMipmaps.push_back(pTexture.get());
+      }
+    }
+
+    ++mStats.completedUploads;
+  }
+
+  for (const auto pTexture : texturesNeedingMipmaps)
+  {
+    pTexture->generateMipmaps();
+  }
+}
+
+
+void TextureUploader::finishAll()
+{
+  while (!mQueue.empty())
+  {
+    processUploads();
+  }
+}
+
+} // namespace rigel::opengl
@@ -35,6 +35,19 @@ namespace
 const auto PRE_FILTER_WEIGHT = 0.7f;
 const auto FILTER_WEIGHT = 0.9f;
 
+
+void appendTime(std::stringstream& stream, const std::optional<double> time)
+{
+  if (time)
+  {
+    stream << *time * 1000.0 << " ms";
+  }
+  else
+  {
+    stream << "n/a";
+  }
+}
+
 } // namespace
 
 
@@ -42,6 +55,23 @@ void FpsDisplay::updateAndRender(
   const double totalElapsed,
   const double elapsedCpu,
   const double elapsedGpu)
+{
+  render(totalElapsed, elapsedCpu, elapsedGpu, {});
+}
+
+
+void FpsDisplay::updateAndRender(const opengl::FrameTimings& timings)
+{
+  render(
+    timings.totalElapsed, timings.cpuTime, timings.gpuTime, timings.scopes);
+}
+
+
+void FpsDisplay::render(
+  const double totalElapsed,
+  const double elapsedCpu,
+  const std::optional<double> elapsedGpu,
+  const std::vector<opengl::ProfileScopeTiming>& scopes)
 {
 #ifdef RIGEL_HAVE_BOOST
   mFrameTimesHistory.push_back(float(totalElapsed));
@@ -60,9 +90,10 @@ void FpsDisplay::updateAndRender(
     << smoothedFps << " FPS, "
     << std::setw(4) << std::fixed << std::setprecision(2)
     << totalElapsed * 1000.0 << " ms, "
-    << elapsedCpu * 1000.0 << " ms (CPU), "
-    << elapsedGpu * 1000.0 << " ms (GPU)";
+    << elapsedCpu * 1000.0 << " ms (CPU), ";
   // clang-format on
+  appendTime(statsReport, elapsedGpu);
+  statsReport << " (GPU)";
 
   const auto reportString = statsReport.str();
 
@@ -76,6 +107,28 @@ void FpsDisplay::updateAndRender(
     reportString.data(),
     reportString.data() + reportString.size());
 
+  // Per-scope breakdown, one line per scope below the main report
+  const auto lineHeight = ImGui::GetDrawListSharedData()->FontSize;
+  auto linePos = ImVec2{0, lineHeight};
+
+  for (const auto& scope : scopes)
+  {
+    std::stringstream scopeReport;
+    scopeReport << std::string(2 * std::size_t(scope.depth), ' ')
+                << scope.name << ": " << std::fixed << std::setprecision(2)
+                << scope.cpuTime * 1000.0 << " ms (CPU), ";
+    appendTime(scopeReport, scope.gpuTime);
+    scopeReport << " (GPU)";
+
+    const auto scopeString = scopeReport.str();
+    pDrawList->AddText(
+      linePos,
+      color,
+      scopeString.data(),
+      scopeString.data() + scopeString.size());
+    linePos.y += lineHeight;
+  }
+
 #ifdef RIGEL_HAVE_BOOST
   // Draw frame-time graph
   if (mFrameTimesHistory.size() < 2)
@@ -16,6 +16,16 @@
 
 #include "ui/imgui_integration.hpp"
 
+#include "base/binary_io.hpp"
+#include "base/clock.hpp"
+#include "base/file_utils.hpp"
+#include "base/hash.hpp"
+#include "opengl/opengl.hpp"
+#include "opengl/render_target.hpp"
+#include "opengl/shader.hpp"
+#include "opengl/sprite_batch.hpp"
+#include "opengl/state_cache.hpp"
+
 RIGEL_DISABLE_WARNINGS
 #include <imgui.h>
 #include <imgui_impl_opengl3.h>
@@ -23,6 +33,16 @@ RIGEL_DISABLE_WARNINGS
 RIGEL_RESTORE_WARNINGS
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
 
 
 namespace rigel::ui::imgui_integration
@@ -36,8 +56,61 @@ constexpr auto VERTICAL_4K_RES = 2160.0f;
 constexpr auto IMGUI_DEFAULT_FONT_SIZE = 13;
 constexpr auto INITIAL_UI_SCALE = 3.0f;
 
+// Window resizing produces a stream of size change events. The UI is only
+// rescaled once the size has stopped changing for this long.
+constexpr auto UI_SCALE_DEBOUNCE_TIME = std::chrono::milliseconds{100};
+
+// Restoring the font atlas from the cache relies on Dear ImGui internals,
+// which are only compatible with versions before the font system rework in
+// 1.92. With other versions, the atlas is always built from scratch.
+#if IMGUI_VERSION_NUM >= 17800 && IMGUI_VERSION_NUM < 19200
+  #define RIGEL_CACHE_IMGUI_FONT_ATLAS
+#endif
+
+constexpr auto FONT_ATLAS_CACHE_FILE = "ImGuiFontAtlas.bin";
+
+// Some widgets react to input with a delay of a frame or two, e.g. hover
+// highlights after a mouse move. The UI is therefore not considered idle
+// right after an event, even if the draw data didn't change.
+constexpr auto NUM_FRAMES_TO_SETTLE_AFTER_INPUT = 2;
+
+const auto COMPOSITE_VERTEX_SOURCE = R"shd(
+ATTRIBUTE HIGHP vec2 position;
+ATTRIBUTE HIGHP vec2 texCoord;
+
+OUT HIGHP vec2 texCoordFrag;
+
+void main() {
+  gl_Position = vec4(position, 0.0, 1.0);
+  texCoordFrag = texCoord;
+}
+)shd";
+
+const auto COMPOSITE_FRAGMENT_SOURCE = R"shd(
+DEFAULT_PRECISION_DECLARATION
+OUTPUT_COLOR_DECLARATION
+
+IN HIGHP vec2 texCoordFrag;
+
+uniform sampler2D textureData;
+
+void main() {
+  OUTPUT_COLOR = TEXTURE_LOOKUP(textureData, texCoordFrag);
+}
+)shd";
+
+const char* COMPOSITE_TEXTURE_UNIT_NAMES[] = {"textureData"};
+
 std::string gIniFilePath;
 
+ImGuiStyle gBaseStyle;
+float gUiScaleFactor = 0.0f;
+std::optional<int> gPendingUiScaleHeight;
+base::Clock::time_point gLastSizeChangeTime;
+
+int gNumFramesUntilSettled = 0;
+bool gLastFrameWasUnchanged = false;
+
 bool shouldConsumeEvent(const SDL_Event& event)
 {
   const auto& io = ImGui::GetIO();
@@ -58,7 +131,7 @@ bool shouldConsumeEvent(const SDL_Event& event)
 }
 
 
-void updateUiScale(const int, const int newHeight)
+void updateUiScale(const int newHeight)
 {
   // TODO: Implement proper DPI scaling
 
@@ -70,13 +143,527 @@ void updateUiScale(const int, const int newHeight)
   const auto scaleFactor =
     std::clamp(newHeight / VERTICAL_4K_RES, 1.0f / INITIAL_UI_SCALE, 1.0f);
 
+  if (scaleFactor == gUiScaleFactor)
+  {
+    return;
+  }
+
+  gUiScaleFactor = scaleFactor;
+
+  // ScaleAllSizes() rounds the results, so it can't be applied on top of an
+  // already scaled style without accumulating errors. We always start from
+  // the unscaled base style instead.
   ImGui::GetIO().FontGlobalScale = scaleFactor;
-  ImGui::GetStyle() = ImGuiStyle{};
+  ImGui::GetStyle() = gBaseStyle;
   ImGui::GetStyle().ScaleAllSizes(scaleFactor * INITIAL_UI_SCALE);
+}
 
-  // AntiAliasedLinesUseTex requires using bilinear filtering, but we don't use
-  // it (see our version of imgui_impl_opengl3.cpp).
-  ImGui::GetStyle().AntiAliasedLinesUseTex = false;
+
+void applyPendingUiScaleChange()
+{
+  if (
+    gPendingUiScaleHeight &&
+    base::Clock::now() - gLastSizeChangeTime >= UI_SCALE_DEBOUNCE_TIME)
+  {
+    updateUiScale(*gPendingUiScaleHeight);
+    gPendingUiScaleHeight.reset();
+  }
+}
+
+
+#ifdef RIGEL_CACHE_IMGUI_FONT_ATLAS
+
+/* Font atlas cache file format (native byte order, the file is only meant
+ * to be used on the machine that wrote it):
+ *
+ *   u32 magic ("RIFA")
+ *   u32 format version
+ *   i32 IMGUI_VERSION_NUM
+ *   f32 font size in pixels
+ *   i32 texture width, i32 texture height
+ *   ImVec2 TexUvScale, ImVec2 TexUvWhitePixel
+ *   ImVec4[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1] TexUvLines
+ *   f32 FontSize, f32 Ascent, f32 Descent
+ *   u32 FallbackChar, u32 EllipsisChar, i32 MetricsTotalSurface
+ *   u32 glyph count, CachedGlyph[glyph count]
+ *   u8[width * height] alpha texture
+ *
+ * The atlas is rasterized as 8-bit alpha, Dear ImGui derives the RGBA
+ * version from that when creating the texture. Storing only the alpha
+ * values keeps the file at a quarter of the size.
+ */
+constexpr auto FONT_ATLAS_MAGIC = std::uint32_t{0x41464952};
+constexpr auto FONT_ATLAS_VERSION = std::uint32_t{1};
+constexpr auto MAX_FONT_ATLAS_SIZE = 16384;
+
+
+struct CachedGlyph
+{
+  std::uint32_t mCodepoint;
+  std::uint32_t mVisible;
+  float mAdvanceX;
+  float mX0, mY0, mX1, mY1;
+  float mU0, mV0, mU1, mV1;
+};
+
+
+void saveFontAtlas(
+  const std::filesystem::path& path,
+  const ImFontAtlas& atlas,
+  const ImFont& font)
+{
+  using base::write;
+  using base::writeArray;
+
+  if (!atlas.TexPixelsAlpha8)
+  {
+    return;
+  }
+
+  std::vector<CachedGlyph> glyphs;
+  glyphs.reserve(font.Glyphs.Size);
+  for (const auto& glyph : font.Glyphs)
+  {
+    glyphs.push_back(CachedGlyph{
+      glyph.Codepoint,
+      glyph.Visible,
+      glyph.AdvanceX,
+      glyph.X0,
+      glyph.Y0,
+      glyph.X1,
+      glyph.Y1,
+      glyph.U0,
+      glyph.V0,
+      glyph.U1,
+      glyph.V1});
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+
+  // Written under a temporary name and then renamed, so that a crash or
+  // another instance of the application never leaves a truncated atlas behind
+  const auto tempPath = base::temporaryPathFor(path);
+
+  {
+    std::ofstream file(tempPath, std::ios::binary);
+    if (!file.is_open())
+    {
+      return;
+    }
+
+    write(file, FONT_ATLAS_MAGIC);
+    write(file, FONT_ATLAS_VERSION);
+    write(file, std::int32_t{IMGUI_VERSION_NUM});
+    write(file, atlas.ConfigData[0].SizePixels);
+    write(file, std::int32_t{atlas.TexWidth});
+    write(file, std::int32_t{atlas.TexHeight});
+    write(file, atlas.TexUvScale);
+    write(file, atlas.TexUvWhitePixel);
+    writeArray(file, atlas.TexUvLines, std::size(atlas.TexUvLines));
+    write(file, font.FontSize);
+    write(file, font.Ascent);
+    write(file, font.Descent);
+    write(file, std::uint32_t{font.FallbackChar});
+    write(file, std::uint32_t{font.EllipsisChar});
+    write(file, std::int32_t{font.MetricsTotalSurface});
+    write(file, static_cast<std::uint32_t>(glyphs.size()));
+    writeArray(file, glyphs.data(), glyphs.size());
+    writeArray(
+      file,
+      atlas.TexPixelsAlpha8,
+      std::size_t(atlas.TexWidth) * std::size_t(atlas.TexHeight));
+
+    if (!file.good())
+    {
+      file.close();
+      std::filesystem::remove(tempPath, ec);
+      return;
+    }
+  }
+
+  std::filesystem::rename(tempPath, path, ec);
+  if (ec)
+  {
+    std::filesystem::remove(tempPath, ec);
+  }
+}
+
+
+bool loadFontAtlas(
+  const std::filesystem::path& path,
+  ImFontAtlas& atlas,
+  ImFont& font)
+{
+  using base::read;
+  using base::readArray;
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  const auto magic = read<std::uint32_t>(file);
+  const auto version = read<std::uint32_t>(file);
+  const auto imGuiVersion = read<std::int32_t>(file);
+  const auto sizePixels = read<float>(file);
+  const auto width = read<std::int32_t>(file);
+  const auto height = read<std::int32_t>(file);
+
+  if (
+    !file.good() || magic != FONT_ATLAS_MAGIC ||
+    version != FONT_ATLAS_VERSION || imGuiVersion != IMGUI_VERSION_NUM ||
+    sizePixels != atlas.ConfigData[0].SizePixels || width <= 0 ||
+    height <= 0 || width > MAX_FONT_ATLAS_SIZE ||
+    height > MAX_FONT_ATLAS_SIZE)
+  {
+    return false;
+  }
+
+  const auto texUvScale = read<ImVec2>(file);
+  const auto texUvWhitePixel = read<ImVec2>(file);
+  ImVec4 texUvLines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+  readArray(file, texUvLines, std::size(texUvLines));
+  const auto fontSize = read<float>(file);
+  const auto ascent = read<float>(file);
+  const auto descent = read<float>(file);
+  const auto fallbackChar = read<std::uint32_t>(file);
+  const auto ellipsisChar = read<std::uint32_t>(file);
+  const auto metricsTotalSurface = read<std::int32_t>(file);
+  const auto numGlyphs = read<std::uint32_t>(file);
+
+  if (!file.good() || numGlyphs == 0 || numGlyphs >= 0xFFFF)
+  {
+    return false;
+  }
+
+  std::vector<CachedGlyph> glyphs(numGlyphs);
+  readArray(file, glyphs.data(), glyphs.size());
+
+  std::vector<unsigned char> pixels(std::size_t(width) * std::size_t(height));
+  readArray(file, pixels.data(), pixels.size());
+
+  if (!file.good())
+  {
+    return false;
+  }
+
+  // All data has been read successfully, now set up the atlas as if it had
+  // been built normally
+  atlas.TexPixelsAlpha8 =
+    static_cast<unsigned char*>(IM_ALLOC(pixels.size()));
+  std::memcpy(atlas.TexPixelsAlpha8, pixels.data(), pixels.size());
+  atlas.TexWidth = width;
+  atlas.TexHeight = height;
+  atlas.TexUvScale = texUvScale;
+  atlas.TexUvWhitePixel = texUvWhitePixel;
+  std::copy(std::begin(texUvLines), std::end(texUvLines), atlas.TexUvLines);
+#if IMGUI_VERSION_NUM >= 18700
+  // Since 1.87, IsBuilt() also checks this flag, which is normally set by
+  // Build()
+  atlas.TexReady = true;
+#endif
+
+  font.ContainerAtlas = &atlas;
+  font.ConfigData = &atlas.ConfigData[0];
+  font.ConfigDataCount = 1;
+  font.FontSize = fontSize;
+  font.Ascent = ascent;
+  font.Descent = descent;
+  font.FallbackChar = static_cast<ImWchar>(fallbackChar);
+  font.EllipsisChar = static_cast<ImWchar>(ellipsisChar);
+  font.MetricsTotalSurface = metricsTotalSurface;
+
+  font.Glyphs.resize(static_cast<int>(glyphs.size()));
+  for (std::size_t i = 0; i < glyphs.size(); ++i)
+  {
+    const auto& cached = glyphs[i];
+    auto& glyph = font.Glyphs[static_cast<int>(i)];
+    glyph = ImFontGlyph{};
+    glyph.Codepoint = cached.mCodepoint;
+    glyph.Visible = cached.mVisible;
+    glyph.AdvanceX = cached.mAdvanceX;
+    glyph.X0 = cached.mX0;
+    glyph.Y0 = cached.mY0;
+    glyph.X1 = cached.mX1;
+    glyph.Y1 = cached.mY1;
+    glyph.U0 = cached.mU0;
+    glyph.V0 = cached.mV0;
+    glyph.U1 = cached.mU1;
+    glyph.V1 = cached.mV1;
+  }
+
+  font.BuildLookupTable();
+  return true;
+}
+
+#endif
+
+
+void setUpFont(const std::optional<std::filesystem::path>& cacheDirectory)
+{
+  // We rasterize the font at a size that looks good at a 4k resolution, and
+  // then scale it down for smaller screen sizes.
+  ImFontConfig config;
+  config.SizePixels = IMGUI_DEFAULT_FONT_SIZE * INITIAL_UI_SCALE;
+
+  auto& atlas = *ImGui::GetIO().Fonts;
+  [[maybe_unused]] const auto pFont = atlas.AddFontDefault(&config);
+
+#ifdef RIGEL_CACHE_IMGUI_FONT_ATLAS
+  if (!cacheDirectory)
+  {
+    return;
+  }
+
+  const auto cachePath = *cacheDirectory / FONT_ATLAS_CACHE_FILE;
+  if (loadFontAtlas(cachePath, atlas, *pFont))
+  {
+    return;
+  }
+
+  // Building explicitly here instead of letting the renderer backend do it
+  // on first use, so that the result can be saved
+  atlas.Build();
+  saveFontAtlas(cachePath, atlas, *pFont);
+#else
+  static_cast<void>(cacheDirectory);
+#endif
+}
+
+
+/** Copy of ImDrawData which owns its data
+ *
+ * Dear ImGui's own containers allocate via ImGui::MemAlloc, which also
+ * updates statistics in the ImGui context. That's not safe to do on the
+ * render thread while the main thread is building the next frame, so the
+ * copy keeps its data in standard containers. For rendering, temporary
+ * ImDrawList objects are pointed at that data.
+ */
+struct DrawDataCopy
+{
+  struct DrawList
+  {
+    std::vector<ImDrawCmd> mCommands;
+    std::vector<ImDrawIdx> mIndices;
+    std::vector<ImDrawVert> mVertices;
+  };
+
+  std::vector<DrawList> mDrawLists;
+  int mTotalIdxCount = 0;
+  int mTotalVtxCount = 0;
+  ImVec2 mDisplayPos;
+  ImVec2 mDisplaySize;
+  ImVec2 mFramebufferScale;
+};
+
+
+template <typename T>
+std::vector<T> toStdVector(const ImVector<T>& vector)
+{
+  return std::vector<T>(vector.Data, vector.Data + vector.Size);
+}
+
+
+template <typename T>
+void pointTo(ImVector<T>& vector, std::vector<T>& data)
+{
+  vector.Data = data.data();
+  vector.Size = vector.Capacity = static_cast<int>(data.size());
+}
+
+
+template <typename T>
+void release(ImVector<T>& vector)
+{
+  vector.Data = nullptr;
+  vector.Size = vector.Capacity = 0;
+}
+
+
+DrawDataCopy copyDrawData(const ImDrawData& drawData)
+{
+  DrawDataCopy copy;
+  copy.mTotalIdxCount = drawData.TotalIdxCount;
+  copy.mTotalVtxCount = drawData.TotalVtxCount;
+  copy.mDisplayPos = drawData.DisplayPos;
+  copy.mDisplaySize = drawData.DisplaySize;
+  copy.mFramebufferScale = drawData.FramebufferScale;
+
+  copy.mDrawLists.reserve(drawData.CmdListsCount);
+  for (auto i = 0; i < drawData.CmdListsCount; ++i)
+  {
+    const auto& drawList = *drawData.CmdLists[i];
+    copy.mDrawLists.push_back(DrawDataCopy::DrawList{
+      toStdVector(drawList.CmdBuffer),
+      toStdVector(drawList.IdxBuffer),
+      toStdVector(drawList.VtxBuffer)});
+  }
+
+  return copy;
+}
+
+
+void renderDrawDataCopy(DrawDataCopy& copy)
+{
+  std::deque<ImDrawList> drawLists;
+  std::vector<ImDrawList*> drawListPointers;
+
+  for (auto& drawListData : copy.mDrawLists)
+  {
+    auto& drawList = drawLists.emplace_back(nullptr);
+    pointTo(drawList.CmdBuffer, drawListData.mCommands);
+    pointTo(drawList.IdxBuffer, drawListData.mIndices);
+    pointTo(drawList.VtxBuffer, drawListData.mVertices);
+    drawListPointers.push_back(&drawList);
+  }
+
+  ImDrawData drawData;
+  drawData.Valid = true;
+  drawData.CmdListsCount = static_cast<int>(drawListPointers.size());
+  drawData.TotalIdxCount = copy.mTotalIdxCount;
+  drawData.TotalVtxCount = copy.mTotalVtxCount;
+  drawData.DisplayPos = copy.mDisplayPos;
+  drawData.DisplaySize = copy.mDisplaySize;
+  drawData.FramebufferScale = copy.mFramebufferScale;
+#if IMGUI_VERSION_NUM >= 18973
+  pointTo(drawData.CmdLists, drawListPointers);
+#else
+  drawData.CmdLists = drawListPointers.data();
+#endif
+
+  ImGui_ImplOpenGL3_RenderDrawData(&drawData);
+
+  // The data is owned by the copy, make sure ImGui doesn't try to free it
+#if IMGUI_VERSION_NUM >= 18973
+  release(drawData.CmdLists);
+#endif
+  for (auto& drawList : drawLists)
+  {
+    release(drawList.CmdBuffer);
+    release(drawList.IdxBuffer);
+    release(drawList.VtxBuffer);
+  }
+}
+
+
+/** Off-screen copy of the last rendered UI, used by endFrameCached() */
+struct UiRenderCache
+{
+  UiRenderCache()
+    : mCompositeShader(opengl::ShaderSpec{
+        opengl::VertexLayout::PositionAndTexCoords,
+        COMPOSITE_TEXTURE_UNIT_NAMES,
+        COMPOSITE_VERTEX_SOURCE,
+        COMPOSITE_FRAGMENT_SOURCE})
+  {
+  }
+
+  opengl::Shader mCompositeShader;
+  opengl::SpriteBatch mBatch;
+  std::optional<opengl::RenderTarget> mTarget;
+  std::optional<std::uint64_t> mDrawDataHash;
+};
+
+std::unique_ptr<UiRenderCache> gpRenderCache;
+
+
+template <typename T>
+std::uint64_t hashVector(const ImVector<T>& vector, const std::uint64_t hash)
+{
+  return base::hashBytes(vector.Data, vector.size_in_bytes(), hash);
+}
+
+
+/** Hash everything that affects the rendered image
+ *
+ * Returns nothing if the image can't be determined from the draw data, which
+ * is the case when there are user callbacks, or when textures other than the
+ * font atlas are drawn. The contents of those textures can change without
+ * the draw data changing.
+ */
+std::optional<std::uint64_t> hashDrawData(
+  const ImDrawData& drawData,
+  const ImTextureID fontTextureId)
+{
+  auto hash = base::hashValue(drawData.DisplayPos);
+  hash = base::hashValue(drawData.DisplaySize, hash);
+  hash = base::hashValue(drawData.FramebufferScale, hash);
+
+  for (auto i = 0; i < drawData.CmdListsCount; ++i)
+  {
+    const auto& drawList = *drawData.CmdLists[i];
+
+    // ImDrawCmd contains padding, so its members are hashed one by one
+    for (const auto& command : drawList.CmdBuffer)
+    {
+      if (command.UserCallback || command.TextureId != fontTextureId)
+      {
+        return std::nullopt;
+      }
+
+      hash = base::hashValue(command.ClipRect, hash);
+      hash = base::hashValue(command.TextureId, hash);
+      hash = base::hashValue(command.VtxOffset, hash);
+      hash = base::hashValue(command.IdxOffset, hash);
+      hash = base::hashValue(command.ElemCount, hash);
+    }
+
+    hash = hashVector(drawList.IdxBuffer, hash);
+    hash = hashVector(drawList.VtxBuffer, hash);
+  }
+
+  return hash;
+}
+
+
+void renderIntoCache(UiRenderCache& cache, ImDrawData& drawData)
+{
+  GLint previousFramebuffer = 0;
+  GLfloat previousClearColor[4] = {};
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glGetFloatv(GL_COLOR_CLEAR_VALUE, previousClearColor);
+  const auto scissorWasEnabled = glIsEnabled(GL_SCISSOR_TEST);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, cache.mTarget->framebuffer());
+  glDisable(GL_SCISSOR_TEST);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  // Restores all state it modifies, so glStateCache() stays valid
+  ImGui_ImplOpenGL3_RenderDrawData(&drawData);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previousFramebuffer));
+  glClearColor(
+    previousClearColor[0],
+    previousClearColor[1],
+    previousClearColor[2],
+    previousClearColor[3]);
+  if (scissorWasEnabled)
+  {
+    glEnable(GL_SCISSOR_TEST);
+  }
+}
+
+
+void compositeCachedUi(UiRenderCache& cache)
+{
+  auto& stateCache = opengl::glStateCache();
+
+  // The cached image was rendered with regular alpha blending on top of
+  // a transparent background, which makes its color premultiplied.
+  stateCache.setBlendEnabled(true);
+  stateCache.setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  stateCache.setViewport(
+    0, 0, GLsizei(cache.mTarget->width()), GLsizei(cache.mTarget->height()));
+
+  cache.mBatch.drawQuad(
+    cache.mCompositeShader,
+    cache.mTarget->texture().handle(),
+    {{-1.0f, -1.0f}, {2.0f, 2.0f}});
+  cache.mBatch.flush();
+  cache.mBatch.resetStats();
 }
 
 } // namespace
@@ -85,7 +672,8 @@ void updateUiScale(const int, const int newHeight)
 void init(
   SDL_Window* pWindow,
   void* pGlContext,
-  const std::optional<std::filesystem::path>& preferencesPath)
+  const std::optional<std::filesystem::path>& preferencesPath,
+  const std::optional<std::filesystem::path>& cacheDirectory)
 {
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
@@ -94,17 +682,20 @@ void init(
   ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
   ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;
 
-  {
-    // We rasterize the font at a size that looks good at a 4k resolution, and
-    // then scale it down for smaller screen sizes.
-    ImFontConfig config;
-    config.SizePixels = IMGUI_DEFAULT_FONT_SIZE * INITIAL_UI_SCALE;
-    ImGui::GetIO().Fonts->AddFontDefault(&config);
+  setUpFont(cacheDirectory);
+
+  // AntiAliasedLinesUseTex requires using bilinear filtering, but we don't use
+  // it (see our version of imgui_impl_opengl3.cpp).
+  gBaseStyle = ImGuiStyle{};
+  gBaseStyle.AntiAliasedLinesUseTex = false;
 
+  {
     int width = 0;
     int height = 0;
     SDL_GL_GetDrawableSize(pWindow, &width, &height);
-    updateUiScale(width, height);
+    gUiScaleFactor = 0.0f;
+    gPendingUiScaleHeight.reset();
+    updateUiScale(height);
   }
 
   ImGui_ImplSDL2_InitForOpenGL(pWindow, pGlContext);
@@ -113,6 +704,10 @@ void init(
   // GL ES as well as regular GL.
   ImGui_ImplOpenGL3_Init(nullptr);
 
+  // Normally done lazily by the first beginFrame(). Doing it here means that
+  // beginFrame() never needs the GL context.
+  ImGui_ImplOpenGL3_CreateDeviceObjects();
+
   if (preferencesPath)
   {
     const auto iniFilePath = *preferencesPath / "ImGui.ini";
@@ -128,6 +723,10 @@ void init(
 
 void shutdown()
 {
+  gpRenderCache.reset();
+  gNumFramesUntilSettled = 0;
+  gLastFrameWasUnchanged = false;
+
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
@@ -139,12 +738,14 @@ void shutdown()
 bool handleEvent(const SDL_Event& event)
 {
   const auto handledEvent = ImGui_ImplSDL2_ProcessEvent(&event);
+  gNumFramesUntilSettled = NUM_FRAMES_TO_SETTLE_AFTER_INPUT;
 
   if (
     event.type == SDL_WINDOWEVENT &&
     event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
   {
-    updateUiScale(event.window.data1, event.window.data2);
+    gPendingUiScaleHeight = event.window.data2;
+    gLastSizeChangeTime = base::Clock::now();
   }
 
   return handledEvent && shouldConsumeEvent(event);
@@ -153,6 +754,8 @@ bool handleEvent(const SDL_Event& event)
 
 void beginFrame(SDL_Window* pWindow)
 {
+  applyPendingUiScaleChange();
+
   ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplSDL2_NewFrame(pWindow);
   ImGui::NewFrame();
@@ -165,4 +768,75 @@ void endFrame()
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+
+std::function<void()> endFrameDeferred()
+{
+  ImGui::Render();
+
+  // std::function requires a copyable function object
+  auto pCopy =
+    std::make_shared<DrawDataCopy>(copyDrawData(*ImGui::GetDrawData()));
+  return [pCopy = std::move(pCopy)]() { renderDrawDataCopy(*pCopy); };
+}
+
+bool endFrameCached()
+{
+  ImGui::Render();
+
+  auto& drawData = *ImGui::GetDrawData();
+  const auto width =
+    static_cast<int>(drawData.DisplaySize.x * drawData.FramebufferScale.x);
+  const auto height =
+    static_cast<int>(drawData.DisplaySize.y * drawData.FramebufferScale.y);
+
+  if (gNumFramesUntilSettled > 0)
+  {
+    --gNumFramesUntilSettled;
+  }
+
+  if (width <= 0 || height <= 0)
+  {
+    gLastFrameWasUnchanged = true;
+    return false;
+  }
+
+  if (!gpRenderCache)
+  {
+    gpRenderCache = std::make_unique<UiRenderCache>();
+  }
+
+  auto& cache = *gpRenderCache;
+  if (
+    !cache.mTarget || std::size_t(width) != cache.mTarget->width() ||
+    std::size_t(height) != cache.mTarget->height())
+  {
+    // Release the old target first to keep peak memory usage down
+    cache.mTarget.reset();
+    cache.mTarget.emplace(std::size_t(width), std::size_t(height));
+    cache.mDrawDataHash.reset();
+  }
+
+  const auto hash =
+    hashDrawData(drawData, ImGui::GetIO().Fonts->TexID);
+  const auto needsRendering = !hash || hash != cache.mDrawDataHash;
+
+  if (needsRendering)
+  {
+    renderIntoCache(cache, drawData);
+    cache.mDrawDataHash = hash;
+  }
+
+  compositeCachedUi(cache);
+
+  gLastFrameWasUnchanged = !needsRendering;
+  return needsRendering;
+}
+
+
+bool isIdle()
+{
+  return gLastFrameWasUnchanged && gNumFramesUntilSettled == 0 &&
+    !gPendingUiScaleHeight;
+}
+
 } // namespace rigel::ui::imgui_integration
@@ -0,0 +1,178 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/asset_loader.hpp>
+#include <rigel/base/image_loading.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace rigel::base;
+
+
+namespace
+{
+
+Image makeTestImage(const std::size_t width, const std::size_t height)
+{
+  PixelBuffer pixels;
+
+  for (auto i = 0u; i < width * height; ++i)
+  {
+    pixels.push_back(Color{std::uint8_t(i), 100, 200, 255});
+  }
+
+  return Image{std::move(pixels), width, height};
+}
+
+
+/** Wait until all previously submitted work has finished
+ *
+ * Only works with a single worker thread, which executes tasks in order.
+ */
+void waitForWorker(AssetLoader& loader, const std::filesystem::path& path)
+{
+  loader.loadImageAsync(path).wait();
+}
+
+} // namespace
+
+
+TEST_CASE("Asset loader")
+{
+  const auto directory =
+    std::filesystem::temp_directory_path() / "rigel_asset_loader_test";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+
+  const auto imageA = makeTestImage(4, 3);
+  const auto imageB = makeTestImage(7, 5);
+  const auto pathA = directory / "a.png";
+  const auto pathB = directory / "b.png";
+  const auto missingPath = directory / "missing.png";
+  REQUIRE(savePng(pathA, imageA));
+  REQUIRE(savePng(pathB, imageB));
+
+  SECTION("Futures receive the decoded images")
+  {
+    AssetLoader loader{2};
+
+    auto results = loader.loadImagesAsync({pathA, missingPath, pathB});
+    REQUIRE(results.size() == 3);
+
+    const auto a = results[0].get();
+    const auto missing = results[1].get();
+    const auto b = results[2].get();
+
+    REQUIRE(a);
+    CHECK(a->pixelData() == imageA.pixelData());
+    CHECK(!missing);
+    REQUIRE(b);
+    CHECK(b->pixelData() == imageB.pixelData());
+  }
+
+  SECTION("Callbacks are invoked by processCompletions in completion order")
+  {
+    AssetLoader loader{1};
+
+    std::vector<std::filesystem::path> loadedPaths;
+    std::vector<bool> hadImage;
+    const auto mainThreadId = std::this_thread::get_id();
+
+    loader.requestImages(
+      {pathB, missingPath, pathA},
+      [&](const std::filesystem::path& path, std::optional<Image> image) {
+        CHECK(std::this_thread::get_id() == mainThreadId);
+        loadedPaths.push_back(path);
+        hadImage.push_back(image.has_value());
+      });
+    CHECK(loader.numPendingRequests() == 3);
+
+    waitForWorker(loader, pathA);
+    CHECK(loadedPaths.empty());
+
+    CHECK(loader.processCompletions() == 3);
+    CHECK(loader.numPendingRequests() == 0);
+    CHECK(
+      loadedPaths == std::vector<std::filesystem::path>{
+        pathB, missingPath, pathA});
+    CHECK(hadImage == std::vector<bool>{true, false, true});
+
+    CHECK(loader.processCompletions() == 0);
+  }
+
+  SECTION("Pending count covers requests not processed yet")
+  {
+    AssetLoader loader{1};
+    auto numLoaded = 0;
+    const auto onLoaded = [&](const std::filesystem::path&,
+                              std::optional<Image>) { ++numLoaded; };
+
+    loader.requestImages({pathA, pathB}, onLoaded);
+    waitForWorker(loader, pathA);
+    loader.requestImages({pathA}, onLoaded);
+    CHECK(loader.numPendingRequests() == 3);
+
+    // The last request may or may not have completed already
+    const auto numProcessed = loader.processCompletions();
+    CHECK(numProcessed >= 2);
+    CHECK(loader.numPendingRequests() == 3 - numProcessed);
+
+    waitForWorker(loader, pathA);
+    loader.processCompletions();
+    CHECK(loader.numPendingRequests() == 0);
+    CHECK(numLoaded == 3);
+  }
+
+  SECTION("Errors are rethrown after invoking the remaining callbacks")
+  {
+    AssetLoader loader{1};
+    std::vector<std::filesystem::path> loadedPaths;
+
+    loader.requestImages(
+      {pathA, pathB, missingPath},
+      [&](const std::filesystem::path& path, std::optional<Image>) {
+        loadedPaths.push_back(path);
+        if (path == pathA)
+        {
+          throw std::runtime_error("Callback failed");
+        }
+      });
+    waitForWorker(loader, pathA);
+
+    CHECK_THROWS_AS(loader.processCompletions(), std::runtime_error);
+    CHECK(
+      loadedPaths == std::vector<std::filesystem::path>{
+        pathA, pathB, missingPath});
+    CHECK(loader.numPendingRequests() == 0);
+
+    // Nothing is delivered twice
+    CHECK(loader.processCompletions() == 0);
+  }
+
+  std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,289 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/byte_buffer.hpp>
+#include <rigel/base/mapped_file.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const auto TEST_DATA = rigel::base::ByteBuffer{
+  0x01, 0x34, 0x12, 0x78, 0x56, 0x34, 0x12, 0xFF, 0xFF, 0xFF, 0x7F};
+
+
+std::filesystem::path writeTestFile(const rigel::base::ByteBuffer& data)
+{
+  const auto path =
+    std::filesystem::temp_directory_path() / "rigel_test_byte_buffer.bin";
+  rigel::base::saveToFile(data, path);
+  return path;
+}
+
+} // namespace
+
+
+TEST_CASE("LeStreamReader reads little-endian values")
+{
+  using namespace rigel::base;
+
+  SECTION("From byte buffer")
+  {
+    LeStreamReader reader{TEST_DATA};
+
+    CHECK(reader.readU8() == 0x01);
+    CHECK(reader.readU16() == 0x1234);
+    CHECK(reader.readU32() == 0x12345678);
+    CHECK(reader.peekS32() == 0x7FFFFFFF);
+    CHECK(reader.numBytesLeft() == 4);
+    CHECK(reader.currentIter() == TEST_DATA.begin() + 7);
+    reader.skipBytes(4);
+    CHECK(!reader.hasData());
+    CHECK_THROWS(reader.readU8());
+  }
+
+  SECTION("From array view")
+  {
+    LeStreamReader reader{ArrayView<std::uint8_t>{TEST_DATA}};
+
+    CHECK(reader.readU8() == 0x01);
+    CHECK(reader.readU16() == 0x1234);
+    CHECK(reader.readU32() == 0x12345678);
+    CHECK(reader.numBytesLeft() == 4);
+    CHECK_THROWS(reader.skipBytes(5));
+
+    // There is no ByteBuffer to return an iterator into
+    CHECK_THROWS_AS(reader.currentIter(), std::logic_error);
+  }
+
+  SECTION("From string")
+  {
+    const auto text = std::string{"\x34\x12\x78\x56\x34\x12"};
+    LeStreamReader reader{text};
+
+    CHECK(reader.readU16() == 0x1234);
+    CHECK(reader.readU32() == 0x12345678);
+    CHECK(!reader.hasData());
+    CHECK_THROWS_AS(reader.currentIter(), std::logic_error);
+  }
+
+  SECTION("Empty buffer")
+  {
+    const auto empty = ByteBuffer{};
+    LeStreamReader reader{empty};
+
+    CHECK(!reader.hasData());
+    CHECK(reader.numBytesLeft() == 0);
+    CHECK(reader.currentIter() == empty.end());
+    CHECK_THROWS(reader.readU8());
+  }
+
+  SECTION("Failed read doesn't consume data")
+  {
+    const auto data = ByteBuffer{0x01, 0x02, 0x03};
+    LeStreamReader reader{data};
+
+    CHECK_THROWS(reader.readU32());
+    CHECK(reader.numBytesLeft() == 3);
+    CHECK(reader.readU24() == 0x030201);
+  }
+
+  SECTION("Signed values")
+  {
+    const auto data = ByteBuffer{0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x80};
+    LeStreamReader reader{data};
+
+    CHECK(reader.readS16() == -2);
+    CHECK(reader.readS24() == -1);
+    CHECK(reader.readS16() == -32768);
+  }
+}
+
+
+TEST_CASE("LeStreamReader bulk reads")
+{
+  using namespace rigel::base;
+
+  SECTION("Arrays")
+  {
+    LeStreamReader reader{TEST_DATA};
+    reader.skipBytes(1);
+
+    std::uint16_t words[2];
+    reader.readArrayU16(2, words);
+    CHECK(words[0] == 0x1234);
+    CHECK(words[1] == 0x5678);
+
+    std::uint32_t dword = 0;
+    reader.readArrayU32(1, &dword);
+    CHECK(dword == 0xFFFF1234);
+
+    CHECK_THROWS(reader.readArrayU16(2, words));
+    CHECK(reader.numBytesLeft() == 2);
+  }
+
+  SECTION("Batches")
+  {
+    const auto data = ByteBuffer{1, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0};
+    LeStreamReader reader{data};
+
+    const auto values = reader.readU32Batch<3>();
+    CHECK(values[0] == 1);
+    CHECK(values[1] == 2);
+    CHECK(values[2] == 3);
+  }
+
+  SECTION("Huge counts don't overflow the bounds check")
+  {
+    LeStreamReader reader{TEST_DATA};
+    std::uint32_t dummy = 0;
+
+    CHECK_THROWS(reader.readArrayU32(SIZE_MAX / 2, &dummy));
+  }
+
+  SECTION("Fixed-size strings")
+  {
+    const auto data = ByteBuffer{'a', 'b', 0, 'c', 'd', 'e', 'f'};
+    LeStreamReader reader{data};
+
+    CHECK(readFixedSizeString(reader, 4) == "ab");
+    CHECK(readFixedSizeString(reader, 3) == "def");
+  }
+}
+
+
+TEST_CASE("LeStreamReader performance", "[.][benchmark]")
+{
+  using namespace rigel::base;
+
+  constexpr auto NUM_VALUES = 64 * 1024;
+  const auto data = ByteBuffer(NUM_VALUES * sizeof(std::uint32_t), 0xAB);
+
+  // This is how readU32() used to be implemented, with a bounds check for
+  // each individual byte.
+  BENCHMARK("Per-byte readU8 x 4")
+  {
+    LeStreamReader reader{data};
+    auto sum = std::uint32_t{0};
+    for (auto i = 0; i < NUM_VALUES; ++i)
+    {
+      const auto b0 = reader.readU8();
+      const auto b1 = reader.readU8();
+      const auto b2 = reader.readU8();
+      const auto b3 = reader.readU8();
+      sum += b0 | (b1 << 8) | (b2 << 16) | (std::uint32_t(b3) << 24);
+    }
+    return sum;
+  };
+
+  BENCHMARK("LeStreamReader::readU32")
+  {
+    LeStreamReader reader{data};
+    auto sum = std::uint32_t{0};
+    for (auto i = 0; i < NUM_VALUES; ++i)
+    {
+      sum += reader.readU32();
+    }
+    return sum;
+  };
+
+  BENCHMARK("LeStreamReader::readArrayU32")
+  {
+    LeStreamReader reader{data};
+    std::vector<std::uint32_t> values(NUM_VALUES);
+    reader.readArrayU32(values.size(), values.data());
+    return values.back();
+  };
+}
+
+
+TEST_CASE("Memory-mapped files")
+{
+  using namespace rigel::base;
+
+  SECTION("Contents match the file")
+  {
+    const auto path = writeTestFile(TEST_DATA);
+
+    {
+      const auto file = mapFileOrThrow(path);
+
+      REQUIRE(file.size() == TEST_DATA.size());
+      CHECK(std::equal(
+        file.data().begin(), file.data().end(), TEST_DATA.begin()));
+
+      LeStreamReader reader{file.data()};
+      reader.skipBytes(3);
+      CHECK(reader.readU32() == 0x12345678);
+    }
+
+    std::filesystem::remove(path);
+  }
+
+  SECTION("Empty file")
+  {
+    const auto path = writeTestFile({});
+
+    {
+      const auto file = tryMapFile(path);
+
+      REQUIRE(file);
+      CHECK(file->empty());
+      CHECK(file->data().empty());
+    }
+
+    std::filesystem::remove(path);
+  }
+
+  SECTION("Non-existent file")
+  {
+    const auto path =
+      std::filesystem::temp_directory_path() / "rigel_no_such_file.bin";
+
+    CHECK(!tryMapFile(path));
+    CHECK_THROWS(mapFileOrThrow(path));
+  }
+
+  SECTION("Moving transfers ownership of the mapping")
+  {
+    const auto path = writeTestFile(TEST_DATA);
+
+    {
+      auto file = mapFileOrThrow(path);
+      const auto pData = file.data().data();
+
+      auto movedTo = std::move(file);
+
+      CHECK(movedTo.data().data() == pData);
+      CHECK(movedTo.size() == TEST_DATA.size());
+      CHECK(file.empty());
+    }
+
+    std::filesystem::remove(path);
+  }
+}
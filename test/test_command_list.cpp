@@ -0,0 +1,110 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <rigel/base/command_list.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+using namespace rigel::base;
+
+
+TEST_CASE("Command list")
+{
+  CommandList commands;
+  std::vector<int> calls;
+
+  SECTION("Commands run in order, and the list is cleared afterwards")
+  {
+    for (auto i = 0; i < 1000; ++i)
+    {
+      commands.add([&calls, i]() { calls.push_back(i); });
+    }
+
+    CHECK(commands.size() == 1000);
+
+    commands.execute();
+
+    REQUIRE(calls.size() == 1000);
+    CHECK(calls.front() == 0);
+    CHECK(calls.back() == 999);
+    CHECK(commands.empty());
+  }
+
+  SECTION("Move-only and large commands are supported")
+  {
+    auto pValue = std::make_unique<int>(42);
+    commands.add([&calls, pValue = std::move(pValue)]() {
+      calls.push_back(*pValue);
+    });
+
+    std::array<int, 32 * 1024> bigArray{};
+    bigArray.back() = 7;
+    commands.add([&calls, bigArray]() { calls.push_back(bigArray.back()); });
+
+    commands.execute();
+
+    CHECK(calls == std::vector<int>{42, 7});
+  }
+
+  SECTION("Commands are destroyed when clearing, without running")
+  {
+    auto pShared = std::make_shared<int>(0);
+    commands.add([pShared]() {});
+    CHECK(pShared.use_count() == 2);
+
+    commands.clear();
+    CHECK(pShared.use_count() == 1);
+  }
+
+  SECTION("Remaining commands are destroyed if one throws")
+  {
+    auto pShared = std::make_shared<int>(0);
+    commands.add([]() { throw std::runtime_error("failed"); });
+    commands.add([pShared, &calls]() { calls.push_back(1); });
+
+    CHECK_THROWS(commands.execute());
+    CHECK(calls.empty());
+    CHECK(commands.empty());
+    CHECK(pShared.use_count() == 1);
+  }
+
+  SECTION("List can be reused")
+  {
+    for (auto round = 0; round < 3; ++round)
+    {
+      for (auto i = 0; i < 10000; ++i)
+      {
+        commands.add([&calls, round]() { calls.push_back(round); });
+      }
+
+      commands.execute();
+    }
+
+    REQUIRE(calls.size() == 30000);
+    CHECK(calls.back() == 2);
+  }
+}
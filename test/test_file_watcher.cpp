@@ -0,0 +1,95 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/file_watcher.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+
+using namespace rigel::base;
+
+
+namespace
+{
+
+void writeFile(const std::filesystem::path& path, const std::string& contents)
+{
+  std::ofstream file(path);
+  file << contents;
+}
+
+} // namespace
+
+
+TEST_CASE("File watcher")
+{
+  const auto directory =
+    std::filesystem::temp_directory_path() / "rigel_file_watcher_test";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+
+  const auto watchedPath = directory / "watched.txt";
+  const auto otherPath = directory / "other.txt";
+  writeFile(watchedPath, "a");
+  writeFile(otherPath, "a");
+
+  FileWatcher watcher;
+  watcher.watch(watchedPath);
+  CHECK(watcher.pollChanges().empty());
+
+  // Make sure that modification times differ, for platforms without
+  // inotify
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+
+  SECTION("Writing to a file is reported once")
+  {
+    writeFile(watchedPath, "b");
+    writeFile(watchedPath, "c");
+    writeFile(otherPath, "b");
+
+    const auto changes = watcher.pollChanges();
+    REQUIRE(changes.size() == 1);
+    CHECK(std::filesystem::equivalent(changes[0], watchedPath));
+    CHECK(watcher.pollChanges().empty());
+  }
+
+  SECTION("Replacing a file by renaming is reported")
+  {
+    const auto tempPath = directory / "watched.txt.tmp";
+    writeFile(tempPath, "b");
+    std::filesystem::rename(tempPath, watchedPath);
+
+    const auto changes = watcher.pollChanges();
+    REQUIRE(changes.size() == 1);
+    CHECK(std::filesystem::equivalent(changes[0], watchedPath));
+
+    // The file is still watched after being replaced
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    writeFile(watchedPath, "c");
+    CHECK(watcher.pollChanges().size() == 1);
+  }
+
+  std::filesystem::remove_all(directory);
+}
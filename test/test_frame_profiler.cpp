@@ -0,0 +1,153 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/warnings.hpp>
+#include <rigel/opengl/frame_profiler.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+
+using namespace rigel::opengl;
+
+
+// With GPU timing disabled, the profiler doesn't make any OpenGL calls, so
+// it can be tested without a context.
+TEST_CASE("Frame profiler (CPU only)")
+{
+  FrameProfiler profiler{false};
+
+  SECTION("GPU timing is reported as unavailable")
+  {
+    CHECK(!profiler.isGpuTimingAvailable());
+  }
+
+  SECTION("Timings are available right after the frame ends")
+  {
+    profiler.beginFrame();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    profiler.endFrame();
+
+    const auto& timings = profiler.latestTimings();
+    CHECK(timings.cpuTime >= 0.002);
+    CHECK(!timings.gpuTime);
+    CHECK(timings.scopes.empty());
+
+    // There is no previous frame to measure against
+    CHECK(timings.totalElapsed == 0.0);
+  }
+
+  SECTION("Total elapsed time covers the previous frame")
+  {
+    profiler.beginFrame();
+    profiler.endFrame();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    profiler.beginFrame();
+    profiler.endFrame();
+
+    const auto& timings = profiler.latestTimings();
+    CHECK(timings.totalElapsed >= 0.002);
+    CHECK(timings.totalElapsed >= timings.cpuTime);
+  }
+
+  SECTION("Scopes are reported in start order with their nesting depth")
+  {
+    profiler.beginFrame();
+    {
+      auto outer = profiler.scope("Outer");
+      {
+        auto inner = profiler.scope("Inner");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    {
+      auto second = profiler.scope("Second");
+    }
+    profiler.endFrame();
+
+    const auto& scopes = profiler.latestTimings().scopes;
+    REQUIRE(scopes.size() == 3);
+
+    CHECK(std::string{scopes[0].name} == "Outer");
+    CHECK(scopes[0].depth == 0);
+    CHECK(std::string{scopes[1].name} == "Inner");
+    CHECK(scopes[1].depth == 1);
+    CHECK(std::string{scopes[2].name} == "Second");
+    CHECK(scopes[2].depth == 0);
+
+    CHECK(scopes[1].cpuTime >= 0.001);
+    CHECK(scopes[0].cpuTime >= scopes[1].cpuTime);
+    CHECK(!scopes[0].gpuTime);
+    CHECK(profiler.latestTimings().cpuTime >= scopes[0].cpuTime);
+  }
+
+  SECTION("Each frame replaces the previous frame's scopes")
+  {
+    profiler.beginFrame();
+    {
+      auto scope = profiler.scope("First frame");
+    }
+    profiler.endFrame();
+
+    profiler.beginFrame();
+    profiler.endFrame();
+
+    CHECK(profiler.latestTimings().scopes.empty());
+  }
+
+  SECTION("Scopes outside of a frame are ignored")
+  {
+    {
+      auto scope = profiler.scope("Ignored");
+    }
+
+    profiler.beginFrame();
+    profiler.endFrame();
+
+    CHECK(profiler.latestTimings().scopes.empty());
+  }
+
+  SECTION("Unbalanced frames and scopes are rejected")
+  {
+    CHECK_THROWS_AS(profiler.endFrame(), std::runtime_error);
+
+    profiler.beginFrame();
+    CHECK_THROWS_AS(profiler.beginFrame(), std::runtime_error);
+
+    profiler.beginScope("Not ended");
+    CHECK_THROWS_AS(profiler.endFrame(), std::runtime_error);
+
+    // The broken frame is discarded, and doesn't block the next one
+    profiler.beginFrame();
+    {
+      auto scope = profiler.scope("Balanced");
+    }
+    CHECK_NOTHROW(profiler.endFrame());
+
+    const auto& scopes = profiler.latestTimings().scopes;
+    REQUIRE(scopes.size() == 1);
+    CHECK(std::string{scopes[0].name} == "Balanced");
+    CHECK(scopes[0].depth == 0);
+  }
+}
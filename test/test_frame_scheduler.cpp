@@ -0,0 +1,117 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <rigel/base/frame_scheduler.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+
+using namespace rigel::base;
+
+
+TEST_CASE("Frame scheduler")
+{
+  SECTION("Frame rate cap")
+  {
+    FrameSchedulerConfig config;
+    config.maxFps = 200.0;
+    FrameScheduler scheduler{config};
+
+    const auto start = Clock::now();
+    for (auto i = 0; i < 10; ++i)
+    {
+      scheduler.beginFrame();
+    }
+
+    // The first frame starts right away, the remaining 9 are 5 ms apart
+    CHECK(Clock::now() - start >= std::chrono::milliseconds{45});
+    CHECK(scheduler.stats().numFrames == 10);
+  }
+
+  SECTION("Fixed time step accounts for all elapsed time")
+  {
+    FrameSchedulerConfig config;
+    config.fixedTimeStep = 0.004;
+    config.maxUpdatesPerFrame = 1000;
+    FrameScheduler scheduler{config};
+
+    auto totalElapsed = 0.0;
+    auto totalUpdates = 0;
+    auto lastAlpha = 0.0;
+
+    for (auto i = 0; i < 10; ++i)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds{3});
+
+      const auto timing = scheduler.beginFrame();
+      CHECK(timing.frameNumber == std::uint64_t(i));
+      CHECK(timing.interpolationAlpha >= 0.0);
+      CHECK(timing.interpolationAlpha < 1.0);
+
+      totalElapsed += timing.elapsed;
+      totalUpdates += timing.numUpdates;
+      lastAlpha = timing.interpolationAlpha;
+    }
+
+    const auto accountedTime =
+      (totalUpdates + lastAlpha) * config.fixedTimeStep;
+    CHECK(std::abs(accountedTime - totalElapsed) < 1e-9);
+    CHECK(scheduler.stats().numDroppedUpdates == 0);
+  }
+
+  SECTION("Late frames are detected")
+  {
+    FrameSchedulerConfig config;
+    config.maxFps = 500.0;
+    FrameScheduler scheduler{config};
+
+    scheduler.beginFrame();
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    const auto timing = scheduler.beginFrame();
+
+    CHECK(timing.previousFrameWasLate);
+    CHECK(timing.stats.numLateFrames == 1);
+    CHECK(timing.stats.worstLateness > 0.005);
+  }
+
+  SECTION("Idle waits don't count as late frames")
+  {
+    FrameSchedulerConfig config;
+    config.maxFps = 500.0;
+    FrameScheduler scheduler{config};
+
+    scheduler.beginFrame();
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    scheduler.onIdleWait();
+    const auto timing = scheduler.beginFrame();
+
+    CHECK(!timing.previousFrameWasLate);
+    CHECK(timing.stats.numLateFrames == 0);
+    CHECK(timing.elapsed >= 0.01);
+
+    // The schedule restarts after the wait, so the next frame is on time
+    const auto nextTiming = scheduler.beginFrame();
+    CHECK(!nextTiming.previousFrameWasLate);
+  }
+}
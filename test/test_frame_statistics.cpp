@@ -0,0 +1,85 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <rigel/base/frame_statistics.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+#include <nlohmann/json.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <sstream>
+
+
+using namespace rigel::base;
+
+
+TEST_CASE("Frame time summary")
+{
+  SECTION("Empty input gives all zeros")
+  {
+    const auto summary = summarizeFrameTimes({});
+    CHECK(summary.numFrames == 0);
+    CHECK(summary.max == 0.0);
+    CHECK(summary.p99 == 0.0);
+  }
+
+  SECTION("Percentiles use nearest rank")
+  {
+    // 1..100, in reverse order
+    std::vector<double> frameTimes;
+    for (int i = 100; i > 0; --i)
+    {
+      frameTimes.push_back(i);
+    }
+
+    const auto summary = summarizeFrameTimes(frameTimes);
+    CHECK(summary.numFrames == 100);
+    CHECK(summary.min == 1.0);
+    CHECK(summary.max == 100.0);
+    CHECK(summary.mean == 50.5);
+    CHECK(summary.median == 50.0);
+    CHECK(summary.p90 == 90.0);
+    CHECK(summary.p95 == 95.0);
+    CHECK(summary.p99 == 99.0);
+  }
+
+  SECTION("Single value")
+  {
+    const auto summary = summarizeFrameTimes({0.016});
+    CHECK(summary.min == 0.016);
+    CHECK(summary.median == 0.016);
+    CHECK(summary.p99 == 0.016);
+  }
+}
+
+
+TEST_CASE("Frame times JSON output")
+{
+  std::stringstream stream;
+  // Exactly representable, to allow exact comparisons
+  writeFrameTimesJson(stream, {0.125, 0.25, 0.5});
+
+  const auto json = nlohmann::json::parse(stream.str());
+  CHECK(json["summary"]["numFrames"] == 3);
+  CHECK(json["summary"]["max"] == 500.0);
+  CHECK(json["summary"]["median"] == 250.0);
+  REQUIRE(json["frameTimes"].size() == 3);
+  CHECK(json["frameTimes"][0] == 125.0);
+}
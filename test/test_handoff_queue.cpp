@@ -0,0 +1,101 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <rigel/base/handoff_queue.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+using namespace rigel::base;
+
+
+TEST_CASE("Handoff queue")
+{
+  SECTION("Items arrive in order across threads")
+  {
+    constexpr auto NUM_ITEMS = 10000;
+
+    HandoffQueue<std::vector<int>> queue{3};
+    std::vector<int> received;
+
+    std::thread consumer{[&]() {
+      while (auto pItem = queue.beginRead())
+      {
+        received.insert(received.end(), pItem->begin(), pItem->end());
+        pItem->clear();
+        queue.endRead();
+      }
+    }};
+
+    for (auto i = 0; i < NUM_ITEMS; ++i)
+    {
+      auto pItem = queue.beginWrite();
+      REQUIRE(pItem);
+      CHECK(pItem->empty());
+      pItem->push_back(i);
+      queue.endWrite();
+    }
+
+    queue.close();
+    consumer.join();
+
+    REQUIRE(received.size() == NUM_ITEMS);
+    for (auto i = 0; i < NUM_ITEMS; ++i)
+    {
+      REQUIRE(received[i] == i);
+    }
+  }
+
+  SECTION("Filled slots can be read after closing")
+  {
+    HandoffQueue<int> queue{2};
+    *queue.beginWrite() = 1;
+    queue.endWrite();
+    queue.close();
+
+    auto pItem = queue.beginRead();
+    REQUIRE(pItem);
+    CHECK(*pItem == 1);
+    queue.endRead();
+
+    CHECK(queue.beginRead() == nullptr);
+    CHECK(queue.beginWrite() == nullptr);
+  }
+
+  SECTION("Closing wakes up a waiting producer")
+  {
+    HandoffQueue<int> queue{1};
+    queue.beginWrite();
+    queue.endWrite();
+
+    std::thread closer{[&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      queue.close();
+    }};
+
+    CHECK(queue.beginWrite() == nullptr);
+    closer.join();
+  }
+}
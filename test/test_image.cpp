@@ -0,0 +1,441 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/image.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+
+using namespace rigel::base;
+
+
+namespace
+{
+
+/** Image with one pixel for each combination of color and alpha value */
+Image makeAllCombinationsImage()
+{
+  PixelBuffer pixels;
+  pixels.reserve(256 * 256);
+
+  for (auto alpha = 0; alpha < 256; ++alpha)
+  {
+    for (auto value = 0; value < 256; ++value)
+    {
+      pixels.push_back(Color{
+        std::uint8_t(value),
+        std::uint8_t(255 - value),
+        std::uint8_t(value ^ 0x5A),
+        std::uint8_t(alpha)});
+    }
+  }
+
+  return Image{std::move(pixels), 256, 256};
+}
+
+
+bool isPremultipliedVersionOf(
+  const Image& premultiplied,
+  const Image& original)
+{
+  const auto premultiply = [](const std::uint8_t value, const std::uint8_t a) {
+    return std::uint8_t(value * a / 255);
+  };
+
+  for (auto i = 0u; i < original.pixelData().size(); ++i)
+  {
+    const auto& source = original.pixelData()[i];
+    const auto expected = Color{
+      premultiply(source.r, source.a),
+      premultiply(source.g, source.a),
+      premultiply(source.b, source.a),
+      source.a};
+
+    if (
+      premultiplied.pixelData()[i] != expected ||
+      premultiplied.pixelData()[i] != source.asPremultiplied())
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+/** Image where each pixel encodes its own position */
+Image makeNumberedImage(const std::size_t width, const std::size_t height)
+{
+  PixelBuffer pixels;
+
+  for (auto y = 0u; y < height; ++y)
+  {
+    for (auto x = 0u; x < width; ++x)
+    {
+      pixels.push_back(Color{std::uint8_t(x), std::uint8_t(y), 0, 255});
+    }
+  }
+
+  return Image{std::move(pixels), width, height};
+}
+
+} // namespace
+
+
+TEST_CASE("Premultiplied alpha")
+{
+  SECTION("Exact for all color and alpha values")
+  {
+    const auto image = makeAllCombinationsImage();
+
+    CHECK(isPremultipliedVersionOf(image.withPremultipliedAlpha(), image));
+
+    auto inPlace = Image{image};
+    inPlace.premultiplyAlpha();
+    CHECK(inPlace.pixelData() == image.withPremultipliedAlpha().pixelData());
+  }
+
+  SECTION("Sizes not divisible by the SIMD width")
+  {
+    const auto allCombinations = makeAllCombinationsImage();
+
+    for (auto width = 1u; width <= 37u; ++width)
+    {
+      const auto image = allCombinations.extractSubImage(61, 3, width, 3);
+      CHECK(isPremultipliedVersionOf(image.withPremultipliedAlpha(), image));
+    }
+  }
+
+  SECTION("Empty image")
+  {
+    auto image = Image{0, 0};
+    CHECK(image.withPremultipliedAlpha().pixelData().empty());
+
+    image.premultiplyAlpha();
+    CHECK(image.pixelData().empty());
+  }
+}
+
+
+TEST_CASE("Image views and sub-images")
+{
+  const auto image = makeNumberedImage(8, 6);
+
+  SECTION("Sub-views reference the original pixels")
+  {
+    const auto view = image.subView(2, 1, 4, 3).subView(1, 1, 2, 2);
+
+    CHECK(view.width() == 2);
+    CHECK(view.height() == 2);
+    CHECK(view.stride() == 8);
+    CHECK(view.row(0) == &image.pixelData()[3 + 2 * 8]);
+    CHECK(view.pixel(1, 1) == Color{4, 3, 0, 255});
+  }
+
+  SECTION("Extracting")
+  {
+    const auto subImage = image.extractSubImage(3, 2, 4, 3);
+
+    REQUIRE(subImage.width() == 4);
+    REQUIRE(subImage.height() == 3);
+    CHECK(subImage.pixelData().front() == Color{3, 2, 0, 255});
+    CHECK(subImage.pixelData().back() == Color{6, 4, 0, 255});
+
+    CHECK_THROWS_AS(image.extractSubImage(5, 0, 4, 1), std::invalid_argument);
+    CHECK_THROWS_AS(image.subView(0, 4, 1, 3), std::invalid_argument);
+  }
+
+  SECTION("Inserting")
+  {
+    auto target = Image{10, 10};
+    target.insertImage(1, 2, image.subView(4, 3, 3, 2));
+
+    CHECK(target.pixelData()[0] == Color{});
+    CHECK(target.pixelData()[1 + 2 * 10] == Color{4, 3, 0, 255});
+    CHECK(target.pixelData()[3 + 3 * 10] == Color{6, 4, 0, 255});
+    CHECK(target.pixelData()[4 + 3 * 10] == Color{});
+
+    CHECK_THROWS_AS(target.insertImage(3, 5, image), std::invalid_argument);
+  }
+
+  SECTION("Inserting an overlapping view of the same image")
+  {
+    // Copies the 4x3 region at (2, 2) to the given position, which overlaps
+    // the source across multiple rows
+    const auto checkCopy = [&](const int x, const int y, const bool flip) {
+      auto target = image;
+      const auto source = target.subView(2, 2, 4, 3);
+      target.insertImage(x, y, flip ? source.flippedVertically() : source);
+
+      for (auto row = 0; row < 3; ++row)
+      {
+        const auto sourceRow = flip ? 4 - row : 2 + row;
+        for (auto column = 0; column < 4; ++column)
+        {
+          CHECK(
+            target.view().pixel(x + column, y + row) ==
+            image.view().pixel(2 + column, sourceRow));
+        }
+      }
+    };
+
+    checkCopy(3, 3, false);
+    checkCopy(1, 1, false);
+    checkCopy(2, 3, false);
+    checkCopy(2, 3, true);
+    checkCopy(1, 1, true);
+  }
+
+  SECTION("Clipped inserting")
+  {
+    auto target = Image{4, 4};
+    target.insertImageClipped(-3, 2, image.view());
+
+    CHECK(target.pixelData()[0 + 2 * 4] == Color{3, 0, 0, 255});
+    CHECK(target.pixelData()[3 + 3 * 4] == Color{6, 1, 0, 255});
+    CHECK(target.pixelData()[0 + 1 * 4] == Color{});
+
+    auto untouched = Image{4, 4};
+    untouched.insertImageClipped(4, 0, image.view());
+    untouched.insertImageClipped(-8, -6, image.view());
+    CHECK(untouched.pixelData() == Image{4, 4}.pixelData());
+  }
+}
+
+
+TEST_CASE("Vertical flipping")
+{
+  const auto image = makeNumberedImage(5, 7);
+
+  const auto isFlippedVersionOf = [](const Image& flipped, const Image& other) {
+    for (auto y = 0u; y < other.height(); ++y)
+    {
+      for (auto x = 0u; x < other.width(); ++x)
+      {
+        if (
+          flipped.pixelData()[x + y * other.width()] !=
+          other.pixelData()[x + (other.height() - 1 - y) * other.width()])
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  };
+
+  SECTION("Copy")
+  {
+    CHECK(isFlippedVersionOf(image.flipped(), image));
+  }
+
+  SECTION("In place")
+  {
+    auto flipped = image;
+    flipped.flipVertically();
+    CHECK(isFlippedVersionOf(flipped, image));
+
+    auto evenHeight = makeNumberedImage(3, 4);
+    evenHeight.flipVertically();
+    CHECK(isFlippedVersionOf(evenHeight, makeNumberedImage(3, 4)));
+  }
+
+  SECTION("View")
+  {
+    const auto view = image.view().flippedVertically();
+
+    CHECK(view.stride() == -5);
+    CHECK(!view.isContiguous());
+    CHECK(view.pixel(1, 0) == Color{1, 6, 0, 255});
+    CHECK(view.subView(1, 2, 2, 2).pixel(0, 1) == Color{1, 3, 0, 255});
+    CHECK(isFlippedVersionOf(Image{view}, image));
+    CHECK(Image{view.flippedVertically()}.pixelData() == image.pixelData());
+  }
+}
+
+
+TEST_CASE("Alpha blending")
+{
+  const auto blend = [](const Color& source, const Color& destination) {
+    const auto channel = [&](const std::uint8_t s, const std::uint8_t d) {
+      return std::uint8_t(std::min(s + d * (255 - source.a) / 255, 255));
+    };
+
+    return Color{
+      channel(source.r, destination.r),
+      channel(source.g, destination.g),
+      channel(source.b, destination.b),
+      channel(source.a, destination.a)};
+  };
+
+  const auto source = makeAllCombinationsImage().withPremultipliedAlpha();
+  const auto background = Color{200, 100, 50, 180};
+
+  SECTION("Exact for all color and alpha values")
+  {
+    auto target = Image{PixelBuffer(256 * 256, background), 256, 256};
+    target.blendImage(0, 0, source.view());
+
+    auto allMatch = true;
+    for (auto i = 0u; i < source.pixelData().size(); ++i)
+    {
+      allMatch = allMatch &&
+        target.pixelData()[i] == blend(source.pixelData()[i], background);
+    }
+
+    CHECK(allMatch);
+  }
+
+  SECTION("Clipped")
+  {
+    auto target = Image{PixelBuffer(13 * 5, background), 13, 5};
+    target.blendImage(-250, -253, source.view());
+
+    CHECK(
+      target.pixelData()[0] ==
+      blend(source.pixelData()[250 + 253 * 256], background));
+    CHECK(
+      target.pixelData()[5 + 2 * 13] ==
+      blend(source.pixelData()[255 + 255 * 256], background));
+    CHECK(target.pixelData()[6 + 2 * 13] == background);
+    CHECK(target.pixelData()[0 + 3 * 13] == background);
+  }
+}
+
+
+TEST_CASE("Image blitting performance", "[.][benchmark]")
+{
+  constexpr auto TILE_SIZE = std::size_t{32};
+  constexpr auto NUM_TILES = std::size_t{16};
+
+  const auto source = makeAllCombinationsImage();
+  auto target = Image{TILE_SIZE * NUM_TILES, TILE_SIZE * NUM_TILES};
+  auto referencePixels = target.pixelData();
+  const auto targetWidth = target.width();
+
+  // This is how insertImage() and extractSubImage() used to work, copying
+  // one pixel at a time
+  BENCHMARK("Per-pixel insert")
+  {
+    for (auto tile = 0u; tile < NUM_TILES * NUM_TILES; ++tile)
+    {
+      const auto x = (tile % NUM_TILES) * TILE_SIZE;
+      const auto y = (tile / NUM_TILES) * TILE_SIZE;
+      for (size_t row = 0; row < TILE_SIZE; ++row)
+      {
+        for (size_t col = 0; col < TILE_SIZE; ++col)
+        {
+          referencePixels[(x + col) + (y + row) * targetWidth] =
+            source.pixelData()[col + row * source.width()];
+        }
+      }
+    }
+
+    return referencePixels.size();
+  };
+
+  BENCHMARK("Image::insertImage")
+  {
+    for (auto tile = 0u; tile < NUM_TILES * NUM_TILES; ++tile)
+    {
+      target.insertImage(
+        (tile % NUM_TILES) * TILE_SIZE,
+        (tile / NUM_TILES) * TILE_SIZE,
+        source.subView(0, 0, TILE_SIZE, TILE_SIZE));
+    }
+
+    return target.pixelData().size();
+  };
+
+  BENCHMARK("Per-pixel extract")
+  {
+    auto total = std::size_t{0};
+
+    for (auto tile = 0u; tile < 64; ++tile)
+    {
+      PixelBuffer data;
+      data.reserve(TILE_SIZE * TILE_SIZE);
+
+      const auto x = (tile % 8) * TILE_SIZE;
+      const auto y = (tile / 8) * TILE_SIZE;
+      for (size_t row = y; row < y + TILE_SIZE; ++row)
+      {
+        for (size_t col = x; col < x + TILE_SIZE; ++col)
+        {
+          data.push_back(source.pixelData()[col + row * source.width()]);
+        }
+      }
+
+      total += Image{std::move(data), TILE_SIZE, TILE_SIZE}.width();
+    }
+
+    return total;
+  };
+
+  BENCHMARK("Image::extractSubImage")
+  {
+    auto total = std::size_t{0};
+
+    for (auto tile = 0u; tile < 64; ++tile)
+    {
+      total += source
+                 .extractSubImage(
+                   (tile % 8) * TILE_SIZE,
+                   (tile / 8) * TILE_SIZE,
+                   TILE_SIZE,
+                   TILE_SIZE)
+                 .width();
+    }
+
+    return total;
+  };
+
+  const auto premultipliedSource = source.withPremultipliedAlpha();
+
+  BENCHMARK("Per-pixel blend")
+  {
+    for (auto y = 0u; y < source.height(); ++y)
+    {
+      for (auto x = 0u; x < source.width(); ++x)
+      {
+        const auto& s = premultipliedSource.pixelData()[x + y * 256];
+        auto& d = referencePixels[x + y * targetWidth];
+        const auto inverseAlpha = 255 - s.a;
+        d = Color{
+          std::uint8_t(s.r + d.r * inverseAlpha / 255),
+          std::uint8_t(s.g + d.g * inverseAlpha / 255),
+          std::uint8_t(s.b + d.b * inverseAlpha / 255),
+          std::uint8_t(s.a + d.a * inverseAlpha / 255)};
+      }
+    }
+
+    return referencePixels.size();
+  };
+
+  BENCHMARK("Image::blendImage")
+  {
+    target.blendImage(0, 0, premultipliedSource.view());
+    return target.pixelData().size();
+  };
+}
@@ -0,0 +1,164 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/image_cache.hpp>
+#include <rigel/base/image_loading.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <string>
+
+
+using namespace rigel::base;
+
+
+namespace
+{
+
+Image makeTestImage(const std::size_t width, const std::size_t height)
+{
+  PixelBuffer pixels;
+
+  for (auto i = 0u; i < width * height; ++i)
+  {
+    pixels.push_back(Color{std::uint8_t(i), 200, 100, std::uint8_t(i * 7)});
+  }
+
+  return Image{std::move(pixels), width, height};
+}
+
+} // namespace
+
+
+TEST_CASE("Image cache")
+{
+  const auto directory =
+    std::filesystem::temp_directory_path() / "rigel_image_cache_test";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+
+  const auto imageA = makeTestImage(16, 8);
+  const auto imageB = makeTestImage(8, 8);
+  const auto pathA = directory / "a.png";
+  const auto pathB = directory / "b.png";
+  REQUIRE(savePng(pathA, imageA));
+  REQUIRE(savePng(pathB, imageB));
+
+  SECTION("Repeated loads are served from memory")
+  {
+    ImageCache cache;
+
+    const auto pFirst = cache.load(pathA);
+    const auto pSecond = cache.load(pathA);
+
+    REQUIRE(pFirst);
+    CHECK(pFirst == pSecond);
+    CHECK(pFirst->pixelData() == imageA.pixelData());
+    CHECK(cache.stats().decodes == 1);
+    CHECK(cache.stats().memoryHits == 1);
+    CHECK(cache.memoryUsage() == 16 * 8 * 4);
+
+    CHECK(cache.load(directory / "does_not_exist.png") == nullptr);
+  }
+
+  SECTION("Least recently used images are evicted")
+  {
+    auto config = ImageCacheConfig{};
+    config.memoryBudgetBytes = 16 * 8 * 4 + 8 * 8 * 4 - 1;
+    ImageCache cache{config};
+
+    const auto pA = cache.load(pathA);
+    cache.load(pathB);
+    CHECK(cache.memoryUsage() == 8 * 8 * 4);
+
+    // Evicted images stay valid for their users
+    CHECK(pA->pixelData() == imageA.pixelData());
+
+    cache.load(pathB);
+    cache.load(pathA);
+    CHECK(cache.stats().decodes == 3);
+    CHECK(cache.stats().memoryHits == 1);
+  }
+
+  SECTION("Warm start from disk cache")
+  {
+    auto config = ImageCacheConfig{};
+    config.diskCacheDirectory = directory / "cache";
+    config.premultiplyAlpha = true;
+
+    {
+      ImageCache cache{config};
+      cache.load(pathA);
+      CHECK(cache.stats().decodes == 1);
+    }
+
+    ImageCache cache{config};
+    const auto pImage = cache.load(pathA);
+
+    REQUIRE(pImage);
+    CHECK(cache.stats().decodes == 0);
+    CHECK(cache.stats().diskHits == 1);
+    CHECK(pImage->pixelData() == imageA.withPremultipliedAlpha().pixelData());
+  }
+
+  SECTION("Modifying a file replaces the cached version")
+  {
+    auto config = ImageCacheConfig{};
+    config.diskCacheDirectory = directory / "modified_cache";
+    ImageCache cache{config};
+
+    const auto numCacheFiles = [&]() {
+      return std::distance(
+        std::filesystem::directory_iterator{*config.diskCacheDirectory},
+        std::filesystem::directory_iterator{});
+    };
+
+    cache.load(pathA);
+    CHECK(numCacheFiles() == 1);
+
+    // Also moves the modification time forward, in case the file system's
+    // timestamps are too coarse to tell the two writes apart
+    const auto modifiedImage = makeTestImage(4, 4);
+    const auto previousWriteTime = std::filesystem::last_write_time(pathA);
+    REQUIRE(savePng(pathA, modifiedImage));
+    std::filesystem::last_write_time(
+      pathA, previousWriteTime + std::chrono::seconds(2));
+
+    const auto pModified = cache.load(pathA);
+    REQUIRE(pModified);
+    CHECK(pModified->pixelData() == modifiedImage.pixelData());
+    CHECK(cache.stats().decodes == 2);
+
+    // The outdated version is gone from memory and disk
+    CHECK(cache.memoryUsage() == 4 * 4 * 4);
+    CHECK(numCacheFiles() == 1);
+
+    ImageCache secondCache{config};
+    const auto pFromDisk = secondCache.load(pathA);
+    REQUIRE(pFromDisk);
+    CHECK(secondCache.stats().diskHits == 1);
+    CHECK(pFromDisk->pixelData() == modifiedImage.pixelData());
+  }
+
+  std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,796 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/byte_buffer.hpp>
+#include <rigel/base/image_loading.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+#include <stb_image.h>
+RIGEL_RESTORE_WARNINGS
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+
+using namespace rigel::base;
+
+
+namespace
+{
+
+Image makeTestImage(const std::size_t width, const std::size_t height)
+{
+  PixelBuffer pixels;
+
+  for (auto y = 0u; y < height; ++y)
+  {
+    for (auto x = 0u; x < width; ++x)
+    {
+      pixels.push_back(Color{
+        std::uint8_t(x), std::uint8_t(y), std::uint8_t(x * y), 255});
+    }
+  }
+
+  return Image{std::move(pixels), width, height};
+}
+
+
+std::uint32_t readU32BigEndian(const std::uint8_t* pData)
+{
+  return (std::uint32_t{pData[0]} << 24) | (std::uint32_t{pData[1]} << 16) |
+    (std::uint32_t{pData[2]} << 8) | pData[3];
+}
+
+
+void appendU32BigEndian(ByteBuffer& buffer, const std::uint32_t value)
+{
+  buffer.push_back(std::uint8_t(value >> 24));
+  buffer.push_back(std::uint8_t(value >> 16));
+  buffer.push_back(std::uint8_t(value >> 8));
+  buffer.push_back(std::uint8_t(value));
+}
+
+
+std::uint32_t crc32(const std::uint8_t* pData, const std::size_t size)
+{
+  auto crc = 0xFFFFFFFFu;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    crc ^= pData[i];
+    for (auto bit = 0; bit < 8; ++bit)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+
+  return ~crc;
+}
+
+
+void appendChunk(
+  ByteBuffer& output,
+  const char* type,
+  const std::uint8_t* pData,
+  const std::size_t size)
+{
+  appendU32BigEndian(output, std::uint32_t(size));
+
+  const auto typeStart = output.size();
+  output.insert(output.end(), type, type + 4);
+  output.insert(output.end(), pData, pData + size);
+  appendU32BigEndian(
+    output, crc32(output.data() + typeStart, output.size() - typeStart));
+}
+
+
+/** Re-split a PNG's image data into IDAT chunks of the given sizes
+ *
+ * An additional chunk holding the remaining data is added at the end.
+ */
+ByteBuffer splitImageData(
+  const ByteBuffer& png,
+  const std::vector<std::size_t>& chunkSizes)
+{
+  constexpr auto SIGNATURE_SIZE = std::size_t{8};
+
+  ByteBuffer imageData;
+  ByteBuffer chunksBefore;
+  ByteBuffer chunksAfter;
+
+  for (auto position = SIGNATURE_SIZE; position < png.size();)
+  {
+    const auto length = std::size_t{readU32BigEndian(&png[position])};
+    const auto chunkEnd = position + length + 12;
+    const auto pData = &png[position + 8];
+
+    if (std::equal(pData - 4, pData, "IDAT"))
+    {
+      imageData.insert(imageData.end(), pData, pData + length);
+    }
+    else
+    {
+      auto& target = imageData.empty() ? chunksBefore : chunksAfter;
+      target.insert(target.end(), &png[position], png.data() + chunkEnd);
+    }
+
+    position = chunkEnd;
+  }
+
+  ByteBuffer result{png.begin(), png.begin() + SIGNATURE_SIZE};
+  result.insert(result.end(), chunksBefore.begin(), chunksBefore.end());
+
+  auto offset = std::size_t{0};
+  for (const auto size : chunkSizes)
+  {
+    appendChunk(result, "IDAT", imageData.data() + offset, size);
+    offset += size;
+  }
+
+  appendChunk(
+    result, "IDAT", imageData.data() + offset, imageData.size() - offset);
+  result.insert(result.end(), chunksAfter.begin(), chunksAfter.end());
+  return result;
+}
+
+
+// Small PNG files written with zlib, to cover the parts of the format which
+// encodePng() doesn't produce. All are 13x7 unless noted otherwise. Every
+// row uses a different filter type, cycling through all five.
+
+// 20x12, compressed with dynamic Huffman codes
+const std::uint8_t RGB_DYNAMIC_HUFFMAN[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x0c,
+  0x08, 0x02, 0x00, 0x00, 0x00, 0xed, 0x6e, 0x0a, 0xac, 0x00, 0x00, 0x01,
+  0x5d, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x5d, 0x91, 0x2d, 0x92, 0xc4,
+  0x20, 0x10, 0x85, 0xdf, 0xfe, 0x28, 0x0e, 0x81, 0xc6, 0xcc, 0x0d, 0x50,
+  0x6d, 0x67, 0x04, 0x1a, 0x85, 0x58, 0x33, 0x73, 0x02, 0x8e, 0x90, 0x13,
+  0xa0, 0xa3, 0xa2, 0x11, 0xd1, 0xad, 0x22, 0xfa, 0x1c, 0x73, 0x92, 0x6d,
+  0x3a, 0xc9, 0xee, 0xec, 0x56, 0x51, 0x9d, 0xee, 0xf7, 0x5e, 0x01, 0xf9,
+  0x00, 0xe0, 0x90, 0x04, 0xb3, 0x00, 0x62, 0x8d, 0x3b, 0x9b, 0x5d, 0x71,
+  0x2f, 0x96, 0xfc, 0x0b, 0xbf, 0xe9, 0xc7, 0x27, 0x8c, 0x55, 0xb4, 0x92,
+  0x4f, 0xac, 0xcd, 0xed, 0x50, 0x6c, 0x3c, 0x2c, 0x15, 0xc9, 0x17, 0x7e,
+  0x0d, 0xbf, 0x03, 0xf0, 0x40, 0x04, 0x32, 0x68, 0x01, 0x6f, 0xc0, 0x13,
+  0x30, 0x91, 0x22, 0x38, 0x03, 0x0b, 0x60, 0x22, 0x01, 0x7c, 0x26, 0x55,
+  0xa4, 0x0d, 0xfc, 0x01, 0x7c, 0xc5, 0x80, 0x6b, 0xa0, 0xa9, 0xf3, 0x3d,
+  0x60, 0x09, 0xf0, 0x1d, 0x5b, 0xa0, 0x18, 0xf8, 0xda, 0x31, 0x05, 0x0c,
+  0xb1, 0x93, 0x0f, 0xbc, 0x05, 0xc4, 0xae, 0x49, 0x15, 0xe9, 0xde, 0x59,
+  0x93, 0x9f, 0xfb, 0x21, 0x0f, 0x70, 0xb5, 0x43, 0x9a, 0xed, 0xba, 0x1f,
+  0xf2, 0x00, 0x4c, 0xa4, 0x06, 0x5e, 0x8e, 0xeb, 0xa8, 0x48, 0xd5, 0xc6,
+  0x66, 0x8a, 0x6b, 0x49, 0xf2, 0x2c, 0x1e, 0xb2, 0x26, 0xa9, 0xb3, 0x8b,
+  0x06, 0xa3, 0xcd, 0x92, 0x07, 0x0e, 0xb7, 0xce, 0x52, 0x21, 0xd1, 0x38,
+  0x35, 0xb8, 0x9c, 0xc4, 0xcf, 0xb2, 0x42, 0xea, 0x0e, 0x6c, 0x4d, 0x78,
+  0xea, 0x2a, 0x5a, 0xe9, 0x99, 0xd8, 0x1a, 0x0c, 0xb1, 0xd8, 0x78, 0x58,
+  0xc3, 0x5d, 0x8b, 0x8d, 0x67, 0x78, 0x00, 0xbb, 0xd9, 0x0d, 0xa7, 0xbf,
+  0xc0, 0x6e, 0xf6, 0x2f, 0xd3, 0x5f, 0x60, 0x67, 0xf2, 0x05, 0x98, 0x0f,
+  0xb8, 0x28, 0xa1, 0xce, 0x0a, 0x23, 0x2b, 0xa1, 0xae, 0xd8, 0x06, 0xa1,
+  0x4b, 0x87, 0xb1, 0x44, 0xee, 0x74, 0x0f, 0xbc, 0xb3, 0xbc, 0x28, 0xb6,
+  0x40, 0xd7, 0xce, 0xf9, 0x07, 0x98, 0xbe, 0x4a, 0xb4, 0x5d, 0xe3, 0x58,
+  0xbf, 0xaf, 0x62, 0xe2, 0xe1, 0x9e, 0x8f, 0x3a, 0xc6, 0x3d, 0x39, 0x80,
+  0x29, 0x03, 0xa5, 0xa2, 0x9c, 0xda, 0x80, 0xe1, 0xaa, 0x01, 0xcb, 0x46,
+  0x25, 0x26, 0xd7, 0x8c, 0x65, 0x35, 0x60, 0x19, 0x4e, 0xa1, 0xc6, 0x41,
+  0x4e, 0x59, 0x1a, 0xb0, 0x9a, 0xb0, 0x24, 0xd4, 0xa2, 0x95, 0x6a, 0xe2,
+  0xa5, 0xd8, 0xa8, 0x62, 0xb1, 0xf1, 0xb0, 0xcc, 0x2d, 0x7c, 0x5a, 0x5a,
+  0xe9, 0x1b, 0x88, 0x3e, 0xd3, 0x60, 0xbd, 0xc2, 0xe7, 0x2d, 0x00, 0x00,
+  0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+// Uncompressed (stored) deflate blocks
+const std::uint8_t RGBA_STORED_BLOCKS[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x08, 0x06, 0x00, 0x00, 0x00, 0xd3, 0x70, 0xc7, 0x1a, 0x00, 0x00, 0x01,
+  0x7e, 0x49, 0x44, 0x41, 0x54, 0x78, 0x01, 0x01, 0x73, 0x01, 0x8c, 0xfe,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x0a, 0x00, 0x00, 0x26, 0x14, 0x00,
+  0x00, 0x39, 0x1e, 0x00, 0x00, 0x4c, 0x28, 0x00, 0x00, 0x5f, 0x32, 0x00,
+  0x00, 0x72, 0x3c, 0x00, 0x00, 0x85, 0x46, 0x00, 0x00, 0x98, 0x50, 0x00,
+  0x00, 0xab, 0x5a, 0x00, 0x00, 0xbe, 0x64, 0x00, 0x00, 0xd1, 0x6e, 0x00,
+  0x00, 0xe4, 0x78, 0x00, 0x00, 0x01, 0x1f, 0x00, 0x1e, 0x00, 0x13, 0x0a,
+  0x00, 0x07, 0x13, 0x0a, 0x00, 0x07, 0x13, 0x0a, 0x00, 0x07, 0x13, 0x0a,
+  0x00, 0x07, 0x13, 0x0a, 0x00, 0x07, 0x13, 0x0a, 0x00, 0x07, 0x13, 0x0a,
+  0x00, 0x07, 0x13, 0x0a, 0x00, 0x07, 0x13, 0x0a, 0x00, 0x07, 0x13, 0x0a,
+  0x00, 0x07, 0x13, 0x0a, 0x00, 0x07, 0x13, 0x0a, 0x00, 0x07, 0x02, 0x1f,
+  0x00, 0x1e, 0x00, 0x1f, 0x00, 0x1e, 0x07, 0x1f, 0x00, 0x1e, 0x0e, 0x1f,
+  0x00, 0x1e, 0x15, 0x1f, 0x00, 0x1e, 0x1c, 0x1f, 0x00, 0x1e, 0x23, 0x1f,
+  0x00, 0x1e, 0x2a, 0x1f, 0x00, 0x1e, 0x31, 0x1f, 0x00, 0x1e, 0x38, 0x1f,
+  0x00, 0x1e, 0x3f, 0x1f, 0x00, 0x1e, 0x46, 0x1f, 0x00, 0x1e, 0x4d, 0x1f,
+  0x00, 0x1e, 0x54, 0x03, 0x3e, 0x00, 0x3c, 0x00, 0x19, 0x05, 0x0f, 0x0e,
+  0x19, 0x05, 0x0f, 0x12, 0x19, 0x05, 0x0f, 0x15, 0x19, 0x05, 0x0f, 0x19,
+  0x19, 0x05, 0x0f, 0x1c, 0x19, 0x05, 0x0f, 0x20, 0x19, 0x05, 0x0f, 0x23,
+  0x19, 0x05, 0x0f, 0x27, 0x19, 0x05, 0x0f, 0x2a, 0x99, 0x05, 0x0f, 0x2e,
+  0x19, 0x05, 0x0f, 0x31, 0x19, 0x05, 0x0f, 0x35, 0x04, 0x1f, 0x00, 0x1e,
+  0x00, 0x13, 0x00, 0x00, 0x07, 0x13, 0x00, 0x00, 0x0e, 0x13, 0x00, 0x00,
+  0x15, 0x13, 0x00, 0x00, 0x1c, 0x13, 0x00, 0x00, 0x1c, 0x13, 0x00, 0x00,
+  0x1c, 0x13, 0x00, 0x00, 0x1c, 0x13, 0x00, 0x00, 0x1c, 0x1f, 0x00, 0x00,
+  0x1c, 0x13, 0x00, 0x00, 0x1c, 0x13, 0x00, 0x00, 0x1c, 0x13, 0x00, 0x00,
+  0x1c, 0x00, 0x9b, 0x00, 0x96, 0x00, 0xae, 0x0a, 0x96, 0x23, 0xc1, 0x14,
+  0x96, 0x46, 0xd4, 0x1e, 0x96, 0x69, 0xe7, 0x28, 0x96, 0x8c, 0xfa, 0x32,
+  0x96, 0xaf, 0x0d, 0x3c, 0x96, 0xd2, 0x20, 0x46, 0x96, 0xf5, 0x33, 0x50,
+  0x96, 0x18, 0x46, 0x5a, 0x96, 0x3b, 0x59, 0x64, 0x96, 0x5e, 0x6c, 0x6e,
+  0x96, 0x81, 0x7f, 0x78, 0x96, 0xa4, 0x01, 0xba, 0x00, 0xb4, 0x00, 0x13,
+  0x0a, 0x00, 0x2a, 0x13, 0x0a, 0x00, 0x2a, 0x13, 0x0a, 0x00, 0x2a, 0x13,
+  0x0a, 0x00, 0x2a, 0x13, 0x0a, 0x00, 0x2a, 0x13, 0x0a, 0x00, 0x2a, 0x13,
+  0x0a, 0x00, 0x2a, 0x13, 0x0a, 0x00, 0x2a, 0x13, 0x0a, 0x00, 0x2a, 0x13,
+  0x0a, 0x00, 0x2a, 0x13, 0x0a, 0x00, 0x2a, 0x13, 0x0a, 0x00, 0x2a, 0xd5,
+  0xf6, 0x32, 0xc4, 0x53, 0xac, 0x32, 0x80, 0x00, 0x00, 0x00, 0x00, 0x49,
+  0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+const std::uint8_t GRAY_8[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x08, 0x00, 0x00, 0x00, 0x00, 0xf6, 0x1b, 0x98, 0xc6, 0x00, 0x00, 0x00,
+  0x3e, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x10, 0x56, 0xb3,
+  0xf4, 0x89, 0x2f, 0x6a, 0x9d, 0xb1, 0x7a, 0xdf, 0xc5, 0x27, 0x8c, 0xf2,
+  0xc2, 0x48, 0x80, 0x49, 0x1e, 0x19, 0x30, 0xdb, 0x49, 0xc2, 0xc0, 0x4c,
+  0x49, 0x49, 0x16, 0xb8, 0x4a, 0x10, 0x83, 0x61, 0xf6, 0xba, 0x83, 0x57,
+  0x9e, 0xff, 0xe2, 0x55, 0x30, 0x76, 0x8b, 0xcc, 0xa9, 0x67, 0xdc, 0x85,
+  0x6c, 0x0a, 0x00, 0xd9, 0xe5, 0x13, 0xac, 0xa0, 0x62, 0xee, 0xb5, 0x00,
+  0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+// Gray level 60 is transparent
+const std::uint8_t GRAY_8_TRNS[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x08, 0x00, 0x00, 0x00, 0x00, 0xf6, 0x1b, 0x98, 0xc6, 0x00, 0x00, 0x00,
+  0x02, 0x74, 0x52, 0x4e, 0x53, 0x00, 0x3c, 0x59, 0xfc, 0xb1, 0xbf, 0x00,
+  0x00, 0x00, 0x29, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0xb0,
+  0xa9, 0xd8, 0x02, 0xc7, 0x8c, 0x36, 0x36, 0x36, 0x3e, 0x70, 0xcc, 0x84,
+  0xcc, 0xb1, 0x61, 0xae, 0x40, 0xe2, 0xd8, 0xb0, 0x20, 0x73, 0x7c, 0x50,
+  0x0c, 0xb1, 0x61, 0xac, 0x40, 0xd6, 0x07, 0x00, 0xdd, 0x8c, 0x19, 0x6c,
+  0x1d, 0x2b, 0xd1, 0x15, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44,
+  0xae, 0x42, 0x60, 0x82,
+};
+
+const std::uint8_t GRAY_ALPHA_8[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x08, 0x04, 0x00, 0x00, 0x00, 0x79, 0x79, 0x0f, 0x91, 0x00, 0x00, 0x00,
+  0x5f, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x60, 0x10, 0x16,
+  0x56, 0x53, 0xb3, 0xb4, 0xf4, 0xf1, 0x89, 0x8f, 0x2f, 0x2a, 0x6a, 0x6d,
+  0x9d, 0x31, 0x63, 0xf5, 0xea, 0x7d, 0xfb, 0x2e, 0x5e, 0x7c, 0xf2, 0x84,
+  0x51, 0x1e, 0x28, 0x85, 0x1d, 0x30, 0xc9, 0x33, 0xe0, 0x82, 0xcc, 0x76,
+  0x0c, 0x92, 0x5c, 0xe8, 0x70, 0x26, 0x98, 0x64, 0x01, 0x1a, 0x88, 0x06,
+  0x61, 0x22, 0x0c, 0xb3, 0x19, 0xd6, 0x09, 0x1f, 0x54, 0xbb, 0x62, 0xf9,
+  0xdc, 0xe7, 0x57, 0x3c, 0x6f, 0x91, 0x42, 0xab, 0xf1, 0x0c, 0xb7, 0xd5,
+  0x91, 0xfb, 0x72, 0x2e, 0xd6, 0x3f, 0x61, 0xdc, 0x85, 0xd3, 0x19, 0x00,
+  0xd7, 0x2a, 0x21, 0x80, 0x26, 0x08, 0x0d, 0x11, 0x00, 0x00, 0x00, 0x00,
+  0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+const std::uint8_t GRAY_1[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x01, 0x00, 0x00, 0x00, 0x00, 0xfb, 0x0b, 0xfa, 0xb7, 0x00, 0x00, 0x00,
+  0x1e, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x08, 0x0d, 0x60, 0x5c,
+  0xf5, 0x8f, 0x69, 0xf5, 0x0a, 0xe6, 0x06, 0x6d, 0x96, 0xd5, 0xbf, 0x19,
+  0x56, 0xad, 0x60, 0x0c, 0xfd, 0x0d, 0x00, 0x55, 0x2a, 0x08, 0x9f, 0x8e,
+  0x3d, 0xd0, 0x06, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae,
+  0x42, 0x60, 0x82,
+};
+
+const std::uint8_t GRAY_2[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x02, 0x00, 0x00, 0x00, 0x00, 0xbc, 0xab, 0x80, 0x67, 0x00, 0x00, 0x00,
+  0x2e, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x01, 0x23, 0x00, 0xdc, 0xff,
+  0x00, 0x1b, 0x1b, 0x1b, 0x00, 0x01, 0xc6, 0x00, 0x00, 0xfa, 0x02, 0xeb,
+  0xeb, 0xeb, 0xc0, 0x03, 0x14, 0xde, 0xde, 0xca, 0x04, 0xaf, 0x00, 0x00,
+  0xe5, 0x00, 0xc6, 0xc6, 0xc6, 0xc0, 0x01, 0xb1, 0x00, 0x00, 0xcf, 0xe4,
+  0xcc, 0x0e, 0x5e, 0x91, 0xfe, 0x54, 0x92, 0x00, 0x00, 0x00, 0x00, 0x49,
+  0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+const std::uint8_t GRAY_4[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x04, 0x00, 0x00, 0x00, 0x00, 0x33, 0xeb, 0x75, 0xc7, 0x00, 0x00, 0x00,
+  0x38, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x54, 0x76, 0x4d,
+  0xef, 0x5c, 0x7d, 0x80, 0xd1, 0x44, 0x09, 0x04, 0x84, 0x98, 0x8c, 0x41,
+  0x40, 0xd9, 0x80, 0x39, 0x5d, 0x5b, 0x5b, 0x5a, 0x59, 0x5b, 0x8d, 0xc5,
+  0x58, 0x49, 0x48, 0xc9, 0x58, 0x49, 0x92, 0xe1, 0x83, 0x90, 0x49, 0x58,
+  0xc5, 0xac, 0x0d, 0x8c, 0xca, 0x60, 0x75, 0xc2, 0x00, 0x4a, 0x7d, 0x0b,
+  0x83, 0x04, 0x9c, 0xae, 0x95, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e,
+  0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+const std::uint8_t PALETTE_8_TRNS[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x08, 0x03, 0x00, 0x00, 0x00, 0xe4, 0xae, 0x37, 0x28, 0x00, 0x00, 0x00,
+  0x30, 0x50, 0x4c, 0x54, 0x45, 0x00, 0xff, 0x00, 0x10, 0xef, 0x4d, 0x20,
+  0xdf, 0x9a, 0x30, 0xcf, 0xe7, 0x40, 0xbf, 0x34, 0x50, 0xaf, 0x81, 0x60,
+  0x9f, 0xce, 0x70, 0x8f, 0x1b, 0x80, 0x7f, 0x68, 0x90, 0x6f, 0xb5, 0xa0,
+  0x5f, 0x02, 0xb0, 0x4f, 0x4f, 0xc0, 0x3f, 0x9c, 0xd0, 0x2f, 0xe9, 0xe0,
+  0x1f, 0x36, 0xf0, 0x0f, 0x83, 0x2c, 0xba, 0xfd, 0x64, 0x00, 0x00, 0x00,
+  0x0c, 0x74, 0x52, 0x4e, 0x53, 0xff, 0xef, 0xdf, 0xcf, 0xbf, 0xaf, 0x9f,
+  0x8f, 0x7f, 0x6f, 0x5f, 0x4f, 0x7e, 0x05, 0xe3, 0xeb, 0x00, 0x00, 0x00,
+  0x30, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x60, 0x64, 0x62,
+  0x66, 0x61, 0x65, 0x63, 0xe7, 0xe0, 0xe4, 0xe2, 0xe6, 0x61, 0x44, 0x01,
+  0x4c, 0x28, 0x3c, 0x66, 0x14, 0x2e, 0x0b, 0x32, 0xe7, 0x23, 0x03, 0xcc,
+  0x00, 0x5e, 0x3e, 0x7e, 0x06, 0x46, 0x46, 0x36, 0x84, 0x0c, 0x23, 0x23,
+  0x00, 0x50, 0xec, 0x02, 0xf0, 0x77, 0x16, 0x73, 0x61, 0x00, 0x00, 0x00,
+  0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+// Smaller palette than the bit depth allows
+const std::uint8_t PALETTE_2[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x02, 0x03, 0x00, 0x00, 0x00, 0xae, 0x1e, 0x2f, 0x89, 0x00, 0x00, 0x00,
+  0x0c, 0x50, 0x4c, 0x54, 0x45, 0x00, 0xff, 0x00, 0x10, 0xef, 0x4d, 0x20,
+  0xdf, 0x9a, 0x30, 0xcf, 0xe7, 0x74, 0xad, 0x70, 0x8d, 0x00, 0x00, 0x00,
+  0x28, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x00, 0x02, 0x46,
+  0x69, 0x06, 0x86, 0xa7, 0x4c, 0xec, 0xec, 0xec, 0x0c, 0xcc, 0x1a, 0x3c,
+  0x3c, 0x4f, 0x58, 0x8e, 0x83, 0x04, 0xa5, 0xa5, 0xa5, 0x19, 0x18, 0x95,
+  0x18, 0x18, 0xee, 0x01, 0x00, 0x3e, 0xd0, 0x04, 0x5d, 0x3c, 0x9e, 0xd0,
+  0xb9, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60,
+  0x82,
+};
+
+const std::uint8_t PALETTE_4[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x04, 0x03, 0x00, 0x00, 0x00, 0x21, 0x5e, 0xda, 0x29, 0x00, 0x00, 0x00,
+  0x30, 0x50, 0x4c, 0x54, 0x45, 0x00, 0xff, 0x00, 0x10, 0xef, 0x4d, 0x20,
+  0xdf, 0x9a, 0x30, 0xcf, 0xe7, 0x40, 0xbf, 0x34, 0x50, 0xaf, 0x81, 0x60,
+  0x9f, 0xce, 0x70, 0x8f, 0x1b, 0x80, 0x7f, 0x68, 0x90, 0x6f, 0xb5, 0xa0,
+  0x5f, 0x02, 0xb0, 0x4f, 0x4f, 0xc0, 0x3f, 0x9c, 0xd0, 0x2f, 0xe9, 0xe0,
+  0x1f, 0x36, 0xf0, 0x0f, 0x83, 0x2c, 0xba, 0xfd, 0x64, 0x00, 0x00, 0x00,
+  0x33, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x54, 0x76, 0x4d,
+  0xef, 0x5c, 0x7d, 0x80, 0x51, 0x59, 0x09, 0x04, 0x84, 0x99, 0xc0, 0x94,
+  0x92, 0x02, 0xb3, 0x2b, 0x88, 0x12, 0x52, 0x60, 0x01, 0x53, 0x4a, 0xb2,
+  0x0c, 0xab, 0xcf, 0xbe, 0x07, 0x2a, 0x4d, 0x60, 0x3c, 0x0b, 0xe4, 0x29,
+  0x29, 0x49, 0x02, 0x00, 0x34, 0x43, 0x0b, 0x24, 0xfe, 0x61, 0x5f, 0x22,
+  0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+const std::uint8_t RGB_16[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x10, 0x02, 0x00, 0x00, 0x00, 0x0c, 0x82, 0x8c, 0x0e, 0x00, 0x00, 0x00,
+  0xfc, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x00, 0x03, 0x01,
+  0x66, 0xe1, 0x0e, 0x06, 0x06, 0x05, 0x36, 0x75, 0x01, 0x06, 0x06, 0x03,
+  0x4e, 0xab, 0x19, 0x0c, 0x0c, 0x0e, 0x3c, 0x7e, 0x0a, 0x0c, 0x0c, 0x01,
+  0xfc, 0x89, 0x2b, 0x18, 0x18, 0x12, 0x84, 0x4a, 0x0d, 0x18, 0x18, 0x0a,
+  0x44, 0x3b, 0x76, 0x30, 0x30, 0x34, 0x48, 0xcc, 0x71, 0x60, 0x60, 0x98,
+  0x20, 0xbd, 0xfe, 0x04, 0x03, 0xc3, 0x02, 0xb9, 0xc3, 0x01, 0x0c, 0x0c,
+  0x1b, 0x14, 0xaf, 0xdd, 0x60, 0x60, 0x38, 0xa0, 0xf2, 0x2a, 0x81, 0x81,
+  0x81, 0x51, 0xee, 0x3d, 0x03, 0x83, 0xb2, 0x06, 0xc4, 0x38, 0x01, 0x66,
+  0x91, 0x0e, 0x98, 0xd1, 0xc8, 0x6c, 0x41, 0x1c, 0xe2, 0x98, 0x6c, 0x26,
+  0x79, 0xb0, 0x71, 0xf8, 0x49, 0x39, 0x22, 0x48, 0x88, 0x4a, 0x66, 0xbb,
+  0x38, 0x06, 0x06, 0xb7, 0x00, 0x89, 0x9f, 0x5c, 0x2e, 0x42, 0x22, 0x40,
+  0xf2, 0x08, 0x98, 0x24, 0x83, 0x3d, 0xbd, 0x12, 0xc4, 0x66, 0x91, 0x87,
+  0x7a, 0x16, 0x12, 0x82, 0xe4, 0x90, 0xf2, 0x48, 0x6c, 0x86, 0x59, 0xab,
+  0x19, 0x18, 0xd6, 0x9f, 0x58, 0xb5, 0x4e, 0xb8, 0x63, 0xfd, 0x89, 0x5d,
+  0x1b, 0xd5, 0x05, 0xd6, 0x9f, 0x38, 0xb5, 0xc5, 0x6a, 0xc6, 0xfa, 0x13,
+  0xb7, 0xb6, 0xfb, 0x29, 0xac, 0x3f, 0xf1, 0x6a, 0x57, 0xe2, 0x8a, 0xf5,
+  0x27, 0x7e, 0xed, 0x2d, 0x35, 0x58, 0x7f, 0x82, 0xeb, 0x40, 0xc7, 0x8e,
+  0xf5, 0x27, 0xa4, 0x0e, 0xcf, 0x71, 0x58, 0x7f, 0x42, 0xeb, 0xd8, 0xfa,
+  0x13, 0xeb, 0x4f, 0x58, 0x9d, 0x3c, 0x1c, 0xb0, 0xfe, 0x84, 0xd7, 0x99,
+  0x6b, 0x37, 0xd6, 0x9f, 0x88, 0x3a, 0xff, 0x2a, 0x61, 0xfd, 0x09, 0xc6,
+  0x9d, 0xb3, 0x18, 0x18, 0x2e, 0x7d, 0x20, 0x26, 0x98, 0x89, 0x61, 0x03,
+  0x00, 0xe4, 0x7b, 0x7e, 0xea, 0xd7, 0xc6, 0x17, 0xb7, 0x00, 0x00, 0x00,
+  0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+const std::uint8_t GRAY_ALPHA_16[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x10, 0x04, 0x00, 0x00, 0x00, 0x29, 0xe9, 0xd3, 0xd2, 0x00, 0x00, 0x00,
+  0xb1, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x00, 0x02, 0x01,
+  0x66, 0xe1, 0x0e, 0x05, 0x36, 0x75, 0x01, 0x03, 0x4e, 0xab, 0x19, 0x0e,
+  0x3c, 0x7e, 0x0a, 0x01, 0xfc, 0x89, 0x2b, 0x12, 0x84, 0x4a, 0x0d, 0x0a,
+  0x44, 0x3b, 0x76, 0x34, 0x48, 0xcc, 0x71, 0x98, 0x20, 0xbd, 0xfe, 0xc4,
+  0x02, 0xb9, 0xc3, 0x01, 0x1b, 0x14, 0xaf, 0xdd, 0x38, 0xa0, 0xf2, 0x2a,
+  0x81, 0x51, 0xee, 0x3d, 0x44, 0x93, 0x00, 0xb3, 0x48, 0x07, 0x32, 0x2d,
+  0x88, 0xc6, 0x47, 0xa6, 0x99, 0xe4, 0x81, 0x9a, 0xb0, 0x61, 0x39, 0x1c,
+  0x18, 0x24, 0xc7, 0x6c, 0x17, 0xc7, 0xc0, 0x20, 0xf1, 0x93, 0xcb, 0x05,
+  0x88, 0x8f, 0x10, 0x43, 0x4f, 0xaf, 0xe4, 0x3a, 0xc2, 0x22, 0x0f, 0x76,
+  0x1e, 0x71, 0x58, 0x1e, 0x4a, 0x33, 0xcc, 0x5a, 0xcd, 0xc0, 0xb0, 0x6a,
+  0x9d, 0x70, 0xc7, 0xae, 0x8d, 0xea, 0x02, 0xa7, 0xb6, 0x58, 0xcd, 0xb8,
+  0xb5, 0xdd, 0x4f, 0xe1, 0xd5, 0xae, 0xc4, 0x15, 0xbf, 0xf6, 0x96, 0x1a,
+  0x70, 0x1d, 0xe8, 0xd8, 0x21, 0x75, 0x78, 0x8e, 0x83, 0xd6, 0xb1, 0xf5,
+  0x27, 0xac, 0x4e, 0x1e, 0x0e, 0xf0, 0x3a, 0x73, 0xed, 0x46, 0xd4, 0x79,
+  0x60, 0x40, 0xec, 0x9c, 0x85, 0x3d, 0x20, 0xf0, 0xd1, 0x00, 0xe4, 0x22,
+  0x63, 0x5a, 0x15, 0xd6, 0x75, 0x53, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45,
+  0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+// (100, 100, 50) is transparent
+const std::uint8_t RGB_8_TRNS[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00, 0x07,
+  0x08, 0x02, 0x00, 0x00, 0x00, 0x5c, 0x12, 0x50, 0x4d, 0x00, 0x00, 0x00,
+  0x06, 0x74, 0x52, 0x4e, 0x53, 0x00, 0x64, 0x00, 0x64, 0x00, 0x32, 0x85,
+  0x1d, 0xe4, 0x60, 0x00, 0x00, 0x00, 0x47, 0x49, 0x44, 0x41, 0x54, 0x78,
+  0xda, 0x63, 0x60, 0x60, 0x30, 0x4a, 0x61, 0x30, 0x3a, 0xc1, 0x60, 0x84,
+  0x9f, 0xc1, 0xc8, 0x90, 0x02, 0xe4, 0x30, 0x00, 0x91, 0x05, 0x98, 0xc4,
+  0xc5, 0x60, 0x62, 0x98, 0xc3, 0x40, 0x0c, 0x62, 0x66, 0x48, 0x91, 0x34,
+  0x32, 0x62, 0x00, 0xa2, 0x39, 0x60, 0x12, 0x17, 0x83, 0x05, 0xa4, 0x9c,
+  0x28, 0x00, 0x74, 0x5f, 0x8a, 0xd1, 0x89, 0x14, 0x23, 0xfc, 0x0c, 0x46,
+  0xb0, 0xa7, 0x08, 0xfb, 0x03, 0x00, 0x28, 0xd9, 0x2b, 0xb9, 0x68, 0xb2,
+  0xe6, 0x9a, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42,
+  0x60, 0x82,
+};
+
+// 17x29, image data split into IDAT chunks of 97 bytes
+const std::uint8_t RGB_MULTIPLE_CHUNKS[] = {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x1d,
+  0x08, 0x02, 0x00, 0x00, 0x00, 0xc3, 0xcd, 0x10, 0xd6, 0x00, 0x00, 0x00,
+  0x61, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x9d, 0x94, 0x7f, 0x84, 0xa6,
+  0x55, 0x14, 0xc7, 0xcf, 0xb9, 0xf7, 0x3e, 0xbf, 0x7f, 0xbe, 0x73, 0xde,
+  0x77, 0x66, 0xce, 0xbb, 0x3b, 0x73, 0xa3, 0xd4, 0xc8, 0x0e, 0x6b, 0xa2,
+  0x15, 0x53, 0xa6, 0xd2, 0x90, 0xe9, 0x8f, 0x61, 0x15, 0xbb, 0x52, 0x7f,
+  0x34, 0x96, 0x65, 0x15, 0x49, 0x4d, 0x94, 0x65, 0x49, 0xd2, 0x50, 0x26,
+  0x8d, 0x5e, 0x45, 0x2b, 0x86, 0x88, 0x22, 0x1b, 0xab, 0x88, 0x24, 0x86,
+  0x25, 0x36, 0xfd, 0x11, 0x65, 0x19, 0x96, 0xfe, 0x58, 0x32, 0xa3, 0x32,
+  0xbd, 0x33, 0x3d, 0xef, 0xe9, 0x79, 0xef, 0xfc, 0xd8, 0x59, 0x19, 0x6a,
+  0x38, 0x8e, 0xe3, 0xf0, 0xb8, 0xcf, 0x53, 0xa1, 0xa4, 0x99, 0x00, 0x00,
+  0x00, 0x61, 0x49, 0x44, 0x41, 0x54, 0xf7, 0xfb, 0xfd, 0xdc, 0x0b, 0x00,
+  0x40, 0x80, 0x77, 0x82, 0xba, 0x0f, 0xf4, 0x63, 0x60, 0x9e, 0x06, 0xef,
+  0x79, 0xf0, 0x5f, 0x83, 0xe0, 0x3d, 0x08, 0x3f, 0x81, 0xe8, 0x6b, 0x88,
+  0xaf, 0x42, 0x72, 0x1d, 0xd2, 0x0d, 0xc8, 0x62, 0xc8, 0x47, 0xa0, 0x38,
+  0x0e, 0x25, 0x5a, 0x40, 0x42, 0x21, 0xd4, 0xff, 0xbd, 0xab, 0xfa, 0x1b,
+  0x8b, 0xda, 0xaa, 0xca, 0x6a, 0xb1, 0x06, 0xad, 0xa7, 0xad, 0x5f, 0xd9,
+  0x40, 0x6c, 0x88, 0x36, 0xd2, 0x36, 0xae, 0x6c, 0x22, 0x36, 0x45, 0x9b,
+  0x69, 0x9b, 0x57, 0xb6, 0x10, 0x5b, 0xa2, 0x7e, 0x00, 0x14, 0x2b, 0x61,
+  0x0d, 0xac, 0x85, 0x8d, 0x61, 0x23, 0xec, 0x19, 0xd1, 0x21, 0xf3, 0x00,
+  0x00, 0x00, 0x61, 0x49, 0x44, 0x41, 0x54, 0x01, 0x7b, 0xc2, 0xbe, 0x61,
+  0x5f, 0x3a, 0x01, 0x70, 0x20, 0x1c, 0x1a, 0x0e, 0x85, 0x23, 0xe0, 0x48,
+  0x38, 0x36, 0xc6, 0xfd, 0x9b, 0x22, 0x85, 0xa4, 0x91, 0x4c, 0x97, 0x0c,
+  0xee, 0x95, 0x35, 0x6a, 0x77, 0xbe, 0x65, 0x0f, 0xef, 0x83, 0xf7, 0xa9,
+  0x67, 0xbe, 0x89, 0x83, 0x1f, 0x0b, 0xff, 0xd7, 0x26, 0x6e, 0x32, 0x64,
+  0xa3, 0xfa, 0xb6, 0xdb, 0xd5, 0x3d, 0x63, 0xd9, 0xf4, 0x78, 0x7a, 0x6a,
+  0xa2, 0x38, 0x77, 0x22, 0x3f, 0x3f, 0x19, 0x2d, 0x3e, 0x18, 0x2e, 0x4f,
+  0x27, 0x97, 0x67, 0xe2, 0x2b, 0xb3, 0x2d, 0xfc, 0x12, 0x7c, 0xf2, 0x91,
+  0xfc, 0xea, 0x5f, 0x3d, 0x3b, 0x68, 0xbf, 0xed, 0xcf, 0x27, 0xcc, 0x23,
+  0x00, 0x00, 0x00, 0x61, 0x49, 0x44, 0x41, 0x54, 0x81, 0x58, 0x85, 0xbb,
+  0x1e, 0x88, 0xf5, 0x71, 0xd7, 0x03, 0xb1, 0x31, 0xee, 0x7a, 0x20, 0x36,
+  0xc7, 0x1d, 0x0f, 0x16, 0xc0, 0x63, 0x4f, 0x75, 0x3c, 0xed, 0x44, 0x7b,
+  0x1c, 0xf8, 0x1c, 0x04, 0x1c, 0x86, 0x1c, 0xae, 0x73, 0xb4, 0xc9, 0xd1,
+  0x16, 0xc7, 0x7f, 0x73, 0x5c, 0x71, 0xd2, 0xe3, 0x44, 0x3a, 0x29, 0x70,
+  0x1a, 0x99, 0xed, 0x73, 0x48, 0x29, 0xd2, 0x42, 0xb5, 0x68, 0x4f, 0xc8,
+  0x57, 0x14, 0x08, 0x85, 0x48, 0x91, 0x50, 0xa4, 0xf6, 0xba, 0xdd, 0x99,
+  0x11, 0xee, 0x85, 0xf8, 0xd1, 0x38, 0x79, 0xb2, 0x19, 0x3e, 0x37, 0x1a,
+  0x5d, 0x18, 0xcb, 0xdf, 0x9d, 0x28, 0x3e, 0x9e, 0x4c, 0x2a, 0x07, 0x2c,
+  0x4d, 0x00, 0x00, 0x00, 0x61, 0x49, 0x44, 0x41, 0x54, 0xbf, 0x9a, 0xce,
+  0xbe, 0x9f, 0x55, 0xab, 0xa7, 0xf5, 0x1f, 0x73, 0x10, 0x3c, 0x8b, 0xed,
+  0x79, 0x7f, 0xfc, 0x42, 0x30, 0xb5, 0x60, 0x4e, 0x2e, 0x79, 0x67, 0x2e,
+  0xb6, 0xf1, 0x71, 0x48, 0x28, 0x91, 0xdd, 0x0a, 0xf6, 0xcd, 0x1b, 0x07,
+  0xec, 0x87, 0xf6, 0x38, 0xf0, 0xac, 0x0e, 0xac, 0xe9, 0x5a, 0x6f, 0xeb,
+  0x56, 0x0e, 0x3c, 0x9b, 0x04, 0x36, 0xed, 0xda, 0x6c, 0xeb, 0x26, 0x07,
+  0xa7, 0x20, 0x70, 0x49, 0x2b, 0x97, 0x74, 0xcf, 0x25, 0xad, 0x3a, 0xb1,
+  0x6c, 0x8b, 0xe6, 0x54, 0x71, 0x2a, 0x9c, 0xf5, 0x38, 0x13, 0xce, 0x15,
+  0xe7, 0xc2, 0x45, 0xbe, 0xc7, 0x41, 0xe5, 0x38, 0x40, 0xf2, 0x8b, 0xae,
+  0x7c, 0x0d, 0x00, 0x00, 0x00, 0x61, 0x49, 0x44, 0x41, 0x54, 0x54, 0x7d,
+  0x0e, 0x05, 0xe8, 0x3c, 0x50, 0x14, 0x57, 0x94, 0x20, 0xa5, 0x48, 0x99,
+  0xa2, 0xbc, 0xa2, 0x1c, 0xeb, 0x82, 0xab, 0x50, 0x5c, 0x2f, 0xf2, 0x8d,
+  0xd1, 0x2c, 0x1e, 0x4f, 0x47, 0x26, 0x93, 0xe3, 0x33, 0xf1, 0xc3, 0xa7,
+  0xa3, 0x27, 0xce, 0x86, 0x67, 0xe7, 0x83, 0x57, 0x5e, 0xf7, 0xdf, 0x5a,
+  0xf2, 0x3e, 0x5a, 0x36, 0x5f, 0x5c, 0xd2, 0x2b, 0xdf, 0xaa, 0x9f, 0x7f,
+  0xc0, 0xdf, 0x56, 0x01, 0xd7, 0x2c, 0xae, 0x41, 0x49, 0x25, 0xfe, 0x9f,
+  0x5a, 0x3d, 0x14, 0x07, 0x77, 0x41, 0x5c, 0x8b, 0x76, 0x49, 0x03, 0x27,
+  0xda, 0x89, 0xae, 0x38, 0x03, 0xce, 0xb4, 0x13, 0x5d, 0x71, 0x01, 0xe2,
+  0x67, 0xd9, 0xeb, 0x00, 0x00, 0x00, 0x61, 0x49, 0x44, 0x41, 0x54, 0x5c,
+  0x68, 0x2e, 0x15, 0x97, 0x15, 0x37, 0x80, 0x1b, 0xbf, 0x9b, 0x9d, 0x7b,
+  0xda, 0xbf, 0x0b, 0xe2, 0x3c, 0x90, 0x3e, 0x88, 0x7b, 0x1c, 0xc4, 0x48,
+  0xee, 0x1c, 0xca, 0xa4, 0x6f, 0x00, 0x49, 0xfd, 0x7b, 0x70, 0x0e, 0x9a,
+  0xe7, 0x9b, 0xad, 0xc5, 0xb1, 0xc1, 0xe5, 0xc9, 0xa1, 0xcb, 0xb3, 0xe5,
+  0x95, 0xb9, 0xc6, 0xb5, 0xf9, 0x81, 0xf5, 0x05, 0x32, 0x17, 0x8f, 0x0e,
+  0x5d, 0x1a, 0xb9, 0x7b, 0x65, 0xf4, 0xfe, 0x5f, 0xec, 0xec, 0xda, 0xf0,
+  0x33, 0x86, 0x5f, 0x1c, 0x6e, 0xbf, 0x71, 0xec, 0xc8, 0x07, 0x53, 0x06,
+  0xdf, 0x84, 0x16, 0xb5, 0x84, 0x5a, 0xda, 0xf5, 0xad, 0x7d, 0x73, 0x72,
+  0x2c, 0xe4, 0x44, 0x25, 0x00, 0x00, 0x00, 0x61, 0x49, 0x44, 0x41, 0x54,
+  0xc0, 0xfe, 0xc6, 0xa1, 0xde, 0x83, 0x17, 0x20, 0x75, 0x49, 0xd7, 0xa2,
+  0xa5, 0x93, 0x83, 0x4b, 0xba, 0x16, 0x2d, 0x5c, 0x86, 0x5c, 0x8a, 0x13,
+  0x2d, 0xbc, 0x08, 0x3c, 0x20, 0x4c, 0xc0, 0x24, 0xdc, 0xfc, 0xeb, 0xe6,
+  0x7b, 0x60, 0x77, 0x38, 0x40, 0xe7, 0x41, 0xcd, 0xc1, 0x7a, 0x8d, 0xbd,
+  0xf3, 0x00, 0x69, 0xb8, 0xf6, 0xa0, 0x4f, 0x00, 0x15, 0xfd, 0x88, 0xa0,
+  0x7e, 0x58, 0xda, 0x3c, 0x3c, 0x3e, 0x71, 0x64, 0x6a, 0xa6, 0x7d, 0x72,
+  0x6e, 0xe4, 0xcc, 0xab, 0x47, 0x5f, 0x5e, 0xb2, 0x0b, 0x9f, 0x8d, 0x7e,
+  0xb8, 0xd2, 0xf8, 0x7c, 0xb5, 0xfc, 0x6e, 0x93, 0x7e, 0xa2, 0x81, 0x1b,
+  0xc7, 0x43, 0x17, 0x2a, 0x10, 0x00, 0x00, 0x00, 0x46, 0x49, 0x44, 0x41,
+  0x54, 0x5a, 0xbd, 0x47, 0x9a, 0x8d, 0xa7, 0x86, 0xee, 0x78, 0x69, 0xf0,
+  0xc4, 0xdb, 0x51, 0xfd, 0x82, 0xb6, 0xa9, 0x8d, 0xd4, 0xae, 0x5c, 0xf7,
+  0xf6, 0xcd, 0x7f, 0x1e, 0xb4, 0x3f, 0x14, 0x07, 0x0f, 0x41, 0xc1, 0x85,
+  0x72, 0x49, 0x1b, 0x2e, 0xbb, 0xdc, 0xe8, 0xf5, 0x45, 0x0f, 0xd4, 0xa2,
+  0x2b, 0x26, 0xc5, 0xef, 0x68, 0x6e, 0x1a, 0x6e, 0x76, 0xb9, 0xd5, 0xe3,
+  0x96, 0xf0, 0x20, 0xf0, 0x60, 0xf5, 0x0f, 0x25, 0x35, 0x34, 0x0b, 0xce,
+  0xb5, 0x29, 0xa6, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae,
+  0x42, 0x60, 0x82,
+};
+
+
+std::optional<Image> decodeWithStb(const ArrayView<std::uint8_t> png)
+{
+  int width = 0;
+  int height = 0;
+  const auto pData = stbi_load_from_memory(
+    png.data(), int(png.size()), &width, &height, nullptr, 4);
+  if (!pData)
+  {
+    return {};
+  }
+
+  const auto pPixels = reinterpret_cast<const Pixel*>(pData);
+  auto image = Image{
+    PixelBuffer{pPixels, pPixels + width * height},
+    std::size_t(width),
+    std::size_t(height)};
+  stbi_image_free(pData);
+  return image;
+}
+
+
+/** Decode with the built-in decoder and compare against STB Image
+ *
+ * Decodes in bands of 3 rows, to also exercise band splitting. Doesn't use
+ * loadImage(), since that falls back to STB Image on failure.
+ */
+void checkMatchesStb(const ArrayView<std::uint8_t> png)
+{
+  const auto expected = decodeWithStb(png);
+  REQUIRE(expected);
+
+  const auto width = expected->width();
+  const auto height = expected->height();
+  Image decoded{width, height};
+  auto numRowsDecoded = std::size_t{0};
+
+  const auto result = detail::decodePngRows(
+    png,
+    [&](const std::size_t firstRow, const ImageView& rows) {
+      CHECK(firstRow == numRowsDecoded);
+      CHECK(rows.height() <= 3);
+
+      decoded.insertImage(0, firstRow, rows);
+      numRowsDecoded += rows.height();
+    },
+    3);
+
+  REQUIRE(result == detail::PngDecodeResult::Success);
+  CHECK(numRowsDecoded == height);
+  CHECK(decoded.pixelData() == expected->pixelData());
+}
+
+} // namespace
+
+
+TEST_CASE("PNG encoding")
+{
+  // Decoded with STB Image, so that a bug shared by the built-in encoder and
+  // decoder can't go unnoticed.
+  const auto checkRoundTrip = [](const ImageView& image) {
+    const auto decoded = decodeWithStb(encodePng(image));
+    REQUIRE(decoded);
+    CHECK(decoded->pixelData() == Image{image}.pixelData());
+  };
+
+  SECTION("Single pixel")
+  {
+    checkRoundTrip(makeTestImage(1, 1).view());
+  }
+
+  SECTION("Single row and single column")
+  {
+    checkRoundTrip(makeTestImage(301, 1).view());
+    checkRoundTrip(makeTestImage(1, 301).view());
+  }
+
+  SECTION("Odd sizes")
+  {
+    checkRoundTrip(makeTestImage(3, 5).view());
+    checkRoundTrip(makeTestImage(123, 77).view());
+  }
+
+  SECTION("Multiple bands")
+  {
+    // Tall enough to be split into bands, with a last band that's shorter
+    // than the others
+    checkRoundTrip(makeTestImage(97, 1031).view());
+  }
+
+  SECTION("Highly compressible content")
+  {
+    const auto image =
+      Image{PixelBuffer(300 * 257, Color{10, 20, 30, 40}), 300, 257};
+    checkRoundTrip(image.view());
+  }
+
+  SECTION("Views with a stride and flipped views")
+  {
+    const auto image = makeTestImage(200, 150);
+    checkRoundTrip(image.subView(13, 7, 101, 99));
+    checkRoundTrip(image.view().flippedVertically());
+  }
+
+  SECTION("Empty images are rejected")
+  {
+    CHECK_THROWS_AS(encodePng(Image{0, 0}), std::invalid_argument);
+  }
+
+  SECTION("Asynchronous saving")
+  {
+    const auto directory =
+      std::filesystem::temp_directory_path() / "rigel_png_encoding_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const auto first = makeTestImage(64, 65);
+    const auto second = makeTestImage(5, 3);
+
+    auto firstSaved = savePngAsync(directory / "first.png", first);
+    auto secondSaved = savePngAsync(directory / "second.png", second);
+    auto failedSave =
+      savePngAsync(directory / "missing" / "third.png", second);
+
+    CHECK(firstSaved.get());
+    CHECK(secondSaved.get());
+    CHECK(!failedSave.get());
+
+    const auto firstLoaded =
+      decodeWithStb(loadFileOrThrow(directory / "first.png"));
+    REQUIRE(firstLoaded);
+    CHECK(firstLoaded->pixelData() == first.pixelData());
+
+    const auto secondLoaded =
+      decodeWithStb(loadFileOrThrow(directory / "second.png"));
+    REQUIRE(secondLoaded);
+    CHECK(secondLoaded->pixelData() == second.pixelData());
+
+    std::filesystem::remove_all(directory);
+  }
+}
+
+
+TEST_CASE("PNG decoding")
+{
+  const auto original = makeTestImage(123, 77);
+  const auto encoded = encodePng(original);
+
+  SECTION("Whole image")
+  {
+    const auto info = readImageInfo(encoded);
+    REQUIRE(info);
+    CHECK(info->width == 123);
+    CHECK(info->height == 77);
+
+    const auto decoded = loadImage(encoded);
+    REQUIRE(decoded);
+    CHECK(decoded->width() == 123);
+    CHECK(decoded->height() == 77);
+    CHECK(decoded->pixelData() == original.pixelData());
+  }
+
+  SECTION("Row bands")
+  {
+    Image assembled{123, 77};
+    auto expectedFirstRow = std::size_t{0};
+
+    const auto success = decodeImageRows(
+      encoded,
+      [&](const std::size_t firstRow, const ImageView& rows) {
+        CHECK(firstRow == expectedFirstRow);
+        CHECK(rows.width() == 123);
+        CHECK(rows.height() <= 10);
+        CHECK(rows.height() > 0);
+
+        assembled.insertImage(0, firstRow, rows);
+        expectedFirstRow += rows.height();
+      },
+      10);
+
+    CHECK(success);
+    CHECK(expectedFirstRow == 77);
+    CHECK(assembled.pixelData() == original.pixelData());
+  }
+
+  SECTION("zlib header split across IDAT chunks")
+  {
+    // Both are valid PNG files: Nothing requires IDAT chunks to be
+    // non-empty, or to be split at any particular point.
+    const auto withEmptyChunk = splitImageData(encoded, {0});
+    const auto withSplitHeader = splitImageData(encoded, {1, 0, 5});
+
+    for (const auto& png : {withEmptyChunk, withSplitHeader})
+    {
+      Image assembled{123, 77};
+      const auto success = decodeImageRows(
+        png,
+        [&](const std::size_t firstRow, const ImageView& rows) {
+          assembled.insertImage(0, firstRow, rows);
+        },
+        10);
+
+      CHECK(success);
+      CHECK(assembled.pixelData() == original.pixelData());
+
+      const auto decoded = loadImage(png);
+      REQUIRE(decoded);
+      CHECK(decoded->pixelData() == original.pixelData());
+    }
+  }
+
+  SECTION("Corrupt data")
+  {
+    auto corrupted = encoded;
+    corrupted.resize(corrupted.size() / 2);
+
+    CHECK(!loadImage(corrupted));
+    CHECK(!decodeImageRows(
+      corrupted, [](std::size_t, const ImageView&) {}, 10));
+  }
+}
+
+
+TEST_CASE("PNG decoding matches STB Image")
+{
+  SECTION("Dynamic Huffman codes")
+  {
+    checkMatchesStb(RGB_DYNAMIC_HUFFMAN);
+  }
+
+  SECTION("Stored blocks")
+  {
+    checkMatchesStb(RGBA_STORED_BLOCKS);
+  }
+
+  SECTION("Grayscale")
+  {
+    checkMatchesStb(GRAY_8);
+    checkMatchesStb(GRAY_ALPHA_8);
+  }
+
+  SECTION("Bit depths below 8")
+  {
+    checkMatchesStb(GRAY_1);
+    checkMatchesStb(GRAY_2);
+    checkMatchesStb(GRAY_4);
+    checkMatchesStb(PALETTE_2);
+    checkMatchesStb(PALETTE_4);
+  }
+
+  SECTION("16 bit")
+  {
+    checkMatchesStb(RGB_16);
+    checkMatchesStb(GRAY_ALPHA_16);
+  }
+
+  SECTION("Palette with transparency")
+  {
+    checkMatchesStb(PALETTE_8_TRNS);
+  }
+
+  SECTION("Transparent color key")
+  {
+    checkMatchesStb(GRAY_8_TRNS);
+    checkMatchesStb(RGB_8_TRNS);
+  }
+
+  SECTION("Multiple IDAT chunks")
+  {
+    checkMatchesStb(RGB_MULTIPLE_CHUNKS);
+  }
+}
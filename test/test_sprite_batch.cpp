@@ -0,0 +1,208 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/warnings.hpp>
+#include <rigel/opengl/sprite_batch.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <vector>
+
+
+using namespace rigel::opengl;
+using detail::MAX_QUADS_PER_DRAW;
+using detail::QuadRun;
+using detail::QueuedQuad;
+
+
+namespace
+{
+
+// Batching only compares shader pointers, it never dereferences them. This
+// makes it possible to test it without an OpenGL context.
+int gShaderStandIns[2];
+
+const auto pShaderA = reinterpret_cast<const Shader*>(&gShaderStandIns[0]);
+const auto pShaderB = reinterpret_cast<const Shader*>(&gShaderStandIns[1]);
+
+
+std::vector<QueuedQuad> makeQuads(
+  const Shader* pShader,
+  const GLuint texture,
+  const std::size_t count)
+{
+  return std::vector<QueuedQuad>(count, QueuedQuad{pShader, texture, 0});
+}
+
+
+std::vector<QuadRun> runsFor(const std::vector<QueuedQuad>& quads)
+{
+  std::vector<QuadRun> runs;
+  detail::splitIntoRuns(quads, runs);
+  return runs;
+}
+
+} // namespace
+
+
+namespace rigel::opengl::detail
+{
+
+bool operator==(const QuadRun& lhs, const QuadRun& rhs)
+{
+  return lhs.mFirst == rhs.mFirst && lhs.mCount == rhs.mCount;
+}
+
+} // namespace rigel::opengl::detail
+
+
+TEST_CASE("Sprite batch run splitting")
+{
+  SECTION("No quads give no runs")
+  {
+    CHECK(runsFor({}).empty());
+  }
+
+  SECTION("Quads sharing shader and texture are merged")
+  {
+    const auto runs = runsFor(makeQuads(pShaderA, 1, 10));
+    CHECK(runs == std::vector<QuadRun>{{0, 10}});
+  }
+
+  SECTION("Runs are split on shader or texture changes")
+  {
+    const auto quads = std::vector<QueuedQuad>{
+      {pShaderA, 1, 0},
+      {pShaderA, 1, 16},
+      {pShaderA, 2, 32},
+      {pShaderB, 2, 48},
+      {pShaderB, 2, 72},
+      {pShaderA, 1, 96},
+    };
+
+    const auto expected =
+      std::vector<QuadRun>{{0, 2}, {2, 1}, {3, 2}, {5, 1}};
+    CHECK(runsFor(quads) == expected);
+  }
+
+  SECTION("Runs fitting exactly into one draw call aren't split")
+  {
+    const auto runs = runsFor(makeQuads(pShaderA, 1, MAX_QUADS_PER_DRAW));
+    CHECK(runs == std::vector<QuadRun>{{0, MAX_QUADS_PER_DRAW}});
+  }
+
+  SECTION("Runs exceeding the index range are split")
+  {
+    CHECK(MAX_QUADS_PER_DRAW == 16384);
+
+    const auto runs =
+      runsFor(makeQuads(pShaderA, 1, 2 * MAX_QUADS_PER_DRAW + 5));
+    const auto expected = std::vector<QuadRun>{
+      {0, MAX_QUADS_PER_DRAW},
+      {MAX_QUADS_PER_DRAW, MAX_QUADS_PER_DRAW},
+      {2 * MAX_QUADS_PER_DRAW, 5}};
+    CHECK(runs == expected);
+  }
+
+  SECTION("Splitting restarts at each shader or texture change")
+  {
+    auto quads = makeQuads(pShaderA, 1, 10);
+    const auto more = makeQuads(pShaderA, 2, MAX_QUADS_PER_DRAW + 1);
+    quads.insert(quads.end(), more.begin(), more.end());
+
+    const auto expected = std::vector<QuadRun>{
+      {0, 10}, {10, MAX_QUADS_PER_DRAW}, {10 + MAX_QUADS_PER_DRAW, 1}};
+    CHECK(runsFor(quads) == expected);
+  }
+
+  SECTION("Previous contents of the output are replaced")
+  {
+    std::vector<QuadRun> runs{{7, 7}, {8, 8}};
+    detail::splitIntoRuns(makeQuads(pShaderB, 3, 2), runs);
+    CHECK(runs == std::vector<QuadRun>{{0, 2}});
+  }
+}
+
+
+TEST_CASE("Sprite batch sorting")
+{
+  auto quads = std::vector<QueuedQuad>{
+    {pShaderB, 1, 0},
+    {pShaderA, 2, 16},
+    {pShaderB, 1, 32},
+    {pShaderA, 1, 48},
+    {pShaderA, 2, 64},
+    {pShaderB, 0, 80},
+    {pShaderA, 1, 96},
+  };
+
+  detail::sortByShaderAndTexture(quads);
+
+  SECTION("Quads are grouped by shader, then texture")
+  {
+    const auto expected = std::vector<QueuedQuad>{
+      {pShaderA, 1, 48},
+      {pShaderA, 1, 96},
+      {pShaderA, 2, 16},
+      {pShaderA, 2, 64},
+      {pShaderB, 0, 80},
+      {pShaderB, 1, 0},
+      {pShaderB, 1, 32},
+    };
+
+    REQUIRE(quads.size() == expected.size());
+    for (std::size_t i = 0; i < quads.size(); ++i)
+    {
+      CHECK(quads[i].mpShader == expected[i].mpShader);
+      CHECK(quads[i].mTexture == expected[i].mTexture);
+
+      // Submission order is kept within each group
+      CHECK(quads[i].mDataOffset == expected[i].mDataOffset);
+    }
+  }
+
+  SECTION("Sorted quads need one run per shader and texture combination")
+  {
+    CHECK(runsFor(quads).size() == 4);
+  }
+}
+
+
+TEST_CASE("Sprite batch stats")
+{
+  SpriteBatchStats stats;
+
+  auto quads = makeQuads(pShaderA, 1, MAX_QUADS_PER_DRAW + 3);
+  quads.push_back(QueuedQuad{pShaderB, 0, 0});
+
+  for (const auto& run : runsFor(quads))
+  {
+    detail::addToStats(stats, run);
+  }
+
+  CHECK(stats.drawCalls == 3);
+  CHECK(stats.vertices == (MAX_QUADS_PER_DRAW + 4) * 4);
+
+  SECTION("Stats accumulate across flushes")
+  {
+    detail::addToStats(stats, QuadRun{0, 2});
+
+    CHECK(stats.drawCalls == 4);
+    CHECK(stats.vertices == (MAX_QUADS_PER_DRAW + 6) * 4);
+  }
+}
@@ -0,0 +1,162 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rigel/base/texture_atlas.hpp>
+#include <rigel/base/thread_pool.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <cstdint>
+#include <stdexcept>
+
+
+using namespace rigel::base;
+
+
+namespace
+{
+
+Image makeSolidImage(
+  const std::size_t width,
+  const std::size_t height,
+  const std::uint8_t id)
+{
+  const auto color = Color{id, 0, 0, 255};
+  return Image{PixelBuffer(width * height, color), width, height};
+}
+
+
+const Color& pixelAt(const Image& image, const int x, const int y)
+{
+  return image.pixelData()[x + y * image.width()];
+}
+
+
+bool containsImage(const TextureAtlas& atlas, const std::size_t id)
+{
+  const auto& [pageIndex, rect] = atlas.locations[id];
+  const auto& page = atlas.pages[pageIndex];
+
+  for (auto y = rect.top(); y <= rect.bottom(); ++y)
+  {
+    for (auto x = rect.left(); x <= rect.right(); ++x)
+    {
+      if (pixelAt(page, x, y).r != id)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+
+TEST_CASE("Texture atlas packing")
+{
+  SECTION("Images are placed without overlap")
+  {
+    TextureAtlasBuilder builder{{128, 1, 0}};
+    for (auto i = 0; i < 20; ++i)
+    {
+      builder.add(makeSolidImage(6 + i, 20 - i / 2, std::uint8_t(i)));
+    }
+
+    ThreadPool threadPool{2};
+    const auto atlas = builder.build(threadPool);
+
+    REQUIRE(atlas.pages.size() == 1);
+    REQUIRE(atlas.locations.size() == 20);
+    CHECK(atlas.pages[0].width() <= 128);
+    CHECK(atlas.pages[0].height() <= 128);
+
+    for (auto id = 0u; id < 20; ++id)
+    {
+      CHECK(atlas.locations[id].rect.size.width == int(6 + id));
+      CHECK(containsImage(atlas, id));
+
+      for (auto other = id + 1; other < 20; ++other)
+      {
+        const auto& rect = atlas.locations[id].rect;
+        CHECK(!rect.intersects(atlas.locations[other].rect));
+      }
+    }
+  }
+
+  SECTION("Multiple pages")
+  {
+    TextureAtlasBuilder builder{{64, 0, 0}};
+    for (auto i = 0; i < 9; ++i)
+    {
+      builder.add(makeSolidImage(30, 30, std::uint8_t(i)));
+    }
+
+    const auto atlas = builder.build();
+
+    REQUIRE(atlas.pages.size() == 3);
+    for (auto id = 0u; id < 9; ++id)
+    {
+      CHECK(containsImage(atlas, id));
+    }
+  }
+
+  SECTION("Views and extrusion")
+  {
+    PixelBuffer pixels;
+    for (auto i = 0; i < 6; ++i)
+    {
+      pixels.push_back(Color{std::uint8_t(i), 0, 0, 255});
+    }
+
+    const auto sheet = Image{pixels, 3, 2};
+
+    TextureAtlasBuilder builder{{16, 0, 2}};
+    builder.add(sheet.subView(1, 0, 2, 2));
+    const auto atlas = builder.build();
+
+    const auto& page = atlas.pages[0];
+    const auto& rect = atlas.locations[0].rect;
+
+    CHECK(page.width() == 6);
+    CHECK(page.height() == 6);
+    CHECK(rect == Rect<int>{{2, 2}, {2, 2}});
+
+    CHECK(pixelAt(page, 2, 2).r == 1);
+    CHECK(pixelAt(page, 3, 3).r == 5);
+    CHECK(pixelAt(page, 0, 0).r == 1);
+    CHECK(pixelAt(page, 5, 0).r == 2);
+    CHECK(pixelAt(page, 0, 5).r == 4);
+    CHECK(pixelAt(page, 5, 4).r == 5);
+  }
+
+  SECTION("Images that don't fit are rejected")
+  {
+    TextureAtlasBuilder builder{{32, 0, 1}};
+    CHECK_THROWS_AS(builder.add(Image{31, 4}), std::invalid_argument);
+
+    // The builder is still usable, and the rejected image left no trace
+    CHECK(builder.add(Image{30, 4}) == 0);
+    CHECK(builder.build().pages.size() == 1);
+
+    CHECK_THROWS_AS(
+      TextureAtlasBuilder(TextureAtlasConfig{0, 0, 0}), std::invalid_argument);
+  }
+}
@@ -0,0 +1,130 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <rigel/base/thread_pool.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+using namespace rigel::base;
+
+
+TEST_CASE("Thread pool")
+{
+  SECTION("All submitted tasks are executed")
+  {
+    constexpr auto NUM_TASKS = 1000;
+
+    std::atomic<int> numExecuted{0};
+
+    {
+      ThreadPool pool{4};
+      REQUIRE(pool.numThreads() == 4);
+
+      for (auto i = 0; i < NUM_TASKS; ++i)
+      {
+        pool.submit([&]() { ++numExecuted; });
+      }
+    }
+
+    CHECK(numExecuted == NUM_TASKS);
+  }
+
+  SECTION("Futures receive the task's result")
+  {
+    ThreadPool pool{3};
+
+    std::vector<std::future<int>> results;
+    for (auto i = 0; i < 100; ++i)
+    {
+      results.push_back(pool.submit([i]() { return i * i; }));
+    }
+
+    for (auto i = 0; i < 100; ++i)
+    {
+      CHECK(results[i].get() == i * i);
+    }
+
+    auto stringResult = pool.submit([]() { return std::string{"done"}; });
+    CHECK(stringResult.get() == "done");
+  }
+
+  SECTION("Exceptions are propagated through the future")
+  {
+    ThreadPool pool{2};
+
+    auto failing =
+      pool.submit([]() -> int { throw std::runtime_error("Task failed"); });
+    auto succeeding = pool.submit([]() { return 42; });
+
+    CHECK_THROWS_AS(failing.get(), std::runtime_error);
+
+    // The worker survives the exception and keeps executing tasks
+    CHECK(succeeding.get() == 42);
+    CHECK(pool.submit([]() { return 7; }).get() == 7);
+  }
+
+  SECTION("Destruction finishes all queued tasks")
+  {
+    std::promise<void> unblock;
+    auto unblockFuture = unblock.get_future().share();
+    std::atomic<int> numExecuted{0};
+    std::vector<std::future<void>> results;
+
+    {
+      ThreadPool pool{1};
+
+      // The single worker is stuck on the first task, so all others are
+      // still queued when the pool is destroyed.
+      results.push_back(pool.submit([unblockFuture]() {
+        unblockFuture.wait();
+      }));
+
+      for (auto i = 0; i < 50; ++i)
+      {
+        results.push_back(pool.submit([&]() { ++numExecuted; }));
+      }
+
+      unblock.set_value();
+    }
+
+    CHECK(numExecuted == 50);
+    for (auto& result : results)
+    {
+      CHECK(
+        result.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    }
+  }
+
+  SECTION("The pool always has at least one worker")
+  {
+    ThreadPool pool{0};
+    CHECK(pool.numThreads() == 1);
+    CHECK(pool.submit([]() { return 1; }).get() == 1);
+  }
+}
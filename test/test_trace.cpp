@@ -0,0 +1,104 @@
+/* Copyright (C) 2024, Nikolai Wuttke. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <rigel/base/trace.hpp>
+#include <rigel/base/warnings.hpp>
+
+RIGEL_DISABLE_WARNINGS
+#include <catch2/catch_test_macros.hpp>
+#include <nlohmann/json.hpp>
+RIGEL_RESTORE_WARNINGS
+
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+
+using namespace rigel::base;
+
+
+TEST_CASE("Chrome trace export")
+{
+  const auto writeTrace = []() {
+    std::stringstream stream;
+    writeChromeTrace(stream);
+    return nlohmann::json::parse(stream.str());
+  };
+
+  SECTION("Nothing is recorded while tracing is stopped")
+  {
+    startTracing();
+    stopTracing();
+
+    {
+      TraceScope scope{"ignored"};
+    }
+
+    CHECK(writeTrace()["traceEvents"].empty());
+  }
+
+  SECTION("Scopes from multiple threads are recorded")
+  {
+    startTracing();
+
+    {
+      TraceScope outer{"outer"};
+      TraceScope inner{"inner \"quoted\""};
+    }
+
+    std::thread{[]() { TraceScope scope{"worker"}; }}.join();
+
+    stopTracing();
+
+    const auto trace = writeTrace();
+    const auto& events = trace["traceEvents"];
+    REQUIRE(events.size() == 3);
+
+    std::set<std::string> names;
+    std::set<int> threadIds;
+    for (const auto& event : events)
+    {
+      CHECK(event["ph"] == "X");
+      CHECK(event["dur"].get<double>() >= 0.0);
+      names.insert(event["name"].get<std::string>());
+      threadIds.insert(event["tid"].get<int>());
+    }
+
+    const auto expectedNames =
+      std::set<std::string>{"outer", "inner \"quoted\"", "worker"};
+    CHECK(names == expectedNames);
+    CHECK(threadIds.size() == 2);
+  }
+
+  SECTION("Restarting discards events from all threads")
+  {
+    startTracing();
+    std::thread{[]() { TraceScope scope{"previous session"}; }}.join();
+
+    startTracing();
+    {
+      TraceScope scope{"current session"};
+    }
+    stopTracing();
+
+    const auto trace = writeTrace();
+    const auto& events = trace["traceEvents"];
+    REQUIRE(events.size() == 1);
+    CHECK(events[0]["name"] == "current session");
+  }
+}